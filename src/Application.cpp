@@ -3,6 +3,9 @@
 #define TOML_EXCEPTIONS 0
 #include "toml.hpp"
 
+#include "ThreadPool.h"
+#include "Compute/ComputeKernels.h"
+
 #include "backends/imgui_impl_glfw.h"
 #include "backends/imgui_impl_vulkan.h"
 #include <stdio.h>          // printf, fprintf
@@ -12,7 +15,11 @@
 #include <GLFW/glfw3.h>
 #include <vulkan/vulkan.h>
 
+#include <algorithm>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <mutex>
 #include <nfd.h>
 
 
@@ -47,17 +54,37 @@ static VkQueue                  g_Queue = VK_NULL_HANDLE;
 static VkDebugReportCallbackEXT g_DebugReport = VK_NULL_HANDLE;
 static VkPipelineCache          g_PipelineCache = VK_NULL_HANDLE;
 static VkDescriptorPool         g_DescriptorPool = VK_NULL_HANDLE;
+static Surge::GpuAllocator*     g_GpuAllocator = nullptr;
+static Surge::StagingRing*      g_StagingRing = nullptr;
+static Surge::DescriptorCache*  g_DescriptorCache = nullptr;
+// Builds the compute kernels in the background while the window and ImGui are set up.
+static Surge::ThreadPool*       g_ThreadPool = nullptr;
+static Surge::Profiler*         g_Profiler = nullptr;
+// Whether the instance was made with VK_EXT_debug_utils, which the profiler labels dispatches with.
+static bool                     g_DebugUtils = false;
 
 static ImGui_ImplVulkanH_Window g_MainWindowData;
 static int                      g_MinImageCount = 2;
 static bool                     g_SwapChainRebuild = false;
 
+static uint32_t					g_ComputeQueueFamily = (uint32_t)-1;
 static VkQueue					g_ComputeQueue;
-static VkCommandPool			g_ComputeCommandPool;
+
+// Queues have to be externally synchronised and the compute queue is usually the graphics queue too,
+// so every submit and present goes through this once the evaluation thread is running.
+static std::mutex				s_QueueMutex;
+
+// Command pools can only be used by one thread at a time, so every thread recording compute work gets its own.
+static std::mutex				s_ComputeCommandPoolsMutex;
+static std::vector<VkCommandPool> s_ComputeCommandPools;
+static thread_local VkCommandPool s_ThreadComputeCommandPool = VK_NULL_HANDLE;
+static thread_local VkCommandBuffer s_ComputeBatchCommandBuffer = VK_NULL_HANDLE;
+static thread_local std::vector<std::function<void()>> s_ComputeResourceFreeQueue;
 
 // Per-frame-in-flight
 static std::vector<std::vector<VkCommandBuffer>> s_AllocatedCommandBuffers;
 static std::vector<std::vector<std::function<void()>>> s_ResourceFreeQueue;
+static std::mutex s_ResourceFreeMutex;
 
 // Unlike g_MainWindowData.FrameIndex, this is not the the swapchain image index
 // and is always guaranteed to increase (eg. 0, 1, 2, 0, 1, 2)
@@ -96,6 +123,87 @@ static uint32_t GetQueueFamily(VkPhysicalDevice device, VkQueueFlagBits familyFl
 }
 
 
+// Compute pipelines are kept between runs in this file. Vulkan's own cache header doesn't cover the
+// driver version, so the data is preceded by one of ours, and anything not matching the device and
+// driver in use is thrown away rather than handed to the driver.
+static const char* PipelineCachePath = "pipeline_cache.bin";
+static constexpr uint32_t PipelineCacheMagic = 0x43504753; // "SGPC"
+static constexpr uint32_t PipelineCacheVersion = 1;
+
+struct PipelineCacheFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vendorID;
+	uint32_t deviceID;
+	uint32_t driverVersion;
+	uint8_t  pipelineCacheUUID[VK_UUID_SIZE];
+	// Keeps the struct free of padding, headers are compared with memcmp.
+	uint32_t reserved;
+	uint64_t dataSize;
+};
+
+static PipelineCacheFileHeader GetPipelineCacheFileHeader(uint64_t dataSize)
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(g_PhysicalDevice, &properties);
+
+	PipelineCacheFileHeader header = {};
+	header.magic = PipelineCacheMagic;
+	header.version = PipelineCacheVersion;
+	header.vendorID = properties.vendorID;
+	header.deviceID = properties.deviceID;
+	header.driverVersion = properties.driverVersion;
+	memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+	header.dataSize = dataSize;
+	return header;
+}
+
+static std::vector<char> LoadPipelineCacheData()
+{
+	std::ifstream file(PipelineCachePath, std::ios::binary | std::ios::ate);
+	if (!file)
+	{
+		return {};
+	}
+	const uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+	file.seekg(0);
+
+	PipelineCacheFileHeader header = {};
+	const PipelineCacheFileHeader expected = GetPipelineCacheFileHeader(fileSize - sizeof(header));
+	if (fileSize < sizeof(header) || !file.read(reinterpret_cast<char*>(&header), sizeof(header)) || memcmp(&header, &expected, sizeof(header)) != 0)
+	{
+		printf("[vulkan] Discarding %s, it was written for another device or driver\n", PipelineCachePath);
+		return {};
+	}
+
+	std::vector<char> data(header.dataSize);
+	if (!file.read(data.data(), static_cast<std::streamsize>(data.size())))
+	{
+		return {};
+	}
+	return data;
+}
+
+static void SavePipelineCacheData()
+{
+	size_t size = 0;
+	if (vkGetPipelineCacheData(g_Device, g_PipelineCache, &size, nullptr) != VK_SUCCESS || size == 0)
+	{
+		return;
+	}
+	std::vector<char> data(size);
+	if (vkGetPipelineCacheData(g_Device, g_PipelineCache, &size, data.data()) != VK_SUCCESS)
+	{
+		return;
+	}
+
+	const PipelineCacheFileHeader header = GetPipelineCacheFileHeader(size);
+	std::ofstream file(PipelineCachePath, std::ios::binary | std::ios::trunc);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(data.data(), static_cast<std::streamsize>(size));
+}
+
 #ifdef IMGUI_VULKAN_DEBUG_REPORT
 static VKAPI_ATTR VkBool32 VKAPI_CALL debug_report(VkDebugReportFlagsEXT flags, VkDebugReportObjectTypeEXT objectType, uint64_t object, size_t location, int32_t messageCode, const char* pLayerPrefix, const char* pMessage, void* pUserData)
 {
@@ -105,46 +213,95 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL debug_report(VkDebugReportFlagsEXT flags,
 }
 #endif // IMGUI_VULKAN_DEBUG_REPORT
 
-static void SetupVulkan(const char** extensions, uint32_t extensions_count)
+static bool IsInstanceExtensionAvailable(const char* name)
+{
+	uint32_t count = 0;
+	vkEnumerateInstanceExtensionProperties(nullptr, &count, nullptr);
+	std::vector<VkExtensionProperties> extensions(count);
+	vkEnumerateInstanceExtensionProperties(nullptr, &count, extensions.data());
+	for (const VkExtensionProperties& extension : extensions)
+	{
+		if (strcmp(extension.extensionName, name) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool IsInstanceLayerAvailable(const char* name)
+{
+	uint32_t count = 0;
+	vkEnumerateInstanceLayerProperties(&count, nullptr);
+	std::vector<VkLayerProperties> layers(count);
+	vkEnumerateInstanceLayerProperties(&count, layers.data());
+	for (const VkLayerProperties& layer : layers)
+	{
+		if (strcmp(layer.layerName, name) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+// Headless, there is no surface to present to, so the device only needs a queue that can run
+// compute and none of the window system extensions.
+static void SetupVulkan(const char** extensions, uint32_t extensions_count, bool headless)
 {
 	VkResult err;
 
 	// Create Vulkan Instance
 	{
+		// Lets captures show which node each dispatch belongs to, wherever the loader has it.
+		std::vector<const char*> instance_extensions(extensions, extensions + extensions_count);
+		g_DebugUtils = IsInstanceExtensionAvailable(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+		if (g_DebugUtils)
+		{
+			instance_extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+		}
+
 		VkInstanceCreateInfo create_info = {};
 		create_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
-		create_info.enabledExtensionCount = extensions_count;
-		create_info.ppEnabledExtensionNames = extensions;
+		create_info.enabledExtensionCount = static_cast<uint32_t>(instance_extensions.size());
+		create_info.ppEnabledExtensionNames = instance_extensions.data();
 #ifdef IMGUI_VULKAN_DEBUG_REPORT
-		// Enabling validation layers
-		const char* layers[] = { "VK_LAYER_KHRONOS_validation" };
-		create_info.enabledLayerCount = 1;
-		create_info.ppEnabledLayerNames = layers;
-
-		// Enable debug report extension (we need additional storage, so we duplicate the user array to add our new extension to it)
-		const char** extensions_ext = (const char**)malloc(sizeof(const char*) * (extensions_count + 1));
-		memcpy(extensions_ext, extensions, extensions_count * sizeof(const char*));
-		extensions_ext[extensions_count] = "VK_EXT_debug_report";
-		create_info.enabledExtensionCount = extensions_count + 1;
-		create_info.ppEnabledExtensionNames = extensions_ext;
-
-		// Create Vulkan Instance
-		err = vkCreateInstance(&create_info, g_Allocator, &g_Instance);
-		check_vk_result(err);
-		free(extensions_ext);
-
-		// Get the function pointer (required for any extensions)
-		auto vkCreateDebugReportCallbackEXT = (PFN_vkCreateDebugReportCallbackEXT)vkGetInstanceProcAddr(g_Instance, "vkCreateDebugReportCallbackEXT");
-		IM_ASSERT(vkCreateDebugReportCallbackEXT != NULL);
-
-		// Setup the debug report callback
-		VkDebugReportCallbackCreateInfoEXT debug_report_ci = {};
-		debug_report_ci.sType = VK_STRUCTURE_TYPE_DEBUG_REPORT_CALLBACK_CREATE_INFO_EXT;
-		debug_report_ci.flags = VK_DEBUG_REPORT_ERROR_BIT_EXT | VK_DEBUG_REPORT_WARNING_BIT_EXT | VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT;
-		debug_report_ci.pfnCallback = debug_report;
-		debug_report_ci.pUserData = NULL;
-		err = vkCreateDebugReportCallbackEXT(g_Instance, &debug_report_ci, g_Allocator, &g_DebugReport);
-		check_vk_result(err);
+		if (IsInstanceLayerAvailable("VK_LAYER_KHRONOS_validation"))
+		{
+			// Enabling validation layers
+			const char* layers[] = { "VK_LAYER_KHRONOS_validation" };
+			create_info.enabledLayerCount = 1;
+			create_info.ppEnabledLayerNames = layers;
+
+			// Enable debug report extension
+			instance_extensions.push_back("VK_EXT_debug_report");
+			create_info.enabledExtensionCount = static_cast<uint32_t>(instance_extensions.size());
+			create_info.ppEnabledExtensionNames = instance_extensions.data();
+
+			// Create Vulkan Instance
+			err = vkCreateInstance(&create_info, g_Allocator, &g_Instance);
+			check_vk_result(err);
+
+			// Get the function pointer (required for any extensions)
+			auto vkCreateDebugReportCallbackEXT = (PFN_vkCreateDebugReportCallbackEXT)vkGetInstanceProcAddr(g_Instance, "vkCreateDebugReportCallbackEXT");
+			IM_ASSERT(vkCreateDebugReportCallbackEXT != NULL);
+
+			// Setup the debug report callback
+			VkDebugReportCallbackCreateInfoEXT debug_report_ci = {};
+			debug_report_ci.sType = VK_STRUCTURE_TYPE_DEBUG_REPORT_CALLBACK_CREATE_INFO_EXT;
+			debug_report_ci.flags = VK_DEBUG_REPORT_ERROR_BIT_EXT | VK_DEBUG_REPORT_WARNING_BIT_EXT | VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT;
+			debug_report_ci.pfnCallback = debug_report;
+			debug_report_ci.pUserData = NULL;
+			err = vkCreateDebugReportCallbackEXT(g_Instance, &debug_report_ci, g_Allocator, &g_DebugReport);
+			check_vk_result(err);
+		}
+		else
+		{
+			// Render machines often only have the driver installed, carry on without validation there.
+			printf("[vulkan] VK_LAYER_KHRONOS_validation isn't installed, running without validation\n");
+			err = vkCreateInstance(&create_info, g_Allocator, &g_Instance);
+			check_vk_result(err);
+		}
 #else
 		// Create Vulkan Instance without any debug feature
 		err = vkCreateInstance(&create_info, g_Allocator, &g_Instance);
@@ -167,30 +324,46 @@ static void SetupVulkan(const char** extensions, uint32_t extensions_count)
 		// If a number >1 of GPUs got reported, find discrete GPU if present, or use first one available. This covers
 		// most common cases (multi-gpu/integrated+dedicated graphics). Handling more complicated setups (multiple
 		// dedicated GPUs) is out of scope of this sample.
+		// A GPU asked for by name in the AppConfig is used instead when there is one.
+		const std::string& wanted = Surge::Application::GetConfig().deviceName;
 		int use_gpu = 0;
+		bool found = false;
 		for (int i = 0; i < (int)gpu_count; i++)
 		{
 			VkPhysicalDeviceProperties properties;
 			vkGetPhysicalDeviceProperties(gpus[i], &properties);
-			if (properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU)
+			if (!wanted.empty() && strstr(properties.deviceName, wanted.c_str()) != nullptr)
 			{
 				use_gpu = i;
+				found = true;
 				break;
 			}
+			if (wanted.empty() && properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU)
+			{
+				use_gpu = i;
+				break;
+			}
+		}
+		if (!wanted.empty() && !found)
+		{
+			VkPhysicalDeviceProperties properties;
+			vkGetPhysicalDeviceProperties(gpus[use_gpu], &properties);
+			fprintf(stderr, "No GPU called %s, using %s\n", wanted.c_str(), properties.deviceName);
 		}
 
 		g_PhysicalDevice = gpus[use_gpu];
 		free(gpus);
 	}
 
-	// Select graphics queue family
+	// Select graphics queue family, or just compute when headless
 	{
+		const VkQueueFlags queue_flags = headless ? VK_QUEUE_COMPUTE_BIT : VK_QUEUE_GRAPHICS_BIT;
 		uint32_t count;
 		vkGetPhysicalDeviceQueueFamilyProperties(g_PhysicalDevice, &count, NULL);
 		VkQueueFamilyProperties* queues = (VkQueueFamilyProperties*)malloc(sizeof(VkQueueFamilyProperties) * count);
 		vkGetPhysicalDeviceQueueFamilyProperties(g_PhysicalDevice, &count, queues);
 		for (uint32_t i = 0; i < count; i++)
-			if (queues[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
+			if (queues[i].queueFlags & queue_flags)
 			{
 				g_QueueFamily = i;
 				break;
@@ -201,7 +374,7 @@ static void SetupVulkan(const char** extensions, uint32_t extensions_count)
 
 	// Create Logical Device (with 1 graphics queue)
 	{
-		int device_extension_count = 1;
+		const uint32_t device_extension_count = headless ? 0 : 1;
 		const char* device_extensions[] = { "VK_KHR_swapchain" };
 		const float queue_priority[] = { 1.0f };
 		VkDeviceQueueCreateInfo queue_info[1] = {};
@@ -220,17 +393,38 @@ static void SetupVulkan(const char** extensions, uint32_t extensions_count)
 		vkGetDeviceQueue(g_Device, g_QueueFamily, 0, &g_Queue);
 	}
 
-	// Create Compute Queue & Compute CommandPool
+	// Shared by ImGui and every compute kernel.
 	{
-		int computeQueueId = GetQueueFamily( g_PhysicalDevice, VK_QUEUE_COMPUTE_BIT );
-		
-		//CreateCommandPool
-		VkCommandPoolCreateInfo poolCI = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
-		poolCI.queueFamilyIndex = computeQueueId;
-		vkCreateCommandPool( g_Device, &poolCI, g_Allocator, &g_ComputeCommandPool );
+		const std::vector<char> data = LoadPipelineCacheData();
+		VkPipelineCacheCreateInfo pipelineCacheCI = { VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
+		pipelineCacheCI.initialDataSize = data.size();
+		pipelineCacheCI.pInitialData = data.empty() ? nullptr : data.data();
+		err = vkCreatePipelineCache(g_Device, &pipelineCacheCI, g_Allocator, &g_PipelineCache);
+		if (err != VK_SUCCESS && !data.empty())
+		{
+			// The header matched but the driver still refused the data, start over without it.
+			pipelineCacheCI.initialDataSize = 0;
+			pipelineCacheCI.pInitialData = nullptr;
+			err = vkCreatePipelineCache(g_Device, &pipelineCacheCI, g_Allocator, &g_PipelineCache);
+		}
+		check_vk_result(err);
+	}
 
-		vkGetDeviceQueue( g_Device, computeQueueId, 0, &g_ComputeQueue );
+	g_GpuAllocator = new Surge::GpuAllocator(g_PhysicalDevice, g_Device);
+	// Room for a few full size RGBA uploads in flight, larger transfers get a buffer of their own.
+	g_StagingRing = new Surge::StagingRing(g_Device, 64ull * 1024 * 1024);
+	// Comfortably more than the sets one evaluation of a large graph binds.
+	g_DescriptorCache = new Surge::DescriptorCache(g_Device, 1024);
+
+	// Create Compute Queue, the command pools are created per thread in GetThreadComputeCommandPool
+	{
+		// The device was only created with a queue from g_QueueFamily, which headless was picked for compute.
+		g_ComputeQueueFamily = headless ? g_QueueFamily : GetQueueFamily( g_PhysicalDevice, VK_QUEUE_COMPUTE_BIT );
+
+		vkGetDeviceQueue( g_Device, g_ComputeQueueFamily, 0, &g_ComputeQueue );
 	}
+
+	g_Profiler = new Surge::Profiler(g_Instance, g_PhysicalDevice, g_Device, g_ComputeQueueFamily, g_DebugUtils);
 	
 	// Create Descriptor Pool
 	{
@@ -295,14 +489,34 @@ static void SetupVulkanWindow(ImGui_ImplVulkanH_Window* wd, VkSurfaceKHR surface
 
 static void CleanupVulkan()
 {
-	vkDestroyCommandPool( g_Device, g_ComputeCommandPool, g_Allocator );
+	for (VkCommandPool pool : s_ComputeCommandPools)
+	{
+		vkDestroyCommandPool( g_Device, pool, g_Allocator );
+	}
+	s_ComputeCommandPools.clear();
+
+	delete g_Profiler;
+	g_Profiler = nullptr;
+	delete g_DescriptorCache;
+	g_DescriptorCache = nullptr;
+	delete g_StagingRing;
+	g_StagingRing = nullptr;
+	delete g_GpuAllocator;
+	g_GpuAllocator = nullptr;
 	
 	vkDestroyDescriptorPool(g_Device, g_DescriptorPool, g_Allocator);
 
+	SavePipelineCacheData();
+	vkDestroyPipelineCache(g_Device, g_PipelineCache, g_Allocator);
+	g_PipelineCache = VK_NULL_HANDLE;
+
 #ifdef IMGUI_VULKAN_DEBUG_REPORT
 	// Remove the debug report callback
-	auto vkDestroyDebugReportCallbackEXT = (PFN_vkDestroyDebugReportCallbackEXT)vkGetInstanceProcAddr(g_Instance, "vkDestroyDebugReportCallbackEXT");
-	vkDestroyDebugReportCallbackEXT(g_Instance, g_DebugReport, g_Allocator);
+	if (g_DebugReport != VK_NULL_HANDLE)
+	{
+		auto vkDestroyDebugReportCallbackEXT = (PFN_vkDestroyDebugReportCallbackEXT)vkGetInstanceProcAddr(g_Instance, "vkDestroyDebugReportCallbackEXT");
+		vkDestroyDebugReportCallbackEXT(g_Instance, g_DebugReport, g_Allocator);
+	}
 #endif // IMGUI_VULKAN_DEBUG_REPORT
 
 	vkDestroyDevice(g_Device, g_Allocator);
@@ -328,8 +542,6 @@ static void FrameRender(ImGui_ImplVulkanH_Window* wd, ImDrawData* draw_data)
 	}
 	check_vk_result(err);
 
-	s_CurrentFrameIndex = (s_CurrentFrameIndex + 1) % g_MainWindowData.ImageCount;
-
 	ImGui_ImplVulkanH_Frame* fd = &wd->Frames[wd->FrameIndex];
 	{
 		err = vkWaitForFences(g_Device, 1, &fd->Fence, VK_TRUE, UINT64_MAX);    // wait indefinitely instead of periodically checking
@@ -341,9 +553,14 @@ static void FrameRender(ImGui_ImplVulkanH_Window* wd, ImDrawData* draw_data)
 	
 	{
 		// Free resources in queue
-		for (auto& func : s_ResourceFreeQueue[s_CurrentFrameIndex])
+		std::vector<std::function<void()>> frameQueue;
+		{
+			std::lock_guard<std::mutex> lock(s_ResourceFreeMutex);
+			s_CurrentFrameIndex = (s_CurrentFrameIndex + 1) % g_MainWindowData.ImageCount;
+			frameQueue.swap(s_ResourceFreeQueue[s_CurrentFrameIndex]);
+		}
+		for (auto& func : frameQueue)
 			func();
-		s_ResourceFreeQueue[s_CurrentFrameIndex].clear();
 	}
 	{
 		// Free command buffers allocated by Application::GetCommandBuffer
@@ -394,6 +611,7 @@ static void FrameRender(ImGui_ImplVulkanH_Window* wd, ImDrawData* draw_data)
 
 		err = vkEndCommandBuffer(fd->CommandBuffer);
 		check_vk_result(err);
+		std::lock_guard<std::mutex> lock(s_QueueMutex);
 		err = vkQueueSubmit(g_Queue, 1, &info, fd->Fence);
 		check_vk_result(err);
 	}
@@ -411,7 +629,11 @@ static void FramePresent(ImGui_ImplVulkanH_Window* wd)
 	info.swapchainCount = 1;
 	info.pSwapchains = &wd->Swapchain;
 	info.pImageIndices = &wd->FrameIndex;
-	VkResult err = vkQueuePresentKHR(g_Queue, &info);
+	VkResult err;
+	{
+		std::lock_guard<std::mutex> lock(s_QueueMutex);
+		err = vkQueuePresentKHR(g_Queue, &info);
+	}
 	if (err == VK_ERROR_OUT_OF_DATE_KHR || err == VK_SUBOPTIMAL_KHR)
 	{
 		g_SwapChainRebuild = true;
@@ -436,6 +658,11 @@ namespace Surge
 Application::Application(const AppConfig &config)
 	: m_config(config)
 {
+	if (m_config.headless)
+	{
+		InitHeadless();
+		return;
+	}
 	TryLoadAppConfig();
 	Init();
 }
@@ -467,7 +694,8 @@ void Application::Init()
 	}
 	uint32_t extensions_count = 0;
 	const char** extensions = glfwGetRequiredInstanceExtensions(&extensions_count);
-	SetupVulkan(extensions, extensions_count);
+	SetupVulkan(extensions, extensions_count, false);
+	StartKernelWarmUp();
 
 	// Create Window Surface
 	VkSurfaceKHR surface;
@@ -563,17 +791,76 @@ void Application::Init()
 	m_explorerWindow = new ExplorerWindow();
 	m_nodeCanvas = new NodeCanvas();
 	m_outputWindow = new OutputWindow( m_nodeCanvas );
+	m_profilerWindow = new ProfilerWindow();
+}
+
+void Application::InitHeadless()
+{
+	g_App = this;
+	if (m_config.cpuOnly)
+	{
+		// Still times the CPU kernels, there just aren't any GPU timestamps.
+		g_Profiler = new Surge::Profiler(VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE, 0, false);
+	}
+	else
+	{
+		SetupVulkan(nullptr, 0, true);
+	}
+	StartKernelWarmUp();
+}
+
+void Application::StartKernelWarmUp()
+{
+	// Leave a core for the main thread, which carries on with the window, or the graph when headless.
+	const unsigned int cores = std::thread::hardware_concurrency();
+	g_ThreadPool = new Surge::ThreadPool(cores > 1 ? cores - 1 : 1);
+	if (g_Device != VK_NULL_HANDLE)
+	{
+		Surge::ComputeKernels::WarmUp(*g_ThreadPool);
+	}
+}
+
+void Application::ShutdownHeadless()
+{
+	delete g_ThreadPool;
+	g_ThreadPool = nullptr;
+
+	if (m_config.cpuOnly)
+	{
+		delete g_Profiler;
+		g_Profiler = nullptr;
+		return;
+	}
+
+	const VkResult err = vkDeviceWaitIdle(g_Device);
+	check_vk_result(err);
+	Surge::ComputeKernels::ReleaseImages();
+	CleanupVulkan();
 }
 
 void Application::Shutdown()
 {
+	if (m_config.headless)
+	{
+		ShutdownHeadless();
+		return;
+	}
+
 	delete m_nodeCanvas;
 	delete m_explorerWindow;
+	delete m_profilerWindow;
+
+	// Kernels still being built need the device, so finish them before it goes.
+	delete g_ThreadPool;
+	g_ThreadPool = nullptr;
 	
 	// Cleanup
 	const VkResult err = vkDeviceWaitIdle(g_Device);
 	check_vk_result(err);
 
+	// Queued to be freed with the rest below.
+	Surge::ComputeKernels::ReleaseImages();
+
 	// Free resources in queue
 	for (auto& queue : s_ResourceFreeQueue)
 	{
@@ -615,6 +902,12 @@ void Application::TryLoadAppConfig()
 	m_config.height = config["window"]["height"].value_or( m_config.height );
 	
 	m_config.explorerRoot = config["explorer"]["root"].value_or( "" );
+
+	m_config.batchCompute = config["compute"]["batch"].value_or( m_config.batchCompute );
+	m_config.fusePointwise = config["compute"]["fuse"].value_or( m_config.fusePointwise );
+	m_config.asyncEvaluation = config["compute"]["async"].value_or( m_config.asyncEvaluation );
+	m_config.aliasIntermediates = config["compute"]["alias"].value_or( m_config.aliasIntermediates );
+	m_config.proxyDivisor = std::clamp( config["compute"]["proxy"].value_or( m_config.proxyDivisor ), 1, 8 );
 }
 
 
@@ -629,6 +922,13 @@ void Application::SaveAppConfig()
 	toml::table explorer;
 	explorer.insert_or_assign( "root", m_config.explorerRoot );
 	config.insert_or_assign( "explorer", explorer );
+	toml::table compute;
+	compute.insert_or_assign( "batch", m_config.batchCompute );
+	compute.insert_or_assign( "fuse", m_config.fusePointwise );
+	compute.insert_or_assign( "async", m_config.asyncEvaluation );
+	compute.insert_or_assign( "alias", m_config.aliasIntermediates );
+	compute.insert_or_assign( "proxy", m_config.proxyDivisor );
+	config.insert_or_assign( "compute", compute );
 	outfile << config << "\n";
 	outfile.close();
 }
@@ -772,6 +1072,8 @@ void Application::Run()
 			glfwGetFramebufferSize(m_windowHandle, &width, &height);
 			if (width > 0 && height > 0)
 			{
+				// Waits for the device to go idle, which needs every queue to ourselves.
+				std::lock_guard<std::mutex> lock(s_QueueMutex);
 				ImGui_ImplVulkan_SetMinImageCount(g_MinImageCount);
 				ImGui_ImplVulkanH_CreateOrResizeWindow(g_Instance, g_PhysicalDevice, g_Device, &g_MainWindowData, g_QueueFamily, g_Allocator, width, height, g_MinImageCount);
 				g_MainWindowData.FrameIndex = 0;
@@ -844,6 +1146,8 @@ void Application::Run()
 			m_explorerWindow->UiRender();
 
 			m_outputWindow->UiRender();
+
+			m_profilerWindow->UiRender();
 			
 			ImGui::End();
 		}
@@ -864,6 +1168,8 @@ void Application::Run()
 		// Update and Render additional Platform Windows
 		if (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable)
 		{
+			// The Vulkan backend submits and presents for these windows on g_Queue itself.
+			std::lock_guard<std::mutex> lock(s_QueueMutex);
 			ImGui::UpdatePlatformWindows();
 			ImGui::RenderPlatformWindowsDefault();
 		}
@@ -897,6 +1203,36 @@ VkDevice Application::GetDevice()
 	return g_Device;
 }
 
+GpuAllocator* Application::GetGpuAllocator()
+{
+	return g_GpuAllocator;
+}
+
+StagingRing* Application::GetStagingRing()
+{
+	return g_StagingRing;
+}
+
+DescriptorCache* Application::GetDescriptorCache()
+{
+	return g_DescriptorCache;
+}
+
+VkPipelineCache Application::GetPipelineCache()
+{
+	return g_PipelineCache;
+}
+
+ThreadPool* Application::GetThreadPool()
+{
+	return g_ThreadPool;
+}
+
+Profiler* Application::GetProfiler()
+{
+	return g_Profiler;
+}
+
 VkCommandBuffer Application::GetCommandBuffer()
 {
 	ImGui_ImplVulkanH_Window* wd = &g_MainWindowData;
@@ -941,8 +1277,11 @@ void Application::FlushCommandBuffer(VkCommandBuffer commandBuffer)
 	err = vkCreateFence(g_Device, &fenceCreateInfo, nullptr, &fence);
 	check_vk_result(err);
 
-	err = vkQueueSubmit(g_Queue, 1, &end_info, fence);
-	check_vk_result(err);
+	{
+		std::lock_guard<std::mutex> lock(s_QueueMutex);
+		err = vkQueueSubmit(g_Queue, 1, &end_info, fence);
+		check_vk_result(err);
+	}
 
 	err = vkWaitForFences(g_Device, 1, &fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT);
 	check_vk_result(err);
@@ -951,10 +1290,32 @@ void Application::FlushCommandBuffer(VkCommandBuffer commandBuffer)
 }
 
 
+static VkCommandPool GetThreadComputeCommandPool()
+{
+	if (s_ThreadComputeCommandPool == VK_NULL_HANDLE)
+	{
+		VkCommandPoolCreateInfo poolCI = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+		poolCI.queueFamilyIndex = g_ComputeQueueFamily;
+		const VkResult err = vkCreateCommandPool( g_Device, &poolCI, g_Allocator, &s_ThreadComputeCommandPool );
+		check_vk_result(err);
+
+		// Destroyed with the device, threads are not around for long enough to bother earlier.
+		std::lock_guard<std::mutex> lock(s_ComputeCommandPoolsMutex);
+		s_ComputeCommandPools.push_back(s_ThreadComputeCommandPool);
+	}
+	return s_ThreadComputeCommandPool;
+}
+
+
 VkCommandBuffer Application::GetComputeCommandBuffer()
 {
+	if (s_ComputeBatchCommandBuffer != VK_NULL_HANDLE)
+	{
+		return s_ComputeBatchCommandBuffer;
+	}
+
 	VkCommandBufferAllocateInfo commandBufferAI = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
-	commandBufferAI.commandPool = g_ComputeCommandPool;
+	commandBufferAI.commandPool = GetThreadComputeCommandPool();
 	commandBufferAI.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
 	commandBufferAI.commandBufferCount = 1;
 
@@ -974,7 +1335,16 @@ VkCommandBuffer Application::GetComputeCommandBuffer()
 
 void Application::FlushComputeCommandBuffer( VkCommandBuffer commandBuffer )
 {
+	if (commandBuffer == s_ComputeBatchCommandBuffer)
+	{
+		// Submitted along with the rest of the batch in EndComputeBatch
+		return;
+	}
+
 	const uint64_t DEFAULT_FENCE_TIMEOUT = 100000000000;
+	const Profiler::CpuScope profileScope( "Submit and wait", "submit" );
+
+	vkEndCommandBuffer( commandBuffer );
 
 	VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
 	submitInfo.pCommandBuffers = &commandBuffer;
@@ -985,21 +1355,80 @@ void Application::FlushComputeCommandBuffer( VkCommandBuffer commandBuffer )
 	VkFence fence;
 	VkFenceCreateInfo fenceCI = { VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
 	vkCreateFence( g_Device, &fenceCI, nullptr, &fence );
-	printf("pre-submit\n");
-	vkQueueSubmit( g_ComputeQueue, 1, &submitInfo, fence );
+	const double submitTime = g_Profiler->Now();
+	{
+		std::lock_guard<std::mutex> lock(s_QueueMutex);
+		vkQueueSubmit( g_ComputeQueue, 1, &submitInfo, fence );
+	}
 
 	vkWaitForFences( g_Device, 1, &fence, true, DEFAULT_FENCE_TIMEOUT );
 	vkDestroyFence( g_Device, fence, nullptr );
-	printf("post fence\n");
-	vkResetCommandPool( g_Device, g_ComputeCommandPool, VK_COMMAND_POOL_RESET_RELEASE_RESOURCES_BIT );
+	g_Profiler->Resolve( commandBuffer, submitTime );
+	// Only this buffer goes, an upload can be flushed while a batch is still being recorded from the same pool.
+	vkFreeCommandBuffers( g_Device, GetThreadComputeCommandPool(), 1, &commandBuffer );
+
+	for (auto& func : s_ComputeResourceFreeQueue)
+	{
+		func();
+	}
+	s_ComputeResourceFreeQueue.clear();
+}
+
+
+void Application::BeginComputeBatch()
+{
+	IM_ASSERT(s_ComputeBatchCommandBuffer == VK_NULL_HANDLE);
+	s_ComputeBatchCommandBuffer = GetComputeCommandBuffer();
+}
+
+
+void Application::EndComputeBatch()
+{
+	VkCommandBuffer commandBuffer = s_ComputeBatchCommandBuffer;
+	s_ComputeBatchCommandBuffer = VK_NULL_HANDLE;
+	FlushComputeCommandBuffer( commandBuffer );
+}
+
+
+void Application::FlushComputeBatch()
+{
+	if (s_ComputeBatchCommandBuffer == VK_NULL_HANDLE)
+	{
+		return;
+	}
+	EndComputeBatch();
+	BeginComputeBatch();
+}
+
+
+void Application::SubmitComputeResourceFree(std::function<void()>&& func)
+{
+	if (s_ComputeBatchCommandBuffer == VK_NULL_HANDLE)
+	{
+		func();
+		return;
+	}
+	s_ComputeResourceFreeQueue.emplace_back(func);
 }
 
 
 void Application::SubmitResourceFree(std::function<void()>&& func)
 {
+	if (IsHeadless())
+	{
+		// No frames to wait on, only the compute work that may still be using the resource.
+		SubmitComputeResourceFree(std::move(func));
+		return;
+	}
+	std::lock_guard<std::mutex> lock(s_ResourceFreeMutex);
 	s_ResourceFreeQueue[s_CurrentFrameIndex].emplace_back(func);
 }
 
+bool Application::IsHeadless()
+{
+	return g_App && g_App->m_config.headless;
+}
+
 AppConfig& Application::GetConfig()
 {
 	return g_App->m_config;
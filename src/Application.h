@@ -5,9 +5,15 @@
 #include <string>
 #include <functional>
 
+#include "DescriptorCache.h"
 #include "ExplorerWindow.h"
+#include "GpuAllocator.h"
 #include "imgui.h"
 #include "OutputWindow.h"
+#include "Profiler.h"
+#include "ProfilerWindow.h"
+#include "StagingRing.h"
+#include "ThreadPool.h"
 #include "vulkan/vulkan.h"
 
 
@@ -34,6 +40,22 @@ struct AppConfig
     int width = 1440;
     int height = 900;
     std::string explorerRoot;
+    bool batchCompute = true;
+    bool fusePointwise = true;
+    bool asyncEvaluation = true;
+    bool aliasIntermediates = false;
+    // While a parameter is being dragged, the graph is evaluated at its resolution divided by this
+    // and only at full resolution once it is let go. 1 always evaluates at full resolution.
+    int proxyDivisor = 4;
+    // Only set up Vulkan for compute, with no window, ImGui or app_config.toml. Run must not be
+    // called, the owner evaluates graphs itself, see SurgeCli.
+    bool headless = false;
+    // Headless without Vulkan at all, for machines without a GPU it can use. Images are kept in
+    // host memory and graphs run on the CpuKernels, see GraphEvaluator::Options::cpuBackend.
+    bool cpuOnly = false;
+    // Picks the first GPU whose name contains this, rather than the first discrete one. e.g.
+    // "llvmpipe" runs on lavapipe, Mesa's software Vulkan.
+    std::string deviceName;
 };
 
 class Application
@@ -48,6 +70,18 @@ public:
     static VkInstance GetInstance();
     static VkPhysicalDevice GetPhysicalDevice();
     static VkDevice GetDevice();
+    // Where images and their staging buffers get their memory from.
+    static GpuAllocator* GetGpuAllocator();
+    // Uploads and readbacks go through this rather than staging buffers of their own.
+    static StagingRing* GetStagingRing();
+    // Compute dispatches get the descriptor sets binding their images from here.
+    static DescriptorCache* GetDescriptorCache();
+    // Loaded from disk at startup and written back at shutdown, every compute pipeline goes through it.
+    static VkPipelineCache GetPipelineCache();
+    // Workers for anything that can run beside the main thread, such as decoding the explorer's thumbnails.
+    static ThreadPool* GetThreadPool();
+    // Times evaluation on the CPU and GPU while it is enabled, see ProfilerWindow.
+    static Profiler* GetProfiler();
 
     static VkCommandBuffer GetCommandBuffer();
     static void FlushCommandBuffer(VkCommandBuffer commandBuffer);
@@ -55,8 +89,21 @@ public:
     static VkCommandBuffer GetComputeCommandBuffer();
     static void FlushComputeCommandBuffer(VkCommandBuffer commandBuffer);
 
+    // While a batch is open every GetComputeCommandBuffer returns the same command buffer and
+    // FlushComputeCommandBuffer leaves it alone, so everything recorded in between is submitted
+    // and waited on once by EndComputeBatch. Batches, like the command pools behind them, belong to
+    // the calling thread.
+    static void BeginComputeBatch();
+    static void EndComputeBatch();
+    // Submits and waits on what the calling thread's batch has recorded so far, then carries on
+    // recording into a new command buffer. Does nothing outside a batch.
+    static void FlushComputeBatch();
+    // Runs func once the compute work recorded so far has completed, straight away if there is none pending.
+    static void SubmitComputeResourceFree(std::function<void()>&& func);
+
     static void SubmitResourceFree(std::function<void()>&& func);
 
+    static bool IsHeadless();
     static AppConfig& GetConfig();
     static ExplorerWindow* GetExplorer();
 
@@ -64,7 +111,10 @@ public:
     
 private:
     void Init();
+    void InitHeadless();
+    void StartKernelWarmUp();
     void Shutdown();
+    void ShutdownHeadless();
     void TryLoadAppConfig();
     void SaveAppConfig();
 
@@ -78,6 +128,7 @@ private:
     NodeCanvas *m_nodeCanvas = nullptr;
     ExplorerWindow *m_explorerWindow = nullptr;
     OutputWindow *m_outputWindow = nullptr;
+    ProfilerWindow *m_profilerWindow = nullptr;
 };
 
 }
\ No newline at end of file
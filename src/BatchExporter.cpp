@@ -0,0 +1,230 @@
+#include "BatchExporter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "BoundedQueue.h"
+#include "GraphEvaluator.h"
+#include "Image.h"
+#include "TransientImagePool.h"
+
+#include "GraphNodes/DynamicImageNode.h"
+
+namespace Surge
+{
+
+namespace
+{
+
+// What a frame is carrying as it moves from one stage to the next.
+struct DecodedFrame
+{
+    int index;
+    std::vector<ImageData> inputs;
+};
+
+struct UploadedFrame
+{
+    int index;
+    std::vector<std::shared_ptr<Image>> inputs;
+};
+
+struct RenderedFrame
+{
+    int index;
+    std::shared_ptr<Image> output;
+};
+
+struct ReadbackFrame
+{
+    int index;
+    ImageData output;
+};
+
+
+template <typename Func>
+std::vector<std::thread> StartThreads( const unsigned count, const Func &func )
+{
+    std::vector<std::thread> threads;
+    for ( unsigned i = 0; i < std::max( count, 1u ); ++i )
+    {
+        threads.emplace_back( func );
+    }
+    return threads;
+}
+
+
+void JoinThreads( std::vector<std::thread> &threads )
+{
+    for ( std::thread &thread : threads )
+    {
+        thread.join();
+    }
+}
+
+}
+
+
+BatchExporter::BatchExporter( const Options &options ) : m_options( options )
+{
+}
+
+
+int BatchExporter::Run( const Graph<Node *> &graph, const int rootNodeId, const std::string &outputPrefix )
+{
+    if ( !graph.contains_node( rootNodeId ) )
+    {
+        fprintf( stderr, "Nothing to export, the graph has no output node\n" );
+        return 0;
+    }
+
+    // The evaluation thread works on its own copy of every node, like the EvaluationWorker does.
+    Graph<Node *> frameGraph = graph;
+    for ( const int id : graph.node_ids() )
+    {
+        Node *clone = graph.node( id )->Clone();
+        frameGraph.update_node( id, clone );
+    }
+
+    std::vector<int> dynamicNodes;
+    size_t frameCount = 0;
+    for ( const int id : frameGraph.node_ids() )
+    {
+        const auto dynImage = dynamic_cast<DynamicImageNode *>( frameGraph.node( id ) );
+        if ( dynImage )
+        {
+            frameCount = dynamicNodes.empty() ? dynImage->m_filePaths.size() : std::min( frameCount, dynImage->m_filePaths.size() );
+            dynamicNodes.push_back( id );
+        }
+    }
+
+    BoundedQueue<DecodedFrame>  decoded( m_options.queueDepth );
+    BoundedQueue<UploadedFrame> uploaded( m_options.queueDepth );
+    BoundedQueue<RenderedFrame> rendered( m_options.queueDepth );
+    BoundedQueue<ReadbackFrame> readback( m_options.queueDepth );
+    std::atomic<size_t> nextFrame = 0;
+    std::atomic<int> written = 0;
+
+    // Frames are handed out in order, but from here on they can overtake each other. Each carries
+    // its index, so they end up in the right file regardless.
+    std::vector<std::thread> decodeThreads = StartThreads( m_options.decodeThreads, [&]()
+    {
+        for ( size_t index = nextFrame++; index < frameCount; index = nextFrame++ )
+        {
+            DecodedFrame frame { static_cast<int>( index ), std::vector<ImageData>( dynamicNodes.size() ) };
+            bool loaded = true;
+            for ( size_t i = 0; i < dynamicNodes.size() && loaded; ++i )
+            {
+                const std::string &path = static_cast<DynamicImageNode *>( frameGraph.node( dynamicNodes[i] ) )->m_filePaths[index];
+                loaded = Image::LoadFile( path, frame.inputs[i] );
+                if ( !loaded )
+                {
+                    fprintf( stderr, "Skipping frame %zu, could not load %s\n", index, path.c_str() );
+                }
+            }
+            if ( loaded )
+            {
+                decoded.Push( std::move( frame ) );
+            }
+        }
+    } );
+
+    std::vector<std::thread> uploadThreads = StartThreads( m_options.uploadThreads, [&]()
+    {
+        while ( std::optional<DecodedFrame> frame = decoded.Pop() )
+        {
+            UploadedFrame upload { frame->index, {} };
+            for ( const ImageData &input : frame->inputs )
+            {
+                upload.inputs.push_back( std::make_shared<Image>( input.width, input.height, input.format, input.pixels.data() ) );
+            }
+            uploaded.Push( std::move( upload ) );
+        }
+    } );
+
+    std::thread evaluateThread( [&]()
+    {
+        // Outputs come from a pool of our own, an image goes back into it once the readback stage
+        // is done with it. This also keeps the evaluator away from the images of the nodes copied.
+        TransientImagePool imagePool;
+        GraphEvaluator::Options options;
+        options.batchCompute = m_options.batchCompute;
+        options.fusePointwise = m_options.fusePointwise;
+        options.blankImages = m_options.blankImages;
+        options.imagePool = &imagePool;
+        GraphEvaluator evaluator( options );
+
+        while ( std::optional<UploadedFrame> frame = uploaded.Pop() )
+        {
+            for ( size_t i = 0; i < dynamicNodes.size(); ++i )
+            {
+                Node *node = frameGraph.node( dynamicNodes[i] );
+                node->value = std::move( frame->inputs[i] );
+                node->MarkDirty();
+            }
+            std::shared_ptr<Image> output = evaluator.Evaluate( frameGraph, rootNodeId );
+            if ( !output )
+            {
+                fprintf( stderr, "Skipping frame %d, the output isn't connected to anything\n", frame->index );
+                continue;
+            }
+            rendered.Push( { frame->index, std::move( output ) } );
+        }
+    } );
+
+    std::vector<std::thread> readbackThreads = StartThreads( m_options.readbackThreads, [&]()
+    {
+        while ( std::optional<RenderedFrame> frame = rendered.Pop() )
+        {
+            const Image &output = *frame->output;
+            ReadbackFrame download { frame->index, {} };
+            download.output.width = output.GetWidth();
+            download.output.height = output.GetHeight();
+            download.output.format = output.GetFormat();
+            download.output.pixels.resize( static_cast<size_t>( output.GetWidth() ) * output.GetHeight() * Image::BytesPerPixel( output.GetFormat() ) );
+            output.GetData( download.output.pixels.data() );
+            frame->output.reset();
+            readback.Push( std::move( download ) );
+        }
+    } );
+
+    std::vector<std::thread> encodeThreads = StartThreads( m_options.encodeThreads, [&]()
+    {
+        while ( std::optional<ReadbackFrame> frame = readback.Pop() )
+        {
+            const std::string filepath = outputPrefix + std::to_string( frame->index );
+            const ImageData &output = frame->output;
+            if ( Image::WriteFile( filepath, output.width, output.height, output.format, output.pixels.data() ) )
+            {
+                ++written;
+            }
+            else
+            {
+                fprintf( stderr, "Could not write %s.png\n", filepath.c_str() );
+            }
+        }
+    } );
+
+    // Each stage finishes once the one before it has and its queue has run dry.
+    JoinThreads( decodeThreads );
+    decoded.Close();
+    JoinThreads( uploadThreads );
+    uploaded.Close();
+    evaluateThread.join();
+    rendered.Close();
+    JoinThreads( readbackThreads );
+    readback.Close();
+    JoinThreads( encodeThreads );
+
+    for ( Node *node : frameGraph.nodes() )
+    {
+        delete node;
+    }
+    return written;
+}
+
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+
+#include "BlankImageCache.h"
+#include "Graph.h"
+
+#include "GraphNodes/Node.h"
+
+namespace Surge
+{
+
+// Renders a graph once for every image of its DYNAMIC_IMAGE nodes and writes each result to disk.
+// Frames go through five stages, each on its own threads and handing over to the next through a
+// BoundedQueue: decoding the inputs, uploading them, evaluating the graph, reading the output back
+// and encoding it. While one frame is being evaluated the ones around it are loaded and saved, and
+// the queues cap how many frames are held in memory at once.
+class BatchExporter
+{
+public:
+    struct Options
+    {
+        // Passed on to the GraphEvaluator, see GraphEvaluator::Options.
+        bool batchCompute = true;
+        bool fusePointwise = false;
+        BlankImageCache *blankImages = nullptr;
+
+        // Threads for each stage. Evaluation always has one, the compute kernels are shared.
+        unsigned decodeThreads = 2;
+        unsigned uploadThreads = 1;
+        unsigned readbackThreads = 1;
+        unsigned encodeThreads = 2;
+        // Frames waiting between two stages.
+        size_t queueDepth = 4;
+    };
+
+    BatchExporter() = default;
+    explicit BatchExporter( const Options &options );
+
+    // Writes frame i, made from image i of every dynamic image node, to <outputPrefix><i>.png.
+    // Runs until every frame is done, on copies of the nodes so graph is left as it was. Nodes with
+    // fewer images than the others end the sequence early. Returns how many frames were written.
+    int Run( const Graph<Node *> &graph, int rootNodeId, const std::string &outputPrefix );
+
+private:
+    Options m_options;
+};
+
+}
@@ -0,0 +1,31 @@
+#include "BlankImageCache.h"
+
+#include <cstring>
+#include <vector>
+
+namespace Surge
+{
+
+std::shared_ptr<Image> BlankImageCache::Get( const uint32_t width, const uint32_t height, const ImageFormat format, const ImageStorage storage )
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    std::shared_ptr<Image> &image = m_images[Key( width, height, format, storage )];
+    if ( !image )
+    {
+        image = std::make_shared<Image>( width, height, format, nullptr, storage );
+        // One white pixel in the image's format, repeated.
+        const float white[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        uint8_t pixel[16];
+        Image::ConvertPixels( ImageFormat::RGBA32F, white, format, pixel, 1 );
+        const size_t bytesPerPixel = Image::BytesPerPixel( format );
+        std::vector<uint8_t> data( static_cast<size_t>( width ) * height * bytesPerPixel );
+        for ( size_t i = 0; i < data.size(); i += bytesPerPixel )
+        {
+            memcpy( data.data() + i, pixel, bytesPerPixel );
+        }
+        image->SetData( data.data() );
+    }
+    return image;
+}
+
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+
+#include "Image.h"
+
+namespace Surge
+{
+
+// White images that stand in for input pins nothing is connected to. Nodes don't sample outside
+// of their inputs, so each size an unconnected pin is read at gets its own image, created the first
+// time it is asked for and shared by every pin after that.
+class BlankImageCache
+{
+public:
+    std::shared_ptr<Image> Get( uint32_t width, uint32_t height, ImageFormat format, ImageStorage storage = ImageStorage::Device );
+
+private:
+    using Key = std::tuple<uint32_t, uint32_t, ImageFormat, ImageStorage>;
+
+    std::mutex                            m_mutex;
+    std::map<Key, std::shared_ptr<Image>> m_images;
+};
+
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+namespace Surge
+{
+
+// A queue between two stages of a pipeline, holding at most capacity items so a fast producer
+// waits for its consumers instead of filling memory. Any number of threads can push and pop.
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue( const size_t capacity ) : m_capacity( capacity ) {}
+
+    BoundedQueue( const BoundedQueue & ) = delete;
+    BoundedQueue &operator=( const BoundedQueue & ) = delete;
+
+    // Blocks while the queue is full. Returns false, dropping item, once the queue has been closed.
+    bool Push( T item )
+    {
+        std::unique_lock<std::mutex> lock( m_mutex );
+        m_notFull.wait( lock, [this]() { return m_closed || m_items.size() < m_capacity; } );
+        if ( m_closed )
+        {
+            return false;
+        }
+        m_items.push_back( std::move( item ) );
+        lock.unlock();
+        m_notEmpty.notify_one();
+        return true;
+    }
+
+    // Blocks until there is an item, or returns nothing once the queue is closed and empty.
+    std::optional<T> Pop()
+    {
+        std::unique_lock<std::mutex> lock( m_mutex );
+        m_notEmpty.wait( lock, [this]() { return m_closed || !m_items.empty(); } );
+        if ( m_items.empty() )
+        {
+            return std::nullopt;
+        }
+        T item = std::move( m_items.front() );
+        m_items.pop_front();
+        lock.unlock();
+        m_notFull.notify_one();
+        return item;
+    }
+
+    // No more items will be pushed. Consumers still get whatever is queued before Pop runs dry.
+    void Close()
+    {
+        {
+            std::lock_guard<std::mutex> lock( m_mutex );
+            m_closed = true;
+        }
+        m_notFull.notify_all();
+        m_notEmpty.notify_all();
+    }
+
+private:
+    const size_t            m_capacity;
+    std::mutex              m_mutex;
+    std::condition_variable m_notEmpty;
+    std::condition_variable m_notFull;
+    std::deque<T>           m_items;
+    bool                    m_closed = false;
+};
+
+}
@@ -1,25 +1,31 @@
 ﻿#include "BlurCompute.h"
 
+#include <algorithm>
+#include <cmath>
+
 #include "../Application.h"
 #include "../VulkanUtils.h"
 
 namespace Surge
 {
-constexpr uint32_t WORKGROUP_SIZE = 16;
+BlurCompute::RecursiveParams BlurCompute::GetRecursiveParams( const float sigma )
+{
+    // Coefficients from "Recursive implementation of the Gaussian filter", Young and van Vliet 1995.
+    const float q = sigma >= 2.5f ? 0.98711f * sigma - 0.96330f : 3.97156f - 4.14554f * std::sqrt( 1.0f - 0.26891f * sigma );
+    const float b0 = 1.57825f + 2.44413f * q + 1.4281f * q * q + 0.422205f * q * q * q;
+    const float b1 = 2.44413f * q + 2.85619f * q * q + 1.26661f * q * q * q;
+    const float b2 = -( 1.4281f * q * q + 1.26661f * q * q * q );
+    const float b3 = 0.422205f * q * q * q;
+    return { 1.0f - ( b1 + b2 + b3 ) / b0, b1 / b0, b2 / b0, b3 / b0 };
+}
+
 
 BlurCompute::BlurCompute()
 {
     VkDevice device = Application::GetDevice();
 
-    vulkan::ShaderLoader loader;
-    m_shader = loader.LoadShader( device, BlurComputeShader.c_str() );
-
     m_dscLayout = CreateDescriptorSetLayout( device, 2 );
-    m_dscPool = CreateDescriptorPool( device, 2 );
     
-    VkPipelineCacheCreateInfo pipeCacheCI = { VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
-    vkCreatePipelineCache( device, &pipeCacheCI, nullptr, &m_pipeCache );
-
     std::vector<VkPushConstantRange> pcRanges;
     VkPushConstantRange pcRange = {};
     pcRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
@@ -29,8 +35,36 @@ BlurCompute::BlurCompute()
     
     m_pipeLayout = CreatePipelineLayout( device, m_dscLayout, pcRanges );
 
-    m_pipe = CreateComputePipeline( device, m_shader, m_pipeLayout, m_pipeCache );
+    m_pipes = CreateFormatPipelines( device, BlurComputeShader, m_pipeLayout );
     m_cmdBuffer = {};
+
+    m_gaussianDscLayout = CreateDescriptorSetLayout( device, 2 );
+
+    std::vector<VkPushConstantRange> gaussianPcRanges;
+    VkPushConstantRange gaussianPcRange = {};
+    gaussianPcRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    gaussianPcRange.offset = 0;
+    gaussianPcRange.size = sizeof(GaussianParams);
+    gaussianPcRanges.push_back( gaussianPcRange );
+
+    m_gaussianPipeLayout = CreatePipelineLayout( device, m_gaussianDscLayout, gaussianPcRanges );
+    // The float variants keep the tile as half floats, see GaussianBlurCompute.comp.
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties( Application::GetPhysicalDevice(), &properties );
+    const bool floatTile = properties.limits.maxComputeSharedMemorySize >= 32 * 1024;
+    m_gaussianPipes = CreateFormatPipelines( device, GaussianBlurComputeShader, m_gaussianPipeLayout, floatTile );
+
+    // Both recursive passes bind two images like the Gaussian, only the push constants differ.
+    std::vector<VkPushConstantRange> recursivePcRanges;
+    VkPushConstantRange recursivePcRange = {};
+    recursivePcRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    recursivePcRange.offset = 0;
+    recursivePcRange.size = sizeof(RecursiveParams);
+    recursivePcRanges.push_back( recursivePcRange );
+
+    m_recursivePipeLayout = CreatePipelineLayout( device, m_gaussianDscLayout, recursivePcRanges );
+    m_recursiveHorizontal = CreateFormatPipelines( device, RecursiveGaussianHorizontalShader, m_recursivePipeLayout );
+    m_recursiveVertical = CreateFormatPipelines( device, RecursiveGaussianVerticalShader, m_recursivePipeLayout );
 }
 
 
@@ -38,12 +72,13 @@ BlurCompute::~BlurCompute()
 {
     VkDevice device = Application::GetDevice();
     
-    vkDestroyPipeline( device, m_pipe, nullptr );
-    vkDestroyPipelineLayout( device, m_pipeLayout, nullptr );
-    vkDestroyPipelineCache( device, m_pipeCache, nullptr );
-    vkDestroyDescriptorPool( device, m_dscPool, nullptr );
-    vkDestroyDescriptorSetLayout( device, m_dscLayout, nullptr );
-    vkDestroyShaderModule( device, m_shader, nullptr );
+    // The motion and radial blur's pipelines and layouts are left to ComputeBase.
+    DestroyFormatPipelines( device, m_recursiveHorizontal );
+    DestroyFormatPipelines( device, m_recursiveVertical );
+    vkDestroyPipelineLayout( device, m_recursivePipeLayout, nullptr );
+    DestroyFormatPipelines( device, m_gaussianPipes );
+    vkDestroyPipelineLayout( device, m_gaussianPipeLayout, nullptr );
+    vkDestroyDescriptorSetLayout( device, m_gaussianDscLayout, nullptr );
 }
 
 
@@ -55,6 +90,81 @@ void BlurCompute::Run( Image *input, Image *output, PushParams params )
 }
 
 
+int BlurCompute::GetGaussianRadius( const float sigma )
+{
+    return std::max( 1, static_cast<int>( std::ceil( sigma * 3.0f ) ) );
+}
+
+
+void BlurCompute::RunGaussian( Image *input, Image *output, const float sigma )
+{
+    const int radius = GetGaussianRadius( sigma );
+    const VkPipeline pipeline = GetPipeline( m_gaussianPipes, output->GetFormat() );
+    if ( pipeline == VK_NULL_HANDLE || radius > GetMaxGaussianRadius( output->GetFormat() ) )
+    {
+        RunRecursiveGaussian( input, output, sigma );
+        return;
+    }
+
+    const std::shared_ptr<Image> scratchImage = AcquireScratch( output->GetWidth(), output->GetHeight(), output->GetFormat() );
+    Image *scratch = scratchImage.get();
+
+    const VkDescriptorSet horizontalSet = GetDescriptorSet( m_gaussianDscLayout, { input, scratch } );
+    const VkDescriptorSet verticalSet = GetDescriptorSet( m_gaussianDscLayout, { scratch, output } );
+
+    // Both passes go into the same command buffer, RecordDispatch makes the second wait on the first.
+    VkCommandBuffer cmdBuffer = Application::GetComputeCommandBuffer();
+    const GaussianParams horizontal = { 1, 0, sigma, radius };
+    RecordDispatch( cmdBuffer, pipeline, m_gaussianPipeLayout, horizontalSet, { input, scratch }, &horizontal, sizeof(horizontal) );
+    const GaussianParams vertical = { 0, 1, sigma, radius };
+    RecordDispatch( cmdBuffer, pipeline, m_gaussianPipeLayout, verticalSet, { scratch, output }, &vertical, sizeof(vertical) );
+    Application::FlushComputeCommandBuffer( cmdBuffer );
+}
+
+
+void BlurCompute::RunRecursiveGaussian( Image *input, Image *output, const float sigma )
+{
+    const std::shared_ptr<Image> scratchImage = AcquireScratch( output->GetWidth(), output->GetHeight(), ImageFormat::RGBA32F );
+    Image *scratch = scratchImage.get();
+    const RecursiveParams params = GetRecursiveParams( sigma );
+
+    const VkDescriptorSet horizontalSet = GetDescriptorSet( m_gaussianDscLayout, { input, scratch } );
+    const VkDescriptorSet verticalSet = GetDescriptorSet( m_gaussianDscLayout, { scratch, output } );
+
+    // One invocation per line, WORKGROUP_SIZE squared of them per workgroup.
+    constexpr uint32_t linesPerGroup = 16 * 16;
+    const uint32_t rowGroups = ( output->GetHeight() + linesPerGroup - 1u ) / linesPerGroup;
+    const uint32_t columnGroups = ( output->GetWidth() + linesPerGroup - 1u ) / linesPerGroup;
+
+    // The vertical pass keeps its causal half in the scratch image, so that one is written as well as read.
+    VkCommandBuffer cmdBuffer = Application::GetComputeCommandBuffer();
+    RecordDispatch( cmdBuffer, GetPipeline( m_recursiveHorizontal, input->GetFormat() ), m_recursivePipeLayout, horizontalSet, { input, scratch }, &params,
+                    sizeof(params), rowGroups, 1, false );
+    RecordDispatch( cmdBuffer, GetPipeline( m_recursiveVertical, output->GetFormat() ), m_recursivePipeLayout, verticalSet, { scratch, output }, &params, sizeof(params), columnGroups, 1, true );
+    Application::FlushComputeCommandBuffer( cmdBuffer );
+}
+
+
+void BlurCompute::ReleaseImages()
+{
+    m_scratchImages.NextEpoch();
+    m_scratchImages.Trim();
+}
+
+
+std::shared_ptr<Image> BlurCompute::AcquireScratch( const uint32_t width, const uint32_t height, const ImageFormat format )
+{
+    // Only the scratch images of the latest size stay around once nothing is using the others.
+    m_scratchImages.NextEpoch();
+    std::shared_ptr<Image> scratch = m_scratchImages.Acquire( width, height, format );
+    m_scratchImages.Trim();
+
+    // Inside a batch the dispatches reading it haven't even been submitted yet.
+    Application::SubmitComputeResourceFree( [scratch]() {} );
+    return scratch;
+}
+
+
 void BlurCompute::Bind( Image *input, Image *output, PushParams params )
 {
     VkDevice device = Application::GetDevice();
@@ -63,18 +173,14 @@ void BlurCompute::Bind( Image *input, Image *output, PushParams params )
     m_input = images.emplace_back( input );
     m_output = images.emplace_back( output );;
 
-    VkDescriptorSet set = CreateDescriptorSet( device, m_dscPool, m_dscLayout, images );
+    VkDescriptorSet set = GetDescriptorSet( m_dscLayout, images );
     
-    m_cmdBuffer = CreateCommandBuffer( device, m_cmdPool, m_pipe, m_pipeLayout, set, params );
+    m_cmdBuffer = CreateCommandBuffer( device, m_cmdPool, GetPipeline( m_pipes, output->GetFormat() ), m_pipeLayout, set, params );
 }
 
 
 void BlurCompute::UnBind()
 {
-    VkDevice device = Application::GetDevice();
-    
-    vkDestroyDescriptorPool( device, m_dscPool, nullptr );
-    m_dscPool = CreateDescriptorPool( device, 2);
     m_cmdBuffer = {};
 }
 
@@ -83,80 +189,7 @@ VkCommandBuffer BlurCompute::CreateCommandBuffer( VkDevice device, VkCommandPool
 {
     VkCommandBuffer cmdBuffer = Application::GetComputeCommandBuffer();
 
-    {
-        //Make the barriers for the resources
-        VkImageMemoryBarrier barrier[2] = {};
-
-        barrier[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        barrier[0].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        barrier[0].subresourceRange.levelCount = barrier[0].subresourceRange.layerCount = 1;
-        barrier[0].subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
-
-        barrier[0].oldLayout       = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        barrier[0].newLayout       = VK_IMAGE_LAYOUT_GENERAL;
-        barrier[0].srcAccessMask   = 0;
-        barrier[0].dstAccessMask   = VK_ACCESS_SHADER_READ_BIT;
-        barrier[0].image           = m_input->GetVkImage();
-
-        barrier[1].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        barrier[1].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        barrier[1].subresourceRange.levelCount = barrier[2].subresourceRange.layerCount = 1;
-        barrier[1].subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
-
-        barrier[1].oldLayout       = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        barrier[1].newLayout       = VK_IMAGE_LAYOUT_GENERAL;
-        barrier[1].srcAccessMask   = 0;
-        barrier[1].dstAccessMask   = VK_ACCESS_MEMORY_WRITE_BIT;
-        barrier[1].image           = m_output->GetVkImage();
-
-        vkCmdPipelineBarrier( cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-                                0, 0, nullptr, 0, nullptr,
-                                2, barrier);
-    }
-    
-    vkCmdBindPipeline( cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline );
-    
-    vkCmdBindDescriptorSets( cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, 1, &dscSet, 0, nullptr);
-
-    vkCmdPushConstants( cmdBuffer, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(p), &p );
-
-    const uint32_t wgWidthSize = (m_output->GetWidth() + WORKGROUP_SIZE + 1u) / WORKGROUP_SIZE;
-    const uint32_t wgHeightSize = (m_output->GetHeight() + WORKGROUP_SIZE + 1u) / WORKGROUP_SIZE;
-    
-    vkCmdDispatch( cmdBuffer, wgWidthSize, wgHeightSize, 1 );
-
-    {
-        //Make the barriers for the resources
-        VkImageMemoryBarrier barrier[2] = {};
-
-        barrier[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        barrier[0].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        barrier[0].subresourceRange.levelCount = barrier[0].subresourceRange.layerCount = 1;
-        barrier[0].subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
-
-        barrier[0].oldLayout       = VK_IMAGE_LAYOUT_GENERAL;
-        barrier[0].newLayout       = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        barrier[0].srcAccessMask   = 0;
-        barrier[0].dstAccessMask   = VK_ACCESS_SHADER_READ_BIT;
-        barrier[0].image           = m_input->GetVkImage();
-
-        barrier[1].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        barrier[1].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        barrier[1].subresourceRange.levelCount = barrier[1].subresourceRange.layerCount = 1;
-        barrier[1].subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
-
-        barrier[1].oldLayout       = VK_IMAGE_LAYOUT_GENERAL;
-        barrier[1].newLayout       = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        barrier[1].srcAccessMask   = 0;
-        barrier[1].dstAccessMask   = VK_ACCESS_SHADER_READ_BIT;
-        barrier[1].image           = m_output->GetVkImage();
-
-        vkCmdPipelineBarrier( cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-                                0, 0, nullptr, 0, nullptr,
-                                2, barrier);
-    }
-    
-    vkEndCommandBuffer( cmdBuffer );
+    RecordDispatch( cmdBuffer, pipeline, layout, dscSet, { m_input, m_output }, &p, sizeof(p) );
     
     return cmdBuffer;
 }
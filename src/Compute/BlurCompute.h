@@ -1,9 +1,11 @@
 ﻿#pragma once
 
+#include <memory>
 #include <string>
 
 #include "ComputeBase.h"
 #include "../Image.h"
+#include "../TransientImagePool.h"
 #include "imgui.h"
 #include "vulkan/vulkan.h"
 
@@ -12,7 +14,24 @@ namespace Surge
     class BlurCompute : ComputeBase
     {
         const std::string BlurComputeShader = "Shaders/BlurCompute.comp";
+        const std::string GaussianBlurComputeShader = "Shaders/GaussianBlurCompute.comp";
+        const std::string RecursiveGaussianHorizontalShader = "Shaders/RecursiveGaussianHorizontal.comp";
+        const std::string RecursiveGaussianVerticalShader = "Shaders/RecursiveGaussianVertical.comp";
     public:
+        // The widest Gaussian the shared memory tile in GaussianBlurCompute.comp holds, in pixels
+        // either side. The rgba32f variant keeps its tile in full floats, which leaves room for a
+        // narrower one. RunGaussian hands anything wider to RunRecursiveGaussian.
+        static constexpr int MaxGaussianRadius = 112;
+        static constexpr int MaxGaussianRadius32F = 48;
+        // Above this sigma RunRecursiveGaussian, whose cost doesn't grow with the radius, is the
+        // cheaper of the two. Kept below MaxGaussianRadius / 3, so only rgba32f images ever go
+        // through it from RunGaussian.
+        static constexpr float RecursiveGaussianSigma = 32.0f;
+
+        static int GetMaxGaussianRadius( ImageFormat format ) { return format == ImageFormat::RGBA32F ? MaxGaussianRadius32F : MaxGaussianRadius; }
+        // Three sigma either side covers all but a fraction of a percent of the weight.
+        static int GetGaussianRadius( float sigma );
+
 
         enum class BlurMode
         {
@@ -31,11 +50,46 @@ namespace Surge
             BlurMode blurMode; //TODO draperdanman: support the different blur modes in compute
         };
 
+        // The feedback coefficients of the recursive Gaussian, see RunRecursiveGaussian.
+        struct RecursiveParams
+        {
+            float b;
+            float a1;
+            float a2;
+            float a3;
+        };
+
+        static RecursiveParams GetRecursiveParams( float sigma );
+
         BlurCompute();
         ~BlurCompute();
         void Run( Image *input, Image *output, PushParams params );
+        // Blurs along x into a scratch image, then along y into output. Float images need twice the
+        // shared memory, on devices without it they go through RunRecursiveGaussian instead, as do
+        // ones wider than GetMaxGaussianRadius.
+        void RunGaussian( Image *input, Image *output, float sigma );
+        // Whether RunGaussian has the separable kernel for images of format on this device.
+        bool HasGaussian( ImageFormat format ) const { return GetPipeline( m_gaussianPipes, format ) != VK_NULL_HANDLE; }
+        // Young and van Vliet's recursive approximation, along the rows into an rgba32f scratch
+        // image, then down the columns into output.
+        void RunRecursiveGaussian( Image *input, Image *output, float sigma );
+
+        // Frees the scratch images, which have to go before the device does, see ComputeKernels::ReleaseImages.
+        void ReleaseImages();
 
     private:
+        struct GaussianParams
+        {
+            int directionX;
+            int directionY;
+            float sigma;
+            int radius;
+        };
+
+        // A scratch image no other blur is using, kept from being handed out again until the
+        // compute work recorded so far, which is going to include the caller's, has completed.
+        std::shared_ptr<Image> AcquireScratch( uint32_t width, uint32_t height, ImageFormat format );
+
         void Bind( Image *input, Image *output, PushParams params );
         void UnBind();
         
@@ -43,5 +97,16 @@ namespace Surge
 
         Image *m_input;
         Image *m_output;
+
+        VkDescriptorSetLayout m_gaussianDscLayout;
+        VkPipelineLayout m_gaussianPipeLayout;
+        FormatPipelines m_gaussianPipes;
+
+        FormatPipelines m_recursiveHorizontal;
+        FormatPipelines m_recursiveVertical;
+        VkPipelineLayout m_recursivePipeLayout;
+
+        // Hold the first pass of the Gaussians. Blurs on several threads each take their own.
+        TransientImagePool m_scratchImages;
     };
 }
\ No newline at end of file
@@ -1,22 +1,34 @@
 ﻿#include "ComputeBase.h"
 
+#include <algorithm>
+
 #include "../Application.h"
 #include "../VulkanUtils.h"
 
 namespace Surge
 {
 constexpr uint32_t WORKGROUP_SIZE = 16;
+
+// The formats every kernel is built for, see Shaders/ImageFormat.glsl.
+struct FormatVariant
+{
+    ImageFormat format;
+    const char *suffix;
+    const char *define;
+};
+constexpr std::array<FormatVariant, 3> FormatVariants = { {
+    { ImageFormat::RGBA, "", "" },
+    { ImageFormat::RGBA16F, "rgba16f", "IMAGE_FORMAT_RGBA16F" },
+    { ImageFormat::RGBA32F, "rgba32f", "IMAGE_FORMAT_RGBA32F" },
+} };
     
 ComputeBase::~ComputeBase()
 {
     VkDevice device = Application::GetDevice();
     
-    vkDestroyPipeline( device, m_pipe, nullptr );
+    DestroyFormatPipelines( device, m_pipes );
     vkDestroyPipelineLayout( device, m_pipeLayout, nullptr );
-    vkDestroyPipelineCache( device, m_pipeCache, nullptr );
-    vkDestroyDescriptorPool( device, m_dscPool, nullptr );
     vkDestroyDescriptorSetLayout( device, m_dscLayout, nullptr );
-    vkDestroyShaderModule( device, m_shader, nullptr );
 }
 
 VkDescriptorSetLayout ComputeBase::CreateDescriptorSetLayout( VkDevice device, const int imageCount )
@@ -38,58 +50,10 @@ VkDescriptorSetLayout ComputeBase::CreateDescriptorSetLayout( VkDevice device, c
 }
 
 
-VkDescriptorPool ComputeBase::CreateDescriptorPool( VkDevice device, const int imageCount )
+VkDescriptorSet ComputeBase::GetDescriptorSet( VkDescriptorSetLayout layout, const std::vector<Image *> &images )
 {
-    VkDescriptorPool pool;
-    VkDescriptorPoolSize size;
-    size.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    size.descriptorCount = imageCount;
-    VkDescriptorPoolCreateInfo poolCI = { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
-    poolCI.maxSets = 1;
-    poolCI.poolSizeCount = 1;
-    poolCI.pPoolSizes = &size;
-
-    vkCreateDescriptorPool( device, &poolCI, nullptr, &pool );
-    return pool;
-}
-
-VkDescriptorSet ComputeBase::CreateDescriptorSet( VkDevice device, VkDescriptorPool pool, VkDescriptorSetLayout layout, const std::vector<Image *> &images )
-{
-    VkDescriptorSetAllocateInfo descSetAI = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
-    descSetAI.descriptorPool = pool;
-    descSetAI.descriptorSetCount = 1;
-    descSetAI.pSetLayouts = &layout;
-
-    VkDescriptorSet set;
-    auto result = vkAllocateDescriptorSets( device, &descSetAI, &set );
-
-    fprintf(stderr, vulkan::utils::ErrorAsString(result).c_str());
-    
-    std::vector<VkDescriptorImageInfo> descInfos;
-    for (int i = 0; i < images.size(); ++i)
-    {
-        VkDescriptorImageInfo info = {};
-        info.imageView = images[i]->GetVkImageView();
-        info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-        descInfos.push_back(info);
-    }
-    
-    std::vector<VkWriteDescriptorSet> descWrite;
-
-    for (int i = 0; i < descInfos.size(); ++i)
-    {
-        VkWriteDescriptorSet descW = { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
-        descW.dstSet = set;
-        descW.dstBinding = i;
-        descW.descriptorCount = 1;
-        descW.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-        descW.pImageInfo = &descInfos[i];
-        descWrite.push_back( descW );
-    }
-
-    vkUpdateDescriptorSets( device, descWrite.size(), descWrite.data(), 0, nullptr );
-
-    return set;
+    const Profiler::CpuScope profileScope( "Descriptor setup", "descriptors" );
+    return Application::GetDescriptorCache()->Get( layout, images );
 }
 
 
@@ -108,7 +72,7 @@ VkPipelineLayout ComputeBase::CreatePipelineLayout( VkDevice device, VkDescripto
 }
 
 
-VkPipeline ComputeBase::CreateComputePipeline( VkDevice device, VkShaderModule shader, VkPipelineLayout layout, VkPipelineCache cache )
+VkPipeline ComputeBase::CreateComputePipeline( VkDevice device, VkShaderModule shader, VkPipelineLayout layout )
 {
     // specialize constants of the shader
     std::vector<VkSpecializationMapEntry> specEntries;
@@ -137,10 +101,132 @@ VkPipeline ComputeBase::CreateComputePipeline( VkDevice device, VkShaderModule s
     pipelineCI.layout = layout;
 
     VkPipeline pipe;
-    vkCreateComputePipelines( device, cache, 1, &pipelineCI, nullptr, &pipe);
+    vkCreateComputePipelines( device, Application::GetPipelineCache(), 1, &pipelineCI, nullptr, &pipe);
 
     return pipe;
 }
 
+
+ComputeBase::FormatPipelines ComputeBase::CreateFormatPipelines( VkDevice device, const std::string &path, VkPipelineLayout layout,
+                                                                 const bool floatVariants )
+{
+    // The build compiles X.comp into X.spv, X.rgba16f.spv and X.rgba32f.spv.
+    vulkan::ShaderLoader loader;
+    FormatPipelines pipelines;
+    for ( size_t i = 0; i < FormatVariants.size(); ++i )
+    {
+        const FormatVariant &variant = FormatVariants[i];
+        if ( Image::IsFloat( variant.format ) && !floatVariants )
+        {
+            continue;
+        }
+        pipelines.shaders[i] = loader.LoadShader( device, path.c_str(), variant.suffix, variant.define );
+        pipelines.pipes[i] = CreateComputePipeline( device, pipelines.shaders[i], layout );
+    }
+    return pipelines;
+}
+
+
+void ComputeBase::DestroyFormatPipelines( VkDevice device, const FormatPipelines &pipelines )
+{
+    for ( size_t i = 0; i < FormatVariants.size(); ++i )
+    {
+        vkDestroyPipeline( device, pipelines.pipes[i], nullptr );
+        vkDestroyShaderModule( device, pipelines.shaders[i], nullptr );
+    }
+}
+
+
+VkPipeline ComputeBase::GetPipeline( const FormatPipelines &pipelines, const ImageFormat format )
+{
+    for ( size_t i = 0; i < FormatVariants.size(); ++i )
+    {
+        if ( FormatVariants[i].format == format )
+        {
+            return pipelines.pipes[i];
+        }
+    }
+    return pipelines.pipes[0];
+}
+
+
+void ComputeBase::RecordDispatch( VkCommandBuffer cmdBuffer, VkPipeline pipeline, VkPipelineLayout layout, VkDescriptorSet dscSet, const std::vector<Image *> &images, const void *pushData, uint32_t pushSize )
+{
+    const Image *output = images.back();
+    const uint32_t wgWidthSize = (output->GetWidth() + WORKGROUP_SIZE - 1u) / WORKGROUP_SIZE;
+    const uint32_t wgHeightSize = (output->GetHeight() + WORKGROUP_SIZE - 1u) / WORKGROUP_SIZE;
+
+    RecordDispatch( cmdBuffer, pipeline, layout, dscSet, images, pushData, pushSize, wgWidthSize, wgHeightSize, false );
+}
+
+
+void ComputeBase::RecordDispatch( VkCommandBuffer cmdBuffer, VkPipeline pipeline, VkPipelineLayout layout, VkDescriptorSet dscSet, const std::vector<Image *> &images, const void *pushData, uint32_t pushSize,
+                                  uint32_t groupCountX, uint32_t groupCountY, bool readWrite )
+{
+    Image *output = images.back();
+    const VkAccessFlags inputAccess = readWrite ? VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT : VK_ACCESS_SHADER_READ_BIT;
+
+    // The same image can be bound twice (e.g. both sides of a blend), but it must only be transitioned once.
+    std::vector<Image *> unique;
+    for ( Image *image : images )
+    {
+        if ( std::find( unique.begin(), unique.end(), image ) == unique.end() )
+        {
+            unique.push_back( image );
+        }
+    }
+
+    std::vector<VkImageMemoryBarrier> barriers( unique.size() );
+    for ( size_t i = 0; i < unique.size(); ++i )
+    {
+        VkImageMemoryBarrier &barrier = barriers[i];
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+        // the output is overwritten entirely, so its old contents (and layout, it may never have been written) don't matter
+        barrier.oldLayout       = unique[i] == output ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.newLayout       = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.srcAccessMask   = 0;
+        barrier.dstAccessMask   = unique[i] == output ? VK_ACCESS_SHADER_WRITE_BIT : inputAccess;
+        barrier.image           = unique[i]->GetVkImage();
+    }
+
+    // Previous dispatches already made their writes visible when moving back to SHADER_READ_ONLY, this only has
+    // to wait for them (and for anyone still reading the output, which includes UI frames drawing it) to finish.
+    vkCmdPipelineBarrier( cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                            0, 0, nullptr, 0, nullptr,
+                            static_cast<uint32_t>( barriers.size() ), barriers.data() );
+
+    // Timed and labelled after the node it was recorded for, see Profiler::NodeScope.
+    Profiler *profiler = Application::GetProfiler();
+    profiler->BeginDispatch( cmdBuffer );
+
+    vkCmdBindPipeline( cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline );
     
-}
\ No newline at end of file
+    vkCmdBindDescriptorSets( cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, 1, &dscSet, 0, nullptr);
+
+    vkCmdPushConstants( cmdBuffer, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, pushSize, pushData );
+
+    vkCmdDispatch( cmdBuffer, groupCountX, groupCountY, 1 );
+
+    profiler->EndDispatch( cmdBuffer );
+
+    for ( size_t i = 0; i < unique.size(); ++i )
+    {
+        VkImageMemoryBarrier &barrier = barriers[i];
+        barrier.oldLayout       = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.newLayout       = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask   = unique[i] == output || readWrite ? VK_ACCESS_SHADER_WRITE_BIT : 0;
+        barrier.dstAccessMask   = VK_ACCESS_SHADER_READ_BIT;
+    }
+
+    vkCmdPipelineBarrier( cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                            0, 0, nullptr, 0, nullptr,
+                            static_cast<uint32_t>( barriers.size() ), barriers.data() );
+}
+
+}
@@ -1,5 +1,7 @@
 ﻿#pragma once
 
+#include <array>
+#include <string>
 #include <vector>
 
 #include "../Image.h"
@@ -11,22 +13,44 @@ namespace Surge
 class ComputeBase
 {
 protected:
+    // A kernel built once for each format of image it reads and writes, see Shaders/ImageFormat.glsl. The
+    // images a dispatch binds all have to be of the format its variant was picked for, but for the ones the
+    // shader declares a format of its own for, like the curves LUT.
+    struct FormatPipelines
+    {
+        std::array<VkShaderModule, 3> shaders = {};
+        std::array<VkPipeline, 3> pipes = {};
+    };
+
     ~ComputeBase();
     
     VkDescriptorSetLayout CreateDescriptorSetLayout( VkDevice device, const int imageCount );
-    VkDescriptorPool CreateDescriptorPool( VkDevice device, const int imageCount );
-    virtual VkDescriptorSet CreateDescriptorSet( VkDevice device, VkDescriptorPool pool, VkDescriptorSetLayout layout, const std::vector<Image *> &images );
+    // A set binding images in order, shared with every other dispatch binding the same ones, see DescriptorCache.
+    VkDescriptorSet GetDescriptorSet( VkDescriptorSetLayout layout, const std::vector<Image *> &images );
     VkPipelineLayout CreatePipelineLayout( VkDevice device, VkDescriptorSetLayout dscLayout, const std::vector<VkPushConstantRange> &pushConstantRanges );
-    VkPipeline CreateComputePipeline( VkDevice device, VkShaderModule shader, VkPipelineLayout layout, VkPipelineCache cache );
+    // Goes through the pipeline cache shared by every kernel, see Application::GetPipelineCache.
+    VkPipeline CreateComputePipeline( VkDevice device, VkShaderModule shader, VkPipelineLayout layout );
+    // Loads the shader at path in every format variant, with a pipeline for each. Without floatVariants only
+    // the rgba8 one is made, for shaders that need more of the device for the others.
+    FormatPipelines CreateFormatPipelines( VkDevice device, const std::string &path, VkPipelineLayout layout, bool floatVariants = true );
+    static void DestroyFormatPipelines( VkDevice device, const FormatPipelines &pipelines );
+    // The variant for images of format, null if it wasn't made. The rgba8 one for any other format.
+    static VkPipeline GetPipeline( const FormatPipelines &pipelines, ImageFormat format );
+
+    // Records a dispatch over the last image in images, which is the one the shader writes. Every image is moved
+    // to GENERAL for the dispatch and back to SHADER_READ_ONLY afterwards, waiting on earlier compute writes, so
+    // several dispatches recorded into the same command buffer see each other's results.
+    void RecordDispatch( VkCommandBuffer cmdBuffer, VkPipeline pipeline, VkPipelineLayout layout, VkDescriptorSet dscSet, const std::vector<Image *> &images, const void *pushData, uint32_t pushSize );
+    // The same, for shaders that aren't run once per output pixel: dispatches groupCountX by groupCountY workgroups
+    // instead. With readWrite set, the images before the last one are kept but may be written in place as well.
+    void RecordDispatch( VkCommandBuffer cmdBuffer, VkPipeline pipeline, VkPipelineLayout layout, VkDescriptorSet dscSet, const std::vector<Image *> &images, const void *pushData, uint32_t pushSize,
+                         uint32_t groupCountX, uint32_t groupCountY, bool readWrite );
     
-    VkShaderModule m_shader;            ///< compute shader
+    FormatPipelines m_pipes;            ///< compute shader and the pipeline to submit compute commands, per image format
     VkDescriptorSetLayout m_dscLayout;  ///< c++ definition of the shader binding interface
-    VkDescriptorPool m_dscPool; ///< descriptors pool
     VkCommandPool m_cmdPool;            ///< used to allocate command buffers
-    VkPipelineCache m_pipeCache;        ///< pipeline cache
     VkPipelineLayout m_pipeLayout;      ///< defines shader interface as a set of layout bindings and push constants
 
-    VkPipeline m_pipe;                   ///< pipeline to submit compute commands
     VkCommandBuffer m_cmdBuffer; ///< commands recorded here, once command buffer is submitted to a queue those commands get executed
 };
     
@@ -0,0 +1,51 @@
+﻿#include "ComputeKernels.h"
+
+#include "BlendCompute.h"
+#include "BlurCompute.h"
+#include "CurvesCompute.h"
+#include "DownsampleCompute.h"
+#include "FusedPointwiseCompute.h"
+#include "HSLCompute.h"
+#include "InvertCompute.h"
+#include "LevelsCompute.h"
+#include "NoiseCompute.h"
+#include "TransformCompute.h"
+
+#include "../Application.h"
+
+namespace Surge
+{
+
+void ComputeKernels::WarmUp( ThreadPool &pool )
+{
+    // Loading the shaders and creating the pipelines is most of the startup time, and none of it
+    // depends on another kernel.
+    GetFuture<BlendCompute>( &pool );
+    GetFuture<BlurCompute>( &pool );
+    GetFuture<CurvesCompute>( &pool );
+    GetFuture<DownsampleCompute>( &pool );
+    GetFuture<FusedPointwiseCompute>( &pool );
+    GetFuture<HSLCompute>( &pool );
+    GetFuture<InvertCompute>( &pool );
+    GetFuture<LevelsCompute>( &pool );
+    GetFuture<NoiseCompute>( &pool );
+    GetFuture<TransformCompute>( &pool );
+}
+
+
+void ComputeKernels::ReleaseImages()
+{
+    // WarmUp started every kernel, so this doesn't build one just to empty it.
+    if ( BlurCompute *blur = Get<BlurCompute>() )
+    {
+        blur->ReleaseImages();
+    }
+}
+
+
+bool ComputeKernels::HasDevice()
+{
+    return Application::GetDevice() != VK_NULL_HANDLE;
+}
+
+}
@@ -0,0 +1,48 @@
+﻿#pragma once
+
+#include <future>
+#include <mutex>
+
+#include "../ThreadPool.h"
+
+namespace Surge
+{
+    // Every compute kernel is built once and shared by all the nodes using it. WarmUp starts building
+    // them all on a thread pool at startup; Get hands one out, waiting if it is still being built, or
+    // building it there and then if WarmUp never asked for it. Without a Vulkan device Get returns
+    // nullptr, nodes then only ever run on the CpuKernels.
+    class ComputeKernels
+    {
+    public:
+        static void WarmUp( ThreadPool &pool );
+        // Frees the images kernels keep between runs, e.g. the blur's scratch images. The kernels
+        // themselves are never destroyed, but their images have to go before the device does.
+        static void ReleaseImages();
+
+        template <typename Kernel>
+        static Kernel *Get()
+        {
+            if ( !HasDevice() )
+            {
+                return nullptr;
+            }
+            return GetFuture<Kernel>( nullptr ).get();
+        }
+
+    private:
+        static bool HasDevice();
+
+        template <typename Kernel>
+        static const std::shared_future<Kernel *> &GetFuture( ThreadPool *pool )
+        {
+            static std::once_flag once;
+            static std::shared_future<Kernel *> future;
+            std::call_once( once, [pool]()
+            {
+                auto create = []() -> Kernel * { return new Kernel(); };
+                future = pool ? pool->Submit( create ) : std::async( std::launch::deferred, create ).share();
+            } );
+            return future;
+        }
+    };
+}
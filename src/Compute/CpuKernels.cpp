@@ -0,0 +1,955 @@
+﻿#include "CpuKernels.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "../Application.h"
+
+namespace Surge
+{
+
+namespace
+{
+
+constexpr size_t Channels = 4;
+
+// Calls body for chunks of [0, count), on the calling thread and on whichever of the pool's threads
+// are free. Only the chunks are waited on, not the tasks, so with the pool busy on something else
+// the calling thread just ends up doing more of the work.
+void ParallelFor( const uint32_t count, const std::function<void( uint32_t begin, uint32_t end )> &body )
+{
+    ThreadPool *pool = Application::GetThreadPool();
+    const uint32_t threadCount = pool ? static_cast<uint32_t>( pool->GetThreadCount() ) + 1 : 1;
+    // A few chunks per thread, so one that gets the slow part of the image doesn't hold up the rest.
+    const uint32_t chunkSize = std::max( count / ( threadCount * 4 ), 1u );
+    const uint32_t chunkCount = ( count + chunkSize - 1 ) / chunkSize;
+    if ( chunkCount <= 1 || threadCount == 1 )
+    {
+        body( 0, count );
+        return;
+    }
+
+    struct Work
+    {
+        std::atomic<uint32_t> next = 0;
+        std::mutex mutex;
+        std::condition_variable finished;
+        uint32_t done = 0;
+    };
+    const auto work = std::make_shared<Work>();
+    // Tasks the pool only gets to after the last chunk was taken return straight away, they never
+    // touch body, which is gone by then.
+    auto run = [work, &body, count, chunkSize, chunkCount]()
+    {
+        for ( uint32_t chunk = work->next++; chunk < chunkCount; chunk = work->next++ )
+        {
+            const uint32_t begin = chunk * chunkSize;
+            body( begin, std::min( begin + chunkSize, count ) );
+            std::lock_guard<std::mutex> lock( work->mutex );
+            if ( ++work->done == chunkCount )
+            {
+                work->finished.notify_all();
+            }
+        }
+    };
+
+    for ( uint32_t i = 1; i < std::min( threadCount, chunkCount ); ++i )
+    {
+        pool->Submit( run );
+    }
+    run();
+    std::unique_lock<std::mutex> lock( work->mutex );
+    work->finished.wait( lock, [&work, chunkCount]() { return work->done == chunkCount; } );
+}
+
+
+// Reads width pixels from x, y of image as floats. Pixels outside of the image read as zero, like
+// imageLoad does with robust buffer access.
+void LoadSpan( const Image *image, const int32_t x, const int32_t y, const uint32_t width, float *span )
+{
+    std::fill( span, span + width * Channels, 0.0f );
+    const int32_t imageWidth = static_cast<int32_t>( image->GetWidth() );
+    if ( y < 0 || y >= static_cast<int32_t>( image->GetHeight() ) )
+    {
+        return;
+    }
+    const int32_t begin = std::max( x, 0 );
+    const int32_t end = std::min( x + static_cast<int32_t>( width ), imageWidth );
+    if ( begin >= end )
+    {
+        return;
+    }
+
+    const size_t first = static_cast<size_t>( y ) * imageWidth + begin;
+    Image::ConvertPixels( image->GetFormat(), image->GetPixels() + first * Image::BytesPerPixel( image->GetFormat() ), ImageFormat::RGBA32F,
+                          span + static_cast<size_t>( begin - x ) * Channels, static_cast<size_t>( end - begin ) );
+}
+
+
+// Writes width pixels to x, y of image, which have to be inside it, converted like
+// Image::ConvertPixels does.
+void StoreSpan( Image *image, const uint32_t x, const uint32_t y, const uint32_t width, const float *span )
+{
+    const size_t first = static_cast<size_t>( y ) * image->GetWidth() + x;
+    Image::ConvertPixels( ImageFormat::RGBA32F, span, image->GetFormat(), image->GetPixels() + first * Image::BytesPerPixel( image->GetFormat() ), width );
+}
+
+
+// Runs kernel( row, width ) over every row of output, handed in as the matching rows of inputs and
+// stored from the first of them afterwards.
+template <size_t InputCount, typename Kernel>
+void ForEachRow( const Image *const ( &inputs )[InputCount], Image *output, Kernel kernel )
+{
+    const uint32_t width = output->GetWidth();
+    ParallelFor( output->GetHeight(), [&]( const uint32_t begin, const uint32_t end )
+    {
+        std::vector<float> rows( InputCount * width * Channels );
+        float *rowPointers[InputCount];
+        for ( size_t i = 0; i < InputCount; ++i )
+        {
+            rowPointers[i] = rows.data() + i * width * Channels;
+        }
+        for ( uint32_t y = begin; y < end; ++y )
+        {
+            for ( size_t i = 0; i < InputCount; ++i )
+            {
+                LoadSpan( inputs[i], 0, static_cast<int32_t>( y ), width, rowPointers[i] );
+            }
+            kernel( rowPointers, static_cast<size_t>( width ) * Channels );
+            StoreSpan( output, 0, y, width, rowPointers[0] );
+        }
+    } );
+}
+
+
+struct Vec2
+{
+    float x, y;
+};
+
+struct Vec3
+{
+    float x, y, z;
+};
+
+struct Vec4
+{
+    float r = 0.0f, g = 0.0f, b = 0.0f, a = 0.0f;
+};
+
+
+float Fract( const float value )
+{
+    return value - std::floor( value );
+}
+
+
+float Mix( const float from, const float to, const float t )
+{
+    return from * ( 1.0f - t ) + to * t;
+}
+
+
+float Length( const float x, const float y )
+{
+    return std::sqrt( x * x + y * y );
+}
+
+
+Vec4 Fetch( const Image *image, const int32_t x, const int32_t y )
+{
+    if ( x < 0 || y < 0 || x >= static_cast<int32_t>( image->GetWidth() ) || y >= static_cast<int32_t>( image->GetHeight() ) )
+    {
+        return {};
+    }
+    const size_t index = static_cast<size_t>( y ) * image->GetWidth() + x;
+    Vec4 pixel;
+    Image::ConvertPixels( image->GetFormat(), image->GetPixels() + index * Image::BytesPerPixel( image->GetFormat() ), ImageFormat::RGBA32F, &pixel, 1 );
+    return pixel;
+}
+
+
+// ------ Shaders/Pointwise ------ //
+
+void ApplyHSL( float *pixel, const HSLCompute::PushParams &params )
+{
+    constexpr float epsilon = 1e-10f;
+    const float r = pixel[0], g = pixel[1], b = pixel[2];
+
+    // RGBtoHCV
+    const float p[4] = { g < b ? b : g, g < b ? g : b, g < b ? -1.0f : 0.0f, g < b ? 2.0f / 3.0f : -1.0f / 3.0f };
+    const float q[4] = { r < p[0] ? p[0] : r, p[1], r < p[0] ? p[3] : p[2], r < p[0] ? r : p[0] };
+    const float c = q[0] - std::min( q[3], q[1] );
+    const float h = std::abs( ( q[3] - q[1] ) / ( 6.0f * c + epsilon ) + q[2] );
+
+    // rgb2hsl
+    const float l = q[0] - c * 0.5f;
+    const float s = c / ( 1.0f - std::abs( l * 2.0f - 1.0f ) + epsilon );
+
+    const float hue = h + params.hue;
+    const float saturation = std::clamp( s + params.saturation, 0.0f, 1.0f );
+    const float lightness = std::clamp( l + params.lightness, 0.0f, 1.0f );
+
+    // hsl2rgb
+    const float rgb[3] = { std::clamp( std::abs( hue * 6.0f - 3.0f ) - 1.0f, 0.0f, 1.0f ),
+                           std::clamp( 2.0f - std::abs( hue * 6.0f - 2.0f ), 0.0f, 1.0f ),
+                           std::clamp( 2.0f - std::abs( hue * 6.0f - 4.0f ), 0.0f, 1.0f ) };
+    const float chroma = ( 1.0f - std::abs( 2.0f * lightness - 1.0f ) ) * saturation;
+    for ( int i = 0; i < 3; ++i )
+    {
+        pixel[i] = ( rgb[i] - 0.5f ) * chroma + lightness;
+    }
+    pixel[3] = 1.0f;
+}
+
+
+void ApplyLevels( float *pixel, const LevelsCompute::PushParams &params )
+{
+    const float inputScale = 1.0f / ( params.inputRange.y - params.inputRange.x );
+    const float outputScale = params.outputRange.y - params.outputRange.x;
+    const float exponent = 1.0f / params.gamma;
+    if ( params.luminanceOnly < 0.5f )
+    {
+        for ( int i = 0; i < 3; ++i )
+        {
+            const float value = std::clamp( ( pixel[i] - params.inputRange.x ) * inputScale, 0.0f, 1.0f );
+            pixel[i] = std::pow( value, exponent ) * outputScale + params.outputRange.x;
+        }
+    }
+    else
+    {
+        float luma = pixel[0] * 0.25f + pixel[1] * 0.5f + pixel[2] * 0.25f;
+        const float chroma[3] = { pixel[0] - luma, pixel[1] - luma, pixel[2] - luma };
+        luma = std::clamp( ( luma - params.inputRange.x ) * inputScale, 0.0f, 1.0f );
+        luma = std::pow( luma, exponent ) * outputScale + params.outputRange.x;
+        for ( int i = 0; i < 3; ++i )
+        {
+            pixel[i] = luma + chroma[i];
+        }
+    }
+    pixel[3] = 1.0f;
+}
+
+
+// ------ Shaders/NoiseCompute.comp ------ //
+
+float RawNoise( const float x, const float y )
+{
+    constexpr float strength = 3.0f;
+    constexpr uint32_t k = 1103515245u;
+    uint32_t v[3] = { 0, 0, 0x13375EEDu };
+    memcpy( &v[0], &x, sizeof( float ) );
+    memcpy( &v[1], &y, sizeof( float ) );
+    for ( int round = 0; round < 3; ++round )
+    {
+        const uint32_t mixed[3] = { ( ( v[0] >> 8u ) ^ v[1] ) * k, ( ( v[1] >> 8u ) ^ v[2] ) * k, ( ( v[2] >> 8u ) ^ v[0] ) * k };
+        memcpy( v, mixed, sizeof( v ) );
+    }
+    float noise = 0.0f;
+    for ( const uint32_t bits : v )
+    {
+        const uint32_t mantissa = ( bits & 0x007FFFFFu ) | 0x3F800000u;
+        float value;
+        memcpy( &value, &mantissa, sizeof( float ) );
+        noise += value - 1.5f;
+    }
+    return 1.0f + noise / 3.0f * ( std::exp2( strength ) - 1.0f );
+}
+
+
+Vec3 Hash3( const Vec2 p )
+{
+    return { Fract( std::sin( p.x * 127.1f + p.y * 311.7f ) * 43758.5453f ), Fract( std::sin( p.x * 269.5f + p.y * 183.3f ) * 43758.5453f ),
+             Fract( std::sin( p.x * 419.2f + p.y * 371.9f ) * 43758.5453f ) };
+}
+
+
+float VoronoiNoise( const Vec2 p, const float u, const float v )
+{
+    const float k = 1.0f + 63.0f * std::pow( 1.0f - v, 6.0f );
+    const Vec2 cell = { std::floor( p.x ), std::floor( p.y ) };
+    const Vec2 f = { p.x - cell.x, p.y - cell.y };
+
+    float sum = 0.0f, weightSum = 0.0f;
+    for ( int y = -2; y <= 2; ++y )
+    {
+        for ( int x = -2; x <= 2; ++x )
+        {
+            const Vec3 o = Hash3( { cell.x + x, cell.y + y } );
+            const float distance = Length( x - f.x + o.x * u, y - f.y + o.y * u );
+            // smoothstep(0.0, 1.414, distance)
+            const float t = std::clamp( distance / 1.414f, 0.0f, 1.0f );
+            const float w = std::pow( 1.0f - t * t * ( 3.0f - 2.0f * t ), k );
+            sum += o.z * w;
+            weightSum += w;
+        }
+    }
+    return sum / weightSum;
+}
+
+
+float R( const float n )
+{
+    return Fract( std::cos( n * 89.42f ) * 343.42f );
+}
+
+
+float Worley( const Vec2 n, const float s )
+{
+    const Vec2 cell = { std::floor( n.x / s ), std::floor( n.y / s ) };
+    const Vec2 f = { Fract( n.x / s ), Fract( n.y / s ) };
+    float dis = 2.0f;
+    for ( int x = -1; x <= 1; ++x )
+    {
+        for ( int y = -1; y <= 1; ++y )
+        {
+            const Vec2 p = { cell.x + x, cell.y + y };
+            const Vec2 r = { R( p.x * 23.62f - 300.0f + p.y * 34.35f ), R( p.x * 45.13f + 256.0f + p.y * 38.89f ) };
+            dis = std::min( dis, Length( r.x + x - f.x, r.y + y - f.y ) );
+        }
+    }
+    return 1.0f - dis;
+}
+
+
+Vec3 Hash33( Vec3 p3 )
+{
+    p3 = { Fract( p3.x * 0.1031f ), Fract( p3.y * 0.11369f ), Fract( p3.z * 0.13787f ) };
+    const float d = p3.x * ( p3.y + 19.19f ) + p3.y * ( p3.x + 19.19f ) + p3.z * ( p3.z + 19.19f );
+    p3 = { p3.x + d, p3.y + d, p3.z + d };
+    return { -1.0f + 2.0f * Fract( ( p3.x + p3.y ) * p3.z ), -1.0f + 2.0f * Fract( ( p3.x + p3.z ) * p3.y ),
+             -1.0f + 2.0f * Fract( ( p3.y + p3.z ) * p3.x ) };
+}
+
+
+float PerlinNoise( const Vec3 p )
+{
+    const Vec3 pi = { std::floor( p.x ), std::floor( p.y ), std::floor( p.z ) };
+    const Vec3 pf = { p.x - pi.x, p.y - pi.y, p.z - pi.z };
+    const Vec3 w = { pf.x * pf.x * ( 3.0f - 2.0f * pf.x ), pf.y * pf.y * ( 3.0f - 2.0f * pf.y ), pf.z * pf.z * ( 3.0f - 2.0f * pf.z ) };
+    auto corner = [&pi, &pf]( const float x, const float y, const float z ) -> float
+    {
+        const Vec3 gradient = Hash33( { pi.x + x, pi.y + y, pi.z + z } );
+        return ( pf.x - x ) * gradient.x + ( pf.y - y ) * gradient.y + ( pf.z - z ) * gradient.z;
+    };
+
+    return Mix( Mix( Mix( corner( 0, 0, 0 ), corner( 1, 0, 0 ), w.x ), Mix( corner( 0, 0, 1 ), corner( 1, 0, 1 ), w.x ), w.z ),
+                Mix( Mix( corner( 0, 1, 0 ), corner( 1, 1, 0 ), w.x ), Mix( corner( 0, 1, 1 ), corner( 1, 1, 1 ), w.x ), w.z ), w.y );
+}
+
+
+float WorleyPerlin( const Vec3 v )
+{
+    const Vec2 xy = { v.x, v.y };
+    const float dis = ( 1.0f + PerlinNoise( { v.x * 8.0f, v.y * 8.0f, v.z * 8.0f } ) ) *
+                      ( 1.0f + ( Worley( xy, 32.0f ) + 0.5f * Worley( { 2.0f * v.x, 2.0f * v.y }, 32.0f ) +
+                                 0.25f * Worley( { 4.0f * v.x, 4.0f * v.y }, 32.0f ) ) );
+    return dis / 4.0f;
+}
+
+
+float Mod289( const float x )
+{
+    return x - std::floor( x * ( 1.0f / 289.0f ) ) * 289.0f;
+}
+
+
+float Permute( const float x )
+{
+    return Mod289( ( x * 34.0f + 1.0f ) * x );
+}
+
+
+// Ashima Arts' 3D simplex noise, see the copyright notice in NoiseCompute.comp. The shader's
+// vec4s hold one value per corner of the simplex, here they are loops over the four corners.
+float Simplex( const Vec3 v )
+{
+    constexpr float cx = 1.0f / 6.0f, cy = 1.0f / 3.0f;
+
+    // First corner
+    const float skew = ( v.x + v.y + v.z ) * cy;
+    const float i[3] = { std::floor( v.x + skew ), std::floor( v.y + skew ), std::floor( v.z + skew ) };
+    const float unskew = ( i[0] + i[1] + i[2] ) * cx;
+    const float x0[3] = { v.x - i[0] + unskew, v.y - i[1] + unskew, v.z - i[2] + unskew };
+
+    // Other corners
+    const float g[3] = { x0[0] >= x0[1] ? 1.0f : 0.0f, x0[1] >= x0[2] ? 1.0f : 0.0f, x0[2] >= x0[0] ? 1.0f : 0.0f };
+    const float l[3] = { 1.0f - g[0], 1.0f - g[1], 1.0f - g[2] };
+    const float i1[3] = { std::min( g[0], l[2] ), std::min( g[1], l[0] ), std::min( g[2], l[1] ) };
+    const float i2[3] = { std::max( g[0], l[2] ), std::max( g[1], l[0] ), std::max( g[2], l[1] ) };
+
+    float corners[4][3];
+    for ( int axis = 0; axis < 3; ++axis )
+    {
+        corners[0][axis] = x0[axis];
+        corners[1][axis] = x0[axis] - i1[axis] + cx;
+        corners[2][axis] = x0[axis] - i2[axis] + cy;
+        corners[3][axis] = x0[axis] - 0.5f;
+    }
+
+    // Permutations
+    const float im[3] = { Mod289( i[0] ), Mod289( i[1] ), Mod289( i[2] ) };
+    const float offsets[3][4] = { { 0.0f, i1[0], i2[0], 1.0f }, { 0.0f, i1[1], i2[1], 1.0f }, { 0.0f, i1[2], i2[2], 1.0f } };
+
+    // Gradients: 7x7 points over a square, mapped onto an octahedron.
+    constexpr float n = 0.142857142857f;
+    constexpr float ns[3] = { n * 2.0f, n * 0.5f - 1.0f, n };
+
+    float result = 0.0f;
+    for ( int c = 0; c < 4; ++c )
+    {
+        const float p = Permute( Permute( Permute( im[2] + offsets[2][c] ) + im[1] + offsets[1][c] ) + im[0] + offsets[0][c] );
+        const float j = p - 49.0f * std::floor( p * ns[2] * ns[2] );
+        const float gx = std::floor( j * ns[2] );
+        const float gy = std::floor( j - 7.0f * gx );
+        const float x = gx * ns[0] + ns[1];
+        const float y = gy * ns[0] + ns[1];
+        const float h = 1.0f - std::abs( x ) - std::abs( y );
+        const float sh = h <= 0.0f ? -1.0f : 0.0f;
+        float gradient[3] = { x + ( std::floor( x ) * 2.0f + 1.0f ) * sh, y + ( std::floor( y ) * 2.0f + 1.0f ) * sh, h };
+
+        // Normalise gradients
+        const float norm = 1.79284291400159f - 0.85373472095314f * ( gradient[0] * gradient[0] + gradient[1] * gradient[1] + gradient[2] * gradient[2] );
+        const float *corner = corners[c];
+        float m = std::max( 0.6f - ( corner[0] * corner[0] + corner[1] * corner[1] + corner[2] * corner[2] ), 0.0f );
+        m = m * m;
+        result += m * m * norm * ( gradient[0] * corner[0] + gradient[1] * corner[1] + gradient[2] * corner[2] );
+    }
+    return 42.0f * result;
+}
+
+
+float Fbm3( const Vec3 v )
+{
+    float result = Simplex( v );
+    result += Simplex( { v.x * 2.0f, v.y * 2.0f, v.z * 2.0f } ) / 2.0f;
+    result += Simplex( { v.x * 4.0f, v.y * 4.0f, v.z * 4.0f } ) / 4.0f;
+    return result / ( 1.0f + 1.0f / 2.0f + 1.0f / 4.0f );
+}
+
+
+float Fbm5( const Vec3 v )
+{
+    float result = 0.0f, total = 0.0f;
+    for ( float octave = 1.0f; octave <= 16.0f; octave *= 2.0f )
+    {
+        result += Simplex( { v.x * octave, v.y * octave, v.z * octave } ) / octave;
+        total += 1.0f / octave;
+    }
+    return result / total;
+}
+
+
+float SmokeyNoise( Vec3 v )
+{
+    constexpr int swirlSteps = 2;
+    constexpr float swirlStepValue = 1.0f / static_cast<float>( swirlSteps );
+    // Make it curl
+    for ( int i = 0; i < swirlSteps; ++i )
+    {
+        const float dx = Fbm3( v );
+        const float dy = Fbm3( { v.x, v.y, v.z + 1000.0f } );
+        v.x += dx * swirlStepValue;
+        v.y += dy * swirlStepValue;
+    }
+    return Fbm5( v ) / 2.0f + 0.5f;
+}
+
+}
+
+
+void CpuKernels::Blend( const Image *left, const Image *right, Image *output, const BlendCompute::PushParams params )
+{
+    const Image *inputs[] = { left, right };
+    ForEachRow( inputs, output, [&params]( float *const *rows, const size_t count )
+    {
+        float *top = rows[0];
+        const float *bottom = rows[1];
+        switch ( params.blendMode )
+        {
+        case BlendCompute::BlendMode::ADD:
+            for ( size_t i = 0; i < count; ++i )
+            {
+                top[i] = top[i] + bottom[i];
+            }
+            break;
+        case BlendCompute::BlendMode::SUBTRACT:
+            for ( size_t i = 0; i < count; ++i )
+            {
+                top[i] = ( i % Channels ) == 3 ? 1.0f : top[i] - bottom[i];
+            }
+            break;
+        case BlendCompute::BlendMode::MULTIPLY:
+            for ( size_t i = 0; i < count; ++i )
+            {
+                top[i] = top[i] * bottom[i];
+            }
+            break;
+        case BlendCompute::BlendMode::DIVIDE:
+            for ( size_t i = 0; i < count; ++i )
+            {
+                top[i] = top[i] / bottom[i];
+            }
+            break;
+        case BlendCompute::BlendMode::SCREEN:
+            for ( size_t i = 0; i < count; ++i )
+            {
+                top[i] = 1.0f - ( 1.0f - top[i] ) * ( 1.0f - bottom[i] );
+            }
+            break;
+        default:
+            std::fill( top, top + count, 1.0f );
+            break;
+        }
+    } );
+}
+
+
+void CpuKernels::HSL( const Image *input, Image *output, const HSLCompute::PushParams params )
+{
+    const Image *inputs[] = { input };
+    ForEachRow( inputs, output, [&params]( float *const *rows, const size_t count )
+    {
+        for ( size_t i = 0; i < count; i += Channels )
+        {
+            ApplyHSL( rows[0] + i, params );
+        }
+    } );
+}
+
+
+void CpuKernels::Levels( const Image *input, Image *output, const LevelsCompute::PushParams params )
+{
+    const Image *inputs[] = { input };
+    ForEachRow( inputs, output, [&params]( float *const *rows, const size_t count )
+    {
+        for ( size_t i = 0; i < count; i += Channels )
+        {
+            ApplyLevels( rows[0] + i, params );
+        }
+    } );
+}
+
+
+void CpuKernels::Curves( const Image *input, const Image *curvesLUT, Image *output, const CurvesCompute::PushParams params )
+{
+    // Looked up the way CurvesLUTCoord does, values past the end of the LUT read as zero.
+    const uint32_t lutWidth = curvesLUT->GetWidth();
+    std::vector<float> lut( lutWidth * Channels );
+    LoadSpan( curvesLUT, 0, 0, lutWidth, lut.data() );
+
+    const Image *inputs[] = { input };
+    ForEachRow( inputs, output, [&lut, lutWidth, &params]( float *const *rows, const size_t count )
+    {
+        float *pixels = rows[0];
+        for ( size_t i = 0; i < count; i += Channels )
+        {
+            for ( size_t channel = 0; channel < 3; ++channel )
+            {
+                const int index = static_cast<int>( pixels[i + channel] * static_cast<float>( params.widthLUT ) );
+                pixels[i + channel] = index >= 0 && index < static_cast<int>( lutWidth ) ? lut[index * Channels + channel] : 0.0f;
+            }
+        }
+    } );
+}
+
+
+void CpuKernels::Invert( const Image *input, Image *output, const InvertCompute::PushParams params )
+{
+    const float mask[Channels] = { ( params.channels & 1 ) != 0 ? 1.0f : 0.0f, ( params.channels & 2 ) != 0 ? 1.0f : 0.0f,
+                                   ( params.channels & 4 ) != 0 ? 1.0f : 0.0f, ( params.channels & 8 ) != 0 ? 1.0f : 0.0f };
+    const Image *inputs[] = { input };
+    ForEachRow( inputs, output, [&mask]( float *const *rows, const size_t count )
+    {
+        float *pixels = rows[0];
+        for ( size_t i = 0; i < count; ++i )
+        {
+            pixels[i] = std::abs( mask[i % Channels] - pixels[i] );
+        }
+    } );
+}
+
+
+void CpuKernels::Transform( const Image *input, Image *output, const TransformCompute::PushParams params )
+{
+    // Every input pixel is stored at its mirrored position, like the shader. Those that land outside
+    // of output are dropped, and whatever they would have covered is left as it was.
+    const int32_t width = static_cast<int32_t>( output->GetWidth() );
+    const int32_t height = static_cast<int32_t>( output->GetHeight() );
+    const int32_t sizeX = static_cast<int32_t>( params.size.x );
+    const int32_t sizeY = static_cast<int32_t>( params.size.y );
+    ParallelFor( output->GetHeight(), [&]( const uint32_t begin, const uint32_t end )
+    {
+        std::vector<float> source( width * Channels ), target( width * Channels );
+        for ( uint32_t y = begin; y < end; ++y )
+        {
+            const int32_t targetY = params.scale.y > 0 ? static_cast<int32_t>( y ) : sizeY - static_cast<int32_t>( y );
+            if ( targetY < 0 || targetY >= height )
+            {
+                continue;
+            }
+            LoadSpan( input, 0, static_cast<int32_t>( y ), width, source.data() );
+            LoadSpan( output, 0, targetY, width, target.data() );
+            for ( int32_t x = 0; x < width; ++x )
+            {
+                const int32_t targetX = params.scale.x > 0 ? x : sizeX - x;
+                if ( targetX >= 0 && targetX < width )
+                {
+                    std::copy_n( source.data() + x * Channels, Channels, target.data() + targetX * Channels );
+                }
+            }
+            StoreSpan( output, 0, static_cast<uint32_t>( targetY ), width, target.data() );
+        }
+    } );
+}
+
+
+void CpuKernels::Blur( const Image *input, Image *output, const BlurCompute::PushParams params )
+{
+    const uint32_t width = output->GetWidth();
+    ParallelFor( output->GetHeight(), [&]( const uint32_t begin, const uint32_t end )
+    {
+        std::vector<float> row( width * Channels );
+        for ( uint32_t y = begin; y < end; ++y )
+        {
+            for ( uint32_t x = 0; x < width; ++x )
+            {
+                float *pixel = row.data() + x * Channels;
+                if ( params.blurMode == BlurCompute::BlurMode::MOTION )
+                {
+                    Vec4 color = Fetch( input, static_cast<int32_t>( x ), static_cast<int32_t>( y ) );
+                    float weightSum = 0.5f;
+                    const float radius = std::max( params.useAlpha, color.a ) * params.sigma * 2.6412f;
+                    const Vec2 direction = { std::cos( params.angle ), std::sin( params.angle ) };
+                    for ( float distance = 1.0f; distance < radius; distance += 1.0f )
+                    {
+                        float w = 1.0f - distance / radius;
+                        w = 1.0f - w * w;
+                        w = std::max( 1.0f - w * w, 0.0f );
+                        const Vec4 behind = Fetch( input, static_cast<int32_t>( x - distance * direction.x ), static_cast<int32_t>( y - distance * direction.y ) );
+                        const Vec4 ahead = Fetch( input, static_cast<int32_t>( x + distance * direction.x ), static_cast<int32_t>( y + distance * direction.y ) );
+                        color.r += w * ( behind.r + ahead.r );
+                        color.g += w * ( behind.g + ahead.g );
+                        color.b += w * ( behind.b + ahead.b );
+                        weightSum += w;
+                    }
+                    const float scale = 1.0f / ( weightSum * 2.0f );
+                    pixel[0] = color.r * scale;
+                    pixel[1] = color.g * scale;
+                    pixel[2] = color.b * scale;
+                    pixel[3] = color.a;
+                }
+                else if ( params.blurMode == BlurCompute::BlurMode::RADIAL )
+                {
+                    Vec4 color;
+                    float weightSum = 0.0f;
+                    const float posX = static_cast<float>( static_cast<int32_t>( x ) - static_cast<int32_t>( params.center.x ) );
+                    const float posY = static_cast<float>( static_cast<int32_t>( y ) - static_cast<int32_t>( params.center.y ) );
+                    for ( float i = -params.samples; i <= params.samples; i += 1.0f )
+                    {
+                        const float distance = i / params.samples;
+                        float w = 1.0f - distance;
+                        w = 1.0f - w * w;
+                        w = std::max( 1.0f - w * w, 0.0f );
+
+                        const float c = std::cos( params.angle * distance );
+                        const float s = std::sin( params.angle * distance );
+                        const Vec4 sample = Fetch( input, static_cast<int32_t>( c * posX + s * posY + params.center.x ),
+                                                   static_cast<int32_t>( -s * posX + c * posY + params.center.y ) );
+                        color.r += sample.r * w;
+                        color.g += sample.g * w;
+                        color.b += sample.b * w;
+                        color.a += sample.a * w;
+                        weightSum += w;
+                    }
+                    pixel[0] = color.r / weightSum;
+                    pixel[1] = color.g / weightSum;
+                    pixel[2] = color.b / weightSum;
+                    pixel[3] = color.a / weightSum;
+                }
+                else
+                {
+                    std::fill( pixel, pixel + Channels, 1.0f );
+                }
+            }
+            StoreSpan( output, 0, y, width, row.data() );
+        }
+    } );
+}
+
+
+void CpuKernels::Gaussian( const Image *input, Image *output, const float sigma )
+{
+    // The same two passes as BlurCompute::RunGaussian, through a scratch image of the output's
+    // format so the result is rounded in between the same way. Blurs wider than its tile take the
+    // recursive path there, so they do here as well.
+    const int32_t radius = BlurCompute::GetGaussianRadius( sigma );
+    if ( radius > BlurCompute::GetMaxGaussianRadius( output->GetFormat() ) )
+    {
+        RecursiveGaussian( input, output, sigma );
+        return;
+    }
+
+    std::vector<float> weights( radius + 1 );
+    float weightSum = 0.0f;
+    for ( int32_t i = 0; i <= radius; ++i )
+    {
+        weights[i] = std::exp( -static_cast<float>( i * i ) / ( 2.0f * sigma * sigma ) );
+        weightSum += i == 0 ? weights[i] : 2.0f * weights[i];
+    }
+
+    const uint32_t width = output->GetWidth();
+    const uint32_t height = output->GetHeight();
+    Image scratch( width, height, output->GetFormat(), nullptr, ImageStorage::Host );
+
+    // Along x, with the edge pixels repeated radius times either side of the row.
+    ParallelFor( height, [&]( const uint32_t begin, const uint32_t end )
+    {
+        const size_t padding = static_cast<size_t>( radius ) * Channels;
+        std::vector<float> padded( width * Channels + 2 * padding ), sum( width * Channels );
+        for ( uint32_t y = begin; y < end; ++y )
+        {
+            float *row = padded.data() + padding;
+            LoadSpan( input, 0, static_cast<int32_t>( y ), width, row );
+            for ( size_t i = 0; i < padding; ++i )
+            {
+                padded[i] = row[i % Channels];
+                row[width * Channels + i] = row[( width - 1 ) * Channels + i % Channels];
+            }
+
+            const size_t count = static_cast<size_t>( width ) * Channels;
+            for ( size_t i = 0; i < count; ++i )
+            {
+                sum[i] = row[i] * weights[0];
+            }
+            for ( int32_t tap = 1; tap <= radius; ++tap )
+            {
+                const float w = weights[tap];
+                const float *left = row - tap * Channels;
+                const float *right = row + tap * Channels;
+                for ( size_t i = 0; i < count; ++i )
+                {
+                    sum[i] += ( left[i] + right[i] ) * w;
+                }
+            }
+            for ( size_t i = 0; i < count; ++i )
+            {
+                sum[i] /= weightSum;
+            }
+            StoreSpan( &scratch, 0, y, width, sum.data() );
+        }
+    } );
+
+    // Along y, adding up whole rows so the inner loop still runs along memory.
+    ParallelFor( height, [&]( const uint32_t begin, const uint32_t end )
+    {
+        const size_t count = static_cast<size_t>( width ) * Channels;
+        std::vector<float> above( count ), below( count ), sum( count );
+        auto clampRow = [height]( const int32_t y ) { return std::clamp( y, 0, static_cast<int32_t>( height ) - 1 ); };
+        for ( uint32_t y = begin; y < end; ++y )
+        {
+            LoadSpan( &scratch, 0, static_cast<int32_t>( y ), width, sum.data() );
+            for ( size_t i = 0; i < count; ++i )
+            {
+                sum[i] *= weights[0];
+            }
+            for ( int32_t tap = 1; tap <= radius; ++tap )
+            {
+                LoadSpan( &scratch, 0, clampRow( static_cast<int32_t>( y ) - tap ), width, above.data() );
+                LoadSpan( &scratch, 0, clampRow( static_cast<int32_t>( y ) + tap ), width, below.data() );
+                const float w = weights[tap];
+                for ( size_t i = 0; i < count; ++i )
+                {
+                    sum[i] += ( above[i] + below[i] ) * w;
+                }
+            }
+            for ( size_t i = 0; i < count; ++i )
+            {
+                sum[i] /= weightSum;
+            }
+            StoreSpan( output, 0, y, width, sum.data() );
+        }
+    } );
+}
+
+
+void CpuKernels::RecursiveGaussian( const Image *input, Image *output, const float sigma )
+{
+    // Like BlurCompute::RunRecursiveGaussian, along the rows into a float scratch buffer, then down
+    // the columns. The columns are run side by side, a strip of them per chunk, so each step along
+    // them is a run over a row of floats.
+    const BlurCompute::RecursiveParams params = BlurCompute::GetRecursiveParams( sigma );
+    const uint32_t width = output->GetWidth();
+    const uint32_t height = output->GetHeight();
+    const size_t rowSize = static_cast<size_t>( width ) * Channels;
+    std::vector<float> scratch( rowSize * height );
+
+    ParallelFor( height, [&]( const uint32_t begin, const uint32_t end )
+    {
+        std::vector<float> row( rowSize ), forward( rowSize );
+        for ( uint32_t y = begin; y < end; ++y )
+        {
+            LoadSpan( input, 0, static_cast<int32_t>( y ), width, row.data() );
+            for ( size_t channel = 0; channel < Channels; ++channel )
+            {
+                // Both passes start as if the edge pixel carried on forever.
+                float w1 = row[channel], w2 = w1, w3 = w1;
+                for ( size_t i = channel; i < rowSize; i += Channels )
+                {
+                    const float w = params.b * row[i] + params.a1 * w1 + params.a2 * w2 + params.a3 * w3;
+                    forward[i] = w;
+                    w3 = w2;
+                    w2 = w1;
+                    w1 = w;
+                }
+                float y1 = w1, y2 = w1, y3 = w1;
+                float *result = scratch.data() + y * rowSize;
+                for ( size_t i = rowSize - Channels + channel; i < rowSize; i -= Channels )
+                {
+                    const float value = params.b * forward[i] + params.a1 * y1 + params.a2 * y2 + params.a3 * y3;
+                    result[i] = value;
+                    y3 = y2;
+                    y2 = y1;
+                    y1 = value;
+                }
+            }
+        }
+    } );
+
+    ParallelFor( width, [&]( const uint32_t begin, const uint32_t end )
+    {
+        const size_t first = static_cast<size_t>( begin ) * Channels;
+        const size_t count = static_cast<size_t>( end - begin ) * Channels;
+        std::vector<float> w1( scratch.begin() + first, scratch.begin() + first + count ), w2 = w1, w3 = w1;
+        // The causal pass is kept in scratch until the anti-causal one reads it back.
+        for ( uint32_t y = 0; y < height; ++y )
+        {
+            float *line = scratch.data() + y * rowSize + first;
+            for ( size_t i = 0; i < count; ++i )
+            {
+                const float w = params.b * line[i] + params.a1 * w1[i] + params.a2 * w2[i] + params.a3 * w3[i];
+                line[i] = w;
+                w3[i] = w2[i];
+                w2[i] = w1[i];
+                w1[i] = w;
+            }
+        }
+
+        std::vector<float> &y1 = w1;
+        w2 = w1;
+        w3 = w1;
+        std::vector<float> result( count );
+        for ( uint32_t y = height; y-- > 0; )
+        {
+            const float *line = scratch.data() + y * rowSize + first;
+            for ( size_t i = 0; i < count; ++i )
+            {
+                const float value = params.b * line[i] + params.a1 * y1[i] + params.a2 * w2[i] + params.a3 * w3[i];
+                result[i] = value;
+                w3[i] = w2[i];
+                w2[i] = y1[i];
+                y1[i] = value;
+            }
+            StoreSpan( output, begin, y, end - begin, result.data() );
+        }
+    } );
+}
+
+
+void CpuKernels::Noise( Image *output, const NoiseCompute::PushParams params )
+{
+    const uint32_t width = output->GetWidth();
+    ParallelFor( output->GetHeight(), [&]( const uint32_t begin, const uint32_t end )
+    {
+        std::vector<float> row( width * Channels );
+        for ( uint32_t y = begin; y < end; ++y )
+        {
+            // The noise is laid out over the whole image, of which output may only be a part.
+            const int32_t imageY = static_cast<int32_t>( y ) + params.offsetY;
+            for ( uint32_t x = 0; x < width; ++x )
+            {
+                const int32_t imageX = static_cast<int32_t>( x ) + params.offsetX;
+                const Vec2 uv = { imageX / static_cast<float>( params.width ) * params.scale, imageY / static_cast<float>( params.height ) * params.scale };
+                constexpr float offset = 0.5f;
+
+                float value = 1.0f;
+                switch ( params.noiseMode )
+                {
+                case NoiseCompute::NoiseMode::RAW:
+                    value = RawNoise( static_cast<float>( imageX ), static_cast<float>( imageY ) );
+                    break;
+                case NoiseCompute::NoiseMode::VORONOI:
+                    value = VoronoiNoise( uv, 0.5f, 0.5f );
+                    break;
+                case NoiseCompute::NoiseMode::PERLIN:
+                    value = WorleyPerlin( { uv.x, uv.y, offset } );
+                    break;
+                case NoiseCompute::NoiseMode::SMOKE:
+                    value = SmokeyNoise( { uv.x, uv.y, offset } );
+                    break;
+                }
+
+                float *pixel = row.data() + x * Channels;
+                pixel[0] = pixel[1] = pixel[2] = value;
+                pixel[3] = 1.0f;
+            }
+            StoreSpan( output, 0, y, width, row.data() );
+        }
+    } );
+}
+
+
+void CpuKernels::Downsample( const Image *input, Image *output, const int factor )
+{
+    const uint32_t width = output->GetWidth();
+    const uint32_t inputWidth = width * factor;
+    ParallelFor( output->GetHeight(), [&]( const uint32_t begin, const uint32_t end )
+    {
+        std::vector<float> line( inputWidth * Channels ), sum( width * Channels ), counts( width );
+        for ( uint32_t x = 0; x < width; ++x )
+        {
+            const uint32_t start = x * factor;
+            counts[x] = static_cast<float>( std::max<int64_t>( std::min<int64_t>( start + factor, input->GetWidth() ) - start, 1 ) );
+        }
+
+        for ( uint32_t y = begin; y < end; ++y )
+        {
+            const uint32_t startY = y * factor;
+            const uint32_t endY = std::min( startY + factor, input->GetHeight() );
+            std::fill( sum.begin(), sum.end(), 0.0f );
+            for ( uint32_t inputY = startY; inputY < endY; ++inputY )
+            {
+                // Pixels past the input's right edge read as zero and aren't counted.
+                LoadSpan( input, 0, static_cast<int32_t>( inputY ), inputWidth, line.data() );
+                for ( uint32_t x = 0; x < width; ++x )
+                {
+                    for ( int i = 0; i < factor; ++i )
+                    {
+                        for ( size_t channel = 0; channel < Channels; ++channel )
+                        {
+                            sum[x * Channels + channel] += line[( static_cast<size_t>( x ) * factor + i ) * Channels + channel];
+                        }
+                    }
+                }
+            }
+            const float rows = static_cast<float>( std::max<int64_t>( static_cast<int64_t>( endY ) - startY, 1 ) );
+            for ( uint32_t x = 0; x < width; ++x )
+            {
+                for ( size_t channel = 0; channel < Channels; ++channel )
+                {
+                    sum[x * Channels + channel] /= counts[x] * rows;
+                }
+            }
+            StoreSpan( output, 0, y, width, sum.data() );
+        }
+    } );
+}
+
+}
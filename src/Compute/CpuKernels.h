@@ -0,0 +1,44 @@
+﻿#pragma once
+
+#include "../Image.h"
+
+#include "BlendCompute.h"
+#include "BlurCompute.h"
+#include "CurvesCompute.h"
+#include "HSLCompute.h"
+#include "InvertCompute.h"
+#include "LevelsCompute.h"
+#include "NoiseCompute.h"
+#include "TransformCompute.h"
+
+namespace Surge
+{
+
+// The compute kernels again, run on the CPU over host images, see ImageStorage. For machines
+// without a GPU Vulkan can use, and to check what the shaders render against. Each one takes the
+// parameters of the Run it mirrors and works out the same pixels, short of the odd difference in
+// the last bit of sin, exp and pow.
+//
+// Rows are shared out between the calling thread and the application's thread pool. They are
+// turned into floats, processed, and turned back, so the loops over pixels are plain runs over
+// float arrays that the compiler can vectorise.
+class CpuKernels
+{
+public:
+    static void Blend( const Image *left, const Image *right, Image *output, BlendCompute::PushParams params );
+    static void HSL( const Image *input, Image *output, HSLCompute::PushParams params );
+    static void Levels( const Image *input, Image *output, LevelsCompute::PushParams params );
+    // curvesLUT has to be a host image as well.
+    static void Curves( const Image *input, const Image *curvesLUT, Image *output, CurvesCompute::PushParams params );
+    static void Invert( const Image *input, Image *output, InvertCompute::PushParams params );
+    static void Transform( const Image *input, Image *output, TransformCompute::PushParams params );
+    // Motion and radial blur, like BlurCompute::Run.
+    static void Blur( const Image *input, Image *output, BlurCompute::PushParams params );
+    static void Gaussian( const Image *input, Image *output, float sigma );
+    static void RecursiveGaussian( const Image *input, Image *output, float sigma );
+    static void Noise( Image *output, NoiseCompute::PushParams params );
+    // Like DownsampleCompute::Run, output should be input's size divided by factor.
+    static void Downsample( const Image *input, Image *output, int factor );
+};
+
+}
@@ -0,0 +1,46 @@
+﻿#include "DownsampleCompute.h"
+
+#include "../Application.h"
+#include "../VulkanUtils.h"
+
+namespace Surge
+{
+
+DownsampleCompute::DownsampleCompute()
+{
+    VkDevice device = Application::GetDevice();
+
+    m_dscLayout = CreateDescriptorSetLayout( device, 2 );
+
+    std::vector<VkPushConstantRange> pcRanges;
+    VkPushConstantRange pcRange = {};
+    pcRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pcRange.offset = 0;
+    pcRange.size = sizeof(PushParams);
+    pcRanges.push_back( pcRange );
+
+    m_pipeLayout = CreatePipelineLayout( device, m_dscLayout, pcRanges );
+
+    m_pipes = CreateFormatPipelines( device, DownsampleComputeShader, m_pipeLayout );
+    m_cmdBuffer = {};
+}
+
+
+DownsampleCompute::~DownsampleCompute()
+{
+    //do nothing for now
+}
+
+
+void DownsampleCompute::Run( Image *input, Image *output, const int factor )
+{
+    const std::vector<Image *> images = { input, output };
+    const VkDescriptorSet set = GetDescriptorSet( m_dscLayout, images );
+    const PushParams params = { factor };
+
+    VkCommandBuffer cmdBuffer = Application::GetComputeCommandBuffer();
+    RecordDispatch( cmdBuffer, GetPipeline( m_pipes, output->GetFormat() ), m_pipeLayout, set, images, &params, sizeof(params) );
+    Application::FlushComputeCommandBuffer( cmdBuffer );
+}
+
+}
@@ -0,0 +1,30 @@
+﻿#pragma once
+
+#include "../Image.h"
+#include "vulkan/vulkan.h"
+
+#include <string>
+
+#include "ComputeBase.h"
+
+namespace Surge
+{
+
+// Shrinks an image by a whole factor, averaging the block of pixels behind each output pixel. Used
+// to make the low resolution copies of source images that proxy evaluations start from.
+class DownsampleCompute : ComputeBase
+{
+    const std::string DownsampleComputeShader = "Shaders/DownsampleCompute.comp";
+public:
+    struct PushParams
+    {
+        int factor;
+    };
+
+    DownsampleCompute();
+    ~DownsampleCompute();
+    // output should be input's size divided by factor, rounded down.
+    void Run( Image *input, Image *output, int factor );
+};
+
+}
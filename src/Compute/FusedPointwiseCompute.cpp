@@ -0,0 +1,211 @@
+﻿#include "FusedPointwiseCompute.h"
+
+#include <set>
+
+#include "../Application.h"
+#include "../VulkanUtils.h"
+
+namespace Surge
+{
+
+static const char *GetKernelName( const PointwiseKernel kernel )
+{
+    switch ( kernel )
+    {
+    case PointwiseKernel::HSL:    return "HSL";
+    case PointwiseKernel::LEVELS: return "Levels";
+    case PointwiseKernel::CURVES: return "Curves";
+    case PointwiseKernel::INVERT: return "Invert";
+    }
+    return "";
+}
+
+
+// The GLSL applying one stage to the pixel in c. p is the index of its first parameter and lut the
+// name of the image bound for it, if it has one.
+static std::string GenerateStage( const PointwiseStage &stage, const size_t p, const std::string &lut )
+{
+    auto param = [p]( const size_t i ) -> std::string { return "params.p[" + std::to_string( p + i ) + "]"; };
+
+    switch ( stage.kernel )
+    {
+    case PointwiseKernel::HSL:
+        return "c = ApplyHSL(c, " + param( 0 ) + ", " + param( 1 ) + ", " + param( 2 ) + ");";
+    case PointwiseKernel::LEVELS:
+        return "c = ApplyLevels(c, vec2(" + param( 0 ) + ", " + param( 1 ) + "), vec2(" + param( 2 ) + ", " + param( 3 ) + "), "
+            + param( 4 ) + ", " + param( 5 ) + ");";
+    case PointwiseKernel::CURVES:
+    {
+        const std::string width = "int(" + param( 0 ) + ")";
+        return "c = ApplyCurves(c, imageLoad(" + lut + ", CurvesLUTCoord(c.r, " + width + ")), imageLoad(" + lut + ", CurvesLUTCoord(c.g, "
+            + width + ")), imageLoad(" + lut + ", CurvesLUTCoord(c.b, " + width + ")));";
+    }
+    case PointwiseKernel::INVERT:
+        return "c = ApplyInvert(c, int(" + param( 0 ) + "));";
+    }
+    return "";
+}
+
+
+FusedPointwiseCompute::FusedPointwiseCompute()
+{
+    // Each chain has its own shader and pipeline in m_kernels.
+    m_dscLayout = VK_NULL_HANDLE;
+    m_pipeLayout = VK_NULL_HANDLE;
+    m_cmdBuffer = {};
+}
+
+
+FusedPointwiseCompute::~FusedPointwiseCompute()
+{
+    VkDevice device = Application::GetDevice();
+
+    for ( const auto &entry : m_kernels )
+    {
+        const Kernel &kernel = entry.second;
+        vkDestroyPipeline( device, kernel.pipe, nullptr );
+        vkDestroyPipelineLayout( device, kernel.pipeLayout, nullptr );
+        vkDestroyDescriptorSetLayout( device, kernel.dscLayout, nullptr );
+        vkDestroyShaderModule( device, kernel.shader, nullptr );
+    }
+}
+
+
+std::string FusedPointwiseCompute::GetSignature( const std::vector<PointwiseStage> &stages, const ImageFormat format )
+{
+    std::string signature = format == ImageFormat::RGBA ? "" : format == ImageFormat::RGBA16F ? "rgba16f:" : "rgba32f:";
+    for ( const PointwiseStage &stage : stages )
+    {
+        signature += GetKernelName( stage.kernel );
+        signature += ';';
+    }
+    return signature;
+}
+
+
+std::string FusedPointwiseCompute::GenerateShader( const std::vector<PointwiseStage> &stages, const ImageFormat format )
+{
+    std::string source = "#version 440\n\n";
+    // The same defines the build makes the variants of the other kernels with, see Shaders/ImageFormat.glsl.
+    if ( format == ImageFormat::RGBA16F )
+    {
+        source += "#define IMAGE_FORMAT_RGBA16F\n";
+    }
+    else if ( format == ImageFormat::RGBA32F )
+    {
+        source += "#define IMAGE_FORMAT_RGBA32F\n";
+    }
+    source += "#include \"ImageFormat.glsl\"\n";
+
+    std::set<PointwiseKernel> kernels;
+    for ( const PointwiseStage &stage : stages )
+    {
+        if ( kernels.insert( stage.kernel ).second )
+        {
+            source += "#include \"Pointwise/" + std::string( GetKernelName( stage.kernel ) ) + ".glsl\"\n";
+        }
+    }
+
+    source += "\nlayout(local_size_x_id = 0, local_size_y_id = 1) in;\n";
+    source += "layout(push_constant) uniform Parameters {\n   float p[" + std::to_string( MaxParams ) + "];\n} params;\n\n";
+
+    // Bindings go input, then a LUT for every stage that has one, then the result, the same order
+    // Run binds the images in.
+    int binding = 0;
+    source += "layout (binding = " + std::to_string( binding++ ) + ", IMAGE_FORMAT) uniform readonly image2D inputImage;\n";
+    std::vector<std::string> luts;
+    for ( const PointwiseStage &stage : stages )
+    {
+        if ( stage.lut )
+        {
+            luts.push_back( "lutImage" + std::to_string( binding ) );
+            source += "layout (binding = " + std::to_string( binding++ ) + ", rgba8) uniform image2D " + luts.back() + ";\n";
+        }
+    }
+    source += "layout (binding = " + std::to_string( binding ) + ", IMAGE_FORMAT) uniform image2D resultImage;\n\n";
+
+    source += "void main()\n{\n";
+    source += "    ivec2 pixelCoords = ivec2(gl_GlobalInvocationID.xy);\n";
+    source += "    vec4 c = imageLoad(inputImage, pixelCoords);\n";
+    size_t p = 0;
+    size_t lut = 0;
+    for ( const PointwiseStage &stage : stages )
+    {
+        source += "    " + GenerateStage( stage, p, stage.lut ? luts[lut++] : std::string() ) + "\n";
+        // Separate nodes would have stored to an rgba8 image in between, which clamps.
+        if ( format == ImageFormat::RGBA )
+        {
+            source += "    c = clamp(c, 0.0, 1.0);\n";
+        }
+        p += stage.params.size();
+    }
+    source += "    imageStore(resultImage, pixelCoords, c);\n}\n";
+    return source;
+}
+
+
+FusedPointwiseCompute::Kernel &FusedPointwiseCompute::GetKernel( const std::vector<PointwiseStage> &stages, const ImageFormat format )
+{
+    const std::string signature = GetSignature( stages, format );
+    const auto found = m_kernels.find( signature );
+    if ( found != m_kernels.end() )
+    {
+        return found->second;
+    }
+
+    VkDevice device = Application::GetDevice();
+
+    Kernel kernel = {};
+    kernel.imageCount = 2;
+    for ( const PointwiseStage &stage : stages )
+    {
+        kernel.imageCount += stage.lut ? 1 : 0;
+    }
+
+    vulkan::ShaderLoader loader;
+    kernel.shader = loader.LoadShaderFromSource( device, ( "Fused:" + signature ).c_str(), shaderc_compute_shader, GenerateShader( stages, format ) );
+    kernel.dscLayout = CreateDescriptorSetLayout( device, kernel.imageCount );
+
+    std::vector<VkPushConstantRange> pcRanges;
+    VkPushConstantRange pcRange = {};
+    pcRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pcRange.offset = 0;
+    pcRange.size = MaxParams * sizeof(float);
+    pcRanges.push_back( pcRange );
+
+    kernel.pipeLayout = CreatePipelineLayout( device, kernel.dscLayout, pcRanges );
+    kernel.pipe = CreateComputePipeline( device, kernel.shader, kernel.pipeLayout );
+
+    return m_kernels.emplace( signature, kernel ).first->second;
+}
+
+
+void FusedPointwiseCompute::Run( Image *input, Image *output, const std::vector<PointwiseStage> &stages )
+{
+    const Kernel &kernel = GetKernel( stages, output->GetFormat() );
+
+    std::vector<Image *> images;
+    images.push_back( input );
+    float params[MaxParams] = {};
+    size_t p = 0;
+    for ( const PointwiseStage &stage : stages )
+    {
+        if ( stage.lut )
+        {
+            images.push_back( stage.lut );
+        }
+        for ( const float param : stage.params )
+        {
+            params[p++] = param;
+        }
+    }
+    images.push_back( output );
+
+    const VkDescriptorSet set = GetDescriptorSet( kernel.dscLayout, images );
+
+    VkCommandBuffer cmdBuffer = Application::GetComputeCommandBuffer();
+    RecordDispatch( cmdBuffer, kernel.pipe, kernel.pipeLayout, set, images, params, sizeof(params) );
+    Application::FlushComputeCommandBuffer( cmdBuffer );
+}
+
+}
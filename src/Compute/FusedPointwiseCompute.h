@@ -0,0 +1,65 @@
+﻿#pragma once
+
+#include "../Image.h"
+#include "vulkan/vulkan.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ComputeBase.h"
+
+namespace Surge
+{
+
+// The per-pixel kernels in Shaders/Pointwise that can be chained into one shader.
+enum class PointwiseKernel
+{
+    HSL,
+    LEVELS,
+    CURVES,
+    INVERT,
+};
+
+// One node's part of a fused chain. Integer parameters are passed as floats.
+struct PointwiseStage
+{
+    PointwiseKernel kernel;
+    std::vector<float> params;
+    // Looked up per pixel rather than processed, e.g. the curves LUT.
+    Image *lut = nullptr;
+};
+
+// Runs a chain of pointwise stages in a single dispatch, reading the input and writing the output
+// once instead of going through an image per stage. The shader for a chain is generated from the
+// Shaders/Pointwise snippets the first time that sequence of kernels is seen on images of that
+// format, then reused. The input and output have to be of the same format.
+class FusedPointwiseCompute : ComputeBase
+{
+public:
+    // Every stage's parameters share one push constant block of this many floats, the most
+    // Vulkan guarantees.
+    static constexpr size_t MaxParams = 32;
+
+    FusedPointwiseCompute();
+    ~FusedPointwiseCompute();
+    void Run( Image *input, Image *output, const std::vector<PointwiseStage> &stages );
+
+private:
+    struct Kernel
+    {
+        VkShaderModule shader;
+        VkDescriptorSetLayout dscLayout;
+        VkPipelineLayout pipeLayout;
+        VkPipeline pipe;
+        int imageCount;
+    };
+
+    Kernel &GetKernel( const std::vector<PointwiseStage> &stages, ImageFormat format );
+
+    static std::string GetSignature( const std::vector<PointwiseStage> &stages, ImageFormat format );
+    static std::string GenerateShader( const std::vector<PointwiseStage> &stages, ImageFormat format );
+
+    std::unordered_map<std::string, Kernel> m_kernels;
+};
+}
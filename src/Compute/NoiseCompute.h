@@ -29,6 +29,9 @@ public:
         uint32_t height;
         int seed;
         float scale;
+        // Where the output sits in the width x height image, for rendering it a tile at a time.
+        int offsetX;
+        int offsetY;
     };
 
     NoiseCompute();
@@ -0,0 +1,169 @@
+#include "DescriptorCache.h"
+
+#include "Application.h"
+#include "Image.h"
+
+namespace Surge
+{
+
+// Every compute shader binds only a handful of storage images, pools are sized for that.
+static constexpr uint32_t SetsPerPool = 256;
+static constexpr uint32_t ImagesPerSet = 8;
+
+DescriptorCache::DescriptorCache(VkDevice device, size_t capacity)
+	: m_device(device), m_capacity(capacity)
+{
+}
+
+DescriptorCache::~DescriptorCache()
+{
+	for (VkDescriptorPool pool : m_pools)
+	{
+		vkDestroyDescriptorPool(m_device, pool, nullptr);
+	}
+}
+
+size_t DescriptorCache::KeyHash::operator()(const Key& key) const
+{
+	size_t hash = std::hash<VkDescriptorSetLayout>()(key.layout);
+	for (const uint64_t image : key.images)
+	{
+		hash ^= std::hash<uint64_t>()(image) + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+	}
+	return hash;
+}
+
+VkDescriptorSet DescriptorCache::Get(VkDescriptorSetLayout layout, const std::vector<Image*>& images)
+{
+	Key key = { layout, {} };
+	key.images.reserve(images.size());
+	for (const Image* image : images)
+	{
+		key.images.push_back(image->GetUid());
+	}
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	// Never moves, the map only ever grows.
+	ThreadSets* sets = &m_threads[std::this_thread::get_id()];
+
+	const auto found = sets->entries.find(key);
+	if (found != sets->entries.end())
+	{
+		sets->uses.splice(sets->uses.begin(), sets->uses, found->second.use);
+		return found->second.set;
+	}
+
+	VkDescriptorSetLayout evictedLayout = VK_NULL_HANDLE;
+	VkDescriptorSet evictedSet = VK_NULL_HANDLE;
+	if (sets->entries.size() >= m_capacity)
+	{
+		const Key& oldest = sets->uses.back();
+		evictedLayout = oldest.layout;
+		evictedSet = sets->entries[oldest].set;
+		sets->entries.erase(oldest);
+		sets->uses.pop_back();
+	}
+
+	VkDescriptorSet set = VK_NULL_HANDLE;
+	std::vector<VkDescriptorSet>& freeSets = sets->freeSets[layout];
+	if (!freeSets.empty())
+	{
+		set = freeSets.back();
+		freeSets.pop_back();
+	}
+	else
+	{
+		set = AllocateSet(layout);
+	}
+
+	std::vector<VkDescriptorImageInfo> infos(images.size());
+	std::vector<VkWriteDescriptorSet> writes(images.size());
+	for (size_t i = 0; i < images.size(); ++i)
+	{
+		infos[i].imageView = images[i]->GetVkImageView();
+		infos[i].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		writes[i] = { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+		writes[i].dstSet = set;
+		writes[i].dstBinding = static_cast<uint32_t>(i);
+		writes[i].descriptorCount = 1;
+		writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		writes[i].pImageInfo = &infos[i];
+	}
+	vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+	sets->uses.push_front(key);
+	sets->entries.emplace(std::move(key), Entry{ set, sets->uses.begin() });
+	lock.unlock();
+
+	if (evictedSet != VK_NULL_HANDLE)
+	{
+		// The evicted set may be recorded in the batch still open on this thread, so it can only be
+		// written again once that has been submitted and finished. No other thread was handed it.
+		Application::SubmitComputeResourceFree([this, sets, evictedLayout, evictedSet]() { Recycle(sets, evictedLayout, evictedSet); });
+	}
+	return set;
+}
+
+size_t DescriptorCache::GetSetCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	size_t count = 0;
+	for (const auto& thread : m_threads)
+	{
+		count += thread.second.entries.size();
+	}
+	return count;
+}
+
+VkDescriptorSet DescriptorCache::AllocateSet(VkDescriptorSetLayout layout)
+{
+	VkDescriptorSetAllocateInfo allocInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &layout;
+
+	VkDescriptorSet set = VK_NULL_HANDLE;
+	if (!m_pools.empty())
+	{
+		allocInfo.descriptorPool = m_pools.back();
+		if (vkAllocateDescriptorSets(m_device, &allocInfo, &set) == VK_SUCCESS)
+		{
+			return set;
+		}
+	}
+
+	// Sets are never freed back to a pool, only rewritten, so a full pool stays full.
+	VkDescriptorPoolSize size = {};
+	size.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	size.descriptorCount = SetsPerPool * ImagesPerSet;
+	VkDescriptorPoolCreateInfo poolInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+	poolInfo.maxSets = SetsPerPool;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &size;
+
+	VkDescriptorPool pool = VK_NULL_HANDLE;
+	VkResult err = vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &pool);
+	if (err != VK_SUCCESS)
+	{
+		fprintf(stderr, "[vulkan] Failed to create a descriptor pool: VkResult = %d\n", err);
+		return VK_NULL_HANDLE;
+	}
+	m_pools.push_back(pool);
+
+	allocInfo.descriptorPool = pool;
+	err = vkAllocateDescriptorSets(m_device, &allocInfo, &set);
+	if (err != VK_SUCCESS)
+	{
+		fprintf(stderr, "[vulkan] Failed to allocate a descriptor set: VkResult = %d\n", err);
+		return VK_NULL_HANDLE;
+	}
+	return set;
+}
+
+void DescriptorCache::Recycle(ThreadSets* sets, VkDescriptorSetLayout layout, VkDescriptorSet set)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	sets->freeSets[layout].push_back(set);
+}
+
+}
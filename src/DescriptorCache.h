@@ -0,0 +1,79 @@
+#pragma once
+
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+namespace Surge
+{
+
+class Image;
+
+// Keeps the descriptor sets compute dispatches bind their storage images with, so evaluating the
+// same nodes on the same images again neither allocates nor writes any. Sets are looked up by
+// layout and the images bound, and the least recently used go once there are more than capacity.
+// Safe to use from any thread. Every thread has sets of its own, so an evicted set is only written
+// again once the batch of the one thread that could have bound it has finished.
+class DescriptorCache
+{
+public:
+	DescriptorCache(VkDevice device, size_t capacity);
+	~DescriptorCache();
+
+	DescriptorCache(const DescriptorCache&) = delete;
+	DescriptorCache& operator=(const DescriptorCache&) = delete;
+
+	// A set for layout with images bound to bindings 0 to n-1 in order. It stays valid until the
+	// compute batch recording it has been submitted, however many sets are requested meanwhile.
+	VkDescriptorSet Get(VkDescriptorSetLayout layout, const std::vector<Image*>& images);
+
+	// Across every thread.
+	[[nodiscard]] size_t GetSetCount() const;
+
+private:
+	struct Key
+	{
+		VkDescriptorSetLayout layout;
+		std::vector<uint64_t> images;
+
+		bool operator==(const Key& other) const { return layout == other.layout && images == other.images; }
+	};
+
+	struct KeyHash
+	{
+		size_t operator()(const Key& key) const;
+	};
+
+	struct Entry
+	{
+		VkDescriptorSet set;
+		std::list<Key>::iterator use;
+	};
+
+	// The sets of one thread, up to capacity of them.
+	struct ThreadSets
+	{
+		std::unordered_map<Key, Entry, KeyHash> entries;
+		// Most recently used at the front.
+		std::list<Key> uses;
+		// Evicted sets whose last dispatch has finished, ready to be written again.
+		std::unordered_map<VkDescriptorSetLayout, std::vector<VkDescriptorSet>> freeSets;
+	};
+
+	VkDescriptorSet AllocateSet(VkDescriptorSetLayout layout);
+	void Recycle(ThreadSets* sets, VkDescriptorSetLayout layout, VkDescriptorSet set);
+
+	VkDevice m_device = VK_NULL_HANDLE;
+	size_t m_capacity = 0;
+
+	mutable std::mutex m_mutex;
+	// Kept after a thread is gone, like its compute command pool, threads don't come and go often.
+	std::unordered_map<std::thread::id, ThreadSets> m_threads;
+	std::vector<VkDescriptorPool> m_pools;
+};
+
+}
@@ -0,0 +1,204 @@
+#include "EvaluationWorker.h"
+
+#include "GraphEvaluator.h"
+
+namespace Surge
+{
+
+EvaluationWorker::Request::~Request()
+{
+    for ( Node *node : graph.nodes() )
+    {
+        delete node;
+    }
+}
+
+
+EvaluationWorker::EvaluationWorker()
+{
+    m_thread = std::thread( &EvaluationWorker::ThreadMain, this );
+}
+
+
+EvaluationWorker::~EvaluationWorker()
+{
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        m_quit = true;
+        m_cancel = true;
+    }
+    m_wake.notify_all();
+    m_thread.join();
+}
+
+
+void EvaluationWorker::Submit( std::unique_ptr<Request> request )
+{
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        m_pending = std::move( request );
+        if ( m_running && !m_lastRunCancelled )
+        {
+            m_cancel = true;
+        }
+    }
+    m_wake.notify_all();
+}
+
+
+std::unique_ptr<EvaluationWorker::Result> EvaluationWorker::TakeResult()
+{
+    std::unique_ptr<Result> result;
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        result = std::move( m_result );
+    }
+    if ( result )
+    {
+        m_wake.notify_all();
+    }
+    return result;
+}
+
+
+void EvaluationWorker::CancelPendingAndWait()
+{
+    std::unique_lock<std::mutex> lock( m_mutex );
+    m_pending.reset();
+    m_idle.wait( lock, [this]() { return !m_running; } );
+}
+
+
+void EvaluationWorker::ThreadMain()
+{
+    while ( true )
+    {
+        std::unique_ptr<Request> request;
+        {
+            std::unique_lock<std::mutex> lock( m_mutex );
+            // Until the UI has taken the last result it is still showing the images this worker
+            // would render into next, so hold off until then.
+            m_wake.wait( lock, [this]() { return m_quit || ( m_pending && !m_result ); } );
+            if ( m_quit )
+            {
+                break;
+            }
+            request = std::move( m_pending );
+            m_cancel = false;
+            m_running = true;
+        }
+
+        std::unique_ptr<Result> result = Run( *request );
+        request.reset();
+
+        {
+            std::lock_guard<std::mutex> lock( m_mutex );
+            m_running = false;
+            m_lastRunCancelled = !result;
+            if ( result )
+            {
+                m_result = std::move( result );
+            }
+        }
+        m_idle.notify_all();
+    }
+}
+
+
+std::unique_ptr<EvaluationWorker::Result> EvaluationWorker::Run( Request &request )
+{
+    if ( request.generation != m_imagesGeneration )
+    {
+        m_images.clear();
+        m_imagesGeneration = request.generation;
+    }
+
+    // Forget nodes that have been deleted since the last run.
+    for ( auto iter = m_images.begin(); iter != m_images.end(); )
+    {
+        iter = request.graph.contains_node( iter->first ) ? std::next( iter ) : m_images.erase( iter );
+    }
+
+    if ( request.imagePool )
+    {
+        // The pool never hands out an image the UI, or a clone, still holds, so it takes care of
+        // the double buffering by itself.
+        m_images.clear();
+    }
+
+    // The clones were taken from the UI's nodes, which may not have picked up the previous result
+    // yet. Point them at what this worker last produced so that their images and stamps agree.
+    for ( const int id : request.graph.node_ids() )
+    {
+        Node *node = request.graph.node( id );
+        const auto iter = m_images.find( id );
+        if ( iter != m_images.end() && WritesValue( node->type ) )
+        {
+            node->value = iter->second.front;
+            node->evaluatedStamp = iter->second.evaluatedStamp;
+        }
+    }
+
+    GraphEvaluator::Options options;
+    options.batchCompute = request.batchCompute;
+    options.cancel = &m_cancel;
+    options.blankImages = request.blankImages;
+    options.fusePointwise = request.fusePointwise;
+    options.pinnedNodes = request.pinnedNodes;
+    options.resolutionDivisor = request.resolutionDivisor;
+    options.proxyImages = request.proxyImages;
+    if ( request.imagePool )
+    {
+        options.imagePool = request.imagePool;
+    }
+    else
+    {
+        options.prepareOutput = [this]( const int id, Node *node, const uint32_t width, const uint32_t height, const ImageFormat format ) -> void
+        {
+            NodeImages &images = m_images[id];
+            if ( !images.front )
+            {
+                // First time this node is rendered here, what it holds now is on screen.
+                images.front = node->value;
+            }
+
+            const Image *back = images.back.get();
+            if ( !back || back->GetWidth() != width || back->GetHeight() != height || back->GetFormat() != format )
+            {
+                images.back = std::make_shared<Image>( width, height, format );
+            }
+            node->value = images.back;
+        };
+    }
+
+    GraphEvaluator evaluator( options );
+    std::shared_ptr<Image> output = evaluator.Evaluate( request.graph, request.rootNodeId );
+    if ( evaluator.WasCancelled() )
+    {
+        return nullptr;
+    }
+
+    auto result = std::make_unique<Result>();
+    for ( const int id : evaluator.GetEvaluatedNodes() )
+    {
+        const Node *node = request.graph.node( id );
+        if ( !request.imagePool && WritesValue( node->type ) )
+        {
+            NodeImages &images = m_images[id];
+            std::swap( images.front, images.back );
+            images.evaluatedStamp = node->evaluatedStamp;
+        }
+        result->nodes.push_back( { id, node->value, node->evaluatedStamp, node->resolutionScale } );
+    }
+    for ( const int id : evaluator.GetReleasedNodes() )
+    {
+        m_images.erase( id );
+        result->nodes.push_back( { id, nullptr, request.graph.node( id )->evaluatedStamp, 1.0f } );
+    }
+    result->output = output;
+    result->rootNodeId = request.rootNodeId;
+    result->generation = request.generation;
+    return result;
+}
+
+}
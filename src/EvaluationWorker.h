@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "BlankImageCache.h"
+#include "Graph.h"
+#include "Image.h"
+#include "ProxyImageCache.h"
+#include "TransientImagePool.h"
+
+#include "GraphNodes/Node.h"
+
+namespace Surge
+{
+
+// Evaluates snapshots of the node graph on a thread of its own so the UI never waits on the GPU.
+// Nodes are rendered into a second set of images, the ones the UI currently shows are only swapped
+// out once a whole evaluation has completed.
+class EvaluationWorker
+{
+public:
+    struct Request
+    {
+        // A copy of the graph whose nodes are clones of the UI's, owned by the request.
+        Graph<Node *> graph;
+        int rootNodeId = -1;
+        // Requests and results from a previous project are recognised by this and dropped.
+        uint64_t generation = 0;
+        bool batchCompute = true;
+        bool fusePointwise = true;
+        // When set, outputs come from the pool rather than each node's pair of images, see
+        // GraphEvaluator::Options::imagePool.
+        TransientImagePool *imagePool = nullptr;
+        std::vector<int> pinnedNodes;
+        BlankImageCache *blankImages = nullptr;
+        // See GraphEvaluator::Options::resolutionDivisor.
+        uint32_t resolutionDivisor = 1;
+        ProxyImageCache *proxyImages = nullptr;
+
+        ~Request();
+    };
+
+    struct Result
+    {
+        struct NodeOutput
+        {
+            int id;
+            std::shared_ptr<Image> value;
+            uint64_t evaluatedStamp;
+            float resolutionScale;
+        };
+
+        // Every node the evaluation ran or took the image from, to be copied back onto the UI's nodes.
+        std::vector<NodeOutput> nodes;
+        std::shared_ptr<Image> output;
+        int rootNodeId = -1;
+        uint64_t generation = 0;
+    };
+
+    EvaluationWorker();
+    ~EvaluationWorker();
+
+    // Replaces any request still waiting to start. One already running is abandoned in favour of
+    // the new one, unless the last run was abandoned too, so constant edits still show progress.
+    void Submit( std::unique_ptr<Request> request );
+    // The most recent completed evaluation, or nullptr if nothing finished since the last call.
+    // The worker does not start on the next request until this has been taken.
+    std::unique_ptr<Result> TakeResult();
+    // Drops the request waiting to start, if any, and blocks until the one running has finished.
+    // Used before the UI evaluates the graph itself.
+    void CancelPendingAndWait();
+
+private:
+    // The two images a node alternates between, front being the one last handed to the UI.
+    struct NodeImages
+    {
+        std::shared_ptr<Image> front;
+        std::shared_ptr<Image> back;
+        uint64_t evaluatedStamp = 0;
+    };
+
+    void ThreadMain();
+    std::unique_ptr<Result> Run( Request &request );
+
+    std::thread             m_thread;
+    std::mutex              m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_idle;
+
+    std::unique_ptr<Request> m_pending;
+    std::unique_ptr<Result>  m_result;
+    std::atomic<bool>        m_cancel { false };
+    bool                     m_running = false;
+    bool                     m_lastRunCancelled = false;
+    bool                     m_quit = false;
+
+    // Only touched by the worker thread.
+    std::unordered_map<int, NodeImages> m_images;
+    uint64_t                            m_imagesGeneration = 0;
+};
+
+}
@@ -2,6 +2,9 @@
 
 #include <nfd.h>
 
+#include <algorithm>
+#include <cstring>
+
 #include "Application.h"
 
 namespace Surge
@@ -20,6 +23,61 @@ static bool IsSupportedExtension(std::string_view extension)
     }
     return false;
 }
+
+// The longest side a thumbnail is shrunk to, twice the size of a tile.
+static constexpr uint32_t ThumbnailSize = 256;
+// Next to the pipeline cache, in the working directory.
+static const char* ThumbnailCachePath = "thumbnail_cache";
+
+// Box filters an image down until it fits in ThumbnailSize, as 8 bit whatever it was loaded as.
+static ImageData MakeThumbnail( const ImageData &source )
+{
+    const uint32_t longest = std::max( source.width, source.height );
+    const uint32_t step = std::max( 1u, ( longest + ThumbnailSize - 1 ) / ThumbnailSize );
+
+    auto channel = [&source]( const size_t index ) -> float
+    {
+        if ( source.format == ImageFormat::RGBA32F )
+        {
+            float value;
+            memcpy( &value, source.pixels.data() + index * sizeof( float ), sizeof( float ) );
+            return std::clamp( value, 0.0f, 1.0f ) * 255.0f;
+        }
+        return source.pixels[index];
+    };
+
+    ImageData thumbnail;
+    thumbnail.width = std::max( 1u, source.width / step );
+    thumbnail.height = std::max( 1u, source.height / step );
+    thumbnail.format = ImageFormat::RGBA;
+    thumbnail.pixels.resize( static_cast<size_t>( thumbnail.width ) * thumbnail.height * 4 );
+    const uint32_t blockWidth = std::min( step, source.width );
+    const uint32_t blockHeight = std::min( step, source.height );
+    for ( uint32_t y = 0; y < thumbnail.height; ++y )
+    {
+        for ( uint32_t x = 0; x < thumbnail.width; ++x )
+        {
+            float sum[4] = {};
+            for ( uint32_t sy = y * step; sy < y * step + blockHeight; ++sy )
+            {
+                for ( uint32_t sx = x * step; sx < x * step + blockWidth; ++sx )
+                {
+                    const size_t pixel = ( static_cast<size_t>( sy ) * source.width + sx ) * 4;
+                    for ( int c = 0; c < 4; ++c )
+                    {
+                        sum[c] += channel( pixel + c );
+                    }
+                }
+            }
+            uint8_t *out = thumbnail.pixels.data() + ( static_cast<size_t>( y ) * thumbnail.width + x ) * 4;
+            for ( int c = 0; c < 4; ++c )
+            {
+                out[c] = static_cast<uint8_t>( sum[c] / static_cast<float>( blockWidth * blockHeight ) + 0.5f );
+            }
+        }
+    }
+    return thumbnail;
+}
     
 ExplorerWindow::ExplorerWindow()
 {
@@ -34,6 +92,9 @@ ExplorerWindow::~ExplorerWindow()
 void ExplorerWindow::Init()
 {
     m_folderImage = std::make_shared<Image>( "folder.png" );
+    const uint32_t placeholderColor = 0xff404040;
+    m_placeholderImage = std::make_shared<Image>( 1, 1, ImageFormat::RGBA, &placeholderColor );
+    m_thumbnailCache = std::make_shared<ThumbnailCache>( ThumbnailCachePath );
     AppConfig &config = Application::GetConfig();
     m_explorerRoot = config.explorerRoot;
     if ( m_explorerRoot.empty() )
@@ -49,7 +110,11 @@ void ExplorerWindow::Shutdown()
 {
     AppConfig &config = Application::GetConfig();
     config.explorerRoot = m_explorerRoot.string();
-    m_imageCache.clear();
+    if ( m_cancelLoads )
+    {
+        *m_cancelLoads = true;
+    }
+    m_thumbnails.clear();
     m_currentImages.clear();
 }
 
@@ -76,6 +141,19 @@ void ExplorerWindow::RequestExplorerRoot()
 void ExplorerWindow::NavigateToDir( const std::filesystem::path &path )
 {
     m_currentImages.clear();
+
+    // Whatever the last folder still had queued is of no use now. Thumbnails that were never
+    // uploaded are dropped too, so coming back to a folder queues them again.
+    if ( m_cancelLoads )
+    {
+        *m_cancelLoads = true;
+    }
+    m_cancelLoads = std::make_shared<std::atomic<bool>>( false );
+    for ( auto iter = m_thumbnails.begin(); iter != m_thumbnails.end(); )
+    {
+        iter = iter->second.image ? std::next( iter ) : m_thumbnails.erase( iter );
+    }
+
     namespace fs = std::filesystem;
     if (fs::exists(path) && fs::is_directory(path))
     {
@@ -87,9 +165,9 @@ void ExplorerWindow::NavigateToDir( const std::filesystem::path &path )
             if (fs::is_directory(entry.status()))
             {
                 //dir
-                if (m_imageCache.find( pathStr ) == m_imageCache.end())
+                if (m_thumbnails.find( pathStr ) == m_thumbnails.end())
                 {
-                    m_imageCache.emplace( pathStr, m_folderImage );
+                    m_thumbnails.emplace( pathStr, Thumbnail{ {}, m_folderImage } );
                 }
                 m_currentImages.push_back( pathStr );
             }
@@ -100,9 +178,33 @@ void ExplorerWindow::NavigateToDir( const std::filesystem::path &path )
                     continue;
                 }
                 //files
-                if (m_imageCache.find( pathStr ) == m_imageCache.end())
+                if (m_thumbnails.find( pathStr ) == m_thumbnails.end())
                 {
-                    m_imageCache.emplace( pathStr, std::make_shared<Image>( pathStr ) );
+                    // Decoding a large image takes far longer than a frame, so it happens on the
+                    // pool and only the shrunk result is uploaded. Images that haven't changed
+                    // since they were last shown skip the decode altogether.
+                    auto load = [pathStr, cancel = m_cancelLoads, cache = m_thumbnailCache]() -> ImageData
+                    {
+                        ThumbnailCache::Key key;
+                        ImageData thumbnail;
+                        if ( *cancel || !ThumbnailCache::GetKey( pathStr, key ) )
+                        {
+                            return {};
+                        }
+                        if ( cache->Load( key, thumbnail ) )
+                        {
+                            return thumbnail;
+                        }
+                        ImageData source;
+                        if ( *cancel || !Image::LoadFile( pathStr, source ) )
+                        {
+                            return {};
+                        }
+                        thumbnail = MakeThumbnail( source );
+                        cache->Store( key, thumbnail );
+                        return thumbnail;
+                    };
+                    m_thumbnails.emplace( pathStr, Thumbnail{ Application::GetThreadPool()->Submit( std::move( load ) ), nullptr } );
                 }
                 m_currentImages.push_back( pathStr );
             }
@@ -114,9 +216,44 @@ void ExplorerWindow::NavigateToDir( const std::filesystem::path &path )
     }
 }
 
+void ExplorerWindow::UploadReadyThumbnails()
+{
+    bool batching = false;
+    for ( const std::string &path : m_currentImages )
+    {
+        Thumbnail &thumbnail = m_thumbnails[path];
+        if ( thumbnail.image || !thumbnail.pixels.valid()
+             || thumbnail.pixels.wait_for( std::chrono::seconds( 0 ) ) != std::future_status::ready )
+        {
+            continue;
+        }
+        const ImageData &pixels = thumbnail.pixels.get();
+        if ( pixels.pixels.empty() )
+        {
+            fprintf( stderr, "Could not load a thumbnail for %s\n", path.c_str() );
+            // Keeps the placeholder without asking again every frame.
+            thumbnail.pixels = {};
+            continue;
+        }
+        if ( !batching )
+        {
+            // Everything that finished since the last frame goes up in one submission.
+            Application::BeginComputeBatch();
+            batching = true;
+        }
+        thumbnail.image = std::make_shared<Image>( pixels.width, pixels.height, pixels.format, pixels.pixels.data() );
+        thumbnail.pixels = {};
+    }
+    if ( batching )
+    {
+        Application::EndComputeBatch();
+    }
+}
+
 void ExplorerWindow::UiRender()
 {
     ImGui::Begin( "Explorer" );
+    UploadReadyThumbnails();
     
     ImGui::BeginGroup();
     //Draw an icon for new root folder
@@ -162,7 +299,7 @@ void ExplorerWindow::UiRender()
         {
             ImGui::SameLine();
         }
-        std::shared_ptr<Image> image = m_imageCache[currentImage];
+        const std::shared_ptr<Image> &image = m_thumbnails[currentImage].image;
         bool isFolder = image == m_folderImage;
         ImGui::BeginGroup();
         if (isFolder)
@@ -175,7 +312,7 @@ void ExplorerWindow::UiRender()
         }
         else
         {
-            ImGui::Image( image->GetDescriptorSet(), size );
+            ImGui::Image( ( image ? image : m_placeholderImage )->GetDescriptorSet(), size );
         }
         std::filesystem::path file = currentImage;
         ImGui::Text("%s", file.filename().generic_string().c_str());
@@ -186,7 +323,7 @@ void ExplorerWindow::UiRender()
             ImGui::SetDragDropPayload("DND_EXPLORER", &i, sizeof(int));
 
             // Display preview, image names
-            ImGui::Text("%s", m_imageCache[currentImage]->GetFilename().c_str());
+            ImGui::Text("%s", currentImage.c_str());
             ImGui::EndDragDropSource();
         }
         
@@ -203,7 +340,11 @@ std::shared_ptr<Image> ExplorerWindow::GetImageForIndex( int index )
         return nullptr;
     }
     const std::string& currentImage = m_currentImages[index];
-    return m_imageCache[currentImage];
+    if ( !std::filesystem::is_regular_file( currentImage ) )
+    {
+        return nullptr;
+    }
+    return std::make_shared<Image>( currentImage );
 }
     
 }
\ No newline at end of file
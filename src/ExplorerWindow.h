@@ -1,9 +1,13 @@
 ﻿#pragma once
 
 #include "Image.h"
+#include "ThumbnailCache.h"
 
+#include <atomic>
 #include <filesystem>
+#include <future>
 #include <map>
+#include <memory>
 
 namespace Surge
 {
@@ -15,22 +19,37 @@ public:
 
     void UiRender();
 
+    // The full size image behind a tile, loaded from disk when it is dropped onto the canvas.
     std::shared_ptr<Image> GetImageForIndex( int index );
 private:
+    struct Thumbnail
+    {
+        // Decoded and shrunk on the thread pool. Comes back empty if the file couldn't be read, or
+        // the folder was left before it got a turn.
+        std::shared_future<ImageData> pixels;
+        // Uploaded once the pixels are ready, the tile shows a placeholder until then.
+        std::shared_ptr<Image> image;
+    };
+
     void Init();
     void Shutdown();
 
     void RequestExplorerRoot();
 
     void NavigateToDir( const std::filesystem::path &path );
+    void UploadReadyThumbnails();
     
     std::filesystem::path m_explorerRoot;
     std::filesystem::path m_relativePath;
 
     std::vector<std::string> m_currentImages;
-    //TODO draperdanman: fix this to only load the currently needed images, not cache everything
-    std::map<std::string,std::shared_ptr<Image>> m_imageCache;
+    std::map<std::string,Thumbnail> m_thumbnails;
     std::shared_ptr<Image> m_folderImage;
+    std::shared_ptr<Image> m_placeholderImage;
+    // Shared with the loads still running, which can outlive the window at shutdown.
+    std::shared_ptr<ThumbnailCache> m_thumbnailCache;
+    // Raised when leaving a folder, so thumbnails still queued for it are skipped.
+    std::shared_ptr<std::atomic<bool>> m_cancelLoads;
 };
     
 }
\ No newline at end of file
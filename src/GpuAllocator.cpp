@@ -0,0 +1,280 @@
+#include "GpuAllocator.h"
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+
+#include "Application.h"
+
+namespace Surge
+{
+
+// Big enough for a dozen 2048x2048 RGBA images. Anything over half of it gets a block of its own.
+static constexpr VkDeviceSize s_BlockSize = 256ull * 1024 * 1024;
+static constexpr VkDeviceSize s_DedicatedThreshold = s_BlockSize / 2;
+
+struct GpuMemoryBlock
+{
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize size = 0;
+	char* mapped = nullptr;
+	uint32_t memoryType = 0;
+	GpuResourceTiling tiling = GpuResourceTiling::Optimal;
+	bool dedicated = false;
+
+	// Offset to size of every unused range, neighbouring ranges are always merged.
+	std::map<VkDeviceSize, VkDeviceSize> freeRanges;
+	VkDeviceSize usedBytes = 0;
+	uint32_t allocationCount = 0;
+};
+
+static VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+	return alignment == 0 ? value : ( value + alignment - 1 ) / alignment * alignment;
+}
+
+// First fit, returns false if the block has no free range the request fits in.
+static bool AllocateFromBlock(GpuMemoryBlock& block, const VkMemoryRequirements& requirements, VkDeviceSize& offset)
+{
+	for (auto iter = block.freeRanges.begin(); iter != block.freeRanges.end(); ++iter)
+	{
+		const VkDeviceSize rangeOffset = iter->first;
+		const VkDeviceSize rangeEnd = iter->first + iter->second;
+		const VkDeviceSize aligned = AlignUp(rangeOffset, requirements.alignment);
+		if (aligned + requirements.size > rangeEnd)
+		{
+			continue;
+		}
+
+		block.freeRanges.erase(iter);
+		if (aligned > rangeOffset)
+		{
+			block.freeRanges.emplace(rangeOffset, aligned - rangeOffset);
+		}
+		if (aligned + requirements.size < rangeEnd)
+		{
+			block.freeRanges.emplace(aligned + requirements.size, rangeEnd - aligned - requirements.size);
+		}
+		offset = aligned;
+		return true;
+	}
+	return false;
+}
+
+
+GpuAllocator::GpuAllocator(VkPhysicalDevice physicalDevice, VkDevice device)
+	: m_device(device)
+{
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_memoryProperties);
+}
+
+GpuAllocator::~GpuAllocator()
+{
+	for (const auto& block : m_blocks)
+	{
+		if (block->allocationCount != 0)
+		{
+			fprintf(stderr, "[gpu memory] %u allocation(s) still alive at shutdown\n", block->allocationCount);
+		}
+		vkFreeMemory(m_device, block->memory, nullptr);
+	}
+}
+
+uint32_t GpuAllocator::FindMemoryType(VkMemoryPropertyFlags properties, uint32_t typeBits) const
+{
+	for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++)
+	{
+		if ((m_memoryProperties.memoryTypes[i].propertyFlags & properties) == properties && typeBits & (1 << i))
+		{
+			return i;
+		}
+	}
+
+	return 0xffffffff;
+}
+
+GpuMemoryBlock* GpuAllocator::CreateBlock(uint32_t memoryType, VkDeviceSize size, GpuResourceTiling tiling, bool dedicated)
+{
+	VkMemoryAllocateInfo alloc_info = {};
+	alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	alloc_info.allocationSize = size;
+	alloc_info.memoryTypeIndex = memoryType;
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	if (vkAllocateMemory(m_device, &alloc_info, nullptr, &memory) != VK_SUCCESS)
+	{
+		return nullptr;
+	}
+
+	auto block = std::make_unique<GpuMemoryBlock>();
+	block->memory = memory;
+	block->size = size;
+	block->memoryType = memoryType;
+	block->tiling = tiling;
+	block->dedicated = dedicated;
+	block->freeRanges.emplace(0, size);
+
+	// Host visible memory can only be mapped once at a time, and blocks are shared, so map it up front.
+	if (m_memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		const VkResult err = vkMapMemory(m_device, memory, 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void**>( &block->mapped ));
+		check_vk_result(err);
+	}
+
+	m_blocks.push_back(std::move(block));
+	return m_blocks.back().get();
+}
+
+void GpuAllocator::DestroyBlock(GpuMemoryBlock* block)
+{
+	// Freeing mapped memory unmaps it too.
+	vkFreeMemory(m_device, block->memory, nullptr);
+	m_blocks.erase(std::find_if(m_blocks.begin(), m_blocks.end(), [block](const std::unique_ptr<GpuMemoryBlock>& b) { return b.get() == block; }));
+}
+
+GpuAllocation GpuAllocator::Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, GpuResourceTiling tiling)
+{
+	const uint32_t memoryType = FindMemoryType(properties, requirements.memoryTypeBits);
+	if (memoryType == 0xffffffff)
+	{
+		fprintf(stderr, "[gpu memory] No memory type with properties 0x%x\n", properties);
+		return {};
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	GpuMemoryBlock* block = nullptr;
+	VkDeviceSize offset = 0;
+	if (requirements.size <= s_DedicatedThreshold)
+	{
+		for (const auto& candidate : m_blocks)
+		{
+			if (!candidate->dedicated && candidate->memoryType == memoryType && candidate->tiling == tiling &&
+				AllocateFromBlock(*candidate, requirements, offset))
+			{
+				block = candidate.get();
+				break;
+			}
+		}
+
+		if (!block)
+		{
+			block = CreateBlock(memoryType, s_BlockSize, tiling, false);
+			if (block)
+			{
+				AllocateFromBlock(*block, requirements, offset);
+			}
+		}
+	}
+
+	// Very large requests, or a heap too full for another whole block, get exactly what they asked for.
+	if (!block)
+	{
+		block = CreateBlock(memoryType, requirements.size, tiling, true);
+		if (!block)
+		{
+			fprintf(stderr, "[gpu memory] Out of memory allocating %llu bytes\n", static_cast<unsigned long long>( requirements.size ));
+			check_vk_result(VK_ERROR_OUT_OF_DEVICE_MEMORY);
+			return {};
+		}
+		block->freeRanges.clear();
+	}
+
+	block->usedBytes += requirements.size;
+	block->allocationCount++;
+	m_usedBytes += requirements.size;
+	m_peakUsedBytes = std::max(m_peakUsedBytes, m_usedBytes);
+
+	GpuAllocation allocation;
+	allocation.memory = block->memory;
+	allocation.offset = offset;
+	allocation.size = requirements.size;
+	allocation.mapped = block->mapped ? block->mapped + offset : nullptr;
+	allocation.block = block;
+	return allocation;
+}
+
+void GpuAllocator::Free(const GpuAllocation& allocation)
+{
+	if (!allocation.block)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	GpuMemoryBlock* block = allocation.block;
+	block->usedBytes -= allocation.size;
+	block->allocationCount--;
+	m_usedBytes -= allocation.size;
+
+	if (block->dedicated)
+	{
+		DestroyBlock(block);
+		return;
+	}
+
+	// Put the range back and merge it with whatever free ranges it touches.
+	VkDeviceSize offset = allocation.offset;
+	VkDeviceSize size = allocation.size;
+	auto next = block->freeRanges.lower_bound(offset);
+	if (next != block->freeRanges.begin())
+	{
+		const auto prev = std::prev(next);
+		if (prev->first + prev->second == offset)
+		{
+			offset = prev->first;
+			size += prev->second;
+			block->freeRanges.erase(prev);
+		}
+	}
+	if (next != block->freeRanges.end() && offset + size == next->first)
+	{
+		size += next->second;
+		block->freeRanges.erase(next);
+	}
+	block->freeRanges.emplace(offset, size);
+
+	// Keep one empty block around per memory type so that freeing and reallocating the same image
+	// doesn't go back to the driver every time.
+	if (block->allocationCount == 0)
+	{
+		for (const auto& other : m_blocks)
+		{
+			if (other.get() != block && !other->dedicated && other->allocationCount == 0 &&
+				other->memoryType == block->memoryType && other->tiling == block->tiling)
+			{
+				DestroyBlock(block);
+				return;
+			}
+		}
+	}
+}
+
+GpuMemoryStats GpuAllocator::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	GpuMemoryStats stats;
+	for (const auto& block : m_blocks)
+	{
+		stats.blockCount++;
+		stats.dedicatedCount += block->dedicated ? 1 : 0;
+		stats.allocationCount += block->allocationCount;
+		stats.reservedBytes += block->size;
+		stats.usedBytes += block->usedBytes;
+		for (const auto& range : block->freeRanges)
+		{
+			stats.largestFreeRange = std::max(stats.largestFreeRange, range.second);
+		}
+	}
+	stats.peakUsedBytes = m_peakUsedBytes;
+	return stats;
+}
+
+void GpuAllocator::ResetPeak()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_peakUsedBytes = m_usedBytes;
+}
+
+}
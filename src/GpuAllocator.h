@@ -0,0 +1,86 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+namespace Surge
+{
+
+struct GpuMemoryBlock;
+
+// Buffers and optimally tiled images never share a block, so bufferImageGranularity never has to
+// be accounted for between neighbouring ranges.
+enum class GpuResourceTiling
+{
+	Linear,
+	Optimal
+};
+
+struct GpuAllocation
+{
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	// Host visible memory stays mapped for as long as its block lives, this points at offset.
+	void* mapped = nullptr;
+
+	GpuMemoryBlock* block = nullptr;
+};
+
+struct GpuMemoryStats
+{
+	uint32_t blockCount = 0;
+	uint32_t dedicatedCount = 0;
+	uint32_t allocationCount = 0;
+	VkDeviceSize reservedBytes = 0;
+	VkDeviceSize usedBytes = 0;
+	// The most usedBytes has been since the allocator was made or ResetPeak was last called.
+	VkDeviceSize peakUsedBytes = 0;
+	VkDeviceSize largestFreeRange = 0;
+
+	// How much of the free space in the blocks can't be handed out in one piece, between 0 and 1.
+	[[nodiscard]] float GetFragmentation() const
+	{
+		const VkDeviceSize freeBytes = reservedBytes - usedBytes;
+		return freeBytes == 0 ? 0.0f : 1.0f - static_cast<float>( largestFreeRange ) / static_cast<float>( freeBytes );
+	}
+};
+
+// Hands out ranges of a few large device memory blocks per memory type rather than making a
+// vkAllocateMemory call for every image and staging buffer. Very large requests still get memory
+// of their own. Safe to use from any thread.
+class GpuAllocator
+{
+public:
+	GpuAllocator(VkPhysicalDevice physicalDevice, VkDevice device);
+	~GpuAllocator();
+
+	GpuAllocator(const GpuAllocator&) = delete;
+	GpuAllocator& operator=(const GpuAllocator&) = delete;
+
+	GpuAllocation Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, GpuResourceTiling tiling);
+	// The resource bound to the range has to be destroyed, and the GPU done with it, beforehand.
+	void Free(const GpuAllocation& allocation);
+
+	[[nodiscard]] GpuMemoryStats GetStats() const;
+	// Starts peakUsedBytes over from what is in use now.
+	void ResetPeak();
+
+private:
+	uint32_t FindMemoryType(VkMemoryPropertyFlags properties, uint32_t typeBits) const;
+	GpuMemoryBlock* CreateBlock(uint32_t memoryType, VkDeviceSize size, GpuResourceTiling tiling, bool dedicated);
+	void DestroyBlock(GpuMemoryBlock* block);
+
+	VkDevice m_device = VK_NULL_HANDLE;
+	VkPhysicalDeviceMemoryProperties m_memoryProperties = {};
+
+	mutable std::mutex m_mutex;
+	std::vector<std::unique_ptr<GpuMemoryBlock>> m_blocks;
+	VkDeviceSize m_usedBytes = 0;
+	VkDeviceSize m_peakUsedBytes = 0;
+};
+
+}
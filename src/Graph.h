@@ -4,6 +4,7 @@
 #include <cassert>
 #include <iterator>
 #include <stack>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -44,6 +45,7 @@ public:
     // Element access
 
     Span<const ElementType> elements() const { return elements_; }
+    Span<const int>         ids() const { return sorted_ids_; }
 
     // Capacity
 
@@ -170,7 +172,7 @@ template<typename NodeType>
 class Graph
 {
 public:
-    Graph() : current_id_(0), nodes_(), edges_from_node_(), node_neighbors_(), edges_() {}
+    Graph() : current_id_(0), nodes_(), edges_from_node_(), node_neighbors_(), node_versions_(), edges_() {}
 
     struct Edge
     {
@@ -191,11 +193,17 @@ public:
     Span<const int>  neighbors(int node_id) const;
     Span<const Edge> edges() const;
     Span<const NodeType> nodes() const;
+    Span<const int>  node_ids() const;
 
     // Capacity
 
+    bool   contains_node(int node_id) const;
+
     size_t num_edges_from_node(int node_id) const;
 
+    // Bumped every time an edge leaving the node is inserted or erased.
+    unsigned node_version(int node_id) const;
+
     // Modifiers
 
     int  insert_node(const NodeType& node);
@@ -211,6 +219,7 @@ private:
     IdMap<NodeType>         nodes_;
     IdMap<int>              edges_from_node_;
     IdMap<std::vector<int>> node_neighbors_;
+    IdMap<unsigned>         node_versions_;
 
     // This container maps to the edge id
     IdMap<Edge> edges_;
@@ -250,6 +259,18 @@ Span<const NodeType> Graph<NodeType>::nodes() const
     return nodes_.elements();
 }
 
+template<typename NodeType>
+Span<const int> Graph<NodeType>::node_ids() const
+{
+    return nodes_.ids();
+}
+
+template<typename NodeType>
+bool Graph<NodeType>::contains_node(const int id) const
+{
+    return nodes_.contains(id);
+}
+
 template<typename NodeType>
 size_t Graph<NodeType>::num_edges_from_node(const int id) const
 {
@@ -258,6 +279,14 @@ size_t Graph<NodeType>::num_edges_from_node(const int id) const
     return *iter;
 }
 
+template<typename NodeType>
+unsigned Graph<NodeType>::node_version(const int id) const
+{
+    const auto iter = node_versions_.find(id);
+    assert(iter != node_versions_.end());
+    return *iter;
+}
+
 template<typename NodeType>
 int Graph<NodeType>::insert_node(const NodeType& node)
 {
@@ -266,6 +295,7 @@ int Graph<NodeType>::insert_node(const NodeType& node)
     nodes_.insert(id, node);
     edges_from_node_.insert(id, 0);
     node_neighbors_.insert(id, std::vector<int>());
+    node_versions_.insert(id, 0u);
     return id;
 }
 
@@ -305,6 +335,7 @@ void Graph<NodeType>::erase_node(const int id)
     nodes_.erase(id);
     edges_from_node_.erase(id);
     node_neighbors_.erase(id);
+    node_versions_.erase(id);
 }
 
 template<typename NodeType>
@@ -322,6 +353,8 @@ int Graph<NodeType>::insert_edge(const int from, const int to)
     // update neighbor list
     assert(node_neighbors_.contains(from));
     node_neighbors_.find(from)->push_back(to);
+    // anything evaluated through this node is now stale
+    *node_versions_.find(from) += 1u;
 
     return id;
 }
@@ -349,6 +382,8 @@ void Graph<NodeType>::erase_edge(const int edge_id)
         neighbors->erase(iter);
     }
 
+    *node_versions_.find(edge.from) += 1u;
+
     edges_.erase(edge_id);
 }
 
@@ -372,4 +407,40 @@ void dfs_traverse(const Graph<NodeType>& graph, const int start_node, Visitor vi
         }
     }
 }
+
+// Visits every node reachable from start_node exactly once, and only after all of its neighbors
+// have been visited, i.e. producers before the nodes that consume them. Unlike dfs_traverse, nodes
+// shared by several paths are not visited once per path.
+template<typename NodeType, typename Visitor>
+void postorder_traverse(const Graph<NodeType>& graph, const int start_node, Visitor visitor)
+{
+    // node id and the index of the next neighbor to descend into
+    std::stack<std::pair<int, size_t>> stack;
+    std::unordered_set<int>            visited;
+
+    stack.push(std::make_pair(start_node, size_t(0)));
+    visited.insert(start_node);
+
+    while (!stack.empty())
+    {
+        std::pair<int, size_t>& current = stack.top();
+        const Span<const int>   neighbors = graph.neighbors(current.first);
+
+        if (current.second < neighbors.size())
+        {
+            const int neighbor = neighbors.begin()[current.second++];
+            // a neighbor that was already visited is either done, or is on the stack because the
+            // graph has a cycle, either way there is nothing left to do for it
+            if (visited.insert(neighbor).second)
+            {
+                stack.push(std::make_pair(neighbor, size_t(0)));
+            }
+        }
+        else
+        {
+            visitor(current.first);
+            stack.pop();
+        }
+    }
+}
 } // namespace example
\ No newline at end of file
@@ -0,0 +1,529 @@
+#include "GraphEvaluator.h"
+
+#include <algorithm>
+#include <iterator>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "Application.h"
+#include "Compute/ComputeKernels.h"
+#include "Compute/FusedPointwiseCompute.h"
+
+namespace Surge
+{
+
+// Nodes that are evaluated, as opposed to VALUE pins and the output, which pass on their input.
+static bool IsOperation( const NodeType type )
+{
+    switch (type)
+    {
+    case NodeType::BLEND:
+    case NodeType::HSL:
+    case NodeType::LEVELS:
+    case NodeType::CURVES:
+    case NodeType::TRANSFORM:
+    case NodeType::BLUR:
+    case NodeType::INVERT:
+    case NodeType::UNIFORM_COLOR:
+    case NodeType::NOISE:
+    case NodeType::DYNAMIC_IMAGE:
+    case NodeType::IMAGE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+
+GraphEvaluator::GraphEvaluator( const Options &options )
+    : m_options( options )
+{
+}
+
+
+ImageStorage GraphEvaluator::GetStorage() const
+{
+    return m_options.cpuBackend || Application::GetDevice() == VK_NULL_HANDLE ? ImageStorage::Host : ImageStorage::Device;
+}
+
+
+std::unordered_map<int, GraphEvaluator::OutputDesc> GraphEvaluator::InferOutputs( const Graph<Node *> &graph, const std::vector<int> &postorder ) const
+{
+    // In a proxy evaluation everything is shrunk the way the ProxyImageCache shrinks the sources,
+    // a tile renders at the size of its region.
+    const ImageRegion &region = m_options.region;
+    auto scale = [this, &region]( const uint32_t width, const uint32_t height ) -> OutputDesc
+    {
+        if ( region.width != 0 )
+        {
+            return { region.width, region.height, ImageFormat::RGBA };
+        }
+        return { std::max( 1u, width / m_options.resolutionDivisor ), std::max( 1u, height / m_options.resolutionDivisor ), ImageFormat::RGBA };
+    };
+
+    std::unordered_map<int, OutputDesc> outputs;
+    for ( const int id : postorder )
+    {
+        const Node *node = graph.node( id );
+        OutputDesc output;
+        uint32_t width, height;
+        if ( node->type == NodeType::IMAGE || node->type == NodeType::DYNAMIC_IMAGE )
+        {
+            // Tiles hand the sources a crop of their region already, see TiledEvaluator.
+            if ( node->value )
+            {
+                output = region.width != 0 ? OutputDesc{ node->value->GetWidth(), node->value->GetHeight() }
+                                           : scale( node->value->GetWidth(), node->value->GetHeight() );
+                output.format = Image::IsFloat( node->value->GetFormat() ) ? m_options.floatFormat : node->value->GetFormat();
+            }
+        }
+        else if ( node->GetGeneratedSize( width, height ) )
+        {
+            output = scale( width, height );
+        }
+        else
+        {
+            bool floatInput = false;
+            for ( const int input : graph.neighbors( id ) )
+            {
+                if ( output.width == 0 )
+                {
+                    output = outputs[input];
+                }
+                floatInput = floatInput || Image::IsFloat( outputs[input].format );
+            }
+            if ( floatInput )
+            {
+                output.format = m_options.floatFormat;
+            }
+            if ( output.width == 0 && WritesValue( node->type ) )
+            {
+                // Nothing is connected, every input is going to read as blank.
+                output = scale( DefaultImageSize, DefaultImageSize );
+            }
+        }
+        outputs[id] = output;
+    }
+    return outputs;
+}
+
+
+void GraphEvaluator::PrepareOutput( const int nodeId, Node *node, const OutputDesc &output ) const
+{
+    const ImageStorage storage = GetStorage();
+    if ( m_options.imagePool )
+    {
+        node->value = m_options.imagePool->Acquire( output.width, output.height, output.format, storage );
+    }
+    else if ( m_options.prepareOutput && storage == ImageStorage::Device )
+    {
+        m_options.prepareOutput( nodeId, node, output.width, output.height, output.format );
+    }
+    else if ( !node->value || node->value->GetWidth() != output.width || node->value->GetHeight() != output.height ||
+              node->value->GetFormat() != output.format || node->value->GetStorage() != storage )
+    {
+        // Also when switching between proxy and full resolution, or the inputs changed size.
+        node->value = std::make_shared<Image>( output.width, output.height, output.format, nullptr, storage );
+    }
+}
+
+
+void GraphEvaluator::ReleaseInputs( const Graph<Node *> &graph, const int nodeId, const size_t index, const std::unordered_map<int, size_t> &lastUse,
+                                    const std::unordered_set<int> &pinned, std::unordered_map<int, std::shared_ptr<Image>> &results )
+{
+    if ( !m_options.imagePool )
+    {
+        return;
+    }
+
+    // Anything this node was the last reader of can go back to the pool.
+    for (const int input : graph.neighbors( nodeId ))
+    {
+        const auto use = lastUse.find( input );
+        if (use == lastUse.end() || use->second != index || results.erase( input ) == 0)
+        {
+            continue;
+        }
+
+        Node *inputNode = graph.node( input );
+        if ( WritesValue( inputNode->type ) && inputNode->value && pinned.count( input ) == 0 )
+        {
+            inputNode->value.reset();
+            m_releasedNodes.push_back( input );
+        }
+    }
+}
+
+
+std::shared_ptr<Image> GraphEvaluator::Evaluate( const Graph<Node *> &graph, const int startNode )
+{
+    const Profiler::CpuScope profileScope( "Evaluate graph", "evaluation" );
+    m_evaluatedNodes.clear();
+    m_releasedNodes.clear();
+    m_cancelled = false;
+
+    std::vector<int> postorder;
+    postorder_traverse( graph, startNode, [&postorder]( const int nodeId ) -> void { postorder.push_back( nodeId ); } );
+    const std::unordered_map<int, OutputDesc> outputs = InferOutputs( graph, postorder );
+
+    // A node's stamp combines its own version with the stamps of everything feeding into it, so
+    // an edit only changes the stamps downstream of it. Nodes whose stamp matches the one they
+    // were last evaluated with keep their cached value instead of dispatching again.
+    // The region, backend and float format go in as well, so nothing rendered for another tile,
+    // on the other backend or in another format is taken as up to date.
+    std::unordered_map<int, uint64_t> stamps;
+    auto combine = []( uint64_t seed, const uint64_t v ) -> uint64_t
+    {
+        return seed ^ ( v + 0x9e3779b97f4a7c15ull + ( seed << 6 ) + ( seed >> 2 ) );
+    };
+    const ImageRegion &region = m_options.region;
+    uint64_t seed = combine( 0x9e3779b97f4a7c15ull, static_cast<uint32_t>( region.x ) );
+    seed = combine( combine( seed, static_cast<uint32_t>( region.y ) ), region.width );
+    seed = combine( seed, region.height );
+    const ImageStorage storage = GetStorage();
+    seed = combine( combine( seed, static_cast<uint64_t>( storage ) ), static_cast<uint64_t>( m_options.floatFormat ) );
+    for (const int id : postorder)
+    {
+        uint64_t stamp = combine( combine( seed, graph.node( id )->version ), graph.node_version( id ) );
+        for (const int input : graph.neighbors( id ))
+        {
+            stamp = combine( stamp, stamps[input] );
+        }
+        stamps[id] = stamp;
+    }
+
+    // A proxy evaluation only renders the nodes that have to run at the lower resolution, and
+    // those are stamped with the divisor on top. Nodes still up to date at full resolution, e.g.
+    // everything upstream of the parameter being dragged, keep their image and are shrunk on the
+    // way into the nodes that do run. Once the parameter is let go, only the proxied nodes run again.
+    const uint32_t divisor = m_options.resolutionDivisor;
+    auto runStamp = [&graph, &stamps, &combine, divisor]( const int id ) -> uint64_t
+    {
+        // Source nodes hand on their image as it is, shrinking it happens after them.
+        return divisor > 1 && WritesValue( graph.node( id )->type ) ? combine( stamps[id], divisor ) : stamps[id];
+    };
+    auto mustRun = [&graph, &stamps, &runStamp]( const int id ) -> bool
+    {
+        const Node *node = graph.node( id );
+        return IsOperation( node->type ) && ( !node->value || ( node->evaluatedStamp != stamps[id] && node->evaluatedStamp != runStamp( id ) ) );
+    };
+
+    // Inputs are only needed by nodes that are going to run, so working back from the start node
+    // leaves out everything that only feeds nodes which are still cached. readByRunning holds the
+    // ones a running node reads, through any pins in between, rather than just the output.
+    std::unordered_set<int> needed = { startNode };
+    std::unordered_set<int> readByRunning;
+    std::unordered_map<int, size_t> lastUse;
+    for (auto iter = postorder.rbegin(); iter != postorder.rend(); ++iter)
+    {
+        const int id = *iter;
+        const bool operation = IsOperation( graph.node( id )->type );
+        if (needed.count( id ) != 0 && ( !operation || mustRun( id ) ))
+        {
+            const size_t index = static_cast<size_t>( std::distance( iter, postorder.rend() ) ) - 1;
+            const bool read = operation || readByRunning.count( id ) != 0;
+            for (const int input : graph.neighbors( id ))
+            {
+                needed.insert( input );
+                lastUse.emplace( input, index );
+                if (read)
+                {
+                    readByRunning.insert( input );
+                }
+            }
+        }
+    }
+
+    std::unordered_set<int> pinned( m_options.pinnedNodes.begin(), m_options.pinnedNodes.end() );
+    {
+        // Whatever ends up as the result is shown in the UI, keep it on the node that produced it too.
+        int id = startNode;
+        while ( !IsOperation( graph.node( id )->type ) && graph.neighbors( id ).size() != 0 )
+        {
+            id = *graph.neighbors( id ).begin();
+        }
+        pinned.insert( id );
+    }
+    if ( m_options.imagePool )
+    {
+        m_options.imagePool->NextEpoch();
+    }
+
+    // Runs of per-pixel nodes that each only feed the next one are evaluated as a single shader.
+    // chains holds the nodes of each run by its last node, the only one that ends up with an image,
+    // and fusedInto maps every other node of the run to that last node.
+    std::unordered_map<int, std::vector<int>> chains;
+    std::unordered_map<int, int> fusedInto;
+    if ( m_options.fusePointwise && storage == ImageStorage::Device )
+    {
+        std::unordered_map<int, int> consumers;
+        for (const int id : postorder)
+        {
+            for (const int input : graph.neighbors( id ))
+            {
+                ++consumers[input];
+            }
+        }
+
+        std::unordered_map<int, size_t> chainParams;
+        for (const int id : postorder)
+        {
+            PointwiseStage stage;
+            if (needed.count( id ) == 0 || !mustRun( id ) || !graph.node( id )->GetPointwiseStage( stage ))
+            {
+                continue;
+            }
+
+            // The producer on the other side of this node's input pin, if it can join its run.
+            int producer = -1;
+            if (graph.neighbors( id ).size() == 1)
+            {
+                const int pin = *graph.neighbors( id ).begin();
+                if (graph.node( pin )->type == NodeType::VALUE && graph.neighbors( pin ).size() == 1 && consumers[pin] == 1)
+                {
+                    producer = *graph.neighbors( pin ).begin();
+                }
+            }
+
+            const auto run = chains.find( producer );
+            if (run != chains.end() && consumers[producer] == 1 && pinned.count( producer ) == 0 &&
+                chainParams[producer] + stage.params.size() <= FusedPointwiseCompute::MaxParams)
+            {
+                std::vector<int> chain = std::move( run->second );
+                chains.erase( run );
+                for (const int member : chain)
+                {
+                    fusedInto[member] = id;
+                }
+                chain.push_back( id );
+                chains[id] = std::move( chain );
+                chainParams[id] = chainParams[producer] + stage.params.size();
+            }
+            else
+            {
+                chains[id] = { id };
+                chainParams[id] = stage.params.size();
+            }
+        }
+
+        for (auto iter = chains.begin(); iter != chains.end(); )
+        {
+            iter = iter->second.size() < 2 ? chains.erase( iter ) : std::next( iter );
+        }
+    }
+    // The image going into each run, and the pin it came through, taken when its first node comes up.
+    std::unordered_map<int, std::shared_ptr<Image>> chainInputs;
+    std::unordered_map<int, int> chainInputIds;
+
+    // The CPU backend doesn't record anything, and has to read sources back outside of a batch.
+    const bool batchCompute = m_options.batchCompute && storage == ImageStorage::Device;
+    if ( batchCompute )
+    {
+        Application::BeginComputeBatch();
+    }
+
+    BlankImageCache localBlankImages;
+    BlankImageCache *blankImages = m_options.blankImages ? m_options.blankImages : &localBlankImages;
+    ProxyImageCache localProxyImages;
+    ProxyImageCache *proxyImages = m_options.proxyImages ? m_options.proxyImages : &localProxyImages;
+
+    std::unordered_map<int, std::shared_ptr<Image>> results;
+    for (size_t index = 0; index < postorder.size(); ++index)
+    {
+        const int id = postorder[index];
+        if (needed.count( id ) == 0)
+        {
+            continue;
+        }
+
+        if ( m_options.cancel && m_options.cancel->load() )
+        {
+            m_cancelled = true;
+            break;
+        }
+
+        Node *node = graph.node(id);
+        const bool runs = mustRun( id );
+
+        std::vector<std::shared_ptr<Image>> inputs;
+        std::vector<int> inputIds;
+        if (runs || !IsOperation( node->type ))
+        {
+            for (const int input : graph.neighbors( id ))
+            {
+                inputs.push_back( results[input] );
+                inputIds.push_back( input );
+            }
+        }
+
+        const auto fused = fusedInto.find( id );
+        if (fused != fusedInto.end())
+        {
+            if (chains[fused->second].front() == id)
+            {
+                chainInputs[fused->second] = inputs.empty() ? nullptr : inputs.front();
+                chainInputIds[fused->second] = inputIds.empty() ? -1 : inputIds.front();
+            }
+
+            // Rendered as part of the run instead, whatever image it held is out of date now.
+            results[id] = nullptr;
+            if ( node->value )
+            {
+                node->value.reset();
+                m_releasedNodes.push_back( id );
+            }
+            ReleaseInputs( graph, id, index, lastUse, pinned, results );
+            continue;
+        }
+
+        const auto chain = chains.find( id );
+        if (chain != chains.end())
+        {
+            inputs = { chainInputs[id] };
+            inputIds = { chainInputIds[id] };
+            chainInputs.erase( id );
+            chainInputIds.erase( id );
+        }
+
+        if (runs && WritesValue( node->type ))
+        {
+            PrepareOutput( id, node, outputs.at( id ) );
+            // Pins nothing is connected to read as white, at the size the node renders at.
+            for (size_t i = 0; i < inputs.size(); ++i)
+            {
+                std::shared_ptr<Image> &input = inputs[i];
+                const ImageFormat format = node->value->GetFormat();
+                if ( !input )
+                {
+                    input = blankImages->Get( node->value->GetWidth(), node->value->GetHeight(), format, storage );
+                }
+                else if ( input->GetFormat() != format && m_options.imagePool )
+                {
+                    // E.g. an 8 bit image blended with an HDR one, a kernel reads and writes one format.
+                    // Transient like the outputs, the pool only hands it out again once the batch
+                    // reading it is done with it.
+                    std::shared_ptr<Image> converted = m_options.imagePool->Acquire( input->GetWidth(), input->GetHeight(), format, storage );
+                    converted->CopyFrom( *input );
+                    Application::SubmitComputeResourceFree( [converted]() {} );
+                    input = converted;
+                }
+                else if ( input->GetFormat() != format )
+                {
+                    // Kept along with the stamp of the pin it came through, so an input that hasn't
+                    // changed isn't converted again the next time the node runs.
+                    input = proxyImages->Get( input, 1, storage, format, stamps[inputIds[i]] );
+                }
+            }
+        }
+
+        std::stack<std::shared_ptr<Image>> value_stack;
+        for (const std::shared_ptr<Image> &input : inputs)
+        {
+            value_stack.push( input );
+        }
+
+        switch (node->type)
+        {
+        case NodeType::VALUE:
+        {
+            // If the edge does not have an edge connecting to another node, then the node's input
+            // pin has not been connected to anything. It has no image of its own, the node reading
+            // it is handed a blank one instead.
+            if (graph.num_edges_from_node(id) == 0ull)
+            {
+                results[id] = nullptr;
+            }
+            else
+            {
+                results[id] = value_stack.top();
+            }
+        }
+        break;
+        case NodeType::BLEND:
+        case NodeType::HSL:
+        case NodeType::LEVELS:
+        case NodeType::CURVES:
+        case NodeType::TRANSFORM:
+        case NodeType::BLUR:
+        case NodeType::INVERT:
+        case NodeType::UNIFORM_COLOR:
+        case NodeType::NOISE:
+        case NodeType::DYNAMIC_IMAGE:
+        case NodeType::IMAGE:
+        {
+            if (runs && chain != chains.end())
+            {
+                const Profiler::NodeScope nodeScope( id, node->name + " (fused " + std::to_string( chain->second.size() ) + " nodes)" );
+                std::vector<PointwiseStage> stages( chain->second.size() );
+                for (size_t i = 0; i < stages.size(); ++i)
+                {
+                    graph.node( chain->second[i] )->GetPointwiseStage( stages[i] );
+                }
+                ComputeKernels::Get<FusedPointwiseCompute>()->Run( inputs.front().get(), node->value.get(), stages );
+                results[id] = node->value;
+                node->evaluatedStamp = runStamp( id );
+                m_evaluatedNodes.push_back( id );
+            }
+            else if (runs)
+            {
+                const Profiler::NodeScope nodeScope( id, node->name );
+                node->resolutionScale = 1.0f / static_cast<float>( m_options.resolutionDivisor );
+                node->region = m_options.region;
+                if ( node->region.width == 0 && node->value )
+                {
+                    node->region = { 0, 0, node->value->GetWidth(), node->value->GetHeight(), node->value->GetWidth(), node->value->GetHeight() };
+                }
+                results[id] = node->Evaluate( value_stack );
+                node->evaluatedStamp = runStamp( id );
+                m_evaluatedNodes.push_back( id );
+            }
+            else
+            {
+                results[id] = node->value;
+            }
+
+            const ImageFormat format = outputs.at( id ).format;
+            if (!WritesValue( node->type ) && results[id] &&
+                ( divisor > 1 || results[id]->GetStorage() != storage || results[id]->GetFormat() != format ))
+            {
+                // Source nodes hold their image at full size, as loaded and wherever it was loaded,
+                // everything after them works on a shrunk copy, or one in the format and place the
+                // evaluation works in.
+                results[id] = proxyImages->Get( results[id], divisor, storage, format );
+            }
+            else if (!runs && divisor > 1 && results[id] && node->evaluatedStamp == stamps[id] && readByRunning.count( id ) != 0)
+            {
+                // Kept at full resolution but read by proxied nodes. Its image is rendered into
+                // again by later evaluations, the stamp tells the copies apart.
+                results[id] = proxyImages->Get( results[id], divisor, storage, format, stamps[id] );
+            }
+        }
+        break;
+        default:
+        {
+            // The final output node isn't evaluated, it just passes on whatever is connected to it.
+            if (!value_stack.empty())
+            {
+                results[id] = value_stack.top();
+            }
+        }
+        break;
+        }
+
+        ReleaseInputs( graph, id, index, lastUse, pinned, results );
+    }
+
+    if ( batchCompute )
+    {
+        Application::EndComputeBatch();
+    }
+
+    if ( m_options.imagePool )
+    {
+        m_options.imagePool->Trim();
+    }
+
+    return m_cancelled ? nullptr : results[startNode];
+}
+
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "BlankImageCache.h"
+#include "Graph.h"
+#include "Image.h"
+#include "ProxyImageCache.h"
+#include "TransientImagePool.h"
+
+#include "GraphNodes/Node.h"
+
+namespace Surge
+{
+
+// Walks a graph from the requested node back through everything feeding into it, evaluating
+// producers before their consumers. Only nodes whose parameters or inputs changed since they were
+// last evaluated are run again, the rest hand on their cached value.
+//
+// Before anything runs, the size and format of every node's image is worked out from the sources
+// down. Image nodes have the size of their file, generators the size they are set to, and
+// everything else takes after its first connected input, so images are only as big as what
+// goes into them. Nodes work in 8 bit unless an input is floating point, e.g. an HDR image, and
+// in Options::floatFormat then. Inputs of another format than the node's are converted to it.
+class GraphEvaluator
+{
+public:
+    struct Options
+    {
+        // Record every dispatch into one command buffer that is submitted once at the end,
+        // rather than having each node submit and wait on its own.
+        bool batchCompute = true;
+        // Checked between nodes, once set the evaluation is abandoned and Evaluate returns nullptr.
+        const std::atomic<bool> *cancel = nullptr;
+        // Called before a node that renders into its value is evaluated, so the caller can point
+        // value at the image it should render into.
+        std::function<void( int nodeId, Node *node, uint32_t width, uint32_t height, ImageFormat format )> prepareOutput;
+
+        // When set, outputs are rendered into images from the pool instead, and each node lets go
+        // of its image once the last node reading it has run. Nodes that are never needed at the
+        // same time end up sharing memory, at the cost of having to run again when something
+        // downstream of them changes.
+        TransientImagePool *imagePool = nullptr;
+        // Nodes that keep their image either way, e.g. the ones shown in the UI.
+        std::vector<int> pinnedNodes;
+
+        // Run chains of per-pixel nodes as one generated shader. Only the last node of a chain
+        // keeps an image, the ones before it are handed back like with imagePool.
+        bool fusePointwise = false;
+
+        // Where unconnected input pins get their image from. Without one, each Evaluate makes its own.
+        BlankImageCache *blankImages = nullptr;
+
+        // Evaluate at the full resolution divided by this, for quick previews while a parameter is
+        // being dragged. Only the nodes that have to run are rendered smaller, the images of ones
+        // still up to date at full resolution are kept and shrunk on the way into them, like the
+        // source images. Nodes scale their parameters to match, see Node::resolutionScale. A node
+        // holds either its full resolution or its proxy result, whichever it was last run at.
+        uint32_t resolutionDivisor = 1;
+        // Where the shrunk source images are kept, and with cpuBackend their copies in host memory.
+        // Without one, each Evaluate makes them again.
+        ProxyImageCache *proxyImages = nullptr;
+
+        // Renders only this part of the image, see TiledEvaluator. Source nodes have to hold an
+        // image of the region's size already, nodes without inputs render at it. Left empty, the
+        // whole image is rendered.
+        ImageRegion region;
+
+        // Run every node on the CpuKernels, rendering into images in host memory, rather than on
+        // the GPU. Source images on the GPU are read back first. Chains aren't fused and
+        // prepareOutput isn't called. Always the case without a Vulkan device.
+        bool cpuBackend = false;
+
+        // What nodes with floating point inputs render into, float source images are converted
+        // to it on the way in. Half floats keep HDR values at half the memory and bandwidth,
+        // RGBA32F keeps full precision, blurs included.
+        ImageFormat floatFormat = ImageFormat::RGBA16F;
+    };
+
+    GraphEvaluator() = default;
+    explicit GraphEvaluator( const Options &options );
+
+    std::shared_ptr<Image> Evaluate( const Graph<Node *> &graph, int startNode );
+
+    // Ids of the nodes the last Evaluate actually ran, in the order they ran.
+    const std::vector<int> &GetEvaluatedNodes() const { return m_evaluatedNodes; }
+    // Ids of the nodes the last Evaluate took the image from, see Options::imagePool and
+    // Options::fusePointwise.
+    const std::vector<int> &GetReleasedNodes() const { return m_releasedNodes; }
+    bool WasCancelled() const { return m_cancelled; }
+
+private:
+    // The size and format a node's image is going to have. Zero sized for pins with nothing
+    // connected to them.
+    struct OutputDesc
+    {
+        uint32_t width = 0, height = 0;
+        ImageFormat format = ImageFormat::None;
+    };
+
+    // Where the evaluation's images live, host memory for the CPU backend.
+    ImageStorage GetStorage() const;
+    std::unordered_map<int, OutputDesc> InferOutputs( const Graph<Node *> &graph, const std::vector<int> &postorder ) const;
+    void PrepareOutput( int nodeId, Node *node, const OutputDesc &output ) const;
+    void ReleaseInputs( const Graph<Node *> &graph, int nodeId, size_t index, const std::unordered_map<int, size_t> &lastUse,
+                        const std::unordered_set<int> &pinned, std::unordered_map<int, std::shared_ptr<Image>> &results );
+
+    Options          m_options;
+    std::vector<int> m_evaluatedNodes;
+    std::vector<int> m_releasedNodes;
+    bool             m_cancelled = false;
+};
+
+}
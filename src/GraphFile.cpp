@@ -0,0 +1,353 @@
+#include "GraphFile.h"
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+
+#include "GraphNodes/GraphNodes.h"
+
+namespace Surge
+{
+
+// Written at the start of every file. Files from before there was one start with the node count.
+//  2: Noise and uniform colour nodes have a width and height.
+static constexpr int GraphFileVersion = 2;
+
+// How many input pins a node of this type is saved with.
+static int GetInputCount( const NodeType type )
+{
+    switch ( type )
+    {
+    case NodeType::BLEND:
+        return 2;
+    case NodeType::HSL:
+    case NodeType::LEVELS:
+    case NodeType::CURVES:
+    case NodeType::BLUR:
+    case NodeType::INVERT:
+    case NodeType::OUTPUT:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+
+bool SaveGraphFile( const std::string &filepath, const Graph<Node *> &graph, const std::vector<GraphFileNode> &nodes )
+{
+    std::ofstream outfile( filepath, std::ofstream::binary );
+    if ( !outfile.is_open() )
+    {
+        fprintf( stderr, "Could not open %s for writing\n", filepath.c_str() );
+        return false;
+    }
+
+    outfile << "version " << GraphFileVersion << " ";
+    outfile << nodes.size() << " ";
+    for ( const GraphFileNode &node : nodes )
+    {
+        outfile << static_cast<int>( node.type ) << " ";
+        outfile << node.id << " ";
+        outfile << node.x << " " << node.y << " ";
+        for ( int i = 0; i < GetInputCount( node.type ); ++i )
+        {
+            outfile << node.inputs[i] << " ";
+        }
+
+        const Node *op = graph.node( node.id );
+        switch ( node.type )
+        {
+        case NodeType::BLEND:
+            {
+                auto blendNode = dynamic_cast<const BlendNode *>( op );
+                outfile << static_cast<int>( blendNode->m_mode ) << " ";
+            }
+            break;
+        case NodeType::HSL:
+            {
+                auto hslNode = dynamic_cast<const HSLNode *>( op );
+                outfile << hslNode->m_hue << " " << hslNode->m_lightness << " " << hslNode->m_saturation << " ";
+            }
+            break;
+        case NodeType::LEVELS:
+            {
+                auto levelsNode = dynamic_cast<const LevelsNode *>( op );
+                outfile << levelsNode->m_gamma << " " << levelsNode->m_luminanceOnly << " ";
+                outfile << levelsNode->m_inputRange.x << " " << levelsNode->m_inputRange.y << " ";
+                outfile << levelsNode->m_outputRange.x << " " << levelsNode->m_outputRange.y << " ";
+            }
+            break;
+        case NodeType::BLUR:
+            {
+                auto blurNode = dynamic_cast<const BlurNode *>( op );
+                outfile << static_cast<int>( blurNode->m_blurMode ) << " ";
+                outfile << blurNode->m_angle << " " << blurNode->m_samples << " " << blurNode->m_sigma << " " << blurNode->m_useAlpha << " ";
+                outfile << blurNode->m_center.x << " " << blurNode->m_center.y << " ";
+            }
+            break;
+        case NodeType::INVERT:
+            {
+                auto invertNode = dynamic_cast<const InvertNode *>( op );
+                outfile << invertNode->m_channels << " ";
+            }
+            break;
+        case NodeType::CURVES:
+            {
+                auto curvesNode = dynamic_cast<const CurvesNode *>( op );
+                for ( const float *curve : { curvesNode->m_red, curvesNode->m_green, curvesNode->m_blue } )
+                {
+                    outfile << curve[0] << " " << curve[1] << " " << curve[2] << " " << curve[3] << " " << curve[4] << " ";
+                }
+            }
+            break;
+        case NodeType::UNIFORM_COLOR:
+            {
+                auto uniColNode = dynamic_cast<const UniformColorNode *>( op );
+                outfile << uniColNode->m_color.asPart.red << " " << uniColNode->m_color.asPart.green << " " << uniColNode->m_color.asPart.blue << " " << uniColNode->m_color.asPart.alpha << " ";
+                outfile << uniColNode->m_width << " " << uniColNode->m_height << " ";
+            }
+            break;
+        case NodeType::NOISE:
+            {
+                auto noiseNode = dynamic_cast<const NoiseNode *>( op );
+                outfile << static_cast<int>( noiseNode->m_mode ) << " ";
+                outfile << noiseNode->m_seed << " ";
+                outfile << noiseNode->m_scale << " ";
+                outfile << noiseNode->m_width << " " << noiseNode->m_height << " ";
+            }
+            break;
+        case NodeType::IMAGE:
+            {
+                const std::string fname = dynamic_cast<const ImageNode *>( op )->m_filepath;
+                outfile << fname.size() << " " << fname << " ";
+            }
+            break;
+        case NodeType::DYNAMIC_IMAGE:
+            {
+                auto dynImage = dynamic_cast<const DynamicImageNode *>( op );
+                outfile << dynImage->m_folderPath.size() << " " << dynImage->m_folderPath << " ";
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    const auto edges = graph.edges();
+    outfile << edges.size() << " ";
+    for ( const auto &edge : edges )
+    {
+        outfile << edge.from << " " << edge.to << " ";
+    }
+    return outfile.good();
+}
+
+
+bool LoadGraphFile( const std::string &filepath, Graph<Node *> &graph, std::vector<GraphFileNode> &nodes, const GraphFileOverrides &overrides )
+{
+    std::ifstream infile( filepath, std::ifstream::binary );
+    if ( !infile.is_open() )
+    {
+        fprintf( stderr, "Could not open %s\n", filepath.c_str() );
+        return false;
+    }
+
+    // The paths saved for a node, unless the caller swapped them for another.
+    auto readPath = [&infile, &overrides]( const int fileId ) -> std::string
+    {
+        int strLen;
+        infile >> strLen;
+        std::string path;
+        infile >> path;
+        const auto found = overrides.paths.find( fileId );
+        return found != overrides.paths.end() ? found->second : path;
+    };
+
+    // File ids of every node and input pin, to the ids they were given in graph.
+    std::unordered_map<int, int> fixUpTable;
+
+    int version = 1;
+    int totalNodes = 0;
+    std::string first;
+    infile >> first;
+    if ( first == "version" )
+    {
+        infile >> version >> totalNodes;
+    }
+    else
+    {
+        totalNodes = atoi( first.c_str() );
+    }
+    if ( version > GraphFileVersion )
+    {
+        fprintf( stderr, "%s was saved by a newer version of Surge\n", filepath.c_str() );
+        return false;
+    }
+    for ( int i = 0; i < totalNodes && infile; ++i )
+    {
+        GraphFileNode node;
+        int nodeTypeRaw;
+        infile >> nodeTypeRaw;
+        node.type = static_cast<NodeType>( nodeTypeRaw );
+        infile >> node.fileId;
+        infile >> node.x >> node.y;
+
+        int fileInputs[2] = { -1, -1 };
+        for ( int input = 0; input < GetInputCount( node.type ); ++input )
+        {
+            infile >> fileInputs[input];
+        }
+
+        Node *op = nullptr;
+        switch ( node.type )
+        {
+        case NodeType::BLEND:
+            {
+                BlendNode *blendNode = new BlendNode();
+                int blendModeRaw;
+                infile >> blendModeRaw;
+                blendNode->m_mode = static_cast<BlendCompute::BlendMode>( blendModeRaw );
+                op = blendNode;
+            }
+            break;
+        case NodeType::HSL:
+            {
+                HSLNode *hslNode = new HSLNode();
+                infile >> hslNode->m_hue >> hslNode->m_lightness >> hslNode->m_saturation;
+                op = hslNode;
+            }
+            break;
+        case NodeType::LEVELS:
+            {
+                LevelsNode *levelsNode = new LevelsNode();
+                infile >> levelsNode->m_gamma >> levelsNode->m_luminanceOnly;
+                infile >> levelsNode->m_inputRange.x >> levelsNode->m_inputRange.y;
+                infile >> levelsNode->m_outputRange.x >> levelsNode->m_outputRange.y;
+                op = levelsNode;
+            }
+            break;
+        case NodeType::BLUR:
+            {
+                BlurNode *blurNode = new BlurNode();
+                int blurModeRaw;
+                infile >> blurModeRaw;
+                blurNode->m_blurMode = static_cast<BlurCompute::BlurMode>( blurModeRaw );
+                infile >> blurNode->m_angle >> blurNode->m_samples >> blurNode->m_sigma >> blurNode->m_useAlpha;
+                infile >> blurNode->m_center.x >> blurNode->m_center.y;
+                op = blurNode;
+            }
+            break;
+        case NodeType::INVERT:
+            {
+                InvertNode *invertNode = new InvertNode();
+                infile >> invertNode->m_channels;
+                op = invertNode;
+            }
+            break;
+        case NodeType::CURVES:
+            {
+                CurvesNode *curvesNode = new CurvesNode();
+                for ( float *curve : { curvesNode->m_red, curvesNode->m_green, curvesNode->m_blue } )
+                {
+                    infile >> curve[0] >> curve[1] >> curve[2] >> curve[3] >> curve[4];
+                }
+                op = curvesNode;
+            }
+            break;
+        case NodeType::OUTPUT:
+            {
+                op = new Node( NodeType::OUTPUT );
+            }
+            break;
+        case NodeType::UNIFORM_COLOR:
+            {
+                UniformColorNode *uniColNode = new UniformColorNode();
+                infile >> uniColNode->m_color.asPart.red >> uniColNode->m_color.asPart.green >> uniColNode->m_color.asPart.blue >> uniColNode->m_color.asPart.alpha;
+                if ( version >= 2 )
+                {
+                    infile >> uniColNode->m_width >> uniColNode->m_height;
+                }
+                op = uniColNode;
+            }
+            break;
+        case NodeType::NOISE:
+            {
+                NoiseNode *noiseNode = new NoiseNode();
+                int noiseModeRaw;
+                infile >> noiseModeRaw;
+                noiseNode->m_mode = static_cast<NoiseCompute::NoiseMode>( noiseModeRaw );
+                infile >> noiseNode->m_seed;
+                infile >> noiseNode->m_scale;
+                if ( version >= 2 )
+                {
+                    infile >> noiseNode->m_width >> noiseNode->m_height;
+                }
+                op = noiseNode;
+            }
+            break;
+        case NodeType::IMAGE:
+            {
+                const std::string imgFile = readPath( node.fileId );
+                if ( !std::filesystem::is_regular_file( imgFile ) )
+                {
+                    fprintf( stderr, "%s uses %s, which doesn't exist\n", filepath.c_str(), imgFile.c_str() );
+                    return false;
+                }
+                op = overrides.deferImages ? new ImageNode( nullptr, imgFile ) : new ImageNode( std::make_shared<Image>( imgFile ) );
+            }
+            break;
+        case NodeType::DYNAMIC_IMAGE:
+            {
+                const std::string folderPath = readPath( node.fileId );
+                if ( !std::filesystem::is_directory( folderPath ) )
+                {
+                    fprintf( stderr, "%s uses %s, which isn't a folder\n", filepath.c_str(), folderPath.c_str() );
+                    return false;
+                }
+                op = new DynamicImageNode( folderPath, !overrides.deferImages );
+            }
+            break;
+        case NodeType::TRANSFORM:
+            // Saved without its input or parameters, so there is nothing to restore it from.
+            fprintf( stderr, "Skipping a transform node in %s, they aren't saved yet\n", filepath.c_str() );
+            continue;
+        default:
+            fprintf( stderr, "%s has a node of unknown type %d\n", filepath.c_str(), nodeTypeRaw );
+            return false;
+        }
+
+        for ( int input = 0; input < GetInputCount( node.type ); ++input )
+        {
+            node.inputs[input] = graph.insert_node( new Node( NodeType::VALUE ) );
+            fixUpTable[fileInputs[input]] = node.inputs[input];
+        }
+        node.id = graph.insert_node( op );
+        fixUpTable[node.fileId] = node.id;
+        nodes.push_back( node );
+    }
+
+    int edgeTotal = 0;
+    infile >> edgeTotal;
+    for ( int i = 0; i < edgeTotal && infile; ++i )
+    {
+        int from, to;
+        infile >> from >> to;
+        const auto fromId = fixUpTable.find( from );
+        const auto toId = fixUpTable.find( to );
+        if ( fromId == fixUpTable.end() || toId == fixUpTable.end() )
+        {
+            fprintf( stderr, "%s links %d to %d, which aren't both in it\n", filepath.c_str(), from, to );
+            continue;
+        }
+        graph.insert_edge( fromId->second, toId->second );
+    }
+
+    if ( !infile )
+    {
+        fprintf( stderr, "%s ended before all of the graph was read\n", filepath.c_str() );
+        return false;
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Graph.h"
+
+#include "GraphNodes/Node.h"
+
+namespace Surge
+{
+
+// A node of a .surge file, as written by SaveGraphFile and read back by LoadGraphFile.
+struct GraphFileNode
+{
+    NodeType type;
+    // The id of the node in the graph it was saved from or loaded into.
+    int id = -1;
+    // The id it had in the file, which is what LoadGraphFile's overrides refer to.
+    int fileId = -1;
+    // The VALUE nodes standing in for its input pins, lhs then rhs for a blend. -1 where it has none.
+    int inputs[2] = { -1, -1 };
+    // Where it sits on the canvas.
+    float x = 0.0f, y = 0.0f;
+};
+
+// Changes made to a graph as it is loaded, keyed by the id a node has in the file.
+struct GraphFileOverrides
+{
+    // Files or folders read by IMAGE and DYNAMIC_IMAGE nodes instead of the saved ones.
+    std::unordered_map<int, std::string> paths;
+    // Leaves the images of IMAGE and DYNAMIC_IMAGE nodes on disk rather than uploading them, for
+    // callers that read them in parts, see TiledEvaluator. The nodes only know their paths.
+    bool deferImages = false;
+};
+
+// Writes the nodes listed, with their parameters taken from graph, and every edge of graph.
+bool SaveGraphFile( const std::string &filepath, const Graph<Node *> &graph, const std::vector<GraphFileNode> &nodes );
+
+// Adds the nodes and edges of a file to graph, appending the nodes it created to nodes. Nothing
+// here touches the UI, so graphs can be loaded without a window, see SurgeCli.
+bool LoadGraphFile( const std::string &filepath, Graph<Node *> &graph, std::vector<GraphFileNode> &nodes,
+                    const GraphFileOverrides &overrides = GraphFileOverrides() );
+
+}
@@ -2,6 +2,8 @@
 
 #include "imgui.h"
 #include "../imnodes.h"
+#include "../Compute/ComputeKernels.h"
+#include "../Compute/CpuKernels.h"
 
 namespace Surge
 {
@@ -11,14 +13,8 @@ namespace Surge
         name = "Blend";
         if ( !blendCompute )
         {
-            blendCompute = new BlendCompute();
+            blendCompute = ComputeKernels::Get<BlendCompute>();
         }
-        value = std::make_shared<Image>( 2048, 2048, ImageFormat::RGBA );
-        constexpr auto bufSize = static_cast<size_t>( 2048 * 2048 * 4 );
-        auto *data = new char[bufSize];
-        memset( data, 255,  bufSize);
-        value->SetData( data );
-        delete[] data;
     }
 
     std::shared_ptr<Image> BlendNode::Evaluate(std::stack<std::shared_ptr<Image>> &value_stack)
@@ -27,7 +23,14 @@ namespace Surge
         value_stack.pop();
         const std::shared_ptr<Image> lhs = value_stack.top();
         value_stack.pop();
-        blendCompute->Run( lhs.get(), rhs.get(), value.get(), { m_mode, 0 } );
+        if ( value->IsHost() )
+        {
+            CpuKernels::Blend( lhs.get(), rhs.get(), value.get(), { m_mode, 0 } );
+        }
+        else
+        {
+            blendCompute->Run( lhs.get(), rhs.get(), value.get(), { m_mode, 0 } );
+        }
         return value;
     }
 
@@ -78,7 +81,7 @@ namespace Surge
             ImNodes::EndOutputAttribute();
         }
                 
-        ImGui::Image( node->value->GetDescriptorSet(), ImVec2( node_width,node_width ), ImVec2(0, 0), ImVec2(1,1), ImVec4(1,1,1,1), ImVec4(0.6f,0.6f,0.6f,1) );
+        RenderPreview( node->value, node_width );
                 
         ImNodes::EndNode();
     }
@@ -11,6 +11,7 @@ struct BlendNode : Node
     BlendNode();
 
     std::shared_ptr<Image> Evaluate(std::stack<std::shared_ptr<Image>> &value_stack) override;
+    Node *Clone() const override { return new BlendNode( *this ); }
 
     bool RenderProperties() override;
 
@@ -1,6 +1,8 @@
 ﻿#include "BlurNode.h"
 
 #include "../imnodes.h"
+#include "../Compute/ComputeKernels.h"
+#include "../Compute/CpuKernels.h"
 
 namespace Surge
 {
@@ -10,21 +12,47 @@ BlurNode::BlurNode() : Node( NodeType::BLUR )
     name = "Blur";
     if ( !blurCompute )
     {
-        blurCompute = new BlurCompute();
+        blurCompute = ComputeKernels::Get<BlurCompute>();
     }
-    value = std::make_shared<Image>( 2048, 2048, ImageFormat::RGBA );
-    constexpr auto bufSize = static_cast<size_t>( 2048 * 2048 * 4 );
-    auto *data = new char[bufSize];
-    memset( data, 255,  bufSize);
-    value->SetData( data );
-    delete[] data;
 }
 
 std::shared_ptr<Image> BlurNode::Evaluate(std::stack<std::shared_ptr<Image>> &value_stack)
 {
     const std::shared_ptr<Image> input = value_stack.top();
     value_stack.pop();
-    blurCompute->Run( input.get(), value.get(), { m_center, DegreesToRadians( m_angle ), m_sigma, m_samples, m_useAlpha, m_blurMode } );
+    // Strength and center are in pixels of the full size image.
+    const float sigma = m_sigma * resolutionScale;
+    const bool host = value->IsHost();
+    if (m_blurMode == BlurCompute::BlurMode::GAUSSIAN)
+    {
+        if (sigma > BlurCompute::RecursiveGaussianSigma && host)
+        {
+            CpuKernels::RecursiveGaussian( input.get(), value.get(), sigma );
+        }
+        else if (sigma > BlurCompute::RecursiveGaussianSigma)
+        {
+            blurCompute->RunRecursiveGaussian( input.get(), value.get(), sigma );
+        }
+        else if (host)
+        {
+            CpuKernels::Gaussian( input.get(), value.get(), sigma );
+        }
+        else
+        {
+            blurCompute->RunGaussian( input.get(), value.get(), sigma );
+        }
+        return value;
+    }
+    const ImVec2 center = ImVec2( m_center.x * resolutionScale - region.x, m_center.y * resolutionScale - region.y );
+    const BlurCompute::PushParams params = { center, DegreesToRadians( m_angle ), sigma, m_samples, m_useAlpha, m_blurMode };
+    if (host)
+    {
+        CpuKernels::Blur( input.get(), value.get(), params );
+    }
+    else
+    {
+        blurCompute->Run( input.get(), value.get(), params );
+    }
     return value;
 }
 
@@ -42,17 +70,14 @@ bool BlurNode::RenderProperties()
     m_blurMode = static_cast<BlurCompute::BlurMode>( item );
             
     changed |= ImGui::DragFloat( "Strength", &m_sigma, 0.1f, 0.2f, 100.0f );
-    if (m_blurMode == BlurCompute::BlurMode::GAUSSIAN)
-    {
-        changed |= ImGui::DragFloat( "Samples", &m_samples, 1.f, 1.f, 100.0f );
-    }
-    else
+    if (m_blurMode != BlurCompute::BlurMode::GAUSSIAN)
     {
         changed |= ImGui::DragFloat( "Angle", &m_angle, 0.1f, 0, 180 );
     }
     if (m_blurMode == BlurCompute::BlurMode::RADIAL)
     {
-        changed |= ImGui::DragFloat2( "Center", &m_center.x, 1.f, 0, static_cast<float>( value->GetWidth() ) );
+        changed |= ImGui::DragFloat( "Samples", &m_samples, 1.f, 1.f, 100.0f );
+        changed |= ImGui::DragFloat2( "Center", &m_center.x, 1.f, 0, static_cast<float>( value ? value->GetWidth() / resolutionScale : DefaultImageSize ) );
     }
             
     changed |= ImGui::Checkbox( "Use Alpha", &useAlpha);
@@ -88,7 +113,7 @@ void UiBlurNode::RenderNode( Node* node ) const
         ImGui::TextUnformatted("output");
         ImNodes::EndInputAttribute();
     }
-    ImGui::Image( node->value->GetDescriptorSet(), ImVec2( node_width,node_width ), ImVec2(0, 0), ImVec2(1,1), ImVec4(1,1,1,1), ImVec4(0.6f,0.6f,0.6f,1) );
+    RenderPreview( node->value, node_width );
         
     ImNodes::EndNode();
 }
@@ -18,6 +18,7 @@ struct BlurNode : Node
     BlurNode();
     
     std::shared_ptr<Image> Evaluate(std::stack<std::shared_ptr<Image>> &value_stack) override;
+    Node *Clone() const override { return new BlurNode( *this ); }
 
     bool RenderProperties() override;
 
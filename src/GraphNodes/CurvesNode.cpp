@@ -2,7 +2,10 @@
 
 #include "imgui.h"
 #include "../imnodes.h"
+#include "../Compute/FusedPointwiseCompute.h"
 #include "../ImWidgets/ImBezier.h"
+#include "../Compute/ComputeKernels.h"
+#include "../Compute/CpuKernels.h"
 
 namespace Surge
 {
@@ -12,28 +15,38 @@ namespace Surge
         name = "Curves";
         if ( !curvesCompute )
         {
-            curvesCompute = new CurvesCompute();
+            curvesCompute = ComputeKernels::Get<CurvesCompute>();
         }
-        value = std::make_shared<Image>( 2048, 2048, ImageFormat::RGBA );
-        constexpr auto bufSize = static_cast<size_t>( 2048 * 2048 * 4 );
-        auto *data = new char[bufSize];
-        memset( data, 255,  bufSize);
-        value->SetData( data );
-        delete[] data;
 
-        m_curvesLUTImage = std::make_shared<Image>( 255, 1, ImageFormat::RGBA );
-        UpdateLUT();
+        UpdateLUT( ImageStorage::Device );
     }
 
     std::shared_ptr<Image> CurvesNode::Evaluate(std::stack<std::shared_ptr<Image>> &value_stack)
     {
         const std::shared_ptr<Image> input = value_stack.top();
         value_stack.pop();
-        UpdateLUT();
-        curvesCompute->Run( input.get(), m_curvesLUTImage.get(), value.get(), { static_cast<int>( m_curvesLUTImage->GetWidth() ) } );
+        UpdateLUT( value->GetStorage() );
+        if ( value->IsHost() )
+        {
+            CpuKernels::Curves( input.get(), m_curvesLUTImage.get(), value.get(), { static_cast<int>( m_curvesLUTImage->GetWidth() ) } );
+        }
+        else
+        {
+            curvesCompute->Run( input.get(), m_curvesLUTImage.get(), value.get(), { static_cast<int>( m_curvesLUTImage->GetWidth() ) } );
+        }
         return value;
     }
 
+    bool CurvesNode::GetPointwiseStage( PointwiseStage &stage ) const
+    {
+        // Fused chains never call Evaluate, and only run on the GPU.
+        UpdateLUT( ImageStorage::Device );
+        stage.kernel = PointwiseKernel::CURVES;
+        stage.params = { static_cast<float>( m_curvesLUTImage->GetWidth() ) };
+        stage.lut = m_curvesLUTImage.get();
+        return true;
+    }
+
     bool CurvesNode::RenderProperties()
     {
         ImGui::Text( name.c_str() );
@@ -45,8 +58,23 @@ namespace Surge
         return changed;
     }
 
-    void CurvesNode::UpdateLUT()
+    void CurvesNode::UpdateLUT( const ImageStorage storage ) const
     {
+        const float *curves[4] = { m_red, m_green, m_blue, m_alpha };
+        bool changed = false;
+        for ( int c = 0; c < 4; ++c )
+        {
+            changed |= memcmp( m_lutCurves[c], curves[c], sizeof( m_lutCurves[c] ) ) != 0;
+            memcpy( m_lutCurves[c], curves[c], sizeof( m_lutCurves[c] ) );
+        }
+        if ( !changed && m_curvesLUTImage && m_curvesLUTImage->GetStorage() == storage )
+        {
+            return;
+        }
+        // Made again rather than written to, clones share the image with the node they came from
+        // and may be reading it on another thread.
+        m_curvesLUTImage = std::make_shared<Image>( 255, 1, ImageFormat::RGBA, nullptr, storage );
+
         constexpr auto bufSize = static_cast<size_t>( 255 * 1 * 4 );
         auto *data = new char[bufSize];
         char channel[4];
@@ -55,16 +83,16 @@ namespace Surge
         {
             const float val = static_cast<float>( i/4 ) / 255.f;
 
-            const float redCurveVal = ImGui::BezierValue( val, m_red );
+            const float redCurveVal = ImGui::BezierValue( val, m_lutCurves[0] );
             const int redValue = static_cast<int>( redCurveVal*255 );
 
-            const float greenCurveVal = ImGui::BezierValue( val, m_green );
+            const float greenCurveVal = ImGui::BezierValue( val, m_lutCurves[1] );
             const int greenValue = static_cast<int>( greenCurveVal*255 );
 
-            const float blueCurveVal = ImGui::BezierValue( val, m_blue );
+            const float blueCurveVal = ImGui::BezierValue( val, m_lutCurves[2] );
             const int blueValue = static_cast<int>( blueCurveVal*255 );
 
-            const float alphaCurveVal = ImGui::BezierValue( val, m_alpha );
+            const float alphaCurveVal = ImGui::BezierValue( val, m_lutCurves[3] );
             const int alphaValue = static_cast<int>( alphaCurveVal*255 );
             
             channel[0] = static_cast<char>( redValue );
@@ -104,7 +132,7 @@ namespace Surge
             ImGui::TextUnformatted("output");
             ImNodes::EndInputAttribute();
         }
-        ImGui::Image( node->value->GetDescriptorSet(), ImVec2( node_width,node_width ), ImVec2(0, 0), ImVec2(1,1), ImVec4(1,1,1,1), ImVec4(0.6f,0.6f,0.6f,1) );
+        RenderPreview( node->value, node_width );
         
         ImNodes::EndNode();
     }
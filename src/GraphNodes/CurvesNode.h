@@ -7,7 +7,8 @@ namespace Surge
 {
 struct CurvesNode : Node
 {
-    std::shared_ptr<Image> m_curvesLUTImage = nullptr;
+    // Rebuilt from the curves by UpdateLUT, which also runs while the node hands out its pointwise stage.
+    mutable std::shared_ptr<Image> m_curvesLUTImage = nullptr;
 
     float m_red[5] = { 0.25f, 0.25f, 0.75f, 0.75f };
     float m_green[5] = { 0.25f, 0.25f, 0.75f, 0.75f };
@@ -17,13 +18,21 @@ struct CurvesNode : Node
     CurvesNode();
     
     std::shared_ptr<Image> Evaluate(std::stack<std::shared_ptr<Image>> &value_stack) override;
+    Node *Clone() const override { return new CurvesNode( *this ); }
+    bool GetPointwiseStage( PointwiseStage &stage ) const override;
 
     bool RenderProperties() override;
 
-    void UpdateLUT();
+    // Rebuilds the LUT if the curves changed since it was last built, wherever they were changed
+    // from, e.g. RenderProperties, a loaded file or SurgeCli's --set. The LUT is read by the same
+    // kernels as the image, so it is moved to storage as well.
+    void UpdateLUT( ImageStorage storage ) const;
 
 private:
     inline static CurvesCompute *curvesCompute = nullptr;
+
+    // The curves the LUT was last built from.
+    mutable float m_lutCurves[4][5] = {};
 };
 
 struct UiCurvesNode : UiNode
@@ -9,7 +9,7 @@
 namespace Surge
 {
 
-DynamicImageNode::DynamicImageNode( const std::string &path ) : Node( NodeType::DYNAMIC_IMAGE )
+DynamicImageNode::DynamicImageNode( const std::string &path, const bool loadImage ) : Node( NodeType::DYNAMIC_IMAGE )
 {
     name = "Dynamic Image";
     if ( path.empty() )
@@ -18,7 +18,7 @@ DynamicImageNode::DynamicImageNode( const std::string &path ) : Node( NodeType::
     }
     else
     {
-        BuildPathList( path );
+        BuildPathList( path, loadImage );
     }
 }
 
@@ -42,7 +42,7 @@ void DynamicImageNode::RequestRoot()
     }
 }
 
-void DynamicImageNode::BuildPathList( const std::string &root )
+void DynamicImageNode::BuildPathList( const std::string &root, const bool loadImage )
 {
     m_folderPath = root;
 
@@ -68,9 +68,10 @@ void DynamicImageNode::BuildPathList( const std::string &root )
             // unknown
         }
     }
-    if ( m_filePaths.size() <= 0)
+    MarkDirty();
+    if ( m_filePaths.size() <= 0 || !loadImage )
     {
-        value = std::make_shared<Image>( 2048, 2048, ImageFormat::RGBA );
+        value = nullptr;
         return;
     }
     value = std::make_shared<Image>( m_filePaths[m_currentImage] );
@@ -86,6 +87,7 @@ bool DynamicImageNode::NextImage()
         hitEnd = true;
     }
     value = std::make_shared<Image>( m_filePaths[m_currentImage] );
+    MarkDirty();
         
     return hitEnd;
 }
@@ -102,6 +104,7 @@ bool DynamicImageNode::RenderProperties()
     bool changed = false;
     if ( ImGui::Button( "Open" ))
     {
+        changed |= true;
         RequestRoot();
     }
     ImGui::SameLine();
@@ -138,7 +141,7 @@ void UiDynamicImageNode::RenderNode( Node* node ) const
     
     const DynamicImageNode *dynImage = static_cast<DynamicImageNode*>( node );
     ImGui::TextDisabled( dynImage->m_folderPath.c_str() );
-    ImGui::Image( dynImage->value->GetDescriptorSet(), ImVec2( node_width,node_width ), ImVec2(0, 0), ImVec2(1,1), ImVec4(1,1,1,1), ImVec4(0.6f,0.6f,0.6f,1) );
+    RenderPreview( dynImage->value, node_width );
         
     ImNodes::EndNode();
 }
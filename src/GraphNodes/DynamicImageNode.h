@@ -13,7 +13,8 @@ struct DynamicImageNode : Node
     uint32_t m_currentImage = 0;
     std::vector<std::string> m_filePaths;
     
-    DynamicImageNode( const std::string &path );
+    // Without loadImage only the list of files is built, value is left for the caller to fill.
+    DynamicImageNode( const std::string &path, bool loadImage = true );
 
     const std::vector<std::string> Extensions = { ".png", ".jpg", ".tga" };
 
@@ -31,11 +32,12 @@ struct DynamicImageNode : Node
 
     void RequestRoot();
     
-    void BuildPathList( const std::string &root );
+    void BuildPathList( const std::string &root, bool loadImage = true );
     
     bool NextImage();
     
     std::shared_ptr<Image> Evaluate( std::stack<std::shared_ptr<Image>> &value_stack ) override;
+    Node *Clone() const override { return new DynamicImageNode( *this ); }
 
     bool RenderProperties() override;
 };
@@ -2,6 +2,9 @@
 
 #include "imgui.h"
 #include "../imnodes.h"
+#include "../Compute/FusedPointwiseCompute.h"
+#include "../Compute/ComputeKernels.h"
+#include "../Compute/CpuKernels.h"
 
 namespace Surge
 {
@@ -11,24 +14,32 @@ namespace Surge
         name = "HSL";
         if ( !hslCompute )
         {
-            hslCompute = new HSLCompute();
+            hslCompute = ComputeKernels::Get<HSLCompute>();
         }
-        value = std::make_shared<Image>( 2048, 2048, ImageFormat::RGBA );
-        constexpr auto bufSize = static_cast<size_t>( 2048 * 2048 * 4 );
-        auto *data = new char[bufSize];
-        memset( data, 255,  bufSize);
-        value->SetData( data );
-        delete[] data;
     }
 
     std::shared_ptr<Image> HSLNode::Evaluate(std::stack<std::shared_ptr<Image>> &value_stack)
     {
         const std::shared_ptr<Image> input = value_stack.top();
         value_stack.pop();
-        hslCompute->Run( input.get(), value.get(), { m_hue, m_saturation, m_lightness } );
+        if ( value->IsHost() )
+        {
+            CpuKernels::HSL( input.get(), value.get(), { m_hue, m_saturation, m_lightness } );
+        }
+        else
+        {
+            hslCompute->Run( input.get(), value.get(), { m_hue, m_saturation, m_lightness } );
+        }
         return value;
     }
 
+    bool HSLNode::GetPointwiseStage( PointwiseStage &stage ) const
+    {
+        stage.kernel = PointwiseKernel::HSL;
+        stage.params = { m_hue, m_saturation, m_lightness };
+        return true;
+    }
+
     bool HSLNode::RenderProperties()
     {
         ImGui::Text( name.c_str() );
@@ -67,7 +78,7 @@ namespace Surge
             ImGui::TextUnformatted("output");
             ImNodes::EndInputAttribute();
         }
-        ImGui::Image( node->value->GetDescriptorSet(), ImVec2( node_width,node_width ), ImVec2(0, 0), ImVec2(1,1), ImVec4(1,1,1,1), ImVec4(0.6f,0.6f,0.6f,1) );
+        RenderPreview( node->value, node_width );
         
         ImNodes::EndNode();
     }
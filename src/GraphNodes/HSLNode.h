@@ -14,6 +14,8 @@ struct HSLNode : Node
     HSLNode();
 
     std::shared_ptr<Image> Evaluate(std::stack<std::shared_ptr<Image>> &value_stack) override;
+    Node *Clone() const override { return new HSLNode( *this ); }
+    bool GetPointwiseStage( PointwiseStage &stage ) const override;
 
     bool RenderProperties() override;
 
@@ -5,10 +5,11 @@
 namespace Surge
 {
 
-ImageNode::ImageNode(const std::shared_ptr<Image> &image) : Node( NodeType::IMAGE )
+ImageNode::ImageNode(const std::shared_ptr<Image> &image, const std::string &filepath) : Node( NodeType::IMAGE )
 {
     name = "Image";
     value = image;
+    m_filepath = image ? image->GetFilename() : filepath;
 }
 
 std::shared_ptr<Image> ImageNode::Evaluate(std::stack<std::shared_ptr<Image>> &value_stack)
@@ -37,7 +38,7 @@ void UiImageNode::RenderNode( Node* node ) const
         ImGui::TextUnformatted("output");
         ImNodes::EndInputAttribute();
     }
-    ImGui::Image( node->value->GetDescriptorSet(), ImVec2( node_width,node_width ), ImVec2(0, 0), ImVec2(1,1), ImVec4(1,1,1,1), ImVec4(0.6f,0.6f,0.6f,1) );
+    RenderPreview( node->value, node_width );
             
     ImNodes::EndNode();
 }
@@ -6,10 +6,15 @@ namespace Surge
 {
 struct ImageNode : Node
 {
-    ImageNode(const std::shared_ptr<Image> &image);
+    // The file the image came from. Taken from image when it has one, image can be left empty
+    // for nodes that are only read from disk as they are needed, see TiledEvaluator.
+    std::string m_filepath;
+
+    ImageNode(const std::shared_ptr<Image> &image, const std::string &filepath = std::string());
     
 
     std::shared_ptr<Image> Evaluate(std::stack<std::shared_ptr<Image>> &value_stack) override;
+    Node *Clone() const override { return new ImageNode( *this ); }
 };
 
 struct UiImageNode : UiNode
@@ -12,6 +12,8 @@ struct InvertNode : Node
     InvertNode();
 
     std::shared_ptr<Image> Evaluate(std::stack<std::shared_ptr<Image>> &value_stack) override;
+    Node *Clone() const override { return new InvertNode( *this ); }
+    bool GetPointwiseStage( PointwiseStage &stage ) const override;
 
     bool RenderProperties() override;
 
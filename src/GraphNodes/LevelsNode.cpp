@@ -2,6 +2,9 @@
 
 #include "imgui.h"
 #include "../imnodes.h"
+#include "../Compute/FusedPointwiseCompute.h"
+#include "../Compute/ComputeKernels.h"
+#include "../Compute/CpuKernels.h"
 
 namespace Surge
 {
@@ -11,24 +14,32 @@ namespace Surge
         name = "Levels";
         if ( !levelsCompute )
         {
-            levelsCompute = new LevelsCompute();
+            levelsCompute = ComputeKernels::Get<LevelsCompute>();
         }
-        value = std::make_shared<Image>( 2048, 2048, ImageFormat::RGBA );
-        constexpr auto bufSize = static_cast<size_t>( 2048 * 2048 * 4 );
-        auto *data = new char[bufSize];
-        memset( data, 255,  bufSize);
-        value->SetData( data );
-        delete[] data;
     }
 
     std::shared_ptr<Image> LevelsNode::Evaluate(std::stack<std::shared_ptr<Image>> &value_stack)
     {
         const std::shared_ptr<Image> input = value_stack.top();
         value_stack.pop();
-        levelsCompute->Run( input.get(), value.get(), { m_inputRange, m_outputRange, m_gamma, m_luminanceOnly } );
+        if ( value->IsHost() )
+        {
+            CpuKernels::Levels( input.get(), value.get(), { m_inputRange, m_outputRange, m_gamma, m_luminanceOnly } );
+        }
+        else
+        {
+            levelsCompute->Run( input.get(), value.get(), { m_inputRange, m_outputRange, m_gamma, m_luminanceOnly } );
+        }
         return value;
     }
 
+    bool LevelsNode::GetPointwiseStage( PointwiseStage &stage ) const
+    {
+        stage.kernel = PointwiseKernel::LEVELS;
+        stage.params = { m_inputRange.x, m_inputRange.y, m_outputRange.x, m_outputRange.y, m_gamma, m_luminanceOnly };
+        return true;
+    }
+
     bool LevelsNode::RenderProperties()
     {
         ImGui::Text( name.c_str() );
@@ -71,7 +82,7 @@ namespace Surge
             ImGui::TextUnformatted("output");
             ImNodes::EndInputAttribute();
         }
-        ImGui::Image( node->value->GetDescriptorSet(), ImVec2( node_width,node_width ), ImVec2(0, 0), ImVec2(1,1), ImVec4(1,1,1,1), ImVec4(0.6f,0.6f,0.6f,1) );
+        RenderPreview( node->value, node_width );
         
         ImNodes::EndNode();
     }
@@ -15,6 +15,8 @@ struct LevelsNode : Node
     LevelsNode();
 
     std::shared_ptr<Image> Evaluate(std::stack<std::shared_ptr<Image>> &value_stack) override;
+    Node *Clone() const override { return new LevelsNode( *this ); }
+    bool GetPointwiseStage( PointwiseStage &stage ) const override;
 
     bool RenderProperties() override;
 
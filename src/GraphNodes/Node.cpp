@@ -8,7 +8,6 @@ namespace Surge
 
 Node::Node(const NodeType t): type(t)
 {
-    value = std::make_shared<Image>( 2048, 2048, ImageFormat::RGBA );
 }
 
 Node::Node(const NodeType t, const std::shared_ptr<Image> &val) : type(t)
@@ -29,6 +28,21 @@ bool Node::RenderProperties()
     return false;
 }
 
+void RenderPreview( const std::shared_ptr<Image> &image, const float width )
+{
+    const ImVec2 size( width, width );
+    if ( image )
+    {
+        ImGui::Image( image->GetDescriptorSet(), size, ImVec2(0, 0), ImVec2(1,1), ImVec4(1,1,1,1), ImVec4(0.6f,0.6f,0.6f,1) );
+        return;
+    }
+
+    // Not evaluated yet, or the image went back to the transient pool once nothing needed it.
+    const ImVec2 min = ImGui::GetCursorScreenPos();
+    ImGui::GetWindowDrawList()->AddRect( min, ImVec2( min.x + size.x, min.y + size.y ), ImGui::GetColorU32( ImVec4(0.6f,0.6f,0.6f,1) ) );
+    ImGui::Dummy( size );
+}
+
 // Utils for pushing and popping node styles
 InputHeaderStyleJanitor::InputHeaderStyleJanitor()
 {
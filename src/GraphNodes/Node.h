@@ -1,5 +1,6 @@
 ﻿#pragma once
 
+#include <cstdint>
 #include <memory>
 #include <stack>
 #include <string>
@@ -8,6 +9,22 @@
 
 namespace Surge
 {
+
+struct PointwiseStage;
+
+// What a node renders at when nothing says otherwise, e.g. a generator just put down, or a node
+// with none of its inputs connected.
+constexpr uint32_t DefaultImageSize = 2048;
+
+// The part of the image being rendered that a node's value covers. Only tiled evaluation renders
+// less than the whole image, see TiledEvaluator.
+struct ImageRegion
+{
+    int32_t x = 0, y = 0;
+    uint32_t width = 0, height = 0;
+    // The size of the whole image the region is part of.
+    uint32_t fullWidth = 0, fullHeight = 0;
+};
     
 enum class NodeType
 {
@@ -32,14 +49,59 @@ struct Node
     NodeType type;
     std::shared_ptr<Image> value;
 
+    // Bumped whenever something that affects the output of this node changes, e.g. a parameter in
+    // RenderProperties. GraphEvaluator only re-runs nodes whose inputs or version changed.
+    uint32_t version = 0;
+    // The stamp of this node and its inputs from the evaluation that last produced value.
+    uint64_t evaluatedStamp = 0;
+    // The resolution value was rendered at, relative to the full size image. Below 1 for a proxy
+    // evaluation, see GraphEvaluator::Options::resolutionDivisor, in which case parameters measured
+    // in pixels have to be multiplied by it.
+    float resolutionScale = 1.0f;
+    // Where value sits in the image being rendered, set before Evaluate like resolutionScale. Nodes
+    // whose output depends on the pixel position, e.g. noise, have to offset by it.
+    ImageRegion region;
+
     explicit Node(const NodeType t);
     Node(const NodeType t, const std::shared_ptr<Image> &val);
     virtual ~Node() = default;
 
     virtual std::shared_ptr<Image> Evaluate(std::stack<std::shared_ptr<Image>> &value_stack);
     virtual bool RenderProperties();
+    // A copy of the node and its parameters that can be evaluated away from the UI thread. The copy
+    // shares value, and any other images, with the original.
+    virtual Node *Clone() const { return new Node( *this ); }
+    // Nodes without inputs that render an image of their own, e.g. noise, say how big it is here.
+    // Everything else takes the size of its first connected input, see GraphEvaluator.
+    virtual bool GetGeneratedSize( uint32_t &width, uint32_t &height ) const { return false; }
+    // Per-pixel nodes describe their kernel here, so that GraphEvaluator can run a chain of them as
+    // one shader, see FusedPointwiseCompute. Returns false for nodes that can't be fused.
+    virtual bool GetPointwiseStage( PointwiseStage &stage ) const { return false; }
+
+    void MarkDirty() { ++version; }
 };
 
+// True for nodes that render into their own value when evaluated, rather than passing on an image
+// they were given.
+inline bool WritesValue( const NodeType type )
+{
+    switch ( type )
+    {
+    case NodeType::BLEND:
+    case NodeType::HSL:
+    case NodeType::LEVELS:
+    case NodeType::CURVES:
+    case NodeType::BLUR:
+    case NodeType::INVERT:
+    case NodeType::TRANSFORM:
+    case NodeType::UNIFORM_COLOR:
+    case NodeType::NOISE:
+        return true;
+    default:
+        return false;
+    }
+}
+
 struct UiNode
 {
     NodeType type;
@@ -67,6 +129,9 @@ protected:
     virtual ~UiNode() = default;
 };
 
+// Draws a node's image at the given width, or an empty frame while it has none.
+void RenderPreview( const std::shared_ptr<Image> &image, float width );
+
 struct InputHeaderStyleJanitor
 {
     InputHeaderStyleJanitor();
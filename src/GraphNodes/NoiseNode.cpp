@@ -1,7 +1,11 @@
 ﻿#include "NoiseNode.h"
 
+#include <algorithm>
+
 #include "imgui.h"
 #include "../imnodes.h"
+#include "../Compute/ComputeKernels.h"
+#include "../Compute/CpuKernels.h"
 
 namespace Surge
 {
@@ -11,22 +15,31 @@ NoiseNode::NoiseNode() : Node( NodeType::NOISE )
     name = "Noise";
     if ( !noiseCompute )
     {
-        noiseCompute = new NoiseCompute();
+        noiseCompute = ComputeKernels::Get<NoiseCompute>();
     }
-    value = std::make_shared<Image>( 2048, 2048, ImageFormat::RGBA );
-    constexpr auto bufSize = static_cast<size_t>( 2048 * 2048 * 4 );
-    auto *data = new char[bufSize];
-    memset( data, 255,  bufSize);
-    value->SetData( data );
-    delete[] data;
 }
 
 std::shared_ptr<Image> NoiseNode::Evaluate(std::stack<std::shared_ptr<Image>> &value_stack)
 {
-    noiseCompute->Run( value.get(), { m_mode, value->GetWidth(), value->GetHeight(), m_seed, m_scale } );
+    const NoiseCompute::PushParams params = { m_mode, region.fullWidth, region.fullHeight, m_seed, m_scale, region.x, region.y };
+    if ( value->IsHost() )
+    {
+        CpuKernels::Noise( value.get(), params );
+    }
+    else
+    {
+        noiseCompute->Run( value.get(), params );
+    }
     return value;
 }
 
+bool NoiseNode::GetGeneratedSize( uint32_t &width, uint32_t &height ) const
+{
+    width = static_cast<uint32_t>( std::max( m_width, 1 ) );
+    height = static_cast<uint32_t>( std::max( m_height, 1 ) );
+    return true;
+}
+
 bool NoiseNode::RenderProperties()
 {
     ImGui::Text( name.c_str() );
@@ -42,6 +55,8 @@ bool NoiseNode::RenderProperties()
 
     changed |= ImGui::DragInt( "Seed", &m_seed, 1, 0, UINTMAX_MAX );
     changed |= ImGui::DragFloat( "Scale", &m_scale, 0.1f, -256.f, 256.f );
+    changed |= ImGui::DragInt( "Width", &m_width, 1, 1, 16384 );
+    changed |= ImGui::DragInt( "Height", &m_height, 1, 1, 16384 );
 
     return changed;
 }
@@ -67,7 +82,7 @@ void UiNoiseNode::RenderNode( Node* node ) const
         ImGui::TextUnformatted("output");
         ImNodes::EndInputAttribute();
     }
-    ImGui::Image( node->value->GetDescriptorSet(), ImVec2( node_width,node_width ), ImVec2(0, 0), ImVec2(1,1), ImVec4(1,1,1,1), ImVec4(0.6f,0.6f,0.6f,1) );
+    RenderPreview( node->value, node_width );
         
     ImNodes::EndNode();
 }
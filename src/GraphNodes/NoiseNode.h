@@ -10,10 +10,14 @@ struct NoiseNode : Node
     NoiseCompute::NoiseMode m_mode = NoiseCompute::NoiseMode::RAW;
     int m_seed = 0;
     float m_scale = 1;
+    int m_width = DefaultImageSize;
+    int m_height = DefaultImageSize;
 
     NoiseNode();
 
     std::shared_ptr<Image> Evaluate(std::stack<std::shared_ptr<Image>> &value_stack) override;
+    Node *Clone() const override { return new NoiseNode( *this ); }
+    bool GetGeneratedSize( uint32_t &width, uint32_t &height ) const override;
 
     bool RenderProperties() override;
 
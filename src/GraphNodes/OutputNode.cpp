@@ -9,12 +9,6 @@ namespace Surge
     OutputNode::OutputNode() : Node( NodeType::OUTPUT )
     {
         name = "Output";
-        value = std::make_shared<Image>( 2048, 2048, ImageFormat::RGBA );
-        constexpr auto bufSize = static_cast<size_t>( 2048 * 2048 * 4 );
-        auto *data = new char[bufSize];
-        memset( data, 255,  bufSize);
-        value->SetData( data );
-        delete[] data;
     }
 
     std::shared_ptr<Image> OutputNode::Evaluate(std::stack<std::shared_ptr<Image>> &value_stack)
@@ -41,7 +35,7 @@ namespace Surge
             ImNodes::EndInputAttribute();
         }
                 
-        ImGui::Image( node->value->GetDescriptorSet(), ImVec2( node_width,node_width ), ImVec2(0, 0), ImVec2(1,1), ImVec4(1,1,1,1), ImVec4(0.6f,0.6f,0.6f,1) );
+        RenderPreview( node->value, node_width );
                 
         ImNodes::EndNode();
     }
@@ -10,6 +10,7 @@ namespace Surge
         OutputNode();
 
         std::shared_ptr<Image> Evaluate(std::stack<std::shared_ptr<Image>> &value_stack) override;
+        Node *Clone() const override { return new OutputNode( *this ); }
     };
 
     struct UiOutputNode : UiNode
@@ -2,6 +2,8 @@
 
 #include "imgui.h"
 #include "../imnodes.h"
+#include "../Compute/ComputeKernels.h"
+#include "../Compute/CpuKernels.h"
 
 namespace Surge
 {
@@ -11,14 +13,8 @@ namespace Surge
         name = "Transform";
         if ( !transformCompute )
         {
-            transformCompute = new TransformCompute();
+            transformCompute = ComputeKernels::Get<TransformCompute>();
         }
-        value = std::make_shared<Image>( 2048, 2048, ImageFormat::RGBA );
-        constexpr auto bufSize = static_cast<size_t>( 2048 * 2048 * 4 );
-        auto *data = new char[bufSize];
-        memset( data, 255,  bufSize);
-        value->SetData( data );
-        delete[] data;
     }
 
     std::shared_ptr<Image> TransformNode::Evaluate(std::stack<std::shared_ptr<Image>> &value_stack)
@@ -27,7 +23,14 @@ namespace Surge
         value_stack.pop();
         ImVec2 scale = ImVec2(m_flipH ? -1.f : 1.f, m_flipV ? -1.f : 1.f);
         ImVec2 size = ImVec2( static_cast<float>(input->GetWidth()),static_cast<float>(input->GetHeight()));
-        transformCompute->Run( input.get(), value.get(), { scale, size, m_rotation } );
+        if ( value->IsHost() )
+        {
+            CpuKernels::Transform( input.get(), value.get(), { scale, size, m_rotation } );
+        }
+        else
+        {
+            transformCompute->Run( input.get(), value.get(), { scale, size, m_rotation } );
+        }
         return value;
     }
 
@@ -72,7 +75,7 @@ namespace Surge
             ImGui::TextUnformatted("output");
             ImNodes::EndInputAttribute();
         }
-        ImGui::Image( node->value->GetDescriptorSet(), ImVec2( node_width,node_width ), ImVec2(0, 0), ImVec2(1,1), ImVec4(1,1,1,1), ImVec4(0.6f,0.6f,0.6f,1) );
+        RenderPreview( node->value, node_width );
         
         ImNodes::EndNode();
     }
@@ -14,6 +14,7 @@ struct TransformNode : Node
     TransformNode();
 
     std::shared_ptr<Image> Evaluate(std::stack<std::shared_ptr<Image>> &value_stack) override;
+    Node *Clone() const override { return new TransformNode( *this ); }
 
     bool RenderProperties() override;
 
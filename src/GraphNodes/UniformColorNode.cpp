@@ -1,5 +1,7 @@
 ﻿#include "UniformColorNode.h"
 
+#include <algorithm>
+
 #include "imgui.h"
 #include "../imnodes.h"
 
@@ -8,12 +10,10 @@ namespace Surge
 UniformColorNode::UniformColorNode() : Node( NodeType::UNIFORM_COLOR )
 {
     name = "Uniform Color";
-    value = std::make_shared<Image>( 2048, 2048, ImageFormat::RGBA );
     m_color.asPart.red = 1;
     m_color.asPart.green = 1;
     m_color.asPart.blue = 1;
     m_color.asPart.alpha = 1;
-    UpdateColor();
 }
 
 std::shared_ptr<Image> UniformColorNode::Evaluate(std::stack<std::shared_ptr<Image>> &value_stack)
@@ -22,18 +22,27 @@ std::shared_ptr<Image> UniformColorNode::Evaluate(std::stack<std::shared_ptr<Ima
     return value;
 }
 
+bool UniformColorNode::GetGeneratedSize( uint32_t &width, uint32_t &height ) const
+{
+    width = static_cast<uint32_t>( std::max( m_width, 1 ) );
+    height = static_cast<uint32_t>( std::max( m_height, 1 ) );
+    return true;
+}
+
 bool UniformColorNode::RenderProperties()
 {
     ImGui::Text( name.c_str() );
     ImGui::Separator();
     bool changed = false;
     changed |= ImGui::ColorPicker4("Color", m_color.asArray.data);
+    changed |= ImGui::DragInt( "Width", &m_width, 1, 1, 16384 );
+    changed |= ImGui::DragInt( "Height", &m_height, 1, 1, 16384 );
     return changed;
 }
 
 void UniformColorNode::UpdateColor()
 {
-    constexpr auto bufSize = static_cast<size_t>( 2048 * 2048 * 4 );
+    const auto bufSize = static_cast<size_t>( value->GetWidth() ) * value->GetHeight() * 4;
     auto *data = new char[bufSize];
     char channel[4];
     channel[0] = static_cast<char>( m_color.asPart.red*255 );
@@ -69,7 +78,7 @@ void UiUniformColorNode::RenderNode( Node* node ) const
         ImGui::TextUnformatted("output");
         ImNodes::EndInputAttribute();
     }
-    ImGui::Image( node->value->GetDescriptorSet(), ImVec2( node_width,node_width ), ImVec2(0, 0), ImVec2(1,1), ImVec4(1,1,1,1), ImVec4(0.6f,0.6f,0.6f,1) );
+    RenderPreview( node->value, node_width );
         
     ImNodes::EndNode();
 }
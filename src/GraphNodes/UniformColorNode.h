@@ -22,11 +22,15 @@ struct UniformColorNode : Node
         } asArray;
         
     } m_color;
+    int m_width = DefaultImageSize;
+    int m_height = DefaultImageSize;
     
 
     UniformColorNode();
 
     std::shared_ptr<Image> Evaluate(std::stack<std::shared_ptr<Image>> &value_stack) override;
+    Node *Clone() const override { return new UniformColorNode( *this ); }
+    bool GetGeneratedSize( uint32_t &width, uint32_t &height ) const override;
 
     bool RenderProperties() override;
 
@@ -1,5 +1,8 @@
 #include "Image.h"
 
+#include <atomic>
+#include <mutex>
+
 #include "imgui.h"
 #include "backends/imgui_impl_vulkan.h"
 
@@ -14,75 +17,242 @@
 namespace Surge
 {
 
+// Images are also created by the evaluation thread, and ImGui allocates texture descriptor sets from
+// a pool that may only be used by one thread at a time.
+static std::mutex s_TextureDescriptorMutex;
+
+static std::atomic<uint64_t> s_NextImageUid = 1;
+
+static std::atomic<uint64_t> s_HostBytes = 0;
+static std::atomic<uint64_t> s_PeakHostBytes = 0;
+
 namespace Utils
 {
 
-static uint32_t GetVulkanMemoryType(VkMemoryPropertyFlags properties, uint32_t type_bits)
+static VkFormat SurgeFormatToVulkanFormat(ImageFormat format)
+{
+	switch (format)
+	{
+		case ImageFormat::RGBA:    return VK_FORMAT_R8G8B8A8_UNORM;
+		case ImageFormat::RGBA16F: return VK_FORMAT_R16G16B16A16_SFLOAT;
+		case ImageFormat::RGBA32F: return VK_FORMAT_R32G32B32A32_SFLOAT;
+	}
+	return static_cast<VkFormat>( 0 );
+}
+
+static float BitsToFloat(uint32_t bits)
+{
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+static uint32_t FloatToBits(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+// Both after Fabian Giesen's conversions, rounding to nearest even like the GPU does.
+static float HalfToFloat(uint16_t half)
+{
+	const uint32_t shiftedExponent = 0x7c00u << 13;
+	uint32_t bits = (half & 0x7fffu) << 13;
+	const uint32_t exponent = bits & shiftedExponent;
+	bits += (127u - 15u) << 23;
+	if (exponent == shiftedExponent)
+	{
+		// Inf or NaN
+		bits += (128u - 16u) << 23;
+	}
+	else if (exponent == 0)
+	{
+		// Zero or denormal, renormalised by the float unit.
+		bits += 1u << 23;
+		bits = FloatToBits(BitsToFloat(bits) - BitsToFloat(113u << 23));
+	}
+	return BitsToFloat(bits | (static_cast<uint32_t>(half & 0x8000u) << 16));
+}
+
+static uint16_t FloatToHalf(float value)
+{
+	uint32_t bits = FloatToBits(value);
+	const uint32_t sign = bits & 0x80000000u;
+	bits ^= sign;
+
+	uint32_t half;
+	if (bits >= (127u + 16u) << 23)
+	{
+		// Too large for a half, or Inf or NaN
+		half = bits > 0x7f800000u ? 0x7e00u : 0x7c00u;
+	}
+	else if (bits < 113u << 23)
+	{
+		// Denormal or zero, the float unit rounds the mantissa into place.
+		const float denormMagic = BitsToFloat(((127u - 15u) + (23u - 10u) + 1u) << 23);
+		half = FloatToBits(BitsToFloat(bits) + denormMagic) - FloatToBits(denormMagic);
+	}
+	else
+	{
+		const uint32_t mantissaOdd = (bits >> 13) & 1u;
+		bits += (static_cast<uint32_t>(15 - 127) << 23) + 0xfffu + mantissaOdd;
+		half = bits >> 13;
+	}
+	return static_cast<uint16_t>(half | (sign >> 16));
+}
+
+static uint8_t FloatToUnorm8(float value)
+{
+	value = value > 0.0f ? (value < 1.0f ? value : 1.0f) : 0.0f;
+	return static_cast<uint8_t>(value * 255.0f + 0.5f);
+}
+
+// Calls store(i, value) for each of count channels of pixels, as floats.
+template <typename Store>
+static void LoadChannels(ImageFormat format, const void* pixels, size_t count, Store store)
 {
-	VkPhysicalDeviceMemoryProperties prop;
-	vkGetPhysicalDeviceMemoryProperties(Application::GetPhysicalDevice(), &prop);
-	for (uint32_t i = 0; i < prop.memoryTypeCount; i++)
+	switch (format)
 	{
-		if ((prop.memoryTypes[i].propertyFlags & properties) == properties && type_bits & (1 << i))
+		case ImageFormat::RGBA:
 		{
-			return i;
+			const uint8_t* channels = static_cast<const uint8_t*>(pixels);
+			for (size_t i = 0; i < count; ++i)
+			{
+				store(i, channels[i] * (1.0f / 255.0f));
+			}
+			break;
+		}
+		case ImageFormat::RGBA16F:
+		{
+			const uint16_t* channels = static_cast<const uint16_t*>(pixels);
+			for (size_t i = 0; i < count; ++i)
+			{
+				store(i, HalfToFloat(channels[i]));
+			}
+			break;
+		}
+		case ImageFormat::RGBA32F:
+		{
+			const float* channels = static_cast<const float*>(pixels);
+			for (size_t i = 0; i < count; ++i)
+			{
+				store(i, channels[i]);
+			}
+			break;
 		}
 	}
-	
-	return 0xffffffff;
 }
 
-static uint32_t BytesPerPixel(ImageFormat format)
+}
+
+uint32_t Image::BytesPerPixel(ImageFormat format)
 {
 	switch (format)
 	{
 		case ImageFormat::RGBA:    return 4;
+		case ImageFormat::RGBA16F: return 8;
 		case ImageFormat::RGBA32F: return 16;
 	}
 	return 0;
 }
 
-static VkFormat SurgeFormatToVulkanFormat(ImageFormat format)
+void Image::ConvertPixels(ImageFormat fromFormat, const void* from, ImageFormat toFormat, void* to, size_t count)
 {
-	switch (format)
+	if (fromFormat == toFormat)
 	{
-		case ImageFormat::RGBA:    return VK_FORMAT_R8G8B8A8_UNORM;
-		case ImageFormat::RGBA32F: return VK_FORMAT_R32G32B32A32_SFLOAT;
+		memcpy(to, from, count * BytesPerPixel(fromFormat));
+		return;
 	}
-	return static_cast<VkFormat>( 0 );
+
+	const size_t channelCount = count * 4;
+	switch (toFormat)
+	{
+		case ImageFormat::RGBA:
+		{
+			uint8_t* channels = static_cast<uint8_t*>(to);
+			Utils::LoadChannels(fromFormat, from, channelCount, [channels](size_t i, float value) { channels[i] = Utils::FloatToUnorm8(value); });
+			break;
+		}
+		case ImageFormat::RGBA16F:
+		{
+			uint16_t* channels = static_cast<uint16_t*>(to);
+			Utils::LoadChannels(fromFormat, from, channelCount, [channels](size_t i, float value) { channels[i] = Utils::FloatToHalf(value); });
+			break;
+		}
+		case ImageFormat::RGBA32F:
+		{
+			float* channels = static_cast<float*>(to);
+			Utils::LoadChannels(fromFormat, from, channelCount, [channels](size_t i, float value) { channels[i] = value; });
+			break;
+		}
+	}
+}
+
+Image::Image(std::string_view path, ImageStorage storage)
+	: m_storage(storage), m_filepath(path)
+{
+	ImageData data;
+	if (!LoadFile(m_filepath, data))
+	{
+		fprintf(stderr, "Failed to load %s: %s\n", m_filepath.c_str(), stbi_failure_reason());
+	}
+
+	m_width = data.width;
+	m_height = data.height;
+	m_format = data.format;
+	
+	AllocateMemory(m_width * m_height * BytesPerPixel(m_format));
+	SetData(data.pixels.data());
 }
 
+uint64_t Image::GetHostBytes()
+{
+	return s_HostBytes;
 }
 
-Image::Image(std::string_view path)
-	: m_filepath(path)
+uint64_t Image::GetPeakHostBytes()
 {
+	return s_PeakHostBytes;
+}
+
+void Image::ResetHostPeak()
+{
+	s_PeakHostBytes = s_HostBytes.load();
+}
+
+bool Image::LoadFile(std::string_view path, ImageData& data)
+{
+	const std::string filepath(path);
 	int width, height, channels;
-	uint8_t* data = nullptr;
+	uint8_t* pixels = nullptr;
 
-	if (stbi_is_hdr(m_filepath.c_str()))
+	if (stbi_is_hdr(filepath.c_str()))
 	{
-		data = reinterpret_cast<uint8_t*>( stbi_loadf( m_filepath.c_str(), &width, &height, &channels, 4 ) );
-		m_format = ImageFormat::RGBA32F;
+		pixels = reinterpret_cast<uint8_t*>( stbi_loadf( filepath.c_str(), &width, &height, &channels, 4 ) );
+		data.format = ImageFormat::RGBA32F;
 	}
 	else
 	{
-		data = stbi_load(m_filepath.c_str(), &width, &height, &channels, 4);
-		m_format = ImageFormat::RGBA;
+		pixels = stbi_load(filepath.c_str(), &width, &height, &channels, 4);
+		data.format = ImageFormat::RGBA;
+	}
+	if (!pixels)
+	{
+		return false;
 	}
 
-	m_width = width;
-	m_height = height;
-	
-	AllocateMemory(m_width * m_height * Utils::BytesPerPixel(m_format));
-	SetData(data);
-	stbi_image_free( static_cast<void*>( data ) );
+	data.width = width;
+	data.height = height;
+	data.pixels.assign(pixels, pixels + static_cast<size_t>(data.width) * data.height * BytesPerPixel(data.format));
+	stbi_image_free( static_cast<void*>( pixels ) );
+	return true;
 }
 
-Image::Image(uint32_t width, uint32_t height, ImageFormat format, const void* data)
-	: m_width(width), m_height(height), m_format(format)
+Image::Image(uint32_t width, uint32_t height, ImageFormat format, const void* data, ImageStorage storage)
+	: m_width(width), m_height(height), m_format(format), m_storage(storage)
 {
-	AllocateMemory(m_width * m_height * Utils::BytesPerPixel(m_format));
+	AllocateMemory(m_width * m_height * BytesPerPixel(m_format));
 	if (data)
 	{
 		SetData(data);
@@ -91,17 +261,19 @@ Image::Image(uint32_t width, uint32_t height, ImageFormat format, const void* da
 
 Image::~Image()
 {
-	Application::SubmitResourceFree([sampler = m_sampler, imageView = m_imageView, image = m_image,
-		memory = m_memory, stagingBuffer = m_stagingBuffer, stagingBufferMemory = m_stagingBufferMemory]()
+	if (IsHost())
+	{
+		s_HostBytes -= m_pixels.size();
+		return;
+	}
+	Application::SubmitResourceFree([sampler = m_sampler, imageView = m_imageView, image = m_image, memory = m_memory]()
 	{
 		const VkDevice device = Application::GetDevice();
 
 		vkDestroySampler(device, sampler, nullptr);
 		vkDestroyImageView(device, imageView, nullptr);
 		vkDestroyImage(device, image, nullptr);
-		vkFreeMemory(device, memory, nullptr);
-		vkDestroyBuffer(device, stagingBuffer, nullptr);
-		vkFreeMemory(device, stagingBufferMemory, nullptr);
+		Application::GetGpuAllocator()->Free(memory);
 	});
 }
 
@@ -109,6 +281,23 @@ void Image::AllocateMemory(uint64_t size)
 {
 	VkDevice device = Application::GetDevice();
 
+	m_uid = s_NextImageUid++;
+
+	if (device == VK_NULL_HANDLE)
+	{
+		m_storage = ImageStorage::Host;
+	}
+	if (IsHost())
+	{
+		m_pixels.resize(size);
+		const uint64_t hostBytes = s_HostBytes += size;
+		uint64_t peak = s_PeakHostBytes;
+		while (hostBytes > peak && !s_PeakHostBytes.compare_exchange_weak(peak, hostBytes))
+		{
+		}
+		return;
+	}
+
 	VkResult err;
 	
 	VkFormat vulkanFormat = Utils::SurgeFormatToVulkanFormat(m_format);
@@ -134,13 +323,8 @@ void Image::AllocateMemory(uint64_t size)
 		check_vk_result(err);
 		VkMemoryRequirements req;
 		vkGetImageMemoryRequirements(device, m_image, &req);
-		VkMemoryAllocateInfo alloc_info = {};
-		alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		alloc_info.allocationSize = req.size;
-		alloc_info.memoryTypeIndex = Utils::GetVulkanMemoryType(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, req.memoryTypeBits);
-		err = vkAllocateMemory(device, &alloc_info, nullptr, &m_memory);
-		check_vk_result(err);
-		err = vkBindImageMemory(device, m_image, m_memory, 0);
+		m_memory = Application::GetGpuAllocator()->Allocate(req, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, GpuResourceTiling::Optimal);
+		err = vkBindImageMemory(device, m_image, m_memory.memory, m_memory.offset);
 		check_vk_result(err);
 	}
 
@@ -175,63 +359,34 @@ void Image::AllocateMemory(uint64_t size)
 		check_vk_result(err);
 	}
 
-	// Create the Descriptor Set:
+	// Create the Descriptor Set, only needed to show the image in the UI:
+	if (Application::IsHeadless())
+	{
+		return;
+	}
+	std::lock_guard<std::mutex> lock(s_TextureDescriptorMutex);
 	m_descriptorSet = (VkDescriptorSet)ImGui_ImplVulkan_AddTexture(m_sampler, m_imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 }
 
 void Image::SetData(const void* data)
 {
-	VkDevice device = Application::GetDevice();
-
-	size_t uploadSize = m_width * m_height * Utils::BytesPerPixel(m_format);
-
-	VkResult err;
-
-	if (!m_stagingBuffer)
+	const Profiler::CpuScope profileScope("Upload", "transfer");
+	const size_t uploadSize = m_width * m_height * BytesPerPixel(m_format);
+	if (IsHost())
 	{
-		// Create the Upload Buffer
-		{
-			VkBufferCreateInfo buffer_info = {};
-			buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-			buffer_info.size = uploadSize;
-			buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-			buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-			err = vkCreateBuffer(device, &buffer_info, nullptr, &m_stagingBuffer);
-			check_vk_result(err);
-			VkMemoryRequirements req;
-			vkGetBufferMemoryRequirements(device, m_stagingBuffer, &req);
-			m_alignedSize = req.size;
-			VkMemoryAllocateInfo alloc_info = {};
-			alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-			alloc_info.allocationSize = req.size;
-			alloc_info.memoryTypeIndex = Utils::GetVulkanMemoryType(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, req.memoryTypeBits);
-			err = vkAllocateMemory(device, &alloc_info, nullptr, &m_stagingBufferMemory);
-			check_vk_result(err);
-			err = vkBindBufferMemory(device, m_stagingBuffer, m_stagingBufferMemory, 0);
-			check_vk_result(err);
-		}
-
+		memcpy(m_pixels.data(), data, uploadSize);
+		return;
 	}
 
 	// Upload to Buffer
-	{
-		char* map = nullptr;
-		err = vkMapMemory(device, m_stagingBufferMemory, 0, m_alignedSize, 0, reinterpret_cast<void**>( &map ));
-		check_vk_result(err);
-		memcpy(map, data, uploadSize);
-		VkMappedMemoryRange range[1] = {};
-		range[0].sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-		range[0].memory = m_stagingBufferMemory;
-		range[0].size = m_alignedSize;
-		err = vkFlushMappedMemoryRanges(device, 1, range);
-		check_vk_result(err);
-		vkUnmapMemory(device, m_stagingBufferMemory);
-	}
-
+	const StagingRegion staging = Application::GetStagingRing()->Acquire(uploadSize);
+	memcpy(staging.mapped, data, uploadSize);
 
 	// Copy to Image
 	{
-		VkCommandBuffer command_buffer = Application::GetCommandBuffer();
+		// Recorded on the compute queue so that images can be filled from any thread. Inside a compute
+		// batch the copy goes into the batch ahead of the dispatches that read it.
+		VkCommandBuffer command_buffer = Application::GetComputeCommandBuffer();
 
 		VkImageMemoryBarrier copy_barrier = {};
 		copy_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -252,7 +407,8 @@ void Image::SetData(const void* data)
 		region.imageExtent.width = m_width;
 		region.imageExtent.height = m_height;
 		region.imageExtent.depth = 1;
-		vkCmdCopyBufferToImage(command_buffer, m_stagingBuffer, m_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+		region.bufferOffset = staging.offset;
+		vkCmdCopyBufferToImage(command_buffer, staging.buffer, m_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
 
 		VkImageMemoryBarrier use_barrier = {};
 		use_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -266,33 +422,39 @@ void Image::SetData(const void* data)
 		use_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 		use_barrier.subresourceRange.levelCount = 1;
 		use_barrier.subresourceRange.layerCount = 1;
-		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &use_barrier);
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &use_barrier);
 
-		Application::FlushCommandBuffer(command_buffer);
+		Application::FlushComputeCommandBuffer(command_buffer);
 	}
+
+	// Inside a batch the copy hasn't run yet, the region stays taken until the batch completes.
+	Application::SubmitComputeResourceFree([staging]()
+	{
+		Application::GetStagingRing()->Release(staging);
+	});
 }
 
 
 void Image::GetData( void* data ) const
 {
-	if (!m_stagingBuffer)
+	const Profiler::CpuScope profileScope("Readback", "transfer");
+	const size_t downloadSize = m_width * m_height * BytesPerPixel(m_format);
+	if (IsHost())
 	{
-		// The staging buffer is no longer around, the image is probably gone too.
+		memcpy(data, m_pixels.data(), downloadSize);
 		return;
 	}
-
-	const VkDevice device = Application::GetDevice();
-	
-	VkResult err;
+	const StagingRegion staging = Application::GetStagingRing()->Acquire(downloadSize);
 
 	// TODO DraperDanMan: Make a temp Image on the GPU that has TRANSFER_SRC_BIT set and copy into that image and save from there.
 	// Copy to Image
 	{
-		const VkCommandBuffer command_buffer = Application::GetCommandBuffer();
+		// Not valid inside a compute batch, the copy has to have finished before the staging buffer is read below.
+		const VkCommandBuffer command_buffer = Application::GetComputeCommandBuffer();
 
 		VkImageMemoryBarrier copy_barrier = {};
 		copy_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-		copy_barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		copy_barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
 		copy_barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
 		copy_barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 		copy_barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
@@ -302,7 +464,7 @@ void Image::GetData( void* data ) const
 		copy_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 		copy_barrier.subresourceRange.levelCount = 1;
 		copy_barrier.subresourceRange.layerCount = 1;
-		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &copy_barrier);
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &copy_barrier);
 
 		VkBufferImageCopy region = {};
 		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -310,7 +472,8 @@ void Image::GetData( void* data ) const
 		region.imageExtent.width = m_width;
 		region.imageExtent.height = m_height;
 		region.imageExtent.depth = 1;
-		vkCmdCopyImageToBuffer(command_buffer, m_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_stagingBuffer, 1, &region);
+		region.bufferOffset = staging.offset;
+		vkCmdCopyImageToBuffer(command_buffer, m_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, staging.buffer, 1, &region);
 
 		VkImageMemoryBarrier use_barrier = {};
 		use_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -326,22 +489,72 @@ void Image::GetData( void* data ) const
 		use_barrier.subresourceRange.layerCount = 1;
 		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &use_barrier);
 
-		Application::FlushCommandBuffer(command_buffer);
+		Application::FlushComputeCommandBuffer(command_buffer);
 	}
 
-	// Download to Buffer
+	// Download from Buffer
 	{
-		const size_t downloadSize = m_width * m_height * Utils::BytesPerPixel(m_format);
-		
-		char* map = nullptr;
-		err = vkMapMemory(device, m_stagingBufferMemory, 0, m_alignedSize, 0, reinterpret_cast<void**>( &map ));
-		check_vk_result(err);
-		memcpy(data, map, downloadSize);
-		vkUnmapMemory(device, m_stagingBufferMemory);
+		memcpy(data, staging.mapped, downloadSize);
+		Application::GetStagingRing()->Release(staging);
 	}
 }
 
 
+void Image::CopyFrom(const Image& source)
+{
+	if (IsHost())
+	{
+		ConvertPixels(source.m_format, source.m_pixels.data(), m_format, m_pixels.data(), static_cast<size_t>(m_width) * m_height);
+		return;
+	}
+
+	// A blit converts between any of the formats, recorded like SetData so it can go into a batch.
+	VkCommandBuffer command_buffer = Application::GetComputeCommandBuffer();
+
+	VkImageMemoryBarrier copy_barriers[2] = {};
+	for (VkImageMemoryBarrier& barrier : copy_barriers)
+	{
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.subresourceRange.layerCount = 1;
+	}
+	copy_barriers[0].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	copy_barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	copy_barriers[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	copy_barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	copy_barriers[0].image = source.m_image;
+	copy_barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	copy_barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	copy_barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	copy_barriers[1].image = m_image;
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 2, copy_barriers);
+
+	VkImageBlit region = {};
+	region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.srcSubresource.layerCount = 1;
+	region.srcOffsets[1] = { static_cast<int32_t>(m_width), static_cast<int32_t>(m_height), 1 };
+	region.dstSubresource = region.srcSubresource;
+	region.dstOffsets[1] = region.srcOffsets[1];
+	vkCmdBlitImage(command_buffer, source.m_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, VK_FILTER_NEAREST);
+
+	VkImageMemoryBarrier use_barriers[2] = { copy_barriers[0], copy_barriers[1] };
+	use_barriers[0].srcAccessMask = 0;
+	use_barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	use_barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	use_barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	use_barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	use_barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	use_barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	use_barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 2, use_barriers);
+
+	Application::FlushComputeCommandBuffer(command_buffer);
+}
+
+
 static bool has_suffix(const std::string &str, const std::string &suffix)
 {
 	return str.size() >= suffix.size() &&
@@ -351,11 +564,16 @@ static bool has_suffix(const std::string &str, const std::string &suffix)
 
 bool Image::SaveToFile( std::string filepath )
 {
-	const size_t filesize = m_width * m_height * Utils::BytesPerPixel(m_format);
-	char* data = new char[filesize];
+	const size_t filesize = m_width * m_height * BytesPerPixel(m_format);
+	std::vector<char> data(filesize);
 
-	GetData( data );
+	GetData( data.data() );
+
+	return WriteFile( std::move(filepath), m_width, m_height, m_format, data.data() );
+}
 
+bool Image::WriteFile(std::string filepath, uint32_t width, uint32_t height, ImageFormat format, const void* data)
+{
 	//double check the file ends in png.
 	if (!has_suffix(filepath, ".png"))
 	{
@@ -363,8 +581,17 @@ bool Image::SaveToFile( std::string filepath )
 	}
 	
 	
+	// pngs are 8 bit, float images are clamped to it.
+	std::vector<uint8_t> converted;
+	if (format != ImageFormat::RGBA)
+	{
+		converted.resize(static_cast<size_t>(width) * height * BytesPerPixel(ImageFormat::RGBA));
+		ConvertPixels(format, data, ImageFormat::RGBA, converted.data(), static_cast<size_t>(width) * height);
+		data = converted.data();
+	}
+
 	//write it out
-	const int result = stbi_write_png( filepath.c_str(), m_width, m_height, Utils::BytesPerPixel(m_format), data, m_width * Utils::BytesPerPixel(m_format) );
+	const int result = stbi_write_png( filepath.c_str(), width, height, 4, data, width * 4 );
 	return result > 0;
 }
 
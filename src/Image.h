@@ -1,7 +1,9 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
+#include "GpuAllocator.h"
 #include "vulkan/vulkan.h"
 
 namespace Surge
@@ -11,21 +13,62 @@ enum class ImageFormat
 {
 	None = 0,
 	RGBA,
+	// Half float, HDR headroom at half the memory and bandwidth of RGBA32F.
+	RGBA16F,
 	RGBA32F
 };
 
+enum class ImageStorage
+{
+	// A Vulkan image, what the compute kernels and the UI work with.
+	Device,
+	// Plain memory that the CPU kernels read and write, see CpuKernels.
+	Host
+};
+
+// Pixels read from an image file but not on the GPU yet, so files can be decoded on any thread and
+// only handed to an Image where it is created.
+struct ImageData
+{
+	uint32_t width = 0, height = 0;
+	ImageFormat format = ImageFormat::None;
+	std::vector<uint8_t> pixels;
+};
+
+// Without a Vulkan device, see AppConfig::cpuOnly, every image is kept in host memory whatever
+// storage it was asked for.
 class Image
 {
 public:
-	Image(std::string_view path);
-	Image(uint32_t width, uint32_t height, ImageFormat format, const void* data = nullptr);
+	Image(std::string_view path, ImageStorage storage = ImageStorage::Device);
+	Image(uint32_t width, uint32_t height, ImageFormat format, const void* data = nullptr, ImageStorage storage = ImageStorage::Device);
 	~Image();
 
 	void SetData(const void* data);
 	void GetData( void* data ) const;
 
+	// Copies source, which has to be the same size and kept in the same storage, into this image,
+	// converting between their formats on the way.
+	void CopyFrom(const Image& source);
+
 	bool SaveToFile( std::string filepath );
 
+	// Neither needs Vulkan, so they can run on worker threads.
+	static bool LoadFile(std::string_view path, ImageData& data);
+	static bool WriteFile(std::string filepath, uint32_t width, uint32_t height, ImageFormat format, const void* data);
+
+	[[nodiscard]] static uint32_t BytesPerPixel(ImageFormat format);
+	[[nodiscard]] static bool IsFloat(ImageFormat format) { return format == ImageFormat::RGBA16F || format == ImageFormat::RGBA32F; }
+	// Converts count pixels from one format to another. Storing to 8 bit clamps and rounds like
+	// imageStore to a unorm format, NaN ends up as zero.
+	static void ConvertPixels(ImageFormat fromFormat, const void* from, ImageFormat toFormat, void* to, size_t count);
+
+	// The pixel bytes every host image holds between them, and the most they have held since the
+	// first image or ResetHostPeak, the host side of GpuAllocator::GetStats.
+	[[nodiscard]] static uint64_t GetHostBytes();
+	[[nodiscard]] static uint64_t GetPeakHostBytes();
+	static void ResetHostPeak();
+
 	[[nodiscard]] VkDescriptorSet GetDescriptorSet() const { return m_descriptorSet; }
 	[[nodiscard]] VkImage GetVkImage() const { return m_image; }
 	[[nodiscard]] VkImageView GetVkImageView() const { return m_imageView; }
@@ -34,22 +77,28 @@ public:
 
 	[[nodiscard]] uint32_t GetWidth() const { return m_width; }
 	[[nodiscard]] uint32_t GetHeight() const { return m_height; }
+	[[nodiscard]] ImageFormat GetFormat() const { return m_format; }
+	[[nodiscard]] ImageStorage GetStorage() const { return m_storage; }
+	[[nodiscard]] bool IsHost() const { return m_storage == ImageStorage::Host; }
+	// The pixels of a host image, rows packed one after the other. Null for device images.
+	[[nodiscard]] uint8_t* GetPixels() { return m_pixels.empty() ? nullptr : m_pixels.data(); }
+	[[nodiscard]] const uint8_t* GetPixels() const { return m_pixels.empty() ? nullptr : m_pixels.data(); }
+	// Never shared by two images, unlike Vulkan handles which can be recycled once destroyed.
+	[[nodiscard]] uint64_t GetUid() const { return m_uid; }
 private:
 	void AllocateMemory(uint64_t size);
 private:
 	uint32_t m_width = 0, m_height = 0;
+	uint64_t m_uid = 0;
 
 	VkImage m_image = nullptr;
 	VkImageView m_imageView = nullptr;
-	VkDeviceMemory m_memory = nullptr;
+	GpuAllocation m_memory;
 	VkSampler m_sampler = nullptr;
 
 	ImageFormat m_format = ImageFormat::None;
-
-	VkBuffer m_stagingBuffer = nullptr;
-	VkDeviceMemory m_stagingBufferMemory = nullptr;
-
-	size_t m_alignedSize = 0;
+	ImageStorage m_storage = ImageStorage::Device;
+	std::vector<uint8_t> m_pixels;
 
 	VkDescriptorSet m_descriptorSet = nullptr;
 
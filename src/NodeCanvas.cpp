@@ -1,9 +1,12 @@
 ﻿#include "NodeCanvas.h"
 #include "nfd.h"
-#include <fstream>
+#include <algorithm>
 #include <memory>
 
 #include "Application.h"
+#include "BatchExporter.h"
+#include "GraphEvaluator.h"
+#include "GraphFile.h"
 #include "imnodes_internal.h"
 
 #include "GraphNodes/GraphNodes.h"
@@ -30,72 +33,115 @@ void NodeCanvas::Init()
     ImNodesIO& io = ImNodes::GetIO();
     io.LinkDetachWithModifierClick.Modifier = &ImGui::GetIO().KeyCtrl;
 
-    m_outputImage = std::make_shared<Image>( 2048, 2048, ImageFormat::RGBA);
-    constexpr auto bufSize = static_cast<size_t>( 2048 * 2048 * 4 );
-    auto *data = new char[bufSize];
-    memset( data, 255,  bufSize);
-    m_outputImage->SetData( data );
-    delete[] data;
+    m_worker = new EvaluationWorker();
 }
 
 
 void NodeCanvas::Shutdown()
 {
+    delete m_worker;
+    m_worker = nullptr;
     ImNodes::DestroyContext();
 }
 
 
-std::shared_ptr<Image> NodeCanvas::Evaluate( const Graph<Node *>& graph, const int startNode ) const
+std::shared_ptr<Image> NodeCanvas::Evaluate( const Graph<Node *>& graph, const int startNode, const uint32_t resolutionDivisor )
 {
-    std::stack<int> postorder;
-    dfs_traverse( graph, startNode, [&postorder]( const int nodeId ) -> void { postorder.push( nodeId ); } );
+    GraphEvaluator::Options options;
+    options.batchCompute = Application::GetConfig().batchCompute;
+    options.blankImages = &m_blankImages;
+    options.fusePointwise = Application::GetConfig().fusePointwise;
+    options.pinnedNodes = GetPinnedNodes();
+    options.resolutionDivisor = resolutionDivisor;
+    options.proxyImages = &m_proxyImages;
+    if ( Application::GetConfig().aliasIntermediates )
+    {
+        options.imagePool = &m_imagePool;
+    }
+    GraphEvaluator evaluator( options );
+    return evaluator.Evaluate( graph, startNode );
+}
+
 
-    std::stack<std::shared_ptr<Image>> value_stack;
-    while (!postorder.empty())
+std::vector<int> NodeCanvas::GetPinnedNodes() const
+{
+    // The output is kept by the evaluator itself, the rest are the nodes shown in the output and
+    // properties windows.
+    std::vector<int> selectedNodes( static_cast<size_t>( ImNodes::NumSelectedNodes() ) );
+    if ( !selectedNodes.empty() )
     {
-        const int id = postorder.top();
-        postorder.pop();
-        Node *node = graph.node(id);
+        ImNodes::GetSelectedNodes( selectedNodes.data() );
+    }
+    return selectedNodes;
+}
 
-        switch (node->type)
-        {
-        case NodeType::VALUE:
+
+void NodeCanvas::EvaluateNow( const uint32_t resolutionDivisor )
+{
+    m_outputImage = Evaluate(m_graph, m_rootNodeId, resolutionDivisor);
+    Node *node = m_graph.node(m_rootNodeId);
+    node->value = m_outputImage;
+    m_graph.update_node( m_rootNodeId, node );
+}
+
+
+void NodeCanvas::RequestEvaluation( const uint32_t resolutionDivisor )
+{
+    // The worker gets its own copy of every node, so the UI can carry on editing the originals
+    // while it runs.
+    auto request = std::make_unique<EvaluationWorker::Request>();
+    request->graph = m_graph;
+    for ( const int id : m_graph.node_ids() )
+    {
+        Node *clone = m_graph.node( id )->Clone();
+        request->graph.update_node( id, clone );
+    }
+    request->rootNodeId = m_rootNodeId;
+    request->generation = m_generation;
+    request->batchCompute = Application::GetConfig().batchCompute;
+    request->blankImages = &m_blankImages;
+    request->fusePointwise = Application::GetConfig().fusePointwise;
+    request->pinnedNodes = GetPinnedNodes();
+    request->resolutionDivisor = resolutionDivisor;
+    request->proxyImages = &m_proxyImages;
+    if ( Application::GetConfig().aliasIntermediates )
+    {
+        request->imagePool = &m_imagePool;
+    }
+    m_worker->Submit( std::move( request ) );
+}
+
+
+void NodeCanvas::ApplyEvaluationResult()
+{
+    const std::unique_ptr<EvaluationWorker::Result> result = m_worker->TakeResult();
+    if ( !result || result->generation != m_generation )
+    {
+        return;
+    }
+
+    for ( const auto &output : result->nodes )
+    {
+        if ( !m_graph.contains_node( output.id ) )
         {
-            // If the edge does not have an edge connecting to another node, then just use the value
-            // at this node. It means the node's input pin has not been connected to anything and
-            // the value comes from the node's UI.
-            if (graph.num_edges_from_node(id) == 0ull)
-            {
-                value_stack.push(node->value);
-            }
+            continue;
         }
-        break;
-        case NodeType::BLEND:
-        case NodeType::HSL:
-        case NodeType::LEVELS:
-        case NodeType::CURVES:
-        case NodeType::TRANSFORM:
-        case NodeType::BLUR:
-        case NodeType::INVERT:
-        case NodeType::UNIFORM_COLOR:
-        case NodeType::NOISE:
-        case NodeType::DYNAMIC_IMAGE:
-        case NodeType::IMAGE:
+
+        Node *node = m_graph.node( output.id );
+        // Image nodes only hand on the image they hold, which the UI may have changed since.
+        if ( WritesValue( node->type ) )
         {
-            auto val = node->Evaluate( value_stack );
-            value_stack.push(val);
-        }
-        break;
-        default:
-            break;
+            node->value = output.value;
+            node->resolutionScale = output.resolutionScale;
         }
+        node->evaluatedStamp = output.evaluatedStamp;
     }
 
-    // The final output node isn't evaluated in the loop -- instead we just pop
-    // the three values which should be in the stack.
-    assert(value_stack.size() == 1ull);
-    
-    return value_stack.top();
+    if ( result->rootNodeId == m_rootNodeId && m_graph.contains_node( m_rootNodeId ) )
+    {
+        m_outputImage = result->output;
+        m_graph.node( m_rootNodeId )->value = m_outputImage;
+    }
 }
 
 void NodeCanvas::DrawCreateNodeMenu( const ImVec2 createPos )
@@ -267,6 +313,8 @@ void NodeCanvas::UiRender()
 {
     constexpr auto flags = ImGuiWindowFlags_MenuBar;
 
+    ApplyEvaluationResult();
+
     // The node editor window
     ImGui::Begin("Node Editor", nullptr, flags);
 
@@ -281,6 +329,43 @@ void NodeCanvas::UiRender()
             ImGui::EndMenu();
         }
 
+        if (ImGui::BeginMenu("Evaluation"))
+        {
+            ImGui::MenuItem( "Batch Compute Submission", nullptr, &Application::GetConfig().batchCompute );
+            ImGui::MenuItem( "Fuse Pointwise Nodes", nullptr, &Application::GetConfig().fusePointwise );
+            bool modeChanged = ImGui::MenuItem( "Evaluate In Background", nullptr, &Application::GetConfig().asyncEvaluation );
+            modeChanged |= ImGui::MenuItem( "Alias Intermediate Images", nullptr, &Application::GetConfig().aliasIntermediates );
+            if ( modeChanged )
+            {
+                // Whatever the worker is still holding on to was made for the other mode.
+                m_worker->CancelPendingAndWait();
+                ++m_generation;
+            }
+            if ( ImGui::BeginMenu( "Proxy Resolution While Dragging" ) )
+            {
+                int &proxyDivisor = Application::GetConfig().proxyDivisor;
+                for ( const int divisor : { 1, 2, 4, 8 } )
+                {
+                    const std::string label = divisor == 1 ? "Off" : "1/" + std::to_string( divisor );
+                    if ( ImGui::MenuItem( label.c_str(), nullptr, proxyDivisor == divisor ) )
+                    {
+                        proxyDivisor = divisor;
+                    }
+                }
+                ImGui::EndMenu();
+            }
+            ImGui::TextDisabled( "Transient images: %zu (%.1f MB)", m_imagePool.GetImageCount(),
+                                 static_cast<double>( m_imagePool.GetByteSize() ) / ( 1024.0 * 1024.0 ) );
+            const GpuMemoryStats gpuMemory = Application::GetGpuAllocator()->GetStats();
+            ImGui::TextDisabled( "GPU memory: %.1f of %.1f MB in %u blocks (%u dedicated), %.0f%% fragmented",
+                                 static_cast<double>( gpuMemory.usedBytes ) / ( 1024.0 * 1024.0 ),
+                                 static_cast<double>( gpuMemory.reservedBytes ) / ( 1024.0 * 1024.0 ),
+                                 gpuMemory.blockCount, gpuMemory.dedicatedCount, gpuMemory.GetFragmentation() * 100.0f );
+            ImGui::TextDisabled( "Cached descriptor sets: %zu", Application::GetDescriptorCache()->GetSetCount() );
+            
+            ImGui::EndMenu();
+        }
+
         ImGui::EndMenuBar();
     }
     
@@ -341,6 +426,8 @@ void NodeCanvas::UiRender()
 
     ImNodes::MiniMap(0.2f, m_minimapLocation);
     ImNodes::EndNodeEditor();
+
+    DrawProfilerOverlay();
     
     // Handle new links
     // These are driven by Imnodes, so we place the code after EndNodeEditor().
@@ -456,14 +543,28 @@ void NodeCanvas::UiRender()
     ImGui::End();
 
     invalidateGraph |= RenderPropertiesWindow();
+
+    // While a parameter is being dragged the nodes it affects are previewed at a fraction of their
+    // resolution, and run once more at full resolution when it is let go. Everything upstream of
+    // it keeps its full resolution image throughout, see GraphEvaluator::Options::resolutionDivisor.
+    const uint32_t resolutionDivisor = m_draggingParameter ? static_cast<uint32_t>( std::max( 1, Application::GetConfig().proxyDivisor ) ) : 1;
+    if ( m_showingProxy && resolutionDivisor == 1 )
+    {
+        invalidateGraph = true;
+    }
     
     // Calculate if invalid
     if (invalidateGraph && m_rootNodeId != -1)
     {
-        m_outputImage = Evaluate(m_graph, m_rootNodeId);
-        Node *node = m_graph.node(m_rootNodeId);
-        node->value = m_outputImage;
-        m_graph.update_node( m_rootNodeId, node );
+        if ( Application::GetConfig().asyncEvaluation )
+        {
+            RequestEvaluation( resolutionDivisor );
+        }
+        else
+        {
+            EvaluateNow( resolutionDivisor );
+        }
+        m_showingProxy = resolutionDivisor > 1;
     }
 }
 
@@ -471,6 +572,7 @@ void NodeCanvas::UiRender()
 bool NodeCanvas::RenderPropertiesWindow()
 {
     bool invalidate = false;
+    m_draggingParameter = false;
     ImGui::Begin( "Properties" );
 
     int selectedNodeCount = ImNodes::NumSelectedNodes();
@@ -482,6 +584,11 @@ bool NodeCanvas::RenderPropertiesWindow()
     {
         Node *activeNode = m_graph.node( selectedNodes[0] );
         invalidate = activeNode->RenderProperties();
+        if ( invalidate )
+        {
+            activeNode->MarkDirty();
+        }
+        m_draggingParameter = ImGui::IsAnyItemActive() && ImGui::IsWindowFocused();
     }
     else
     {
@@ -492,7 +599,43 @@ bool NodeCanvas::RenderPropertiesWindow()
 }
 
     
-void NodeCanvas::Export() const
+void NodeCanvas::DrawProfilerOverlay() const
+{
+    // While recording, every node shows how long it took the last time it was evaluated.
+    const Profiler *profiler = Application::GetProfiler();
+    if ( !profiler->IsEnabled() )
+    {
+        return;
+    }
+
+    const auto timings = profiler->GetNodeTimings();
+    const ImRect canvas = ImNodes::GetCurrentContext()->CanvasRectScreenSpace;
+    ImDrawList *drawList = ImGui::GetWindowDrawList();
+    drawList->PushClipRect( canvas.Min, canvas.Max, true );
+    for ( const UiNode *node : m_nodes )
+    {
+        const auto timing = timings.find( node->id );
+        if ( timing == timings.end() )
+        {
+            continue;
+        }
+        char label[64];
+        if ( profiler->HasGpuTimes() )
+        {
+            snprintf( label, sizeof( label ), "%.2f ms GPU", timing->second.gpuMs );
+        }
+        else
+        {
+            snprintf( label, sizeof( label ), "%.2f ms CPU", timing->second.cpuMs );
+        }
+        const ImVec2 position = ImNodes::GetNodeScreenSpacePos( node->id );
+        drawList->AddText( ImVec2( position.x, position.y - ImGui::GetTextLineHeightWithSpacing() ), IM_COL32( 255, 200, 80, 255 ), label );
+    }
+    drawList->PopClipRect();
+}
+
+
+void NodeCanvas::Export()
 {
     nfdchar_t *savePath = nullptr;
     nfdresult_t result = NFD_SaveDialog( "png", nullptr, &savePath );
@@ -500,6 +643,11 @@ void NodeCanvas::Export() const
     {
         puts("Success!");
 
+        // Exporting evaluates on this thread, so the worker has to be out of the way first, and
+        // anything it finished should be in place so that only what is left gets evaluated again.
+        m_worker->CancelPendingAndWait();
+        ApplyEvaluationResult();
+
         std::vector<UiNode *> dynamicNodes;
         std::filesystem::path outFolder = savePath;
         for ( const auto& node : m_nodes )
@@ -516,29 +664,29 @@ void NodeCanvas::Export() const
         }
         if ( !dynamicNodes.empty() )
         {
-            bool allDone = false;
-            int index = 0;
-            while ( !allDone )
-            {
-                for ( const auto& dynNode : dynamicNodes )
-                {
-                    const auto dynImage = dynamic_cast<DynamicImageNode*>( m_graph.node( dynNode->id ) );
-                    if ( dynImage->NextImage() )
-                    {
-                        allDone = true;
-                        break;
-                    }
-                }
-                const std::shared_ptr<Image> temp = Evaluate( m_graph, m_rootNodeId );
-                std::string outFile = outFolder.remove_filename().generic_string();
-                outFile.append( std::to_string( index ) );
-                temp->SaveToFile( outFile );
-                index++;
-            }
+            BatchExporter::Options options;
+            options.batchCompute = Application::GetConfig().batchCompute;
+            options.fusePointwise = Application::GetConfig().fusePointwise;
+            options.blankImages = &m_blankImages;
+            BatchExporter exporter( options );
+            const int written = exporter.Run( m_graph, m_rootNodeId, outFolder.remove_filename().generic_string() );
+            printf( "Exported %d images\n", written );
         }
         else
         {
-            m_outputImage->SaveToFile( savePath );
+            if ( m_rootNodeId != -1 )
+            {
+                // An edit may not have made it through the worker yet.
+                EvaluateNow();
+            }
+            if ( m_outputImage )
+            {
+                m_outputImage->SaveToFile( savePath );
+            }
+            else
+            {
+                fprintf(stderr, "Nothing to export, the output isn't connected to anything." );
+            }
         }
         
         free(savePath);
@@ -556,449 +704,98 @@ void NodeCanvas::Export() const
     
 void NodeCanvas::SaveGraph( std::string filepath )
 {
-    std::ofstream outfile( filepath, std::ofstream::binary );
-
-    outfile << m_nodes.size() << " ";
-    for( const auto& node : m_nodes)
+    std::vector<GraphFileNode> fileNodes;
+    for ( const UiNode *node : m_nodes )
     {
-        outfile << static_cast<int>( node->type ) << " ";
-        outfile << node->id  << " ";
-
-        const ImVec2 nodePos = ImNodes::GetNodeGridSpacePos( node->id );
-        outfile << nodePos.x << " " << nodePos.y << " ";
-        
-        switch (node->type)
+        GraphFileNode fileNode;
+        fileNode.type = node->type;
+        fileNode.id = node->id;
+        if ( node->type == NodeType::BLEND )
         {
-        case NodeType::BLEND:
-            {
-                outfile << node->ui.two.lhs << " ";
-                outfile << node->ui.two.rhs << " ";
-                auto blendNode = dynamic_cast<BlendNode *>( m_graph.node( node->id ));
-                outfile << static_cast<int>( blendNode->m_mode ) << " ";
-            }
-            break;
-        case NodeType::HSL:
-            {
-                outfile << node->ui.one.input << " ";
-                auto hslNode = dynamic_cast<HSLNode *>( m_graph.node( node->id ));
-                outfile << hslNode->m_hue << " " << hslNode->m_lightness << " " << hslNode->m_saturation << " ";
-            }
-            break;
-        case NodeType::LEVELS:
-            {
-                outfile << node->ui.one.input << " ";
-                auto levelsNode = dynamic_cast<LevelsNode *>( m_graph.node( node->id ));
-                outfile << levelsNode->m_gamma << " " << levelsNode->m_luminanceOnly << " ";
-                outfile << levelsNode->m_inputRange.x << " " << levelsNode->m_inputRange.y << " ";
-                outfile << levelsNode->m_outputRange.x << " " << levelsNode->m_outputRange.y << " ";
-            }
-            break;
-        case NodeType::BLUR: 
-            {
-                outfile << node->ui.one.input << " ";
-                auto blurNode = dynamic_cast<BlurNode *>( m_graph.node( node->id ));
-                outfile << static_cast<int>( blurNode->m_blurMode );
-                outfile << blurNode->m_angle << " " << blurNode->m_samples << " " << blurNode->m_sigma << " " << blurNode->m_useAlpha << " ";
-                outfile << blurNode->m_center.x << " " << blurNode->m_center.y << " ";
-            }
-            break;
-        case NodeType::INVERT:
-            {
-                outfile << node->ui.one.input << " ";
-                auto invertNode = dynamic_cast<InvertNode *>( m_graph.node( node->id ));
-                outfile << invertNode->m_channels << " ";
-            }
-            break;
-        case NodeType::CURVES:
-            {
-                outfile << node->ui.one.input << " ";
-                auto op = dynamic_cast<CurvesNode *>( m_graph.node( node->id ));
-                outfile << op->m_red[0] << " " << op->m_red[1] << " " << op->m_red[2] << " " << op->m_red[3] << " " << op->m_red[4] << " ";
-                outfile << op->m_green[0] << " " << op->m_green[1] << " " << op->m_green[2] << " " << op->m_green[3] << " " << op->m_green[4] << " ";
-                outfile << op->m_blue[0] << " " << op->m_blue[1] << " " << op->m_blue[2] << " " << op->m_blue[3] << " " << op->m_blue[4] << " ";
-            }
-            break;
-        case NodeType::OUTPUT:
-            {
-                outfile << node->ui.one.input << " ";
-            }
-            break;
-        case NodeType::UNIFORM_COLOR: 
-            {
-                auto uniColNode = dynamic_cast<UniformColorNode *>( m_graph.node( node->id ));
-                outfile << uniColNode->m_color.asPart.red << " " << uniColNode->m_color.asPart.green << " " << uniColNode->m_color.asPart.blue << " " << uniColNode->m_color.asPart.alpha << " ";
-            }
-            break;
-        case NodeType::NOISE: 
-            {
-                auto noiseNode = dynamic_cast<NoiseNode *>( m_graph.node( node->id ));
-                outfile << static_cast<int>( noiseNode->m_mode ) << " ";
-                outfile << noiseNode->m_seed << " ";
-                outfile << noiseNode->m_scale << " ";
-
-                //other values
-            }
-            break;
-        case NodeType::IMAGE:
-            {
-                auto imageNode = dynamic_cast<ImageNode *>( m_graph.node( node->id ));
-                const std::string fname = imageNode->value->GetFilename();
-                const int strLen = static_cast<int>( fname.size() );
-                outfile << strLen << " " << fname << " ";
-            }
-            break;
-        case NodeType::DYNAMIC_IMAGE:
-            {
-                auto dynImage = dynamic_cast<DynamicImageNode *>( m_graph.node( node->id ));
-                const std::string fpath = dynImage->m_folderPath;
-                const int strLen = static_cast<int>( fpath.size() );
-                outfile << strLen << " " << fpath << " ";
-            }
-            break;
+            fileNode.inputs[0] = node->ui.two.lhs;
+            fileNode.inputs[1] = node->ui.two.rhs;
         }
+        else
+        {
+            fileNode.inputs[0] = node->ui.one.input;
+        }
+
+        const ImVec2 nodePos = ImNodes::GetNodeGridSpacePos( node->id );
+        fileNode.x = nodePos.x;
+        fileNode.y = nodePos.y;
+        fileNodes.push_back( fileNode );
     }
+    SaveGraphFile( filepath, m_graph, fileNodes );
+}
 
-    const auto edges = m_graph.edges();
-    outfile << edges.size() << " ";
-    for ( auto edge : edges)
-    {
-        outfile << edge.from << " " << edge.to << " ";
+
+// The UI side of a node loaded from a file, see LoadGraph.
+static UiNode *CreateUiNode( const NodeType type )
+{
+    switch ( type )
+    {
+    case NodeType::BLEND:         return new UiBlendNode();
+    case NodeType::HSL:           return new UiHSLNode();
+    case NodeType::LEVELS:        return new UiLevelsNode();
+    case NodeType::CURVES:        return new UiCurvesNode();
+    case NodeType::BLUR:          return new UiBlurNode();
+    case NodeType::INVERT:        return new UiInvertNode();
+    case NodeType::TRANSFORM:     return new UiTransformNode();
+    case NodeType::OUTPUT:        return new UiOutputNode();
+    case NodeType::UNIFORM_COLOR: return new UiUniformColorNode();
+    case NodeType::NOISE:         return new UiNoiseNode();
+    case NodeType::IMAGE:         return new UiImageNode();
+    case NodeType::DYNAMIC_IMAGE: return new UiDynamicImageNode();
+    default:                      return nullptr;
     }
-    outfile.close();
 }
 
+
 void NodeCanvas::LoadGraph( std::string filepath )
 {
-    std::ifstream infile( filepath, std::ifstream::binary );
-
-    std::vector<std::pair<int, int>> fixUpTable;
-    
-    int totalNodes;
-    infile >> totalNodes;
-    for( int i = 0; i < totalNodes; ++i)
+    std::vector<GraphFileNode> fileNodes;
+    if ( !LoadGraphFile( filepath, m_graph, fileNodes ) )
     {
-        int nodeTypeRaw;
-        infile >> nodeTypeRaw;
-        auto nodeType = static_cast<NodeType>( nodeTypeRaw );
-        
-        int nodeId;
-        infile >> nodeId;
+        // Don't leave half a graph behind.
+        ClearProject();
+        return;
+    }
 
-        ImVec2 nodePos;
-        infile >> nodePos.x >> nodePos.y;
-        
-        switch (nodeType)
+    for ( const GraphFileNode &fileNode : fileNodes )
+    {
+        UiNode *ui_node = CreateUiNode( fileNode.type );
+        ui_node->type = fileNode.type;
+        ui_node->id = fileNode.id;
+        if ( fileNode.type == NodeType::BLEND )
         {
-        case NodeType::BLEND:
-            {
-                Node *value = new Node(NodeType::VALUE);
-                BlendNode *op = new BlendNode();
-
-                UiBlendNode *ui_node = new UiBlendNode();
-                ui_node->type = NodeType::BLEND;
-
-                int oldLhs, oldRhs;
-                infile >> oldLhs >> oldRhs;
-                ui_node->ui.two.lhs = m_graph.insert_node(value);
-                ui_node->ui.two.rhs = m_graph.insert_node(value);
-                auto lhs = std::make_pair( oldLhs , ui_node->ui.two.lhs );
-                auto rhs = std::make_pair( oldRhs , ui_node->ui.two.rhs );
-                fixUpTable.push_back( lhs );
-                fixUpTable.push_back( rhs );
-
-                //Don't need to store old id, but need the pair for linking later.
-                ui_node->id = m_graph.insert_node(op);
-                auto nodePair = std::make_pair( nodeId, ui_node->id );
-                fixUpTable.push_back( nodePair );
-
-                m_nodes.push_back(ui_node);
-                ImNodes::SetNodeGridSpacePos(ui_node->id, nodePos);
-
-                int blendModeRaw;
-                infile >> blendModeRaw;
-                op->m_mode = static_cast<BlendCompute::BlendMode>( blendModeRaw );
-            }
-            break;
-        case NodeType::HSL:
-            {
-                Node *value = new Node(NodeType::VALUE);
-                HSLNode *op = new HSLNode();
-
-                UiHSLNode *ui_node = new UiHSLNode();
-                ui_node->type = NodeType::HSL;
-
-                int oldInput;
-                infile >> oldInput;
-                ui_node->ui.one.input = m_graph.insert_node(value);
-                auto inpair = std::make_pair( oldInput , ui_node->ui.one.input );
-                fixUpTable.push_back( inpair );
-
-                //Don't need to store old id, but need the pair for linking later.
-                ui_node->id = m_graph.insert_node(op);
-                auto nodePair = std::make_pair( nodeId, ui_node->id );
-                fixUpTable.push_back( nodePair );
-
-                m_nodes.push_back(ui_node);
-                ImNodes::SetNodeGridSpacePos(ui_node->id, nodePos);
-                
-                infile >> op->m_hue >> op->m_lightness >> op->m_saturation;
-            }
-            break;
-        case NodeType::LEVELS:
-            {
-                Node *value = new Node(NodeType::VALUE);
-                LevelsNode *op = new LevelsNode();
-
-                UiLevelsNode *ui_node = new UiLevelsNode();
-                ui_node->type = NodeType::LEVELS;
-
-                int oldInput;
-                infile >> oldInput;
-                ui_node->ui.one.input = m_graph.insert_node(value);
-                auto inpair = std::make_pair( oldInput , ui_node->ui.one.input );
-                fixUpTable.push_back( inpair );
-
-                //Don't need to store old id, but need the pair for linking later.
-                ui_node->id = m_graph.insert_node(op);
-                auto nodePair = std::make_pair( nodeId, ui_node->id );
-                fixUpTable.push_back( nodePair );
-
-                m_nodes.push_back(ui_node);
-                ImNodes::SetNodeGridSpacePos(ui_node->id, nodePos);
-                
-                infile >> op->m_gamma >> op->m_luminanceOnly;
-                infile >> op->m_inputRange.x >> op->m_inputRange.y;
-                infile >> op->m_outputRange.x >> op->m_outputRange.y;
-            }
-            break;
-        case NodeType::BLUR: 
-            {
-                Node *value = new Node(NodeType::VALUE);
-                BlurNode *op = new BlurNode();
-
-                UiBlurNode *ui_node = new UiBlurNode();
-                ui_node->type = NodeType::BLUR;
-
-                int oldInput;
-                infile >> oldInput;
-                ui_node->ui.one.input = m_graph.insert_node(value);
-                auto inpair = std::make_pair( oldInput , ui_node->ui.one.input );
-                fixUpTable.push_back( inpair );
-
-                //Don't need to store old id, but need the pair for linking later.
-                ui_node->id = m_graph.insert_node(op);
-                auto nodePair = std::make_pair( nodeId, ui_node->id );
-                fixUpTable.push_back( nodePair );
-
-                m_nodes.push_back(ui_node);
-                ImNodes::SetNodeGridSpacePos(ui_node->id, nodePos);
-                
-                int blurModeRaw;
-                infile >> blurModeRaw;
-                op->m_blurMode = static_cast<BlurCompute::BlurMode>( blurModeRaw );
-                infile >> op->m_angle >> op->m_samples >> op->m_sigma >> op->m_useAlpha;
-                infile >> op->m_center.x >> op->m_center.y;
-            }
-            break;
-        case NodeType::INVERT:
-            {
-                Node *value = new Node(NodeType::VALUE);
-                InvertNode *op = new InvertNode();
-
-                UiInvertNode *ui_node = new UiInvertNode();
-                ui_node->type = NodeType::INVERT;
-
-                int oldInput;
-                infile >> oldInput;
-                ui_node->ui.one.input = m_graph.insert_node(value);
-                auto inpair = std::make_pair( oldInput , ui_node->ui.one.input );
-                fixUpTable.push_back( inpair );
-
-                //Don't need to store old id, but need the pair for linking later.
-                ui_node->id = m_graph.insert_node(op);
-                auto nodePair = std::make_pair( nodeId, ui_node->id );
-                fixUpTable.push_back( nodePair );
-
-                m_nodes.push_back(ui_node);
-                ImNodes::SetNodeGridSpacePos(ui_node->id, nodePos);
-                
-                infile >> op->m_channels;
-            }
-            break;
-        case NodeType::CURVES:
-            {
-                Node *value = new Node(NodeType::VALUE);
-                CurvesNode *op = new CurvesNode();
-
-                UiCurvesNode *ui_node = new UiCurvesNode();
-                ui_node->type = NodeType::CURVES;
-
-                int oldInput;
-                infile >> oldInput;
-                ui_node->ui.one.input = m_graph.insert_node(value);
-                auto inpair = std::make_pair( oldInput , ui_node->ui.one.input );
-                fixUpTable.push_back( inpair );
-
-                //Don't need to store old id, but need the pair for linking later.
-                ui_node->id = m_graph.insert_node(op);
-                auto nodePair = std::make_pair( nodeId, ui_node->id );
-                fixUpTable.push_back( nodePair );
-
-                m_nodes.push_back(ui_node);
-                ImNodes::SetNodeGridSpacePos(ui_node->id, nodePos);
-                
-                infile >> op->m_red[0] >> op->m_red[1] >> op->m_red[2] >> op->m_red[3] >> op->m_red[4];
-                infile >> op->m_green[0] >> op->m_green[1] >> op->m_green[2] >> op->m_green[3] >> op->m_green[4];
-                infile >> op->m_blue[0] >> op->m_blue[1] >> op->m_blue[2] >> op->m_blue[3] >> op->m_blue[4];
-            }
-            break;
-        case NodeType::OUTPUT:
-            {
-                Node *value = new Node(NodeType::VALUE);
-                Node *out = new Node(NodeType::OUTPUT);
-
-                UiOutputNode *ui_node = new UiOutputNode();
-                ui_node->type = NodeType::OUTPUT;
-
-                int oldInput;
-                infile >> oldInput;
-                ui_node->ui.one.input = m_graph.insert_node(value);
-                auto inpair = std::make_pair( oldInput , ui_node->ui.one.input );
-                fixUpTable.push_back( inpair );
-
-                //Don't need to store old id, but need the pair for linking later.
-                ui_node->id = m_graph.insert_node(out);
-                auto nodePair = std::make_pair( nodeId, ui_node->id );
-                fixUpTable.push_back( nodePair );
-
-                m_nodes.push_back(ui_node);
-                ImNodes::SetNodeGridSpacePos(ui_node->id, nodePos);
-                //set the root node
-                m_rootNodeId = ui_node->id;
-            }
-            break;
-        case NodeType::UNIFORM_COLOR: 
-            {
-                UniformColorNode *op = new UniformColorNode();
-
-                UiUniformColorNode *ui_node = new UiUniformColorNode();
-                ui_node->type = NodeType::UNIFORM_COLOR;
-
-                //Don't need to store old id, but need the pair for linking later.
-                ui_node->id = m_graph.insert_node(op);
-                auto nodePair = std::make_pair( nodeId, ui_node->id );
-                fixUpTable.push_back( nodePair );
-
-                m_nodes.push_back(ui_node);
-                ImNodes::SetNodeGridSpacePos(ui_node->id, nodePos);
-
-                infile >> op->m_color.asPart.red >> op->m_color.asPart.green >> op->m_color.asPart.blue >> op->m_color.asPart.alpha;
-            }
-            break;
-        case NodeType::NOISE: 
-            {
-                NoiseNode *op = new NoiseNode();
-
-                UiNoiseNode *ui_node = new UiNoiseNode();
-                ui_node->type = NodeType::NOISE;
-
-                //Don't need to store old id, but need the pair for linking later.
-                ui_node->id = m_graph.insert_node(op);
-                auto nodePair = std::make_pair( nodeId, ui_node->id );
-                fixUpTable.push_back( nodePair );
-
-                m_nodes.push_back(ui_node);
-                ImNodes::SetNodeGridSpacePos(ui_node->id, nodePos);
-
-                int noiseModeRaw;
-                infile >> noiseModeRaw;
-                op->m_mode = static_cast<NoiseCompute::NoiseMode>( noiseModeRaw );
-
-                infile >> op->m_seed;
-                infile >> op->m_scale;
-                //TODO draperdanman: other values
-            }
-            break;
-        case NodeType::IMAGE:
-            {
-                int strLen;
-                infile >> strLen;
-                //char buffer[1024]; //longer than the max filepath in windows
-                //infile.read( buffer, strLen );
-                std::string imgFile;
-                infile >> imgFile;
-                
-                std::shared_ptr<Image> img = std::make_shared<Image>( imgFile );
-                ImageNode *op = new ImageNode( img );
-
-                UiImageNode *ui_node = new UiImageNode();
-                ui_node->type = NodeType::IMAGE;
-
-                //Don't need to store old id, but need the pair for linking later.
-                ui_node->id = m_graph.insert_node(op);
-                auto nodePair = std::make_pair( nodeId, ui_node->id );
-                fixUpTable.push_back( nodePair );
-
-                m_nodes.push_back(ui_node);
-                ImNodes::SetNodeGridSpacePos(ui_node->id, nodePos);
-            }
-            break;
-        case NodeType::DYNAMIC_IMAGE:
-            {
-                int strLen;
-                infile >> strLen;
-
-                std::string folderPath;
-                infile >> folderPath;
-                
-                DynamicImageNode *op = new DynamicImageNode( folderPath );
-
-                UiDynamicImageNode *ui_node = new UiDynamicImageNode();
-                ui_node->type = NodeType::DYNAMIC_IMAGE;
-
-                //Don't need to store old id, but need the pair for linking later.
-                ui_node->id = m_graph.insert_node(op);
-                auto nodePair = std::make_pair( nodeId, ui_node->id );
-                fixUpTable.push_back( nodePair );
-
-                m_nodes.push_back(ui_node);
-                ImNodes::SetNodeGridSpacePos(ui_node->id, nodePos);
-            }
-            break;
+            ui_node->ui.two.lhs = fileNode.inputs[0];
+            ui_node->ui.two.rhs = fileNode.inputs[1];
+        }
+        else
+        {
+            ui_node->ui.one.input = fileNode.inputs[0];
         }
-    }
-
-    int edgeTotal;
-    infile >> edgeTotal;
 
-    auto findFixup = [&fixUpTable](int id) -> int
-    {
-        for( const auto [fst, snd] : fixUpTable )
+        m_nodes.push_back( ui_node );
+        ImNodes::SetNodeGridSpacePos( ui_node->id, ImVec2( fileNode.x, fileNode.y ) );
+        if ( fileNode.type == NodeType::OUTPUT )
         {
-            if (fst == id)
-            {
-                return snd;
-            }
+            //set the root node
+            m_rootNodeId = ui_node->id;
         }
-        return -1;
-    };
-    
-    for (int i = 0; i < edgeTotal; ++i)
-    {
-        int from, to;
-        infile >> from >> to;
-        m_graph.insert_edge( findFixup(from), findFixup(to) );
     }
 
     if (m_rootNodeId != -1)
     {
-        m_outputImage = Evaluate(m_graph, m_rootNodeId);
-        Node *node = m_graph.node(m_rootNodeId);
-        node->value = m_outputImage;
-        m_graph.update_node( m_rootNodeId, node );
+        if ( Application::GetConfig().asyncEvaluation )
+        {
+            RequestEvaluation();
+        }
+        else
+        {
+            EvaluateNow();
+        }
     }
-    
-    infile.close();
 }
 
 
@@ -1013,6 +810,8 @@ void NodeCanvas::ClearProject()
     m_graph = Graph<Node *>();
     m_nodes.clear();
     m_rootNodeId = -1;
+    // Node ids start over, so anything still coming back from the worker would land on the wrong nodes.
+    ++m_generation;
 }
 
 }
\ No newline at end of file
@@ -4,8 +4,12 @@
 #include <memory>
 #include <utility>
 
+#include "BlankImageCache.h"
+#include "EvaluationWorker.h"
 #include "Graph.h"
 #include "Image.h"
+#include "ProxyImageCache.h"
+#include "TransientImagePool.h"
 #include "imgui.h"
 #include "imnodes.h"
 
@@ -22,7 +26,7 @@ public:
 
     bool RenderPropertiesWindow();
     void UiRender();
-    void Export() const;
+    void Export();
     void SaveGraph( std::string filepath );
     void LoadGraph( std::string filepath );
     void ClearProject();
@@ -34,14 +38,35 @@ private:
     void Init();
     void Shutdown();
 
-    std::shared_ptr<Image> Evaluate(const Graph<Node *> &graph, const int startNode) const;
+    std::shared_ptr<Image> Evaluate(const Graph<Node *> &graph, const int startNode, uint32_t resolutionDivisor = 1);
+    // Nodes whose images are on screen and must not go back to the transient pool.
+    std::vector<int> GetPinnedNodes() const;
+    // Evaluates the graph on this thread, rendering straight into the images shown in the UI.
+    void EvaluateNow( uint32_t resolutionDivisor = 1 );
+    // Hands a snapshot of the graph to the evaluation worker, see ApplyEvaluationResult.
+    void RequestEvaluation( uint32_t resolutionDivisor = 1 );
+    // Picks up the worker's last completed evaluation, if there is one.
+    void ApplyEvaluationResult();
     void DrawCreateNodeMenu( const ImVec2 createPos );
+    // Puts the Profiler's time for each node above it.
+    void DrawProfilerOverlay() const;
     Graph<Node *>          m_graph;
     std::vector<UiNode *>  m_nodes;
     int                    m_rootNodeId;
     ImNodesMiniMapLocation m_minimapLocation;
 
     std::shared_ptr<Image> m_outputImage;
+
+    TransientImagePool     m_imagePool;
+    BlankImageCache        m_blankImages;
+    ProxyImageCache        m_proxyImages;
+    EvaluationWorker      *m_worker = nullptr;
+    // Bumped whenever the worker's results no longer apply to the graph, e.g. a new project.
+    uint64_t               m_generation = 0;
+    // Whether a widget in the properties window is being dragged, and whether the images on screen
+    // came from a proxy evaluation, see AppConfig::proxyDivisor.
+    bool                   m_draggingParameter = false;
+    bool                   m_showingProxy = false;
 };
 
 }
\ No newline at end of file
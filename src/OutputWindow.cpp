@@ -17,7 +17,6 @@ OutputWindow::~OutputWindow()
 
 void OutputWindow::Init()
 {
-    m_outputImage = std::make_shared<Image>( 2048, 2048, ImageFormat::RGBA );
     Refresh();
 }
 
@@ -56,6 +55,14 @@ void OutputWindow::UiRender()
     //choose either the selected or the output node
     const std::shared_ptr<Image> output = (selectedNodeCount > 0 && m_isFollowingSelection) ? m_graph->node( selectedNodes[0] )->value : m_outputImage;
 
+    if ( !output )
+    {
+        // Only happens while a node has given its image back to the transient pool.
+        ImGui::TextDisabled( "Nothing to show until the next evaluation." );
+        ImGui::End();
+        return;
+    }
+
     float maxWidth = ImGui::GetWindowContentRegionWidth();
     
     const auto width = static_cast<float>( output->GetWidth() );
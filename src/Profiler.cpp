@@ -0,0 +1,353 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+#include "Application.h"
+
+namespace Surge
+{
+
+// Two queries per dispatch, far more than a batch of a large graph has in flight.
+static constexpr uint32_t MaxTimedDispatches = 4096;
+// Recording stops adding events past this, a long session would otherwise grow without bound.
+static constexpr size_t MaxEvents = 1u << 20;
+
+// What the calling thread is recording dispatches for, see NodeScope.
+static thread_local int         s_currentNodeId = -1;
+static thread_local uint64_t    s_currentEvaluation = 0;
+static thread_local const char *s_currentName = nullptr;
+// The query the dispatch being recorded on this thread began, so EndDispatch writes the other half.
+static thread_local uint32_t    s_openQuery = UINT32_MAX;
+
+
+Profiler::NodeScope::NodeScope( const int nodeId, std::string name )
+    : m_profiler( Application::GetProfiler() ), m_nodeId( nodeId ), m_name( std::move( name ) ), m_previousNodeId( s_currentNodeId ),
+      m_previousEvaluation( s_currentEvaluation ), m_previousName( s_currentName )
+{
+    if ( !m_profiler )
+    {
+        return;
+    }
+    s_currentNodeId = nodeId;
+    s_currentEvaluation = m_profiler->m_nextEvaluation++;
+    s_currentName = m_name.c_str();
+    m_start = m_profiler->Now();
+}
+
+
+Profiler::NodeScope::~NodeScope()
+{
+    if ( !m_profiler )
+    {
+        return;
+    }
+    s_currentNodeId = m_previousNodeId;
+    s_currentEvaluation = m_previousEvaluation;
+    s_currentName = m_previousName;
+    if ( !m_profiler->IsEnabled() )
+    {
+        return;
+    }
+
+    const double duration = m_profiler->Now() - m_start;
+    {
+        std::lock_guard<std::mutex> lock( m_profiler->m_mutex );
+        NodeTiming &timing = m_profiler->m_nodeTimings[m_nodeId];
+        timing.name = m_name;
+        timing.cpuMs = duration / 1000.0;
+    }
+    m_profiler->AddEvent( m_name, "node", m_profiler->GetThreadIndex(), m_start, duration );
+}
+
+
+Profiler::CpuScope::CpuScope( const char *name, const char *category ) : m_name( name ), m_category( category )
+{
+    Profiler *profiler = Application::GetProfiler();
+    if ( profiler && profiler->IsEnabled() )
+    {
+        m_profiler = profiler;
+        m_start = profiler->Now();
+    }
+}
+
+
+Profiler::CpuScope::~CpuScope()
+{
+    if ( m_profiler )
+    {
+        m_profiler->AddEvent( m_name, m_category, m_profiler->GetThreadIndex(), m_start, m_profiler->Now() - m_start );
+    }
+}
+
+
+Profiler::Profiler( VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device, const uint32_t queueFamily, const bool debugUtils )
+    : m_device( device )
+{
+    if ( physicalDevice == VK_NULL_HANDLE )
+    {
+        return;
+    }
+    if ( debugUtils )
+    {
+        m_cmdBeginLabel = reinterpret_cast<PFN_vkCmdBeginDebugUtilsLabelEXT>( vkGetInstanceProcAddr( instance, "vkCmdBeginDebugUtilsLabelEXT" ) );
+        m_cmdEndLabel = reinterpret_cast<PFN_vkCmdEndDebugUtilsLabelEXT>( vkGetInstanceProcAddr( instance, "vkCmdEndDebugUtilsLabelEXT" ) );
+    }
+
+    uint32_t count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties( physicalDevice, &count, nullptr );
+    std::vector<VkQueueFamilyProperties> families( count );
+    vkGetPhysicalDeviceQueueFamilyProperties( physicalDevice, &count, families.data() );
+    const uint32_t validBits = queueFamily < count ? families[queueFamily].timestampValidBits : 0;
+    if ( validBits == 0 )
+    {
+        printf( "[profiler] The compute queue can't write timestamps, only CPU times will be measured\n" );
+        return;
+    }
+    m_timestampMask = validBits >= 64 ? ~0ull : ( 1ull << validBits ) - 1;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties( physicalDevice, &properties );
+    m_timestampPeriod = properties.limits.timestampPeriod;
+
+    VkQueryPoolCreateInfo queryPoolCI = { VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+    queryPoolCI.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolCI.queryCount = MaxTimedDispatches * 2;
+    if ( vkCreateQueryPool( m_device, &queryPoolCI, nullptr, &m_queryPool ) != VK_SUCCESS )
+    {
+        m_queryPool = VK_NULL_HANDLE;
+        return;
+    }
+    m_freeQueries.reserve( MaxTimedDispatches );
+    for ( uint32_t i = MaxTimedDispatches; i > 0; --i )
+    {
+        m_freeQueries.push_back( ( i - 1 ) * 2 );
+    }
+}
+
+
+Profiler::~Profiler()
+{
+    if ( m_queryPool != VK_NULL_HANDLE )
+    {
+        vkDestroyQueryPool( m_device, m_queryPool, nullptr );
+    }
+}
+
+
+void Profiler::BeginDispatch( VkCommandBuffer cmdBuffer )
+{
+    if ( m_cmdBeginLabel )
+    {
+        VkDebugUtilsLabelEXT label = { VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT };
+        label.pLabelName = s_currentName ? s_currentName : "Dispatch";
+        m_cmdBeginLabel( cmdBuffer, &label );
+    }
+
+    s_openQuery = UINT32_MAX;
+    if ( !IsEnabled() || m_queryPool == VK_NULL_HANDLE )
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        if ( m_freeQueries.empty() )
+        {
+            // Every query is waiting on a command buffer, this dispatch goes untimed.
+            return;
+        }
+        s_openQuery = m_freeQueries.back();
+        m_freeQueries.pop_back();
+        m_pending[cmdBuffer].push_back( { s_openQuery, s_currentNodeId, s_currentEvaluation, s_currentName ? s_currentName : "Dispatch" } );
+    }
+    vkCmdResetQueryPool( cmdBuffer, m_queryPool, s_openQuery, 2 );
+    vkCmdWriteTimestamp( cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_queryPool, s_openQuery );
+}
+
+
+void Profiler::EndDispatch( VkCommandBuffer cmdBuffer )
+{
+    if ( s_openQuery != UINT32_MAX )
+    {
+        vkCmdWriteTimestamp( cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_queryPool, s_openQuery + 1 );
+        s_openQuery = UINT32_MAX;
+    }
+    if ( m_cmdEndLabel )
+    {
+        m_cmdEndLabel( cmdBuffer );
+    }
+}
+
+
+void Profiler::Resolve( VkCommandBuffer cmdBuffer, const double submitTime )
+{
+    std::vector<PendingDispatch> dispatches;
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        const auto pending = m_pending.find( cmdBuffer );
+        if ( pending == m_pending.end() )
+        {
+            return;
+        }
+        dispatches = std::move( pending->second );
+        m_pending.erase( pending );
+    }
+
+    std::vector<uint64_t> ticks( dispatches.size() * 2 );
+    for ( size_t i = 0; i < dispatches.size(); ++i )
+    {
+        vkGetQueryPoolResults( m_device, m_queryPool, dispatches[i].query, 2, sizeof( uint64_t ) * 2, &ticks[i * 2], sizeof( uint64_t ),
+                               VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT );
+    }
+
+    // The first dispatch is taken to start when the command buffer was submitted.
+    const uint64_t base = ticks[0] & m_timestampMask;
+    std::vector<Event> events;
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        for ( size_t i = 0; i < dispatches.size(); ++i )
+        {
+            const PendingDispatch &dispatch = dispatches[i];
+            const uint64_t begin = ticks[i * 2] & m_timestampMask;
+            const uint64_t end = ticks[i * 2 + 1] & m_timestampMask;
+            const double start = submitTime + static_cast<double>( ( begin - base ) & m_timestampMask ) * m_timestampPeriod / 1000.0;
+            const double duration = static_cast<double>( ( end - begin ) & m_timestampMask ) * m_timestampPeriod / 1000.0;
+            m_freeQueries.push_back( dispatch.query );
+
+            if ( dispatch.nodeId >= 0 )
+            {
+                NodeTiming &timing = m_nodeTimings[dispatch.nodeId];
+                uint64_t &evaluation = m_gpuEvaluations[dispatch.nodeId];
+                if ( evaluation != dispatch.evaluation )
+                {
+                    evaluation = dispatch.evaluation;
+                    timing.gpuMs = 0.0;
+                    timing.dispatches = 0;
+                }
+                timing.name = dispatch.name;
+                timing.gpuMs += duration / 1000.0;
+                ++timing.dispatches;
+            }
+            events.push_back( { dispatch.name, "gpu", GpuThread, start, duration } );
+        }
+    }
+    for ( Event &event : events )
+    {
+        AddEvent( std::move( event.name ), event.category, event.thread, event.start, event.duration );
+    }
+}
+
+
+double Profiler::Now() const
+{
+    return std::chrono::duration<double, std::micro>( std::chrono::steady_clock::now() - m_epoch ).count();
+}
+
+
+std::unordered_map<int, Profiler::NodeTiming> Profiler::GetNodeTimings() const
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    return m_nodeTimings;
+}
+
+
+std::unordered_map<std::string, Profiler::CategoryTotal> Profiler::GetCategoryTotals() const
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    return m_categoryTotals;
+}
+
+
+size_t Profiler::GetEventCount() const
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    return m_events.size();
+}
+
+
+void Profiler::Clear()
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    m_events.clear();
+    m_nodeTimings.clear();
+    m_gpuEvaluations.clear();
+    m_categoryTotals.clear();
+}
+
+
+void Profiler::AddEvent( std::string name, const char *category, const uint32_t thread, const double start, const double duration )
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    CategoryTotal &total = m_categoryTotals[category];
+    total.ms += duration / 1000.0;
+    ++total.count;
+    if ( m_events.size() < MaxEvents )
+    {
+        m_events.push_back( { std::move( name ), category, thread, start, duration } );
+    }
+}
+
+
+uint32_t Profiler::GetThreadIndex()
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    const auto index = m_threadIndices.emplace( std::this_thread::get_id(), static_cast<uint32_t>( m_threadIndices.size() ) + 1 );
+    return index.first->second;
+}
+
+
+// Node names are typed in by the user, so anything JSON treats specially has to be escaped.
+static std::string EscapeJson( const std::string &text )
+{
+    std::string escaped;
+    escaped.reserve( text.size() );
+    for ( const char c : text )
+    {
+        if ( c == '"' || c == '\\' )
+        {
+            escaped.push_back( '\\' );
+            escaped.push_back( c );
+        }
+        else if ( static_cast<unsigned char>( c ) < 0x20 )
+        {
+            char code[8];
+            snprintf( code, sizeof( code ), "\\u%04x", c );
+            escaped += code;
+        }
+        else
+        {
+            escaped.push_back( c );
+        }
+    }
+    return escaped;
+}
+
+
+bool Profiler::WriteChromeTrace( const std::string &filepath ) const
+{
+    std::ofstream file( filepath, std::ios::trunc );
+    if ( !file )
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock( m_mutex );
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << GpuThread << ",\"args\":{\"name\":\"GPU\"}}";
+    for ( const auto &thread : m_threadIndices )
+    {
+        file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread.second << ",\"args\":{\"name\":\"CPU " << thread.second << "\"}}";
+    }
+    char times[64];
+    for ( const Event &event : m_events )
+    {
+        snprintf( times, sizeof( times ), "\"ts\":%.3f,\"dur\":%.3f", event.start, event.duration );
+        file << ",\n{\"name\":\"" << EscapeJson( event.name ) << "\",\"cat\":\"" << event.category << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+             << event.thread << "," << times << "}";
+    }
+    file << "\n]}\n";
+    return file.good();
+}
+
+}
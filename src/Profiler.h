@@ -0,0 +1,161 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+namespace Surge
+{
+
+// Measures where evaluation time goes. CPU scopes time node evaluation, descriptor setup, uploads
+// and readbacks, and every compute dispatch is wrapped in a pair of timestamp queries that are
+// read back once its command buffer has completed. Times are kept per node for the canvas overlay
+// and the profiler window, and as a list of events that can be written out as a Chrome trace.
+//
+// Nothing is measured until it is enabled. Dispatches are labelled with the node they belong to
+// through VK_EXT_debug_utils either way, so GPU captures are readable. Safe to use from any thread.
+class Profiler
+{
+public:
+    // Events on this thread are the GPU's, the others are numbered in the order they first recorded something.
+    static constexpr uint32_t GpuThread = 0;
+
+    struct Event
+    {
+        std::string name;
+        const char *category;
+        uint32_t thread;
+        // In microseconds since the profiler was made. GPU events are placed relative to when
+        // their command buffer was submitted, the two clocks are not synchronised.
+        double start;
+        double duration;
+    };
+
+    struct NodeTiming
+    {
+        std::string name;
+        // Milliseconds spent the last time the node was evaluated, recording its dispatches on the
+        // CPU and running them on the GPU.
+        double cpuMs = 0.0;
+        double gpuMs = 0.0;
+        uint32_t dispatches = 0;
+    };
+
+    struct CategoryTotal
+    {
+        double ms = 0.0;
+        uint64_t count = 0;
+    };
+
+    // Puts every dispatch recorded on the calling thread while it is alive down to the node, and
+    // times it on the CPU. Scopes can nest, the innermost one wins.
+    class NodeScope
+    {
+    public:
+        NodeScope( int nodeId, std::string name );
+        ~NodeScope();
+
+        NodeScope( const NodeScope & ) = delete;
+        NodeScope &operator=( const NodeScope & ) = delete;
+
+    private:
+        Profiler *m_profiler = nullptr;
+        int m_nodeId;
+        std::string m_name;
+        double m_start = 0.0;
+        int m_previousNodeId;
+        uint64_t m_previousEvaluation;
+        const char *m_previousName;
+    };
+
+    // Times the enclosing block on the CPU.
+    class CpuScope
+    {
+    public:
+        CpuScope( const char *name, const char *category );
+        ~CpuScope();
+
+        CpuScope( const CpuScope & ) = delete;
+        CpuScope &operator=( const CpuScope & ) = delete;
+
+    private:
+        Profiler *m_profiler = nullptr;
+        const char *m_name;
+        const char *m_category;
+        double m_start = 0.0;
+    };
+
+    // queueFamily is the one compute work is submitted to. With debugUtils the instance was made
+    // with VK_EXT_debug_utils enabled. Without a physicalDevice only CPU times are measured.
+    Profiler( VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamily, bool debugUtils );
+    ~Profiler();
+
+    Profiler( const Profiler & ) = delete;
+    Profiler &operator=( const Profiler & ) = delete;
+
+    void SetEnabled( bool enabled ) { m_enabled = enabled; }
+    bool IsEnabled() const { return m_enabled; }
+    // False when the queue can't write timestamps, only CPU times are measured then.
+    bool HasGpuTimes() const { return m_queryPool != VK_NULL_HANDLE; }
+
+    // Called by ComputeBase::RecordDispatch on either side of every dispatch.
+    void BeginDispatch( VkCommandBuffer cmdBuffer );
+    void EndDispatch( VkCommandBuffer cmdBuffer );
+    // Called by Application once cmdBuffer, submitted at submitTime, has completed, and before it
+    // is freed. Reads back the timestamps its dispatches wrote.
+    void Resolve( VkCommandBuffer cmdBuffer, double submitTime );
+
+    // Microseconds since the profiler was made, the clock every event is on.
+    double Now() const;
+
+    std::unordered_map<int, NodeTiming> GetNodeTimings() const;
+    std::unordered_map<std::string, CategoryTotal> GetCategoryTotals() const;
+    size_t GetEventCount() const;
+    // Forgets every event and timing recorded so far.
+    void Clear();
+    // Writes the events as Chrome trace-event JSON, which chrome://tracing and Perfetto open.
+    bool WriteChromeTrace( const std::string &filepath ) const;
+
+private:
+    struct PendingDispatch
+    {
+        uint32_t query;
+        int nodeId;
+        uint64_t evaluation;
+        std::string name;
+    };
+
+    void AddEvent( std::string name, const char *category, uint32_t thread, double start, double duration );
+    uint32_t GetThreadIndex();
+
+    const std::chrono::steady_clock::time_point m_epoch = std::chrono::steady_clock::now();
+    std::atomic<bool> m_enabled = false;
+    std::atomic<uint64_t> m_nextEvaluation = 1;
+
+    VkDevice m_device;
+    VkQueryPool m_queryPool = VK_NULL_HANDLE;
+    // Nanoseconds per timestamp tick, and the bits of each timestamp that are valid.
+    double m_timestampPeriod = 1.0;
+    uint64_t m_timestampMask = ~0ull;
+    PFN_vkCmdBeginDebugUtilsLabelEXT m_cmdBeginLabel = nullptr;
+    PFN_vkCmdEndDebugUtilsLabelEXT m_cmdEndLabel = nullptr;
+
+    mutable std::mutex m_mutex;
+    // The first of each pair of queries that isn't in use.
+    std::vector<uint32_t> m_freeQueries;
+    std::unordered_map<VkCommandBuffer, std::vector<PendingDispatch>> m_pending;
+    std::unordered_map<int, NodeTiming> m_nodeTimings;
+    // The evaluation each node's GPU time so far belongs to, a new one starts it over.
+    std::unordered_map<int, uint64_t> m_gpuEvaluations;
+    std::unordered_map<std::string, CategoryTotal> m_categoryTotals;
+    std::unordered_map<std::thread::id, uint32_t> m_threadIndices;
+    std::vector<Event> m_events;
+};
+
+}
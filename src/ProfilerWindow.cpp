@@ -0,0 +1,120 @@
+﻿#include "ProfilerWindow.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <nfd.h>
+#include <vector>
+
+#include "Application.h"
+#include "imgui.h"
+
+namespace Surge
+{
+
+void ProfilerWindow::UiRender()
+{
+    Profiler *profiler = Application::GetProfiler();
+
+    ImGui::Begin( "Profiler" );
+    bool recording = profiler->IsEnabled();
+    if ( ImGui::Checkbox( "Record", &recording ) )
+    {
+        profiler->SetEnabled( recording );
+    }
+    ImGui::SameLine();
+    if ( ImGui::Button( "Clear" ) )
+    {
+        profiler->Clear();
+    }
+    ImGui::SameLine();
+    if ( ImGui::Button( "Export Trace" ) )
+    {
+        ExportTrace();
+    }
+    ImGui::SameLine();
+    ImGui::TextDisabled( "%zu events", profiler->GetEventCount() );
+    if ( !m_exportError.empty() )
+    {
+        ImGui::TextColored( ImVec4( 1.0f, 0.4f, 0.4f, 1.0f ), "%s", m_exportError.c_str() );
+    }
+    if ( !profiler->HasGpuTimes() )
+    {
+        ImGui::TextDisabled( "This GPU can't time compute work, only CPU times are shown." );
+    }
+
+    // Slowest on the GPU first, that is where optimising pays off.
+    const auto timings = profiler->GetNodeTimings();
+    std::vector<std::pair<int, Profiler::NodeTiming>> nodes( timings.begin(), timings.end() );
+    std::sort( nodes.begin(), nodes.end(), []( const auto &a, const auto &b ) { return a.second.gpuMs > b.second.gpuMs; } );
+
+    constexpr ImGuiTableFlags tableFlags = ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_SizingStretchProp;
+    if ( ImGui::BeginTable( "Nodes", 4, tableFlags ) )
+    {
+        ImGui::TableSetupColumn( "Node" );
+        ImGui::TableSetupColumn( "GPU ms" );
+        ImGui::TableSetupColumn( "CPU ms" );
+        ImGui::TableSetupColumn( "Dispatches" );
+        ImGui::TableHeadersRow();
+        for ( const auto &node : nodes )
+        {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text( "%s (%d)", node.second.name.c_str(), node.first );
+            ImGui::TableNextColumn();
+            ImGui::Text( "%.3f", node.second.gpuMs );
+            ImGui::TableNextColumn();
+            ImGui::Text( "%.3f", node.second.cpuMs );
+            ImGui::TableNextColumn();
+            ImGui::Text( "%u", node.second.dispatches );
+        }
+        ImGui::EndTable();
+    }
+
+    ImGui::Separator();
+    const auto totals = profiler->GetCategoryTotals();
+    if ( ImGui::BeginTable( "Totals", 3, tableFlags ) )
+    {
+        ImGui::TableSetupColumn( "Since recording started" );
+        ImGui::TableSetupColumn( "Total ms" );
+        ImGui::TableSetupColumn( "Count" );
+        ImGui::TableHeadersRow();
+        for ( const auto &total : totals )
+        {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted( total.first.c_str() );
+            ImGui::TableNextColumn();
+            ImGui::Text( "%.3f", total.second.ms );
+            ImGui::TableNextColumn();
+            ImGui::Text( "%llu", static_cast<unsigned long long>( total.second.count ) );
+        }
+        ImGui::EndTable();
+    }
+    ImGui::End();
+}
+
+
+void ProfilerWindow::ExportTrace()
+{
+    nfdchar_t *savePath = nullptr;
+    const nfdresult_t result = NFD_SaveDialog( "json", nullptr, &savePath );
+    if ( result != NFD_OKAY )
+    {
+        if ( result == NFD_ERROR )
+        {
+            fprintf( stderr, "Error: %s\n", NFD_GetError() );
+        }
+        return;
+    }
+
+    std::string filepath = savePath;
+    free( savePath );
+    if ( std::filesystem::path( filepath ).extension() != ".json" )
+    {
+        filepath += ".json";
+    }
+    m_exportError = Application::GetProfiler()->WriteChromeTrace( filepath ) ? std::string() : "Could not write " + filepath;
+}
+
+}
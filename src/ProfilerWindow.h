@@ -0,0 +1,21 @@
+﻿#pragma once
+
+#include <string>
+
+namespace Surge
+{
+// Shows what the Profiler measured: how long each node took on the CPU and GPU the last time it
+// was evaluated, and the totals of every kind of work since recording started. Recording is
+// started and stopped here, and what was recorded can be saved as a Chrome trace.
+class ProfilerWindow
+{
+public:
+    void UiRender();
+
+private:
+    void ExportTrace();
+
+    // Set when the last export failed, shown until the next one.
+    std::string m_exportError;
+};
+}
@@ -0,0 +1,80 @@
+#include "ProxyImageCache.h"
+
+#include <algorithm>
+
+#include "Application.h"
+#include "Compute/ComputeKernels.h"
+#include "Compute/CpuKernels.h"
+#include "Compute/DownsampleCompute.h"
+
+namespace Surge
+{
+
+std::shared_ptr<Image> ProxyImageCache::Get( const std::shared_ptr<Image> &source, const uint32_t factor, const ImageStorage storage,
+                                             ImageFormat format, const uint64_t stamp )
+{
+    if ( format == ImageFormat::None )
+    {
+        format = source->GetFormat();
+    }
+    if ( factor <= 1 && source->GetStorage() == storage && source->GetFormat() == format )
+    {
+        return source;
+    }
+
+    std::lock_guard<std::mutex> lock( m_mutex );
+
+    // Copies of images nobody holds any more are of no use, and their address may be reused.
+    for ( auto iter = m_entries.begin(); iter != m_entries.end(); )
+    {
+        iter = iter->second.source.expired() ? m_entries.erase( iter ) : std::next( iter );
+    }
+
+    Entry &entry = m_entries[Key( source.get(), factor, storage, format )];
+    if ( !entry.proxy || entry.stamp != stamp )
+    {
+        // Shrunk and converted where the source is, then moved if it has to be.
+        entry.source = source;
+        entry.stamp = stamp;
+        std::shared_ptr<Image> shrunk = source;
+        if ( factor > 1 )
+        {
+            shrunk = std::make_shared<Image>( std::max( 1u, source->GetWidth() / factor ), std::max( 1u, source->GetHeight() / factor ),
+                                              source->GetFormat(), nullptr, source->GetStorage() );
+            if ( source->IsHost() )
+            {
+                CpuKernels::Downsample( source.get(), shrunk.get(), static_cast<int>( factor ) );
+            }
+            else
+            {
+                ComputeKernels::Get<DownsampleCompute>()->Run( source.get(), shrunk.get(), static_cast<int>( factor ) );
+            }
+        }
+
+        if ( shrunk->GetFormat() != format )
+        {
+            std::shared_ptr<Image> converted = std::make_shared<Image>( shrunk->GetWidth(), shrunk->GetHeight(), format, nullptr, shrunk->GetStorage() );
+            converted->CopyFrom( *shrunk );
+            // Inside a batch the copy hasn't run yet.
+            Application::SubmitComputeResourceFree( [shrunk]() {} );
+            shrunk = converted;
+        }
+
+        entry.proxy = shrunk;
+        if ( shrunk->GetStorage() != storage )
+        {
+            entry.proxy = std::make_shared<Image>( shrunk->GetWidth(), shrunk->GetHeight(), shrunk->GetFormat(), nullptr, storage );
+            if ( storage == ImageStorage::Host )
+            {
+                shrunk->GetData( entry.proxy->GetPixels() );
+            }
+            else
+            {
+                entry.proxy->SetData( shrunk->GetPixels() );
+            }
+        }
+    }
+    return entry.proxy;
+}
+
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+
+#include "Image.h"
+
+namespace Surge
+{
+
+// Shrunk copies of the images source nodes hand on, for evaluations at a fraction of the full
+// resolution. Each image is shrunk the first time it is asked for at a factor and the copy is kept
+// for as long as the image is around, so dragging a parameter doesn't shrink the sources every time.
+// The same goes for copies moved between the GPU and host memory, for the CpuKernels, and ones
+// converted to another format, e.g. HDR images to half floats, or 8 bit inputs of a node working in floats.
+// Images that are rendered into again, e.g. a node's kept at full resolution, are told apart by a stamp.
+class ProxyImageCache
+{
+public:
+    // source divided by factor in both directions, see DownsampleCompute, kept in storage and
+    // converted to format, if it isn't None. With a factor of 1 and the storage and format source
+    // already has, that is source itself. The copy is made again whenever stamp differs from the
+    // one it was made with.
+    std::shared_ptr<Image> Get( const std::shared_ptr<Image> &source, uint32_t factor, ImageStorage storage = ImageStorage::Device,
+                                ImageFormat format = ImageFormat::None, uint64_t stamp = 0 );
+
+private:
+    struct Entry
+    {
+        std::weak_ptr<Image>   source;
+        std::shared_ptr<Image> proxy;
+        uint64_t               stamp = 0;
+    };
+    using Key = std::tuple<const Image *, uint32_t, ImageStorage, ImageFormat>;
+
+    std::mutex           m_mutex;
+    std::map<Key, Entry> m_entries;
+};
+
+}
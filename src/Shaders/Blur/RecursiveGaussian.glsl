@@ -0,0 +1,61 @@
+#ifndef RECURSIVE_GAUSSIAN_GLSL
+#define RECURSIVE_GAUSSIAN_GLSL
+
+// Young and van Vliet's recursive Gaussian, one row or column per invocation. A causal pass runs
+// along the line and an anti-causal one back over it, each only looking at the three values before
+// it, so the cost per pixel is the same however large sigma is.
+//
+// Expects inputImage and resultImage to be declared, DIRECTION to be the step along a line, and
+// FORWARD_IMAGE to be the rgba32f image the causal pass can be kept in until the anti-causal one
+// reads it back.
+
+layout(local_size_x_id = 0, local_size_y_id = 1) in;
+layout(push_constant) uniform Parameters {
+   float b;
+   float a1;
+   float a2;
+   float a3;
+} params;
+
+void main()
+{
+    ivec2 size = imageSize(inputImage);
+    ivec2 across = ivec2(DIRECTION.y, DIRECTION.x);
+    int length = DIRECTION.x * size.x + DIRECTION.y * size.y;
+    int lineCount = across.x * size.x + across.y * size.y;
+    int line = int(gl_WorkGroupID.x * gl_WorkGroupSize.x * gl_WorkGroupSize.y + gl_LocalInvocationIndex);
+    if (line >= lineCount)
+    {
+        return;
+    }
+    ivec2 start = across * line;
+
+    // Both passes start as if the edge pixel carried on forever, which the filter leaves unchanged.
+    vec4 w1 = imageLoad(inputImage, start);
+    vec4 w2 = w1;
+    vec4 w3 = w1;
+    for (int i = 0; i < length; ++i)
+    {
+        ivec2 coords = start + DIRECTION * i;
+        vec4 w = params.b * imageLoad(inputImage, coords) + params.a1 * w1 + params.a2 * w2 + params.a3 * w3;
+        imageStore(FORWARD_IMAGE, coords, w);
+        w3 = w2;
+        w2 = w1;
+        w1 = w;
+    }
+
+    vec4 y1 = w1;
+    vec4 y2 = w1;
+    vec4 y3 = w1;
+    for (int i = length - 1; i >= 0; --i)
+    {
+        ivec2 coords = start + DIRECTION * i;
+        vec4 y = params.b * imageLoad(FORWARD_IMAGE, coords) + params.a1 * y1 + params.a2 * y2 + params.a3 * y3;
+        imageStore(resultImage, coords, y);
+        y3 = y2;
+        y2 = y1;
+        y1 = y;
+    }
+}
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef IMAGE_FORMAT_GLSL
+#define IMAGE_FORMAT_GLSL
+
+// The format of the images a kernel reads and writes, so they can be declared
+// `layout (binding = 0, IMAGE_FORMAT)`. Every kernel is built once per format, the float variants
+// with IMAGE_FORMAT_RGBA16F or IMAGE_FORMAT_RGBA32F defined, see ComputeBase::CreateFormatPipelines.
+// IMAGE_FLOAT tells them apart from the rgba8 one, whose stores clamp to [0, 1].
+#if defined(IMAGE_FORMAT_RGBA32F)
+#define IMAGE_FORMAT rgba32f
+#define IMAGE_FLOAT 1
+#elif defined(IMAGE_FORMAT_RGBA16F)
+#define IMAGE_FORMAT rgba16f
+#define IMAGE_FLOAT 1
+#else
+#define IMAGE_FORMAT rgba8
+#define IMAGE_FLOAT 0
+#endif
+
+#endif
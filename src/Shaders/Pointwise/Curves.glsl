@@ -0,0 +1,16 @@
+#ifndef POINTWISE_CURVES_GLSL
+#define POINTWISE_CURVES_GLSL
+
+// Where a channel value is looked up in the curves LUT.
+ivec2 CurvesLUTCoord(float value, int widthLUT)
+{
+    return ivec2(value*widthLUT,0);
+}
+
+// red, green and blue are the LUT entries at CurvesLUTCoord of the pixel's own channels.
+vec4 ApplyCurves(vec4 pixel, vec4 red, vec4 green, vec4 blue)
+{
+    return vec4(red.r, green.g, blue.b, pixel.a);
+}
+
+#endif
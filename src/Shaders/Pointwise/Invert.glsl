@@ -0,0 +1,16 @@
+#ifndef POINTWISE_INVERT_GLSL
+#define POINTWISE_INVERT_GLSL
+
+const int red = 1;
+const int green = 2;
+const int blue = 4;
+const int alpha = 8;
+
+vec4 ApplyInvert(vec4 rgba, int channels)
+{
+    vec4 channelInvert = vec4( (channels & red) != 0, (channels & green) != 0,
+(channels & blue) != 0, (channels & alpha) != 0 );
+    return abs(channelInvert - rgba);
+}
+
+#endif
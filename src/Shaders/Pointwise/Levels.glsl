@@ -0,0 +1,30 @@
+#ifndef POINTWISE_LEVELS_GLSL
+#define POINTWISE_LEVELS_GLSL
+
+vec4 ApplyLevels(vec4 rgba, vec2 inputRange, vec2 outputRange, float gamma, float luminanceOnly)
+{
+    vec3 rgb = rgba.rgb;
+    vec3 result;
+    if (luminanceOnly < 0.5)
+    {
+        // RGB mode
+        rgb = (rgb - inputRange.x) / (inputRange.y - inputRange.x);
+        rgb = pow(clamp(rgb, 0.0, 1.0), vec3(1.0 / gamma));
+        result = rgb * (outputRange.y - outputRange.x) + outputRange.x;
+    }
+    else
+    {
+        // luma mode
+        float luma = dot(rgb, vec3(.25, .5, .25));
+        vec3 chroma = rgb - vec3(luma);
+        luma = (luma - inputRange.x) / (inputRange.y - inputRange.x);
+        luma = pow(clamp(luma, 0.0, 1.0), 1.0 / gamma);
+        luma = luma * (outputRange.y - outputRange.x) + outputRange.x;
+        result = vec3(luma) + chroma;
+    }
+
+    //TODO DraperDanMan: support alpha blend modes
+    return vec4(result, 1.0);
+}
+
+#endif
@@ -0,0 +1,144 @@
+#include "StagingRing.h"
+
+#include "Application.h"
+
+namespace Surge
+{
+
+// Keeps every region's offset valid for buffer to image copies of any format.
+static constexpr VkDeviceSize s_RegionAlignment = 256;
+
+static VkBuffer CreateStagingBuffer(VkDevice device, VkDeviceSize size, GpuAllocation& memory)
+{
+	VkBufferCreateInfo buffer_info = {};
+	buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buffer_info.size = size;
+	buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkResult err = vkCreateBuffer(device, &buffer_info, nullptr, &buffer);
+	check_vk_result(err);
+
+	VkMemoryRequirements req;
+	vkGetBufferMemoryRequirements(device, buffer, &req);
+	// Coherent, so the mapped memory never has to be flushed or invalidated.
+	memory = Application::GetGpuAllocator()->Allocate(req, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, GpuResourceTiling::Linear);
+	err = vkBindBufferMemory(device, buffer, memory.memory, memory.offset);
+	check_vk_result(err);
+	return buffer;
+}
+
+StagingRing::StagingRing(VkDevice device, VkDeviceSize size)
+	: m_device(device), m_size(size)
+{
+	m_buffer = CreateStagingBuffer(m_device, m_size, m_memory);
+}
+
+StagingRing::~StagingRing()
+{
+	vkDestroyBuffer(m_device, m_buffer, nullptr);
+	Application::GetGpuAllocator()->Free(m_memory);
+}
+
+bool StagingRing::TryAcquire(VkDeviceSize size, StagingRegion& region)
+{
+	VkDeviceSize begin = 0;
+	if (!m_inFlight.empty())
+	{
+		const VkDeviceSize tail = m_inFlight.front().begin;
+		const VkDeviceSize head = ( m_inFlight.back().end + s_RegionAlignment - 1 ) / s_RegionAlignment * s_RegionAlignment;
+		if (m_inFlight.back().begin >= tail)
+		{
+			// Everything in flight sits between tail and head, there's room after head and before tail.
+			if (head + size <= m_size)
+			{
+				begin = head;
+			}
+			else if (size <= tail)
+			{
+				begin = 0;
+			}
+			else
+			{
+				return false;
+			}
+		}
+		else if (head + size <= tail)
+		{
+			// Wrapped around, the only room left is between head and tail.
+			begin = head;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	m_inFlight.push_back({ begin, begin + size, m_nextId, false });
+	region.buffer = m_buffer;
+	region.offset = begin;
+	region.mapped = static_cast<char*>( m_memory.mapped ) + begin;
+	region.id = m_nextId++;
+	return true;
+}
+
+StagingRegion StagingRing::AcquireOverflow(VkDeviceSize size)
+{
+	StagingRegion region;
+	region.buffer = CreateStagingBuffer(m_device, size, region.overflow);
+	region.mapped = region.overflow.mapped;
+	return region;
+}
+
+StagingRegion StagingRing::Acquire(VkDeviceSize size)
+{
+	if (size > m_size)
+	{
+		return AcquireOverflow(size);
+	}
+
+	StagingRegion region;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (TryAcquire(size, region))
+		{
+			return region;
+		}
+	}
+
+	// Whatever this thread's batch has recorded can only complete once it is submitted.
+	Application::FlushComputeBatch();
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_released.wait(lock, [&]() { return TryAcquire(size, region); });
+	return region;
+}
+
+void StagingRing::Release(const StagingRegion& region)
+{
+	if (region.overflow.block)
+	{
+		vkDestroyBuffer(m_device, region.buffer, nullptr);
+		Application::GetGpuAllocator()->Free(region.overflow);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (InFlight& inFlight : m_inFlight)
+		{
+			if (inFlight.id == region.id)
+			{
+				inFlight.released = true;
+				break;
+			}
+		}
+		while (!m_inFlight.empty() && m_inFlight.front().released)
+		{
+			m_inFlight.pop_front();
+		}
+	}
+	m_released.notify_all();
+}
+
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+#include "GpuAllocator.h"
+#include "vulkan/vulkan.h"
+
+namespace Surge
+{
+
+// A piece of the staging ring, or of a one-off buffer when a transfer doesn't fit in the ring at all.
+struct StagingRegion
+{
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	void* mapped = nullptr;
+
+	uint64_t id = 0;
+	GpuAllocation overflow;
+};
+
+// One persistently mapped, host visible buffer that every upload and readback streams through,
+// rather than each image holding on to a staging buffer of its own. Space is handed out in order
+// and comes back once the submission that used it has completed, so a region has to be released
+// from Application::SubmitComputeResourceFree after the commands reading or writing it are flushed.
+class StagingRing
+{
+public:
+	StagingRing(VkDevice device, VkDeviceSize size);
+	~StagingRing();
+
+	StagingRing(const StagingRing&) = delete;
+	StagingRing& operator=(const StagingRing&) = delete;
+
+	// Waits for earlier transfers to complete if the ring is full. If the calling thread has a
+	// compute batch open, that batch is flushed first since it may be what holds the space.
+	StagingRegion Acquire(VkDeviceSize size);
+	void Release(const StagingRegion& region);
+
+private:
+	struct InFlight
+	{
+		VkDeviceSize begin;
+		VkDeviceSize end;
+		uint64_t id;
+		bool released;
+	};
+
+	bool TryAcquire(VkDeviceSize size, StagingRegion& region);
+	StagingRegion AcquireOverflow(VkDeviceSize size);
+
+	VkDevice m_device = VK_NULL_HANDLE;
+	VkBuffer m_buffer = VK_NULL_HANDLE;
+	GpuAllocation m_memory;
+	VkDeviceSize m_size = 0;
+
+	std::mutex m_mutex;
+	std::condition_variable m_released;
+	// Oldest first, released regions are only dropped once everything before them is released too.
+	std::deque<InFlight> m_inFlight;
+	uint64_t m_nextId = 1;
+};
+
+}
@@ -0,0 +1,213 @@
+#include "StreamingPngWriter.h"
+
+#include <algorithm>
+#include <array>
+
+namespace Surge
+{
+
+// The largest a stored deflate block can be.
+static constexpr size_t MaxStoredBlock = 65535;
+
+
+static uint32_t Crc32( const uint8_t *data, const size_t size, uint32_t crc = 0 )
+{
+    static const std::array<uint32_t, 256> table = []()
+    {
+        std::array<uint32_t, 256> entries = {};
+        for ( uint32_t i = 0; i < 256; ++i )
+        {
+            uint32_t c = i;
+            for ( int bit = 0; bit < 8; ++bit )
+            {
+                c = ( c & 1 ) ? 0xedb88320u ^ ( c >> 1 ) : c >> 1;
+            }
+            entries[i] = c;
+        }
+        return entries;
+    }();
+
+    crc = ~crc;
+    for ( size_t i = 0; i < size; ++i )
+    {
+        crc = table[( crc ^ data[i] ) & 0xff] ^ ( crc >> 8 );
+    }
+    return ~crc;
+}
+
+
+static uint32_t Adler32( const uint8_t *data, size_t size, const uint32_t adler )
+{
+    uint32_t a = adler & 0xffff, b = adler >> 16;
+    while ( size > 0 )
+    {
+        // The most bytes that can be summed before b could overflow.
+        const size_t run = std::min<size_t>( size, 5552 );
+        for ( size_t i = 0; i < run; ++i )
+        {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        data += run;
+        size -= run;
+    }
+    return ( b << 16 ) | a;
+}
+
+
+static void PutBigEndian( std::vector<uint8_t> &out, const uint32_t value )
+{
+    out.push_back( static_cast<uint8_t>( value >> 24 ) );
+    out.push_back( static_cast<uint8_t>( value >> 16 ) );
+    out.push_back( static_cast<uint8_t>( value >> 8 ) );
+    out.push_back( static_cast<uint8_t>( value ) );
+}
+
+
+static bool has_suffix( const std::string &str, const std::string &suffix )
+{
+    return str.size() >= suffix.size() && str.compare( str.size() - suffix.size(), suffix.size(), suffix ) == 0;
+}
+
+
+StreamingPngWriter::~StreamingPngWriter()
+{
+    if ( m_file )
+    {
+        fclose( m_file );
+    }
+}
+
+
+bool StreamingPngWriter::Open( std::string filepath, const uint32_t width, const uint32_t height )
+{
+    if ( !has_suffix( filepath, ".png" ) )
+    {
+        filepath.append( ".png" );
+    }
+    if ( m_file || width == 0 || height == 0 )
+    {
+        return false;
+    }
+    m_file = fopen( filepath.c_str(), "wb" );
+    if ( !m_file )
+    {
+        return false;
+    }
+    m_width = width;
+    m_height = height;
+    m_rowsWritten = 0;
+    m_pending.clear();
+    m_adler = 1;
+    m_failed = false;
+
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    m_failed |= fwrite( signature, 1, sizeof( signature ), m_file ) != sizeof( signature );
+
+    std::vector<uint8_t> header;
+    PutBigEndian( header, width );
+    PutBigEndian( header, height );
+    // 8 bits per channel, RGBA, deflate, adaptive filtering, not interlaced.
+    header.insert( header.end(), { 8, 6, 0, 0, 0 } );
+    WriteChunk( "IHDR", header.data(), header.size() );
+
+    // The zlib stream's header, deflate with a 32k window and no preset dictionary.
+    static const uint8_t zlibHeader[2] = { 0x78, 0x01 };
+    WriteChunk( "IDAT", zlibHeader, sizeof( zlibHeader ) );
+    return !m_failed;
+}
+
+
+bool StreamingPngWriter::WriteRows( const uint8_t *rows, const uint32_t count )
+{
+    if ( !m_file || m_rowsWritten + count > m_height )
+    {
+        return false;
+    }
+
+    const size_t rowSize = static_cast<size_t>( m_width ) * 4;
+    for ( uint32_t row = 0; row < count; ++row )
+    {
+        // Every row goes in unfiltered, the filter would only help a compressor.
+        m_pending.push_back( 0 );
+        m_pending.insert( m_pending.end(), rows + row * rowSize, rows + ( row + 1 ) * rowSize );
+        if ( m_pending.size() >= MaxStoredBlock )
+        {
+            WriteBlocks( false );
+        }
+    }
+    m_rowsWritten += count;
+    return !m_failed;
+}
+
+
+bool StreamingPngWriter::Close()
+{
+    if ( !m_file )
+    {
+        return false;
+    }
+
+    const bool complete = m_rowsWritten == m_height;
+    WriteBlocks( true );
+    WriteChunk( "IEND", nullptr, 0 );
+    m_failed |= fclose( m_file ) != 0;
+    m_file = nullptr;
+    return complete && !m_failed;
+}
+
+
+void StreamingPngWriter::WriteChunk( const char type[4], const uint8_t *data, const size_t size )
+{
+    std::vector<uint8_t> length;
+    PutBigEndian( length, static_cast<uint32_t>( size ) );
+    uint32_t crc = Crc32( reinterpret_cast<const uint8_t *>( type ), 4 );
+    crc = Crc32( data, size, crc );
+    std::vector<uint8_t> footer;
+    PutBigEndian( footer, crc );
+
+    m_failed |= fwrite( length.data(), 1, length.size(), m_file ) != length.size();
+    m_failed |= fwrite( type, 1, 4, m_file ) != 4;
+    m_failed |= size != 0 && fwrite( data, 1, size, m_file ) != size;
+    m_failed |= fwrite( footer.data(), 1, footer.size(), m_file ) != footer.size();
+}
+
+
+void StreamingPngWriter::WriteBlocks( const bool final )
+{
+    // Full blocks only, the remainder waits for more rows unless this is the end of the image.
+    std::vector<uint8_t> chunk;
+    size_t offset = 0;
+    while ( m_pending.size() - offset >= MaxStoredBlock || ( final && ( offset < m_pending.size() || chunk.empty() ) ) )
+    {
+        const size_t size = std::min( m_pending.size() - offset, MaxStoredBlock );
+        const bool last = final && offset + size == m_pending.size();
+        // Stored blocks start on a byte boundary, so the three header bits take a whole byte.
+        chunk.push_back( last ? 1 : 0 );
+        chunk.push_back( static_cast<uint8_t>( size ) );
+        chunk.push_back( static_cast<uint8_t>( size >> 8 ) );
+        chunk.push_back( static_cast<uint8_t>( ~size ) );
+        chunk.push_back( static_cast<uint8_t>( ~size >> 8 ) );
+        chunk.insert( chunk.end(), m_pending.begin() + offset, m_pending.begin() + offset + size );
+        m_adler = Adler32( m_pending.data() + offset, size, m_adler );
+        offset += size;
+        if ( last )
+        {
+            break;
+        }
+    }
+    m_pending.erase( m_pending.begin(), m_pending.begin() + offset );
+
+    if ( final )
+    {
+        PutBigEndian( chunk, m_adler );
+    }
+    if ( !chunk.empty() )
+    {
+        WriteChunk( "IDAT", chunk.data(), chunk.size() );
+    }
+}
+
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace Surge
+{
+
+// Writes an RGBA8 png a few rows at a time, so an image never has to be held in memory whole, see
+// TiledEvaluator. The pixels are stored rather than compressed: stb can only encode a complete
+// image, and stored deflate blocks can be produced as the rows come in. Files are about as big as
+// the raw pixels, any png tool can recompress them afterwards.
+class StreamingPngWriter
+{
+public:
+    StreamingPngWriter() = default;
+    ~StreamingPngWriter();
+
+    StreamingPngWriter( const StreamingPngWriter & ) = delete;
+    StreamingPngWriter &operator=( const StreamingPngWriter & ) = delete;
+
+    // Adds .png to filepath if it doesn't end in it already, like Image::WriteFile.
+    bool Open( std::string filepath, uint32_t width, uint32_t height );
+    // rows holds count rows of width RGBA8 pixels, top to bottom, following the ones written before.
+    bool WriteRows( const uint8_t *rows, uint32_t count );
+    // Fails if fewer rows than the height given to Open were written. The file is unusable then.
+    bool Close();
+
+private:
+    void WriteChunk( const char type[4], const uint8_t *data, size_t size );
+    void WriteBlocks( bool final );
+
+    FILE *m_file = nullptr;
+    uint32_t m_width = 0, m_height = 0;
+    uint32_t m_rowsWritten = 0;
+    // Filtered rows not written out yet, less than one deflate block once WriteRows returns.
+    std::vector<uint8_t> m_pending;
+    uint32_t m_adler = 1;
+    bool m_failed = false;
+};
+
+}
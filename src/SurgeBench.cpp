@@ -0,0 +1,1108 @@
+#include "Application.h"
+#include "BlankImageCache.h"
+#include "GpuAllocator.h"
+#include "GraphEvaluator.h"
+#include "GraphFile.h"
+#include "Image.h"
+#include "Profiler.h"
+#include "SyntheticGraph.h"
+
+#include "Compute/ComputeKernels.h"
+#include "Compute/CpuKernels.h"
+#include "Compute/DownsampleCompute.h"
+#include "Compute/FusedPointwiseCompute.h"
+
+#include "GraphNodes/GraphNodes.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace Surge
+{
+
+struct BenchArguments
+{
+    std::vector<uint32_t> sizes = { 512, 1024, 2048, 4096, 8192 };
+    // Untimed runs before the timed ones, for pipelines and scratch images to be made and clocks
+    // to settle.
+    uint32_t warmup = 2;
+    uint32_t iterations = 20;
+    // A case stops early once its timed runs add up to this many seconds, the big blurs take a
+    // while on a software device.
+    double maxSeconds = 10.0;
+    // Only the cases whose "<kernel> <mode>" contains this are run.
+    std::string filter;
+    bool gpu = true;
+    bool cpu = false;
+    // See AppConfig::deviceName.
+    std::string deviceName;
+    std::string jsonPath;
+    std::string csvPath;
+
+    // Benchmarks the graph engine on SyntheticGraphs instead of the kernels.
+    bool graphs = false;
+    std::vector<uint32_t> nodeCounts = { 10, 100, 1000 };
+    // The graphs are evaluated at this size, small enough that it is the graph engine being timed
+    // rather than the kernels.
+    uint32_t graphImageSize = 256;
+    uint32_t seed = 1;
+
+    // Checks that fused chains render the same as their nodes one at a time, and float Gaussians the
+    // same on the GPU as on the CPU, instead of timing anything.
+    bool check = false;
+};
+
+
+// What the cases at one size run on, every image is size x size unless it says otherwise. The
+// inputs are filled with noise, so no kernel gets to take a shortcut over flat colour.
+struct BenchImages
+{
+    uint32_t size = 0;
+    std::unique_ptr<Image> left;
+    std::unique_ptr<Image> right;
+    std::unique_ptr<Image> output;
+    // 255 x 1, like the CurvesNode's.
+    std::unique_ptr<Image> curvesLUT;
+    // size / 2 and size / 4, for the downsample cases.
+    std::unique_ptr<Image> half;
+    std::unique_ptr<Image> quarter;
+};
+
+
+struct BenchCase
+{
+    const char *kernel;
+    std::string mode;
+    // Bytes read and written per pixel of the benchmarked size, going through every image the
+    // kernel touches once. The effective bandwidth is this over the median time, so it is a floor
+    // on what the kernel really moves.
+    double bytesPerPixel;
+    std::function<void( BenchImages & )> gpu;
+    // Empty when the CpuKernels have no version of it.
+    std::function<void( BenchImages & )> cpu;
+};
+
+
+struct BenchResult
+{
+    std::string kernel;
+    std::string mode;
+    const char *backend;
+    // "gpu" for timestamps around the dispatches, "wall" for the time the call took on the CPU.
+    const char *timer;
+    uint32_t size;
+    size_t samples;
+    double minMs, meanMs, p50Ms, p90Ms, p99Ms, maxMs;
+    double megapixelsPerSecond;
+    double gigabytesPerSecond;
+};
+
+
+struct GraphBenchResult
+{
+    const char *shape;
+    const char *backend;
+    // Not counting the input pins, which are nodes of the graph as well.
+    size_t nodes;
+    size_t edges;
+    uint32_t size;
+    // Walking the graph from the output, the part of every evaluation that is just the Graph.
+    double traverseP50Ms;
+    // The first evaluation, which makes every node's image.
+    double firstMs;
+    // With every node marked dirty.
+    double fullP50Ms, fullP90Ms;
+    // With the first node made marked dirty, so that as much of the graph as it feeds runs again,
+    // and with the last one before the output, so only it does.
+    double deepEditP50Ms, deepEditP90Ms;
+    double shallowEditP50Ms, shallowEditP90Ms;
+    double saveP50Ms;
+    double loadP50Ms;
+    // The most GPU memory the evaluations had in use on top of what already was before them, see
+    // GpuAllocator::ResetPeak.
+    uint64_t peakGpuBytes;
+    // The same for the pixels of host images, which is where the CPU backend keeps its images, see
+    // Image::ResetHostPeak.
+    uint64_t peakHostImageBytes;
+    // The process' peak working set or resident set after the graph was run, see GetPeakProcessBytes.
+    uint64_t peakProcessBytes;
+};
+
+
+static void PrintUsage()
+{
+    printf( "Usage: SurgeBench [options]\n"
+            "\n"
+            "Times every compute kernel across image sizes, modes and parameters on a compute-only\n"
+            "Vulkan device, with GPU timestamps, and reports the spread of the times along with the\n"
+            "megapixels and effective gigabytes per second at the median.\n"
+            "\n"
+            "  --sizes <a,b,...>     Image sizes to run at, default 512,1024,2048,4096,8192\n"
+            "  --iterations <n>      Timed runs per case, default 20\n"
+            "  --warmup <n>          Untimed runs before them, default 2\n"
+            "  --max-seconds <s>     Stops a case early once its runs take this long, default 10\n"
+            "  --filter <text>       Only runs the cases whose kernel and mode contain text,\n"
+            "                        e.g. BlurCompute or GAUSSIAN\n"
+            "  --device <name>       Runs on the first GPU whose name contains name, e.g. llvmpipe\n"
+            "  --cpu                 Times the CpuKernels as well\n"
+            "  --cpu-only            Only times the CpuKernels, Vulkan isn't loaded at all\n"
+            "  --json <path>         Writes the results as JSON\n"
+            "  --csv <path>          Writes the results as CSV\n"
+            "\n"
+            "  --graphs              Times the graph engine instead, on generated chains, fan-out\n"
+            "                        and fan-in trees and random graphs. Reports evaluating them\n"
+            "                        whole and after an edit, saving and loading them, and the\n"
+            "                        GPU, host image and process memory they take. --filter\n"
+            "                        picks the shapes\n"
+            "  --nodes <a,b,...>     Sizes of the graphs, default 10,100,1000\n"
+            "  --graph-image <size>  Size of the images they are evaluated at, default 256\n"
+            "  --seed <n>            Seed the graphs are generated from, default 1\n"
+            "\n"
+            "  --check               Checks that a chain of per-pixel nodes renders the same fused\n"
+            "                        as one node at a time, after one of its curves is edited,\n"
+            "                        and that float Gaussians on the GPU agree with the CPU ones,\n"
+            "                        rather than timing anything. Fails if they differ\n" );
+}
+
+
+static bool ParseNumber( const char *text, double &value )
+{
+    char *end = nullptr;
+    value = strtod( text, &end );
+    return end != text && *end == '\0' && value >= 0.0;
+}
+
+
+// A comma separated list of numbers of at least min.
+static bool ParseList( const std::string &value, const double min, std::vector<uint32_t> &list )
+{
+    list.clear();
+    size_t start = 0;
+    while ( start <= value.size() )
+    {
+        const size_t comma = std::min( value.find( ',', start ), value.size() );
+        double number = 0.0;
+        if ( !ParseNumber( value.substr( start, comma - start ).c_str(), number ) || number < min )
+        {
+            return false;
+        }
+        list.push_back( static_cast<uint32_t>( number ) );
+        start = comma + 1;
+    }
+    return true;
+}
+
+
+static bool ParseArguments( const int argc, char **argv, BenchArguments &arguments )
+{
+    for ( int i = 1; i < argc; ++i )
+    {
+        const std::string argument = argv[i];
+        if ( argument == "--cpu" )
+        {
+            arguments.cpu = true;
+            continue;
+        }
+        if ( argument == "--cpu-only" )
+        {
+            arguments.cpu = true;
+            arguments.gpu = false;
+            continue;
+        }
+        if ( argument == "--graphs" )
+        {
+            arguments.graphs = true;
+            continue;
+        }
+        if ( argument == "--check" )
+        {
+            arguments.check = true;
+            continue;
+        }
+        if ( argument == "--help" || argument == "-h" )
+        {
+            return false;
+        }
+        if ( argument.rfind( "--", 0 ) != 0 )
+        {
+            fprintf( stderr, "Unexpected %s\n", argument.c_str() );
+            return false;
+        }
+        if ( i + 1 >= argc )
+        {
+            fprintf( stderr, "%s needs a value\n", argument.c_str() );
+            return false;
+        }
+
+        const std::string value = argv[++i];
+        double number = 0.0;
+        if ( argument == "--sizes" )
+        {
+            if ( !ParseList( value, 4.0, arguments.sizes ) )
+            {
+                fprintf( stderr, "Expected --sizes <a,b,...>, numbers of pixels of at least 4, got %s\n", value.c_str() );
+                return false;
+            }
+        }
+        else if ( argument == "--nodes" )
+        {
+            if ( !ParseList( value, 3.0, arguments.nodeCounts ) )
+            {
+                fprintf( stderr, "Expected --nodes <a,b,...>, numbers of nodes of at least 3, got %s\n", value.c_str() );
+                return false;
+            }
+        }
+        else if ( argument == "--graph-image" || argument == "--seed" )
+        {
+            if ( !ParseNumber( value.c_str(), number ) || ( argument == "--graph-image" && number < 1.0 ) )
+            {
+                fprintf( stderr, "Expected %s <n>, got %s\n", argument.c_str(), value.c_str() );
+                return false;
+            }
+            ( argument == "--seed" ? arguments.seed : arguments.graphImageSize ) = static_cast<uint32_t>( number );
+        }
+        else if ( argument == "--iterations" || argument == "--warmup" )
+        {
+            if ( !ParseNumber( value.c_str(), number ) || ( argument == "--iterations" && number < 1.0 ) )
+            {
+                fprintf( stderr, "Expected %s <n>, got %s\n", argument.c_str(), value.c_str() );
+                return false;
+            }
+            ( argument == "--iterations" ? arguments.iterations : arguments.warmup ) = static_cast<uint32_t>( number );
+        }
+        else if ( argument == "--max-seconds" )
+        {
+            if ( !ParseNumber( value.c_str(), number ) )
+            {
+                fprintf( stderr, "Expected --max-seconds <s>, got %s\n", value.c_str() );
+                return false;
+            }
+            arguments.maxSeconds = number;
+        }
+        else if ( argument == "--filter" )
+        {
+            arguments.filter = value;
+        }
+        else if ( argument == "--device" )
+        {
+            arguments.deviceName = value;
+        }
+        else if ( argument == "--json" )
+        {
+            arguments.jsonPath = value;
+        }
+        else if ( argument == "--csv" )
+        {
+            arguments.csvPath = value;
+        }
+        else
+        {
+            fprintf( stderr, "Unknown option %s\n", argument.c_str() );
+            return false;
+        }
+    }
+    return true;
+}
+
+
+static std::vector<BenchCase> MakeCases()
+{
+    // Every image the kernels read and write is rgba8.
+    constexpr double pixelBytes = 4.0;
+    std::vector<BenchCase> cases;
+
+    const std::pair<BlendCompute::BlendMode, const char *> blendModes[] = {
+        { BlendCompute::BlendMode::ADD, "ADD" },           { BlendCompute::BlendMode::SUBTRACT, "SUBTRACT" },
+        { BlendCompute::BlendMode::MULTIPLY, "MULTIPLY" }, { BlendCompute::BlendMode::DIVIDE, "DIVIDE" },
+        { BlendCompute::BlendMode::SCREEN, "SCREEN" },
+    };
+    for ( const auto &blendMode : blendModes )
+    {
+        const BlendCompute::PushParams params = { blendMode.first, 0 };
+        cases.push_back( { "BlendCompute", blendMode.second, 3.0 * pixelBytes,
+                           [params]( BenchImages &images )
+                           { ComputeKernels::Get<BlendCompute>()->Run( images.left.get(), images.right.get(), images.output.get(), params ); },
+                           [params]( BenchImages &images ) { CpuKernels::Blend( images.left.get(), images.right.get(), images.output.get(), params ); } } );
+    }
+
+    {
+        const HSLCompute::PushParams params = { 0.25f, 0.2f, 0.1f };
+        cases.push_back( { "HSLCompute", "hue=0.25 saturation=0.2 lightness=0.1", 2.0 * pixelBytes,
+                           [params]( BenchImages &images ) { ComputeKernels::Get<HSLCompute>()->Run( images.left.get(), images.output.get(), params ); },
+                           [params]( BenchImages &images ) { CpuKernels::HSL( images.left.get(), images.output.get(), params ); } } );
+    }
+
+    for ( const float luminanceOnly : { 0.0f, 1.0f } )
+    {
+        const LevelsCompute::PushParams params = { ImVec2( 0.1f, 0.9f ), ImVec2( 0.0f, 1.0f ), 1.4f, luminanceOnly };
+        cases.push_back( { "LevelsCompute", luminanceOnly != 0.0f ? "luminance gamma=1.4" : "rgb gamma=1.4", 2.0 * pixelBytes,
+                           [params]( BenchImages &images ) { ComputeKernels::Get<LevelsCompute>()->Run( images.left.get(), images.output.get(), params ); },
+                           [params]( BenchImages &images ) { CpuKernels::Levels( images.left.get(), images.output.get(), params ); } } );
+    }
+
+    {
+        cases.push_back( { "CurvesCompute", "lut=255", 2.0 * pixelBytes,
+                           []( BenchImages &images ) {
+                               ComputeKernels::Get<CurvesCompute>()->Run( images.left.get(), images.curvesLUT.get(), images.output.get(),
+                                                                          { static_cast<int>( images.curvesLUT->GetWidth() ) } );
+                           },
+                           []( BenchImages &images ) {
+                               CpuKernels::Curves( images.left.get(), images.curvesLUT.get(), images.output.get(),
+                                                   { static_cast<int>( images.curvesLUT->GetWidth() ) } );
+                           } } );
+    }
+
+    for ( const int channels : { 7, 15 } )
+    {
+        const InvertCompute::PushParams params = { channels };
+        cases.push_back( { "InvertCompute", channels == 15 ? "rgba" : "rgb", 2.0 * pixelBytes,
+                           [params]( BenchImages &images ) { ComputeKernels::Get<InvertCompute>()->Run( images.left.get(), images.output.get(), params ); },
+                           [params]( BenchImages &images ) { CpuKernels::Invert( images.left.get(), images.output.get(), params ); } } );
+    }
+
+    for ( const float rotation : { 0.0f, 30.0f } )
+    {
+        const ImVec2 scale = rotation != 0.0f ? ImVec2( -1.0f, 1.0f ) : ImVec2( 1.0f, 1.0f );
+        auto params = [scale, rotation]( const BenchImages &images ) -> TransformCompute::PushParams
+        {
+            const float size = static_cast<float>( images.size );
+            return { scale, ImVec2( size, size ), rotation };
+        };
+        cases.push_back( { "TransformCompute", rotation != 0.0f ? "flipH rotation=30" : "identity", 2.0 * pixelBytes,
+                           [params]( BenchImages &images )
+                           { ComputeKernels::Get<TransformCompute>()->Run( images.left.get(), images.output.get(), params( images ) ); },
+                           [params]( BenchImages &images ) { CpuKernels::Transform( images.left.get(), images.output.get(), params( images ) ); } } );
+    }
+
+    // Below BlurCompute::RecursiveGaussianSigma the BlurNode uses the separable kernel, which goes
+    // through a scratch image of the output's format, above it the recursive one through an rgba32f one.
+    for ( const float sigma : { 2.0f, 8.0f, 24.0f } )
+    {
+        cases.push_back( { "BlurCompute", "GAUSSIAN sigma=" + std::to_string( static_cast<int>( sigma ) ), 4.0 * pixelBytes,
+                           [sigma]( BenchImages &images ) { ComputeKernels::Get<BlurCompute>()->RunGaussian( images.left.get(), images.output.get(), sigma ); },
+                           [sigma]( BenchImages &images ) { CpuKernels::Gaussian( images.left.get(), images.output.get(), sigma ); } } );
+    }
+    for ( const float sigma : { 48.0f, 128.0f } )
+    {
+        cases.push_back( { "BlurCompute", "GAUSSIAN recursive sigma=" + std::to_string( static_cast<int>( sigma ) ), 2.0 * pixelBytes + 2.0 * 16.0,
+                           [sigma]( BenchImages &images )
+                           { ComputeKernels::Get<BlurCompute>()->RunRecursiveGaussian( images.left.get(), images.output.get(), sigma ); },
+                           [sigma]( BenchImages &images ) { CpuKernels::RecursiveGaussian( images.left.get(), images.output.get(), sigma ); } } );
+    }
+    const struct
+    {
+        BlurCompute::BlurMode mode;
+        const char *name;
+        float sigma;
+        float samples;
+    } blurs[] = {
+        { BlurCompute::BlurMode::MOTION, "MOTION sigma=4", 4.0f, 10.0f },
+        { BlurCompute::BlurMode::MOTION, "MOTION sigma=16", 16.0f, 10.0f },
+        { BlurCompute::BlurMode::RADIAL, "RADIAL samples=8", 1.0f, 8.0f },
+        { BlurCompute::BlurMode::RADIAL, "RADIAL samples=32", 1.0f, 32.0f },
+    };
+    for ( const auto &blur : blurs )
+    {
+        auto params = [blur]( const BenchImages &images ) -> BlurCompute::PushParams
+        {
+            const float center = static_cast<float>( images.size ) * 0.5f;
+            return { ImVec2( center, center ), 0.5f, blur.sigma, blur.samples, 0.0f, blur.mode };
+        };
+        cases.push_back( { "BlurCompute", blur.name, 2.0 * pixelBytes,
+                           [params]( BenchImages &images ) { ComputeKernels::Get<BlurCompute>()->Run( images.left.get(), images.output.get(), params( images ) ); },
+                           [params]( BenchImages &images ) { CpuKernels::Blur( images.left.get(), images.output.get(), params( images ) ); } } );
+    }
+
+    const std::pair<NoiseCompute::NoiseMode, const char *> noiseModes[] = {
+        { NoiseCompute::NoiseMode::RAW, "RAW" },
+        { NoiseCompute::NoiseMode::VORONOI, "VORONOI" },
+        { NoiseCompute::NoiseMode::PERLIN, "PERLIN" },
+        { NoiseCompute::NoiseMode::SMOKE, "SMOKE" },
+    };
+    for ( const auto &noiseMode : noiseModes )
+    {
+        for ( const float scale : { 8.0f, 64.0f } )
+        {
+            auto params = [mode = noiseMode.first, scale]( const BenchImages &images ) -> NoiseCompute::PushParams
+            { return { mode, images.size, images.size, 1, scale, 0, 0 }; };
+            cases.push_back( { "NoiseCompute", std::string( noiseMode.second ) + " scale=" + std::to_string( static_cast<int>( scale ) ), pixelBytes,
+                               [params]( BenchImages &images ) { ComputeKernels::Get<NoiseCompute>()->Run( images.output.get(), params( images ) ); },
+                               [params]( BenchImages &images ) { CpuKernels::Noise( images.output.get(), params( images ) ); } } );
+        }
+    }
+
+    for ( const int factor : { 2, 4 } )
+    {
+        auto output = [factor]( BenchImages &images ) { return factor == 2 ? images.half.get() : images.quarter.get(); };
+        cases.push_back( { "DownsampleCompute", "factor=" + std::to_string( factor ), pixelBytes + pixelBytes / ( factor * factor ),
+                           [factor, output]( BenchImages &images ) { ComputeKernels::Get<DownsampleCompute>()->Run( images.left.get(), output( images ), factor ); },
+                           [factor, output]( BenchImages &images ) { CpuKernels::Downsample( images.left.get(), output( images ), factor ); } } );
+    }
+
+    // The same chain the GraphEvaluator fuses HSL -> Levels -> Invert into, to set against the
+    // three cases above it replaces.
+    {
+        const std::vector<PointwiseStage> stages = {
+            { PointwiseKernel::HSL, { 0.25f, 0.2f, 0.1f } },
+            { PointwiseKernel::LEVELS, { 0.1f, 0.9f, 0.0f, 1.0f, 1.4f, 0.0f } },
+            { PointwiseKernel::INVERT, { 7.0f } },
+        };
+        cases.push_back( { "FusedPointwiseCompute", "HSL+Levels+Invert", 2.0 * pixelBytes,
+                           [stages]( BenchImages &images )
+                           { ComputeKernels::Get<FusedPointwiseCompute>()->Run( images.left.get(), images.output.get(), stages ); },
+                           nullptr } );
+    }
+
+    return cases;
+}
+
+
+static std::unique_ptr<Image> MakeImage( const uint32_t width, const uint32_t height, const ImageStorage storage, uint32_t seed )
+{
+    std::vector<uint8_t> pixels( static_cast<size_t>( width ) * height * 4 );
+    for ( uint8_t &channel : pixels )
+    {
+        // xorshift32
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        channel = static_cast<uint8_t>( seed >> 24 );
+    }
+    return std::make_unique<Image>( width, height, ImageFormat::RGBA, pixels.data(), storage );
+}
+
+
+static BenchImages MakeImages( const uint32_t size, const ImageStorage storage )
+{
+    BenchImages images;
+    images.size = size;
+    images.left = MakeImage( size, size, storage, 1 );
+    images.right = MakeImage( size, size, storage, 2 );
+    images.output = std::make_unique<Image>( size, size, ImageFormat::RGBA, nullptr, storage );
+    images.curvesLUT = MakeImage( 255, 1, storage, 3 );
+    images.half = std::make_unique<Image>( size / 2, size / 2, ImageFormat::RGBA, nullptr, storage );
+    images.quarter = std::make_unique<Image>( size / 4, size / 4, ImageFormat::RGBA, nullptr, storage );
+    return images;
+}
+
+
+// Nearest rank, samples has to be sorted.
+static double Percentile( const std::vector<double> &samples, const double percent )
+{
+    const size_t rank = static_cast<size_t>( std::ceil( percent / 100.0 * samples.size() ) );
+    return samples[std::clamp<size_t>( rank, 1, samples.size() ) - 1];
+}
+
+
+static double TimeMs( const std::function<void()> &work )
+{
+    const auto start = std::chrono::steady_clock::now();
+    work();
+    return std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+}
+
+
+// Calls run arguments.warmup times, then up to arguments.iterations times or until the times it
+// returns add up to arguments.maxSeconds, and returns those times sorted.
+static std::vector<double> Sample( const BenchArguments &arguments, const std::function<double()> &run )
+{
+    for ( uint32_t i = 0; i < arguments.warmup; ++i )
+    {
+        run();
+    }
+    std::vector<double> samples;
+    double totalMs = 0.0;
+    for ( uint32_t i = 0; i < arguments.iterations && ( samples.empty() || totalMs < arguments.maxSeconds * 1000.0 ); ++i )
+    {
+        samples.push_back( run() );
+        totalMs += samples.back();
+    }
+    std::sort( samples.begin(), samples.end() );
+    return samples;
+}
+
+
+static BenchResult RunCase( const BenchArguments &arguments, const BenchCase &benchCase, const bool gpu, BenchImages &images )
+{
+    Profiler *profiler = Application::GetProfiler();
+    const bool gpuTimes = gpu && profiler->HasGpuTimes();
+    const std::function<void( BenchImages & )> &run = gpu ? benchCase.gpu : benchCase.cpu;
+
+    // Every run is its own evaluation of node 0, which the profiler hands the GPU time of the
+    // dispatches it recorded back for.
+    const std::vector<double> samples = Sample( arguments, [&]() -> double
+    {
+        const double wallMs = TimeMs( [&]()
+        {
+            Profiler::NodeScope scope( 0, benchCase.kernel );
+            run( images );
+        } );
+        return gpuTimes ? profiler->GetNodeTimings()[0].gpuMs : wallMs;
+    } );
+    // The events would pile up over the whole run otherwise.
+    profiler->Clear();
+
+    BenchResult result;
+    result.kernel = benchCase.kernel;
+    result.mode = benchCase.mode;
+    result.backend = gpu ? "gpu" : "cpu";
+    result.timer = gpuTimes ? "gpu" : "wall";
+    result.size = images.size;
+    result.samples = samples.size();
+    result.minMs = samples.front();
+    result.maxMs = samples.back();
+    result.meanMs = std::accumulate( samples.begin(), samples.end(), 0.0 ) / samples.size();
+    result.p50Ms = Percentile( samples, 50.0 );
+    result.p90Ms = Percentile( samples, 90.0 );
+    result.p99Ms = Percentile( samples, 99.0 );
+
+    const double pixels = static_cast<double>( images.size ) * images.size;
+    const double seconds = std::max( result.p50Ms, 1e-6 ) / 1000.0;
+    result.megapixelsPerSecond = pixels / seconds / 1e6;
+    result.gigabytesPerSecond = pixels * benchCase.bytesPerPixel / seconds / 1e9;
+    return result;
+}
+
+
+// The most memory the process has had resident since it started, its peak working set on Windows.
+// Unlike the allocators' peaks it can't be started over, so it only grows from one graph to the
+// next, and a graph only shows in it once it takes more than every one before it.
+static uint64_t GetPeakProcessBytes()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters = {};
+    if ( !GetProcessMemoryInfo( GetCurrentProcess(), &counters, sizeof(counters) ) )
+    {
+        return 0;
+    }
+    return counters.PeakWorkingSetSize;
+#else
+    rusage usage = {};
+    if ( getrusage( RUSAGE_SELF, &usage ) != 0 )
+    {
+        return 0;
+    }
+#ifdef __APPLE__
+    return static_cast<uint64_t>( usage.ru_maxrss );
+#else
+    // In kilobytes everywhere but macOS.
+    return static_cast<uint64_t>( usage.ru_maxrss ) * 1024;
+#endif
+#endif
+}
+
+
+// Lets go of the images the last graph left to be freed once the GPU was done with them, so they
+// don't count towards the next one's memory.
+static void FreeReleasedImages()
+{
+    Application::BeginComputeBatch();
+    Application::EndComputeBatch();
+}
+
+
+static bool RunGraph( const BenchArguments &arguments, const SyntheticGraph::Shape shape, const uint32_t nodeCount, const bool gpu,
+                      GraphBenchResult &result )
+{
+    SyntheticGraph synthetic( shape, static_cast<int>( nodeCount ), arguments.seed );
+    Graph<Node *> &graph = synthetic.GetGraph();
+    const int rootNodeId = synthetic.GetRootNodeId();
+    const uint32_t size = arguments.graphImageSize;
+
+    result = {};
+    result.shape = SyntheticGraph::GetShapeName( shape );
+    result.backend = gpu ? "gpu" : "cpu";
+    result.nodes = synthetic.GetNodes().size();
+    result.edges = graph.edges().size();
+    result.size = size;
+
+    const std::vector<double> traverse = Sample( arguments, [&]()
+    {
+        std::vector<int> postorder;
+        return TimeMs( [&]() { postorder_traverse( graph, rootNodeId, [&postorder]( const int nodeId ) -> void { postorder.push_back( nodeId ); } ); } );
+    } );
+    result.traverseP50Ms = Percentile( traverse, 50.0 );
+
+    // Evaluated the way the NodeCanvas does it, only at a smaller size.
+    BlankImageCache blankImages;
+    GraphEvaluator::Options options;
+    options.batchCompute = Application::GetConfig().batchCompute;
+    options.fusePointwise = Application::GetConfig().fusePointwise;
+    options.blankImages = &blankImages;
+    options.cpuBackend = !gpu;
+    options.region = { 0, 0, size, size, size, size };
+    auto evaluate = [&]()
+    {
+        return TimeMs( [&]()
+        {
+            GraphEvaluator evaluator( options );
+            evaluator.Evaluate( graph, rootNodeId );
+        } );
+    };
+    auto edit = [&]( const int nodeId )
+    {
+        return [&, nodeId]()
+        {
+            graph.node( nodeId )->MarkDirty();
+            return evaluate();
+        };
+    };
+
+    GpuAllocator *allocator = gpu ? Application::GetGpuAllocator() : nullptr;
+    VkDeviceSize baselineBytes = 0;
+    if ( allocator )
+    {
+        FreeReleasedImages();
+        allocator->ResetPeak();
+        baselineBytes = allocator->GetStats().usedBytes;
+    }
+    Image::ResetHostPeak();
+    const uint64_t baselineHostBytes = Image::GetHostBytes();
+
+    result.firstMs = evaluate();
+    const std::vector<double> full = Sample( arguments, [&]()
+    {
+        for ( Node *node : graph.nodes() )
+        {
+            node->MarkDirty();
+        }
+        return evaluate();
+    } );
+    const std::vector<double> deepEdit = Sample( arguments, edit( synthetic.GetOperators().front() ) );
+    const std::vector<double> shallowEdit = Sample( arguments, edit( synthetic.GetOperators().back() ) );
+    result.fullP50Ms = Percentile( full, 50.0 );
+    result.fullP90Ms = Percentile( full, 90.0 );
+    result.deepEditP50Ms = Percentile( deepEdit, 50.0 );
+    result.deepEditP90Ms = Percentile( deepEdit, 90.0 );
+    result.shallowEditP50Ms = Percentile( shallowEdit, 50.0 );
+    result.shallowEditP90Ms = Percentile( shallowEdit, 90.0 );
+    if ( allocator )
+    {
+        result.peakGpuBytes = allocator->GetStats().peakUsedBytes - baselineBytes;
+    }
+    result.peakHostImageBytes = Image::GetPeakHostBytes() - baselineHostBytes;
+    result.peakProcessBytes = GetPeakProcessBytes();
+
+    const std::string path = ( std::filesystem::temp_directory_path() / "SurgeBench.surge" ).string();
+    bool valid = true;
+    const std::vector<double> save = Sample( arguments, [&]() { return TimeMs( [&]() { valid &= SaveGraphFile( path, graph, synthetic.GetNodes() ); } ); } );
+    const std::vector<double> load = Sample( arguments, [&]()
+    {
+        Graph<Node *> loaded;
+        std::vector<GraphFileNode> loadedNodes;
+        const double ms = TimeMs( [&]() { valid &= LoadGraphFile( path, loaded, loadedNodes ); } );
+        for ( Node *node : loaded.nodes() )
+        {
+            delete node;
+        }
+        return ms;
+    } );
+    result.saveP50Ms = Percentile( save, 50.0 );
+    result.loadP50Ms = Percentile( load, 50.0 );
+    std::error_code error;
+    std::filesystem::remove( path, error );
+
+    if ( !valid )
+    {
+        fprintf( stderr, "Could not save and load the %u node %s graph through %s\n", nodeCount, result.shape, path.c_str() );
+    }
+    return valid;
+}
+
+
+// Noise into a curves and an invert node, which fuse into one shader. The curves are edited between
+// evaluations the way RenderProperties, a loaded file or SurgeCli's --set change them, and the fused
+// result has to follow the edit and agree with the nodes run one at a time.
+static bool CheckFusedCurves( const uint32_t size )
+{
+    Graph<Node *> graph;
+    auto add = [&graph]( Node *op, const int input ) -> int
+    {
+        const int id = graph.insert_node( op );
+        if ( input >= 0 )
+        {
+            const int pin = graph.insert_node( new Node( NodeType::VALUE ) );
+            graph.insert_edge( id, pin );
+            graph.insert_edge( pin, input );
+        }
+        return id;
+    };
+    NoiseNode *noise = new NoiseNode();
+    CurvesNode *curves = new CurvesNode();
+    const int curvesId = add( curves, add( noise, -1 ) );
+    const int rootNodeId = add( new Node( NodeType::OUTPUT ), add( new InvertNode(), curvesId ) );
+
+    BlankImageCache blankImages;
+    GraphEvaluator::Options options;
+    options.blankImages = &blankImages;
+    options.region = { 0, 0, size, size, size, size };
+    // Returns whether the curves node was run as part of a fused chain.
+    auto render = [&]( const bool fuse, std::vector<uint8_t> &pixels ) -> bool
+    {
+        options.fusePointwise = fuse;
+        GraphEvaluator evaluator( options );
+        const std::shared_ptr<Image> output = evaluator.Evaluate( graph, rootNodeId );
+        pixels.resize( static_cast<size_t>( size ) * size * Image::BytesPerPixel( output->GetFormat() ) );
+        output->GetData( pixels.data() );
+        const std::vector<int> &evaluated = evaluator.GetEvaluatedNodes();
+        return std::find( evaluated.begin(), evaluated.end(), curvesId ) == evaluated.end();
+    };
+
+    std::vector<uint8_t> before, fused, unfused;
+    render( true, before );
+    curves->m_red[1] = 0.9f;
+    curves->m_blue[3] = 0.1f;
+    curves->MarkDirty();
+    const bool wasFused = render( true, fused );
+    // Nothing about the graph changed, without this the unfused evaluation would hand back the cached result.
+    curves->MarkDirty();
+    render( false, unfused );
+
+    // The fused shader doesn't round to 8 bit between the nodes.
+    int maxDifference = 0;
+    for ( size_t i = 0; i < fused.size(); ++i )
+    {
+        maxDifference = std::max( maxDifference, std::abs( static_cast<int>( fused[i] ) - static_cast<int>( unfused[i] ) ) );
+    }
+    const bool valid = wasFused && before != fused && maxDifference <= 2;
+    printf( "%-30s %s, fused and unfused differ by up to %d\n", "fused curves after an edit", valid ? "passed" : "FAILED", maxDifference );
+
+    for ( Node *node : graph.nodes() )
+    {
+        delete node;
+    }
+    return valid;
+}
+
+
+// A Gaussian of HDR noise on the GPU and through the CpuKernels, in both float formats, at a sigma
+// the separable kernel takes and one RGBA32F hands to the recursive one. Both paths keep their
+// inputs whole and work in float, so they only differ by the order the taps are added in and the
+// rounding of what they store: up to 2e-3 of the value for RGBA16F, 1e-4 for RGBA32F.
+static bool CheckFloatGaussian( const uint32_t size )
+{
+    BlurCompute *blurCompute = ComputeKernels::Get<BlurCompute>();
+    const size_t count = static_cast<size_t>( size ) * size;
+    bool valid = true;
+    for ( const ImageFormat format : { ImageFormat::RGBA16F, ImageFormat::RGBA32F } )
+    {
+        const char *formatName = format == ImageFormat::RGBA16F ? "rgba16f" : "rgba32f";
+        if ( !blurCompute->HasGaussian( format ) )
+        {
+            printf( "%-30s skipped, the device has too little shared memory for it\n", ( std::string( "gaussian " ) + formatName ).c_str() );
+            continue;
+        }
+
+        // Well past 1.0, and for RGBA32F past what a half float holds.
+        const float range = format == ImageFormat::RGBA16F ? 1000.0f : 100000.0f;
+        std::vector<float> noise( count * 4 );
+        uint32_t seed = 4;
+        for ( float &channel : noise )
+        {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            channel = static_cast<float>( seed >> 8 ) / static_cast<float>( 1u << 24 ) * range;
+        }
+        std::vector<uint8_t> pixels( count * Image::BytesPerPixel( format ) );
+        Image::ConvertPixels( ImageFormat::RGBA32F, noise.data(), format, pixels.data(), count );
+        Image gpuInput( size, size, format, pixels.data(), ImageStorage::Device );
+        Image cpuInput( size, size, format, pixels.data(), ImageStorage::Host );
+        Image gpuOutput( size, size, format, nullptr, ImageStorage::Device );
+        Image cpuOutput( size, size, format, nullptr, ImageStorage::Host );
+
+        const float tolerance = format == ImageFormat::RGBA16F ? 2e-3f : 1e-4f;
+        for ( const float sigma : { 4.0f, 24.0f } )
+        {
+            blurCompute->RunGaussian( &gpuInput, &gpuOutput, sigma );
+            CpuKernels::Gaussian( &cpuInput, &cpuOutput, sigma );
+
+            std::vector<uint8_t> gpuPixels( pixels.size() ), cpuPixels( pixels.size() );
+            gpuOutput.GetData( gpuPixels.data() );
+            cpuOutput.GetData( cpuPixels.data() );
+            std::vector<float> gpuValues( count * 4 ), cpuValues( count * 4 );
+            Image::ConvertPixels( format, gpuPixels.data(), ImageFormat::RGBA32F, gpuValues.data(), count );
+            Image::ConvertPixels( format, cpuPixels.data(), ImageFormat::RGBA32F, cpuValues.data(), count );
+
+            float maxDifference = 0.0f;
+            for ( size_t i = 0; i < gpuValues.size(); ++i )
+            {
+                const float difference = std::abs( gpuValues[i] - cpuValues[i] ) / std::max( std::abs( cpuValues[i] ), 1.0f );
+                // Written so a NaN fails as well.
+                maxDifference = difference <= maxDifference ? maxDifference : difference;
+            }
+            const bool passed = maxDifference <= tolerance;
+            valid &= passed;
+            const std::string name = std::string( "gaussian " ) + formatName + " sigma " + std::to_string( static_cast<int>( sigma ) );
+            printf( "%-30s %s, GPU and CPU differ by up to %g of the value\n", name.c_str(), passed ? "passed" : "FAILED", maxDifference );
+        }
+    }
+    return valid;
+}
+
+
+static std::vector<BenchResult> BenchKernels( const BenchArguments &arguments )
+{
+    const std::vector<BenchCase> cases = MakeCases();
+    std::vector<BenchResult> results;
+    printf( "%-22s %-28s %-4s %6s %10s %10s %10s %10s %10s\n", "kernel", "mode", "", "size", "p50 ms", "p90 ms", "p99 ms", "MP/s", "GB/s" );
+    for ( const uint32_t size : arguments.sizes )
+    {
+        for ( const bool gpu : { true, false } )
+        {
+            if ( gpu ? !arguments.gpu : !arguments.cpu )
+            {
+                continue;
+            }
+            BenchImages images = MakeImages( size, gpu ? ImageStorage::Device : ImageStorage::Host );
+            for ( const BenchCase &benchCase : cases )
+            {
+                const std::string name = std::string( benchCase.kernel ) + " " + benchCase.mode;
+                if ( !( gpu ? benchCase.gpu : benchCase.cpu ) || name.find( arguments.filter ) == std::string::npos )
+                {
+                    continue;
+                }
+                const BenchResult result = RunCase( arguments, benchCase, gpu, images );
+                printf( "%-22s %-28s %-4s %6u %10.3f %10.3f %10.3f %10.1f %10.2f\n", result.kernel.c_str(), result.mode.c_str(), result.backend,
+                        result.size, result.p50Ms, result.p90Ms, result.p99Ms, result.megapixelsPerSecond, result.gigabytesPerSecond );
+                fflush( stdout );
+                results.push_back( result );
+            }
+        }
+    }
+    return results;
+}
+
+
+static std::vector<GraphBenchResult> BenchGraphs( const BenchArguments &arguments, bool &valid )
+{
+    std::vector<GraphBenchResult> results;
+    printf( "%-7s %-4s %6s %6s %10s %10s %10s %10s %10s %10s %10s %10s %10s %10s\n", "shape", "", "nodes", "edges", "walk ms", "first ms",
+            "full ms", "deep ms", "shallow ms", "save ms", "load ms", "gpu MB", "host MB", "process MB" );
+    for ( const SyntheticGraph::Shape shape : { SyntheticGraph::Shape::CHAIN, SyntheticGraph::Shape::TREE, SyntheticGraph::Shape::RANDOM } )
+    {
+        if ( std::string( SyntheticGraph::GetShapeName( shape ) ).find( arguments.filter ) == std::string::npos )
+        {
+            continue;
+        }
+        for ( const uint32_t nodeCount : arguments.nodeCounts )
+        {
+            for ( const bool gpu : { true, false } )
+            {
+                if ( gpu ? !arguments.gpu : !arguments.cpu )
+                {
+                    continue;
+                }
+                GraphBenchResult result;
+                valid &= RunGraph( arguments, shape, nodeCount, gpu, result );
+                printf( "%-7s %-4s %6zu %6zu %10.3f %10.3f %10.3f %10.3f %10.3f %10.3f %10.3f %10.1f %10.1f %10.1f\n", result.shape, result.backend,
+                        result.nodes, result.edges, result.traverseP50Ms, result.firstMs, result.fullP50Ms, result.deepEditP50Ms,
+                        result.shallowEditP50Ms, result.saveP50Ms, result.loadP50Ms, result.peakGpuBytes / ( 1024.0 * 1024.0 ),
+                        result.peakHostImageBytes / ( 1024.0 * 1024.0 ), result.peakProcessBytes / ( 1024.0 * 1024.0 ) );
+                fflush( stdout );
+                results.push_back( result );
+            }
+        }
+    }
+    return results;
+}
+
+
+// Kernel names, modes and device names have nothing in them that needs escaping.
+static bool WriteJson( const std::string &filepath, const std::string &device, const std::vector<BenchResult> &results )
+{
+    FILE *file = fopen( filepath.c_str(), "w" );
+    if ( !file )
+    {
+        return false;
+    }
+
+    fprintf( file, "{\n  \"device\": \"%s\",\n  \"results\": [\n", device.c_str() );
+    for ( size_t i = 0; i < results.size(); ++i )
+    {
+        const BenchResult &r = results[i];
+        fprintf( file,
+                 "    {\"kernel\": \"%s\", \"mode\": \"%s\", \"backend\": \"%s\", \"timer\": \"%s\", \"width\": %u, \"height\": %u, "
+                 "\"samples\": %zu, \"minMs\": %.4f, \"meanMs\": %.4f, \"p50Ms\": %.4f, \"p90Ms\": %.4f, \"p99Ms\": %.4f, \"maxMs\": %.4f, "
+                 "\"megapixelsPerSecond\": %.2f, \"gigabytesPerSecond\": %.3f}%s\n",
+                 r.kernel.c_str(), r.mode.c_str(), r.backend, r.timer, r.size, r.size, r.samples, r.minMs, r.meanMs, r.p50Ms, r.p90Ms, r.p99Ms,
+                 r.maxMs, r.megapixelsPerSecond, r.gigabytesPerSecond, i + 1 < results.size() ? "," : "" );
+    }
+    fprintf( file, "  ]\n}\n" );
+    return fclose( file ) == 0;
+}
+
+
+static bool WriteJson( const std::string &filepath, const std::string &device, const std::vector<GraphBenchResult> &results )
+{
+    FILE *file = fopen( filepath.c_str(), "w" );
+    if ( !file )
+    {
+        return false;
+    }
+
+    fprintf( file, "{\n  \"device\": \"%s\",\n  \"graphs\": [\n", device.c_str() );
+    for ( size_t i = 0; i < results.size(); ++i )
+    {
+        const GraphBenchResult &r = results[i];
+        fprintf( file,
+                 "    {\"shape\": \"%s\", \"backend\": \"%s\", \"nodes\": %zu, \"edges\": %zu, \"width\": %u, \"height\": %u, "
+                 "\"traverseP50Ms\": %.4f, \"firstMs\": %.4f, \"fullP50Ms\": %.4f, \"fullP90Ms\": %.4f, \"deepEditP50Ms\": %.4f, "
+                 "\"deepEditP90Ms\": %.4f, \"shallowEditP50Ms\": %.4f, \"shallowEditP90Ms\": %.4f, \"saveP50Ms\": %.4f, \"loadP50Ms\": %.4f, "
+                 "\"peakGpuBytes\": %llu, \"peakHostImageBytes\": %llu, \"peakProcessBytes\": %llu}%s\n",
+                 r.shape, r.backend, r.nodes, r.edges, r.size, r.size, r.traverseP50Ms, r.firstMs, r.fullP50Ms, r.fullP90Ms, r.deepEditP50Ms,
+                 r.deepEditP90Ms, r.shallowEditP50Ms, r.shallowEditP90Ms, r.saveP50Ms, r.loadP50Ms, static_cast<unsigned long long>( r.peakGpuBytes ),
+                 static_cast<unsigned long long>( r.peakHostImageBytes ), static_cast<unsigned long long>( r.peakProcessBytes ),
+                 i + 1 < results.size() ? "," : "" );
+    }
+    fprintf( file, "  ]\n}\n" );
+    return fclose( file ) == 0;
+}
+
+
+static bool WriteCsv( const std::string &filepath, const std::string &device, const std::vector<BenchResult> &results )
+{
+    FILE *file = fopen( filepath.c_str(), "w" );
+    if ( !file )
+    {
+        return false;
+    }
+
+    fprintf( file, "device,kernel,mode,backend,timer,width,height,samples,minMs,meanMs,p50Ms,p90Ms,p99Ms,maxMs,megapixelsPerSecond,gigabytesPerSecond\n" );
+    for ( const BenchResult &r : results )
+    {
+        fprintf( file, "\"%s\",%s,\"%s\",%s,%s,%u,%u,%zu,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.2f,%.3f\n", device.c_str(), r.kernel.c_str(), r.mode.c_str(),
+                 r.backend, r.timer, r.size, r.size, r.samples, r.minMs, r.meanMs, r.p50Ms, r.p90Ms, r.p99Ms, r.maxMs, r.megapixelsPerSecond,
+                 r.gigabytesPerSecond );
+    }
+    return fclose( file ) == 0;
+}
+
+
+static bool WriteCsv( const std::string &filepath, const std::string &device, const std::vector<GraphBenchResult> &results )
+{
+    FILE *file = fopen( filepath.c_str(), "w" );
+    if ( !file )
+    {
+        return false;
+    }
+
+    fprintf( file, "device,shape,backend,nodes,edges,width,height,traverseP50Ms,firstMs,fullP50Ms,fullP90Ms,deepEditP50Ms,deepEditP90Ms,"
+                   "shallowEditP50Ms,shallowEditP90Ms,saveP50Ms,loadP50Ms,peakGpuBytes,peakHostImageBytes,peakProcessBytes\n" );
+    for ( const GraphBenchResult &r : results )
+    {
+        fprintf( file, "\"%s\",%s,%s,%zu,%zu,%u,%u,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%llu,%llu,%llu\n", device.c_str(), r.shape,
+                 r.backend, r.nodes, r.edges, r.size, r.size, r.traverseP50Ms, r.firstMs, r.fullP50Ms, r.fullP90Ms, r.deepEditP50Ms, r.deepEditP90Ms,
+                 r.shallowEditP50Ms, r.shallowEditP90Ms, r.saveP50Ms, r.loadP50Ms, static_cast<unsigned long long>( r.peakGpuBytes ),
+                 static_cast<unsigned long long>( r.peakHostImageBytes ), static_cast<unsigned long long>( r.peakProcessBytes ) );
+    }
+    return fclose( file ) == 0;
+}
+
+
+template <typename Result>
+static bool WriteResults( const BenchArguments &arguments, const std::string &device, const std::vector<Result> &results )
+{
+    bool written = true;
+    if ( !arguments.jsonPath.empty() && !WriteJson( arguments.jsonPath, device, results ) )
+    {
+        fprintf( stderr, "Could not write %s\n", arguments.jsonPath.c_str() );
+        written = false;
+    }
+    if ( !arguments.csvPath.empty() && !WriteCsv( arguments.csvPath, device, results ) )
+    {
+        fprintf( stderr, "Could not write %s\n", arguments.csvPath.c_str() );
+        written = false;
+    }
+    return written;
+}
+
+
+// The images have to be gone before the Application shuts Vulkan down, so this runs while it is
+// still around.
+static int Bench( const BenchArguments &arguments )
+{
+    std::string device = "cpu";
+    if ( arguments.gpu )
+    {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties( Application::GetPhysicalDevice(), &properties );
+        device = properties.deviceName;
+        if ( !arguments.graphs && !Application::GetProfiler()->HasGpuTimes() )
+        {
+            fprintf( stderr, "%s can't write timestamps, the GPU cases are timed on the CPU instead\n", device.c_str() );
+        }
+    }
+
+    if ( arguments.check )
+    {
+        if ( !arguments.gpu )
+        {
+            fprintf( stderr, "--check compares against the GPU, it can't run with --cpu-only\n" );
+            return EXIT_FAILURE;
+        }
+        const bool fusedValid = CheckFusedCurves( arguments.graphImageSize );
+        const bool gaussianValid = CheckFloatGaussian( arguments.graphImageSize );
+        return fusedValid && gaussianValid ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if ( arguments.graphs )
+    {
+        bool valid = true;
+        const std::vector<GraphBenchResult> results = BenchGraphs( arguments, valid );
+        return WriteResults( arguments, device, results ) && valid ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    Application::GetProfiler()->SetEnabled( true );
+    const std::vector<BenchResult> results = BenchKernels( arguments );
+    return WriteResults( arguments, device, results ) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+int BenchMain( int argc, char **argv )
+{
+    BenchArguments arguments;
+    if ( !ParseArguments( argc, argv, arguments ) )
+    {
+        PrintUsage();
+        return EXIT_FAILURE;
+    }
+
+    AppConfig config;
+    config.name = "SurgeBench";
+    config.headless = true;
+    config.cpuOnly = !arguments.gpu;
+    config.deviceName = arguments.deviceName;
+    const auto app = new Application( config );
+    const int result = Bench( arguments );
+    delete app;
+
+    return result;
+}
+
+}
+
+int main( int argc, char **argv )
+{
+    return Surge::BenchMain( argc, argv );
+}
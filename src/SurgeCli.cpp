@@ -0,0 +1,430 @@
+#include "Application.h"
+#include "BlankImageCache.h"
+#include "GraphEvaluator.h"
+#include "GraphFile.h"
+#include "TiledEvaluator.h"
+
+#include "GraphNodes/GraphNodes.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace Surge
+{
+
+struct CliArguments
+{
+    std::string graphPath;
+    std::string outputPath;
+    GraphFileOverrides overrides;
+
+    struct Parameter
+    {
+        int nodeId;
+        std::string name;
+        float value;
+    };
+    std::vector<Parameter> parameters;
+
+    bool batchCompute = true;
+    bool fusePointwise = true;
+    // Runs without Vulkan, every node on the CPU, see AppConfig::cpuOnly.
+    bool cpuOnly = false;
+    // What nodes reading float images work in, see GraphEvaluator::Options::floatFormat.
+    ImageFormat floatFormat = ImageFormat::RGBA16F;
+    // Renders in tiles of this size when set, see TiledEvaluator.
+    uint32_t tileSize = 0;
+    // Where to write a Chrome trace of the render, see Profiler.
+    std::string tracePath;
+};
+
+
+static void PrintUsage()
+{
+    printf( "Usage: SurgeCli <graph.surge> <output.png> [options]\n"
+            "\n"
+            "Renders the output node of a graph saved by Surge, without a window.\n"
+            "Nodes are referred to by the ids they have in the .surge file.\n"
+            "\n"
+            "  --set <node>.<parameter>=<value>  Overrides a parameter of a node, e.g. --set 4.sigma=12\n"
+            "  --input <node>=<path>             Reads an image node from another file, or a dynamic\n"
+            "                                    image node from another folder\n"
+            "  --no-batch                        Submits every node's dispatches on their own\n"
+            "  --no-fuse                         Runs chains of per-pixel nodes one node at a time\n"
+            "  --cpu                             Renders on the CPU, for machines without a GPU.\n"
+            "                                    Vulkan isn't loaded at all\n"
+            "  --float32                         Keeps float images, e.g. .exr and .hdr, in 32 bit\n"
+            "                                    floats rather than half floats\n"
+            "  --tile <size>                     Renders the output in tiles of size x size pixels,\n"
+            "                                    for images too big for the GPU. Always writes a png\n"
+            "  --profile <trace.json>            Times every node on the CPU and GPU and writes a\n"
+            "                                    Chrome trace of the render\n" );
+}
+
+
+// Splits "<node><separator><rest>", e.g. "4.sigma" or "4=path".
+static bool SplitNodeArgument( const std::string &argument, const char separator, int &nodeId, std::string &rest )
+{
+    const size_t split = argument.find( separator );
+    if ( split == 0 || split == std::string::npos )
+    {
+        return false;
+    }
+    char *end = nullptr;
+    nodeId = static_cast<int>( strtol( argument.c_str(), &end, 10 ) );
+    if ( end != argument.c_str() + split )
+    {
+        return false;
+    }
+    rest = argument.substr( split + 1 );
+    return !rest.empty();
+}
+
+
+static bool ParseArguments( const int argc, char **argv, CliArguments &arguments )
+{
+    std::vector<std::string> positional;
+    for ( int i = 1; i < argc; ++i )
+    {
+        const std::string argument = argv[i];
+        if ( argument == "--set" || argument == "--input" )
+        {
+            if ( i + 1 >= argc )
+            {
+                fprintf( stderr, "%s needs a value\n", argument.c_str() );
+                return false;
+            }
+            const std::string value = argv[++i];
+            int nodeId;
+            std::string rest;
+            if ( argument == "--input" )
+            {
+                if ( !SplitNodeArgument( value, '=', nodeId, rest ) )
+                {
+                    fprintf( stderr, "Expected --input <node>=<path>, got %s\n", value.c_str() );
+                    return false;
+                }
+                arguments.overrides.paths[nodeId] = rest;
+                continue;
+            }
+
+            const size_t equals = value.find( '=' );
+            char *end = nullptr;
+            const float parameterValue = equals == std::string::npos ? 0.0f : strtof( value.c_str() + equals + 1, &end );
+            if ( equals == std::string::npos || !SplitNodeArgument( value.substr( 0, equals ), '.', nodeId, rest ) || end == value.c_str() + equals + 1 || *end != '\0' )
+            {
+                fprintf( stderr, "Expected --set <node>.<parameter>=<number>, got %s\n", value.c_str() );
+                return false;
+            }
+            arguments.parameters.push_back( { nodeId, rest, parameterValue } );
+        }
+        else if ( argument == "--tile" )
+        {
+            char *end = nullptr;
+            const long tileSize = i + 1 < argc ? strtol( argv[i + 1], &end, 10 ) : 0;
+            if ( i + 1 >= argc || *end != '\0' || tileSize <= 0 )
+            {
+                fprintf( stderr, "Expected --tile <size>, a number of pixels\n" );
+                return false;
+            }
+            arguments.tileSize = static_cast<uint32_t>( tileSize );
+            ++i;
+        }
+        else if ( argument == "--profile" )
+        {
+            if ( i + 1 >= argc )
+            {
+                fprintf( stderr, "%s needs a value\n", argument.c_str() );
+                return false;
+            }
+            arguments.tracePath = argv[++i];
+        }
+        else if ( argument == "--no-batch" )
+        {
+            arguments.batchCompute = false;
+        }
+        else if ( argument == "--no-fuse" )
+        {
+            arguments.fusePointwise = false;
+        }
+        else if ( argument == "--cpu" )
+        {
+            arguments.cpuOnly = true;
+        }
+        else if ( argument == "--float32" )
+        {
+            arguments.floatFormat = ImageFormat::RGBA32F;
+        }
+        else if ( argument == "--help" || argument == "-h" )
+        {
+            return false;
+        }
+        else if ( argument.rfind( "--", 0 ) == 0 )
+        {
+            fprintf( stderr, "Unknown option %s\n", argument.c_str() );
+            return false;
+        }
+        else
+        {
+            positional.push_back( argument );
+        }
+    }
+
+    if ( positional.size() != 2 )
+    {
+        return false;
+    }
+    arguments.graphPath = positional[0];
+    arguments.outputPath = positional[1];
+    return true;
+}
+
+
+// Sets target to value when name is the parameter called field.
+template <typename T>
+static bool Assign( const std::string &name, const char *field, T &target, const float value )
+{
+    if ( name != field )
+    {
+        return false;
+    }
+    if constexpr ( std::is_enum_v<T> || std::is_integral_v<T> )
+    {
+        target = static_cast<T>( static_cast<int>( value ) );
+    }
+    else
+    {
+        target = static_cast<T>( value );
+    }
+    return true;
+}
+
+
+// Parameters are named after the members they set, the same ones SaveGraphFile writes.
+static bool SetParameter( Node *node, const std::string &name, const float value )
+{
+    switch ( node->type )
+    {
+    case NodeType::BLEND:
+        {
+            auto op = dynamic_cast<BlendNode *>( node );
+            return Assign( name, "mode", op->m_mode, value );
+        }
+    case NodeType::HSL:
+        {
+            auto op = dynamic_cast<HSLNode *>( node );
+            return Assign( name, "hue", op->m_hue, value ) || Assign( name, "saturation", op->m_saturation, value )
+                || Assign( name, "lightness", op->m_lightness, value );
+        }
+    case NodeType::LEVELS:
+        {
+            auto op = dynamic_cast<LevelsNode *>( node );
+            return Assign( name, "gamma", op->m_gamma, value ) || Assign( name, "luminanceOnly", op->m_luminanceOnly, value )
+                || Assign( name, "inputMin", op->m_inputRange.x, value ) || Assign( name, "inputMax", op->m_inputRange.y, value )
+                || Assign( name, "outputMin", op->m_outputRange.x, value ) || Assign( name, "outputMax", op->m_outputRange.y, value );
+        }
+    case NodeType::BLUR:
+        {
+            auto op = dynamic_cast<BlurNode *>( node );
+            return Assign( name, "mode", op->m_blurMode, value ) || Assign( name, "angle", op->m_angle, value )
+                || Assign( name, "samples", op->m_samples, value ) || Assign( name, "sigma", op->m_sigma, value )
+                || Assign( name, "useAlpha", op->m_useAlpha, value ) || Assign( name, "centerX", op->m_center.x, value )
+                || Assign( name, "centerY", op->m_center.y, value );
+        }
+    case NodeType::INVERT:
+        {
+            auto op = dynamic_cast<InvertNode *>( node );
+            return Assign( name, "channels", op->m_channels, value );
+        }
+    case NodeType::CURVES:
+        {
+            // red0 to red4, and the same for green and blue, the control points of each curve.
+            auto op = dynamic_cast<CurvesNode *>( node );
+            for ( int i = 0; i < 5; ++i )
+            {
+                const std::string index = std::to_string( i );
+                if ( Assign( name, ( "red" + index ).c_str(), op->m_red[i], value ) || Assign( name, ( "green" + index ).c_str(), op->m_green[i], value )
+                     || Assign( name, ( "blue" + index ).c_str(), op->m_blue[i], value ) )
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+    case NodeType::UNIFORM_COLOR:
+        {
+            auto op = dynamic_cast<UniformColorNode *>( node );
+            return Assign( name, "red", op->m_color.asPart.red, value ) || Assign( name, "green", op->m_color.asPart.green, value )
+                || Assign( name, "blue", op->m_color.asPart.blue, value ) || Assign( name, "alpha", op->m_color.asPart.alpha, value )
+                || Assign( name, "width", op->m_width, value ) || Assign( name, "height", op->m_height, value );
+        }
+    case NodeType::NOISE:
+        {
+            auto op = dynamic_cast<NoiseNode *>( node );
+            return Assign( name, "mode", op->m_mode, value ) || Assign( name, "seed", op->m_seed, value )
+                || Assign( name, "scale", op->m_scale, value ) || Assign( name, "width", op->m_width, value )
+                || Assign( name, "height", op->m_height, value );
+        }
+    default:
+        return false;
+    }
+}
+
+
+// Everything holding images has to be gone before the Application shuts Vulkan down, so this
+// runs while it is still around.
+static int Render( const CliArguments &arguments )
+{
+    Graph<Node *> graph;
+    std::vector<GraphFileNode> nodes;
+    GraphFileOverrides overrides = arguments.overrides;
+    // Tiles read their part of each image from disk, there is no point uploading them whole.
+    overrides.deferImages = arguments.tileSize != 0;
+    const bool loaded = LoadGraphFile( arguments.graphPath, graph, nodes, overrides );
+
+    int rootNodeId = -1;
+    for ( const GraphFileNode &node : nodes )
+    {
+        if ( node.type == NodeType::OUTPUT )
+        {
+            rootNodeId = node.id;
+        }
+    }
+
+    bool valid = loaded;
+    if ( loaded && rootNodeId == -1 )
+    {
+        fprintf( stderr, "%s has no output node\n", arguments.graphPath.c_str() );
+        valid = false;
+    }
+    for ( const auto &path : arguments.overrides.paths )
+    {
+        bool used = false;
+        for ( const GraphFileNode &node : nodes )
+        {
+            used |= node.fileId == path.first && ( node.type == NodeType::IMAGE || node.type == NodeType::DYNAMIC_IMAGE );
+        }
+        if ( loaded && !used )
+        {
+            fprintf( stderr, "%s has no image node %d to read %s into\n", arguments.graphPath.c_str(), path.first, path.second.c_str() );
+            valid = false;
+        }
+    }
+    for ( const CliArguments::Parameter &parameter : arguments.parameters )
+    {
+        if ( !valid )
+        {
+            break;
+        }
+        const GraphFileNode *target = nullptr;
+        for ( const GraphFileNode &node : nodes )
+        {
+            if ( node.fileId == parameter.nodeId )
+            {
+                target = &node;
+            }
+        }
+        if ( !target )
+        {
+            fprintf( stderr, "%s has no node %d\n", arguments.graphPath.c_str(), parameter.nodeId );
+            valid = false;
+        }
+        else if ( !SetParameter( graph.node( target->id ), parameter.name, parameter.value ) )
+        {
+            fprintf( stderr, "Node %d (%s) has no parameter %s\n", parameter.nodeId, graph.node( target->id )->name.c_str(), parameter.name.c_str() );
+            valid = false;
+        }
+    }
+
+    Profiler *profiler = Application::GetProfiler();
+    profiler->SetEnabled( !arguments.tracePath.empty() );
+
+    bool saved = false;
+    if ( valid && arguments.tileSize != 0 )
+    {
+        BlankImageCache blankImages;
+        TiledEvaluator::Options options;
+        options.tileSize = arguments.tileSize;
+        options.batchCompute = arguments.batchCompute;
+        options.fusePointwise = arguments.fusePointwise;
+        options.blankImages = &blankImages;
+        options.cpuBackend = arguments.cpuOnly;
+        options.floatFormat = arguments.floatFormat;
+        TiledEvaluator evaluator( options );
+        saved = evaluator.Render( graph, rootNodeId, arguments.outputPath );
+    }
+    else if ( valid )
+    {
+        BlankImageCache blankImages;
+        GraphEvaluator::Options options;
+        options.batchCompute = arguments.batchCompute;
+        options.fusePointwise = arguments.fusePointwise;
+        options.blankImages = &blankImages;
+        options.cpuBackend = arguments.cpuOnly;
+        options.floatFormat = arguments.floatFormat;
+        GraphEvaluator evaluator( options );
+
+        const std::shared_ptr<Image> output = evaluator.Evaluate( graph, rootNodeId );
+        if ( !output )
+        {
+            fprintf( stderr, "Nothing to render, the output isn't connected to anything\n" );
+        }
+        else
+        {
+            saved = output->SaveToFile( arguments.outputPath );
+            if ( !saved )
+            {
+                fprintf( stderr, "Could not write %s\n", arguments.outputPath.c_str() );
+            }
+        }
+    }
+
+    if ( valid && !arguments.tracePath.empty() )
+    {
+        for ( const auto &timing : profiler->GetNodeTimings() )
+        {
+            printf( "%-32s %8.3f ms GPU %8.3f ms CPU\n", timing.second.name.c_str(), timing.second.gpuMs, timing.second.cpuMs );
+        }
+        if ( !profiler->WriteChromeTrace( arguments.tracePath ) )
+        {
+            fprintf( stderr, "Could not write %s\n", arguments.tracePath.c_str() );
+        }
+    }
+
+    for ( Node *node : graph.nodes() )
+    {
+        delete node;
+    }
+    return saved ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+int CliMain( int argc, char **argv )
+{
+    CliArguments arguments;
+    if ( !ParseArguments( argc, argv, arguments ) )
+    {
+        PrintUsage();
+        return EXIT_FAILURE;
+    }
+
+    AppConfig config;
+    config.name = "SurgeCli";
+    config.headless = true;
+    config.cpuOnly = arguments.cpuOnly;
+    const auto app = new Application( config );
+    const int result = Render( arguments );
+    delete app;
+
+    return result;
+}
+
+}
+
+int main( int argc, char **argv )
+{
+    return Surge::CliMain( argc, argv );
+}
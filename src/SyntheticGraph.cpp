@@ -0,0 +1,231 @@
+#include "SyntheticGraph.h"
+
+#include <algorithm>
+
+#include "GraphNodes/GraphNodes.h"
+
+namespace Surge
+{
+
+SyntheticGraph::SyntheticGraph( const Shape shape, int nodeCount, const uint32_t seed ) : m_random( seed )
+{
+    nodeCount = std::max( nodeCount, 3 );
+    int last = -1;
+    switch ( shape )
+    {
+    case Shape::CHAIN:
+        last = AddSource();
+        for ( int i = 2; i < nodeCount; ++i )
+        {
+            last = AddUnary( last );
+        }
+        break;
+    case Shape::TREE:
+        {
+            // A source, the row, and one blend fewer than the row is long.
+            const int source = AddSource();
+            std::vector<int> row;
+            for ( int i = 0; i < std::max( ( nodeCount - 1 ) / 2, 1 ); ++i )
+            {
+                row.push_back( AddUnary( source ) );
+            }
+            last = BlendTogether( row );
+        }
+        break;
+    case Shape::RANDOM:
+        {
+            // The nodes nothing reads from yet, blending them together takes one node fewer than
+            // there are of them, and then there is the output.
+            std::vector<int> unread;
+            auto read = [&unread]( const int id ) { unread.erase( std::remove( unread.begin(), unread.end(), id ), unread.end() ); };
+            auto any = [this]() { return m_operators[std::uniform_int_distribution<size_t>( 0, m_operators.size() - 1 )( m_random )]; };
+            while ( static_cast<int>( m_operators.size() + unread.size() ) < nodeCount )
+            {
+                const float pick = Uniform( 0.0f, 1.0f );
+                int id;
+                if ( m_operators.empty() || pick < 0.1f )
+                {
+                    id = AddSource();
+                }
+                else if ( pick < 0.35f )
+                {
+                    const int lhs = any();
+                    const int rhs = any();
+                    id = AddBlend( lhs, rhs );
+                    read( lhs );
+                    read( rhs );
+                }
+                else
+                {
+                    const int input = any();
+                    id = AddUnary( input );
+                    read( input );
+                }
+                unread.push_back( id );
+            }
+            last = BlendTogether( unread );
+        }
+        break;
+    }
+
+    m_rootNodeId = AddNode( new Node( NodeType::OUTPUT ), { last } );
+}
+
+
+SyntheticGraph::~SyntheticGraph()
+{
+    for ( Node *node : m_graph.nodes() )
+    {
+        delete node;
+    }
+}
+
+
+const char *SyntheticGraph::GetShapeName( const Shape shape )
+{
+    switch ( shape )
+    {
+    case Shape::CHAIN:  return "chain";
+    case Shape::TREE:   return "tree";
+    case Shape::RANDOM: return "random";
+    }
+    return "";
+}
+
+
+int SyntheticGraph::AddSource()
+{
+    Node *op;
+    if ( Uniform( 0.0f, 1.0f ) < 0.75f )
+    {
+        NoiseNode *noise = new NoiseNode();
+        noise->m_mode = static_cast<NoiseCompute::NoiseMode>( std::uniform_int_distribution<int>( 0, 3 )( m_random ) );
+        noise->m_seed = std::uniform_int_distribution<int>( 0, 1000 )( m_random );
+        noise->m_scale = Uniform( 2.0f, 16.0f );
+        op = noise;
+    }
+    else
+    {
+        UniformColorNode *color = new UniformColorNode();
+        for ( float &channel : color->m_color.asArray.data )
+        {
+            channel = Uniform( 0.0f, 1.0f );
+        }
+        color->m_color.asPart.alpha = 1.0f;
+        op = color;
+    }
+
+    const int id = AddNode( op, {} );
+    m_operators.push_back( id );
+    return id;
+}
+
+
+int SyntheticGraph::AddUnary( const int input )
+{
+    Node *op = nullptr;
+    switch ( std::uniform_int_distribution<int>( 0, 4 )( m_random ) )
+    {
+    case 0:
+        {
+            HSLNode *hsl = new HSLNode();
+            hsl->m_hue = Uniform( -0.2f, 0.2f );
+            hsl->m_saturation = Uniform( -0.2f, 0.2f );
+            hsl->m_lightness = Uniform( -0.1f, 0.1f );
+            op = hsl;
+        }
+        break;
+    case 1:
+        {
+            LevelsNode *levels = new LevelsNode();
+            levels->m_gamma = Uniform( 0.7f, 1.4f );
+            levels->m_inputRange = ImVec2( Uniform( 0.0f, 0.1f ), Uniform( 0.9f, 1.0f ) );
+            op = levels;
+        }
+        break;
+    case 2:
+        op = new CurvesNode();
+        break;
+    case 3:
+        {
+            // Small enough that a long chain of them is still about the graph, not the blurs.
+            BlurNode *blur = new BlurNode();
+            blur->m_blurMode = BlurCompute::BlurMode::GAUSSIAN;
+            blur->m_sigma = Uniform( 0.5f, 4.0f );
+            op = blur;
+        }
+        break;
+    default:
+        op = new InvertNode();
+        break;
+    }
+
+    const int id = AddNode( op, { input } );
+    m_operators.push_back( id );
+    return id;
+}
+
+
+int SyntheticGraph::AddBlend( const int lhs, const int rhs )
+{
+    BlendNode *blend = new BlendNode();
+    blend->m_mode = static_cast<BlendCompute::BlendMode>( std::uniform_int_distribution<int>( 0, 4 )( m_random ) );
+
+    const int id = AddNode( blend, { lhs, rhs } );
+    m_operators.push_back( id );
+    return id;
+}
+
+
+int SyntheticGraph::BlendTogether( std::vector<int> nodes )
+{
+    while ( nodes.size() > 1 )
+    {
+        std::vector<int> blended;
+        for ( size_t i = 0; i + 1 < nodes.size(); i += 2 )
+        {
+            blended.push_back( AddBlend( nodes[i], nodes[i + 1] ) );
+        }
+        if ( nodes.size() % 2 == 1 )
+        {
+            blended.push_back( nodes.back() );
+        }
+        nodes = std::move( blended );
+    }
+    return nodes.front();
+}
+
+
+int SyntheticGraph::AddNode( Node *op, const std::initializer_list<int> inputs )
+{
+    GraphFileNode node;
+    node.type = op->type;
+    int pin = 0;
+    for ( size_t i = 0; i < inputs.size(); ++i )
+    {
+        node.inputs[i] = m_graph.insert_node( new Node( NodeType::VALUE ) );
+    }
+    node.id = m_graph.insert_node( op );
+    node.fileId = node.id;
+    for ( const int input : inputs )
+    {
+        // From the node to its pin, and from the pin to what feeds it, like the NodeCanvas links them.
+        m_graph.insert_edge( node.id, node.inputs[pin] );
+        m_graph.insert_edge( node.inputs[pin], input );
+        ++pin;
+    }
+
+    // In rows, in the order they were made, so the graph can be opened in the canvas.
+    node.x = static_cast<float>( m_nodes.size() % 32 ) * 200.0f;
+    node.y = static_cast<float>( m_nodes.size() / 32 ) * 150.0f;
+    m_nodes.push_back( node );
+    return node.id;
+}
+
+
+float SyntheticGraph::Uniform( const float min, const float max )
+{
+    return std::uniform_real_distribution<float>( min, max )( m_random );
+}
+
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+#include <random>
+#include <vector>
+
+#include "Graph.h"
+#include "GraphFile.h"
+
+#include "GraphNodes/Node.h"
+
+namespace Surge
+{
+
+// Builds graphs out of the regular nodes, at sizes and in shapes nobody would draw by hand, for
+// benchmarking the graph engine, see SurgeBench. Sources are noise and uniform colour nodes, so
+// nothing has to be read from disk, everything in between is picked from the per-pixel nodes, blurs
+// and blends with parameters drawn from seed. Every node ends up feeding the OUTPUT node.
+//
+// The pins and edges are laid out as the NodeCanvas makes them, and the nodes are listed like
+// LoadGraphFile lists them, so the graph can be saved with SaveGraphFile too.
+class SyntheticGraph
+{
+public:
+    enum class Shape
+    {
+        // One source through a line of single input nodes.
+        CHAIN,
+        // One source fanning out to a row of single input nodes, which are blended back together
+        // pairwise down to one.
+        TREE,
+        // Every node takes its inputs from any of the nodes made before it. Whatever nothing reads
+        // is blended together into the output.
+        RANDOM,
+    };
+
+    // nodeCount counts every node but the input pins, the output included. The graph can come out
+    // a node or two off, depending on the shape, at least three nodes are made.
+    SyntheticGraph( Shape shape, int nodeCount, uint32_t seed );
+    ~SyntheticGraph();
+
+    SyntheticGraph( const SyntheticGraph & ) = delete;
+    SyntheticGraph &operator=( const SyntheticGraph & ) = delete;
+
+    static const char *GetShapeName( Shape shape );
+
+    Graph<Node *> &GetGraph() { return m_graph; }
+    const std::vector<GraphFileNode> &GetNodes() const { return m_nodes; }
+    int GetRootNodeId() const { return m_rootNodeId; }
+    // Every node but the pins and the output, in the order they were made, so each comes after
+    // all the nodes it reads from.
+    const std::vector<int> &GetOperators() const { return m_operators; }
+
+private:
+    int AddSource();
+    int AddUnary( int input );
+    int AddBlend( int lhs, int rhs );
+    // Blends nodes together pairwise, then the results, until there is one left, and returns it.
+    int BlendTogether( std::vector<int> nodes );
+    // Inserts op with a pin per input, wired to them.
+    int AddNode( Node *op, std::initializer_list<int> inputs );
+
+    float Uniform( float min, float max );
+
+    std::mt19937 m_random;
+    Graph<Node *> m_graph;
+    std::vector<GraphFileNode> m_nodes;
+    std::vector<int> m_operators;
+    int m_rootNodeId = -1;
+};
+
+}
@@ -0,0 +1,48 @@
+#include "ThreadPool.h"
+
+namespace Surge
+{
+
+ThreadPool::ThreadPool( const size_t threadCount )
+{
+    for ( size_t i = 0; i < threadCount; ++i )
+    {
+        m_threads.emplace_back( &ThreadPool::Run, this );
+    }
+}
+
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for ( std::thread &thread : m_threads )
+    {
+        thread.join();
+    }
+}
+
+
+void ThreadPool::Run()
+{
+    for ( ;; )
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock( m_mutex );
+            m_wake.wait( lock, [this]() { return m_stopping || !m_tasks.empty(); } );
+            if ( m_tasks.empty() )
+            {
+                return;
+            }
+            task = std::move( m_tasks.front() );
+            m_tasks.pop_front();
+        }
+        task();
+    }
+}
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace Surge
+{
+
+// A fixed set of threads working through a queue of tasks, for startup work that can run side by
+// side such as building the compute kernels. Tasks still queued on destruction are run first.
+class ThreadPool
+{
+public:
+    explicit ThreadPool( size_t threadCount );
+    ~ThreadPool();
+
+    ThreadPool( const ThreadPool & ) = delete;
+    ThreadPool &operator=( const ThreadPool & ) = delete;
+
+    template <typename Func>
+    std::shared_future<std::invoke_result_t<Func>> Submit( Func &&func )
+    {
+        using Result = std::invoke_result_t<Func>;
+        auto task = std::make_shared<std::packaged_task<Result()>>( std::forward<Func>( func ) );
+        std::shared_future<Result> future = task->get_future().share();
+        {
+            std::lock_guard<std::mutex> lock( m_mutex );
+            m_tasks.emplace_back( [task]() { ( *task )(); } );
+        }
+        m_wake.notify_one();
+        return future;
+    }
+
+    size_t GetThreadCount() const { return m_threads.size(); }
+
+private:
+    void Run();
+
+    std::mutex                        m_mutex;
+    std::condition_variable           m_wake;
+    std::deque<std::function<void()>> m_tasks;
+    bool                              m_stopping = false;
+    std::vector<std::thread>          m_threads;
+};
+
+}
@@ -0,0 +1,163 @@
+#include "ThumbnailCache.h"
+
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <thread>
+
+namespace Surge
+{
+
+static constexpr uint32_t ThumbnailFileMagic = 0x43544753; // "SGTC"
+static constexpr uint32_t ThumbnailFileVersion = 1;
+// Anything bigger than this is a damaged file rather than a thumbnail.
+static constexpr uint32_t MaxThumbnailSize = 4096;
+
+struct ThumbnailFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    int64_t  writeTime;
+    uint64_t size;
+    uint32_t width;
+    uint32_t height;
+    // Followed by the path, compared in full in case two keys hash to the same name.
+    uint32_t pathLength;
+    // Keeps the struct free of padding.
+    uint32_t reserved;
+};
+
+
+// FNV-1a, spelled out rather than std::hash because the names have to stay the same between builds.
+static uint64_t Hash( const void *data, const size_t size, uint64_t hash = 0xcbf29ce484222325ull )
+{
+    const uint8_t *bytes = static_cast<const uint8_t *>( data );
+    for ( size_t i = 0; i < size; ++i )
+    {
+        hash = ( hash ^ bytes[i] ) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+
+ThumbnailCache::ThumbnailCache( std::filesystem::path directory ) : m_directory( std::move( directory ) )
+{
+    std::error_code error;
+    std::filesystem::create_directories( m_directory, error );
+    if ( error )
+    {
+        fprintf( stderr, "Could not create %s, thumbnails won't be kept: %s\n", m_directory.string().c_str(), error.message().c_str() );
+    }
+}
+
+
+bool ThumbnailCache::GetKey( const std::filesystem::path &source, Key &key )
+{
+    std::error_code error;
+    const auto writeTime = std::filesystem::last_write_time( source, error );
+    if ( error )
+    {
+        return false;
+    }
+    key.size = std::filesystem::file_size( source, error );
+    if ( error )
+    {
+        return false;
+    }
+    key.path = std::filesystem::absolute( source, error ).generic_string();
+    key.writeTime = static_cast<int64_t>( writeTime.time_since_epoch().count() );
+    return !error;
+}
+
+
+std::filesystem::path ThumbnailCache::GetCachePath( const Key &key ) const
+{
+    uint64_t hash = Hash( key.path.data(), key.path.size() );
+    hash = Hash( &key.writeTime, sizeof( key.writeTime ), hash );
+    hash = Hash( &key.size, sizeof( key.size ), hash );
+
+    char name[32];
+    snprintf( name, sizeof( name ), "%016llx.thumb", static_cast<unsigned long long>( hash ) );
+    return m_directory / name;
+}
+
+
+bool ThumbnailCache::Load( const Key &key, ImageData &thumbnail ) const
+{
+    std::ifstream file( GetCachePath( key ), std::ios::binary );
+    if ( !file )
+    {
+        return false;
+    }
+
+    ThumbnailFileHeader header = {};
+    if ( !file.read( reinterpret_cast<char *>( &header ), sizeof( header ) ) || header.magic != ThumbnailFileMagic
+         || header.version != ThumbnailFileVersion || header.writeTime != key.writeTime || header.size != key.size
+         || header.pathLength != key.path.size() || header.width == 0 || header.height == 0 || header.width > MaxThumbnailSize
+         || header.height > MaxThumbnailSize )
+    {
+        return false;
+    }
+    std::string path( header.pathLength, '\0' );
+    if ( !file.read( path.data(), static_cast<std::streamsize>( path.size() ) ) || path != key.path )
+    {
+        return false;
+    }
+
+    thumbnail.width = header.width;
+    thumbnail.height = header.height;
+    thumbnail.format = ImageFormat::RGBA;
+    thumbnail.pixels.resize( static_cast<size_t>( header.width ) * header.height * 4 );
+    if ( !file.read( reinterpret_cast<char *>( thumbnail.pixels.data() ), static_cast<std::streamsize>( thumbnail.pixels.size() ) ) )
+    {
+        thumbnail.pixels.clear();
+        return false;
+    }
+    return true;
+}
+
+
+void ThumbnailCache::Store( const Key &key, const ImageData &thumbnail ) const
+{
+    if ( thumbnail.format != ImageFormat::RGBA || thumbnail.pixels.empty() )
+    {
+        return;
+    }
+
+    ThumbnailFileHeader header = {};
+    header.magic = ThumbnailFileMagic;
+    header.version = ThumbnailFileVersion;
+    header.writeTime = key.writeTime;
+    header.size = key.size;
+    header.width = thumbnail.width;
+    header.height = thumbnail.height;
+    header.pathLength = static_cast<uint32_t>( key.path.size() );
+
+    // Written next to where it belongs and then moved into place, so a reader on another thread
+    // never sees half a file.
+    const std::filesystem::path cachePath = GetCachePath( key );
+    std::filesystem::path writePath = cachePath;
+    writePath += "." + std::to_string( std::hash<std::thread::id>()( std::this_thread::get_id() ) ) + ".tmp";
+    {
+        std::ofstream file( writePath, std::ios::binary | std::ios::trunc );
+        file.write( reinterpret_cast<const char *>( &header ), sizeof( header ) );
+        file.write( key.path.data(), static_cast<std::streamsize>( key.path.size() ) );
+        file.write( reinterpret_cast<const char *>( thumbnail.pixels.data() ), static_cast<std::streamsize>( thumbnail.pixels.size() ) );
+        if ( !file )
+        {
+            file.close();
+            std::error_code error;
+            std::filesystem::remove( writePath, error );
+            return;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename( writePath, cachePath, error );
+    if ( error )
+    {
+        std::filesystem::remove( writePath, error );
+    }
+}
+
+}
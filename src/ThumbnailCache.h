@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+#include "Image.h"
+
+namespace Surge
+{
+
+// Keeps the explorer's thumbnails on disk between runs, one file per source image named after a
+// hash of its path, size and modification time. Editing an image changes its name, so stale
+// thumbnails are never read back, only left behind. Each file is a header, the source path and the
+// RGBA pixels, in that order. Safe to use from several threads.
+class ThumbnailCache
+{
+public:
+    // Identifies one version of a source image.
+    struct Key
+    {
+        std::string path;
+        int64_t     writeTime = 0;
+        uint64_t    size = 0;
+    };
+
+    explicit ThumbnailCache( std::filesystem::path directory );
+
+    // Looks the source image up on disk, false if it can't be read.
+    static bool GetKey( const std::filesystem::path &source, Key &key );
+
+    // Fills thumbnail with what was stored for key, false if there is nothing or it doesn't match.
+    bool Load( const Key &key, ImageData &thumbnail ) const;
+    // Only RGBA thumbnails are stored.
+    void Store( const Key &key, const ImageData &thumbnail ) const;
+
+private:
+    std::filesystem::path GetCachePath( const Key &key ) const;
+
+    std::filesystem::path m_directory;
+};
+
+}
@@ -0,0 +1,321 @@
+#include "TiledEvaluator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include "Application.h"
+#include "GraphEvaluator.h"
+#include "Image.h"
+#include "StreamingPngWriter.h"
+#include "TransientImagePool.h"
+
+#include "GraphNodes/GraphNodes.h"
+
+namespace Surge
+{
+
+namespace
+{
+
+// A part of the output image, from x0, y0 up to but not including x1, y1.
+struct Rect
+{
+    int32_t x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+
+    bool Empty() const { return x1 <= x0 || y1 <= y0; }
+    uint32_t Width() const { return static_cast<uint32_t>( x1 - x0 ); }
+    uint32_t Height() const { return static_cast<uint32_t>( y1 - y0 ); }
+};
+
+
+Rect Union( const Rect &a, const Rect &b )
+{
+    if ( a.Empty() )
+    {
+        return b;
+    }
+    if ( b.Empty() )
+    {
+        return a;
+    }
+    return { std::min( a.x0, b.x0 ), std::min( a.y0, b.y0 ), std::max( a.x1, b.x1 ), std::max( a.y1, b.y1 ) };
+}
+
+
+Rect Grow( const Rect &rect, const int32_t by, const Rect &bounds )
+{
+    return { std::max( rect.x0 - by, bounds.x0 ), std::max( rect.y0 - by, bounds.y0 ), std::min( rect.x1 + by, bounds.x1 ),
+             std::min( rect.y1 + by, bounds.y1 ) };
+}
+
+
+// How far outside of output a node reads its input, in pixels. Has to match the shaders, see
+// BlurCompute.comp and BlurCompute::RunGaussian.
+int32_t GetHalo( const Node *node, const Rect &output )
+{
+    if ( node->type != NodeType::BLUR )
+    {
+        return 0;
+    }
+
+    const BlurNode *blur = dynamic_cast<const BlurNode *>( node );
+    switch ( blur->m_blurMode )
+    {
+    case BlurCompute::BlurMode::GAUSSIAN:
+        if ( blur->m_sigma > BlurCompute::RecursiveGaussianSigma )
+        {
+            // The recursive filter reaches across the whole row, but what comes from further away
+            // than four sigma is too little to show up in 8 bits.
+            return static_cast<int32_t>( std::ceil( blur->m_sigma * 4.0f ) );
+        }
+        return std::clamp( static_cast<int32_t>( std::ceil( blur->m_sigma * 3.0f ) ), 1, BlurCompute::MaxGaussianRadius );
+    case BlurCompute::BlurMode::MOTION:
+        return static_cast<int32_t>( std::ceil( blur->m_sigma * 2.6412f ) ) + 1;
+    case BlurCompute::BlurMode::RADIAL:
+        {
+            // Pixels are turned about the center by up to the angle, so they move by at most the
+            // chord that angle spans at the furthest corner of output.
+            const float dx = std::max( std::abs( output.x0 - blur->m_center.x ), std::abs( output.x1 - blur->m_center.x ) );
+            const float dy = std::max( std::abs( output.y0 - blur->m_center.y ), std::abs( output.y1 - blur->m_center.y ) );
+            constexpr float pi = 3.141592653589793f;
+            const float angle = std::min( std::abs( blur->m_angle ) * ( pi / 180.0f ), pi );
+            return static_cast<int32_t>( std::ceil( 2.0f * std::sqrt( dx * dx + dy * dy ) * std::sin( angle * 0.5f ) ) ) + 1;
+        }
+    default:
+        return 0;
+    }
+}
+
+
+// Copies rect out of source, which covers the whole image.
+ImageData Crop( const ImageData &source, const Rect &rect )
+{
+    const size_t bytesPerPixel = Image::BytesPerPixel( source.format );
+    ImageData cropped;
+    cropped.width = rect.Width();
+    cropped.height = rect.Height();
+    cropped.format = source.format;
+    cropped.pixels.resize( static_cast<size_t>( cropped.width ) * cropped.height * bytesPerPixel );
+    for ( uint32_t row = 0; row < cropped.height; ++row )
+    {
+        const size_t from = ( static_cast<size_t>( rect.y0 + row ) * source.width + rect.x0 ) * bytesPerPixel;
+        memcpy( cropped.pixels.data() + row * cropped.width * bytesPerPixel, source.pixels.data() + from, cropped.width * bytesPerPixel );
+    }
+    return cropped;
+}
+
+}
+
+
+TiledEvaluator::TiledEvaluator( const Options &options ) : m_options( options )
+{
+}
+
+
+bool TiledEvaluator::Render( const Graph<Node *> &graph, const int rootNodeId, const std::string &filepath )
+{
+    if ( !graph.contains_node( rootNodeId ) )
+    {
+        fprintf( stderr, "Nothing to render, the graph has no output node\n" );
+        return false;
+    }
+
+    // The tiles are evaluated on copies of the nodes, like in the BatchExporter.
+    Graph<Node *> tileGraph = graph;
+    for ( const int id : graph.node_ids() )
+    {
+        Node *clone = graph.node( id )->Clone();
+        tileGraph.update_node( id, clone );
+    }
+    auto deleteNodes = [&tileGraph]()
+    {
+        for ( Node *node : tileGraph.nodes() )
+        {
+            delete node;
+        }
+    };
+
+    std::vector<int> postorder;
+    postorder_traverse( tileGraph, rootNodeId, [&postorder]( const int nodeId ) -> void { postorder.push_back( nodeId ); } );
+
+    // Every node is evaluated at the size of the region, so the sources have to agree on the size
+    // of the whole image. Generators only decide it when there are no images.
+    std::unordered_map<int, ImageData> sources;
+    uint32_t width = 0, height = 0;
+    uint32_t generatedWidth = 0, generatedHeight = 0;
+    for ( const int id : postorder )
+    {
+        Node *node = tileGraph.node( id );
+        std::string path;
+        uint32_t nodeWidth, nodeHeight;
+        if ( node->GetGeneratedSize( nodeWidth, nodeHeight ) )
+        {
+            if ( generatedWidth != 0 && ( nodeWidth != generatedWidth || nodeHeight != generatedHeight ) )
+            {
+                fprintf( stderr, "%s is set to %ux%u, other nodes to %ux%u. Tiles need them all the same size\n", node->name.c_str(), nodeWidth,
+                         nodeHeight, generatedWidth, generatedHeight );
+                deleteNodes();
+                return false;
+            }
+            generatedWidth = nodeWidth;
+            generatedHeight = nodeHeight;
+            continue;
+        }
+        if ( node->type == NodeType::TRANSFORM )
+        {
+            fprintf( stderr, "%s uses a transform node, which can't be rendered in tiles\n", filepath.c_str() );
+            deleteNodes();
+            return false;
+        }
+        if ( node->type == NodeType::IMAGE )
+        {
+            path = static_cast<ImageNode *>( node )->m_filepath;
+        }
+        else if ( node->type == NodeType::DYNAMIC_IMAGE )
+        {
+            const auto dynImage = static_cast<DynamicImageNode *>( node );
+            path = dynImage->m_filePaths.empty() ? std::string() : dynImage->m_filePaths[dynImage->m_currentImage];
+        }
+        else
+        {
+            continue;
+        }
+
+        ImageData &source = sources[id];
+        if ( path.empty() || !Image::LoadFile( path, source ) )
+        {
+            fprintf( stderr, "Could not load %s\n", path.empty() ? node->name.c_str() : path.c_str() );
+            deleteNodes();
+            return false;
+        }
+        if ( width != 0 && ( source.width != width || source.height != height ) )
+        {
+            fprintf( stderr, "%s is %ux%u, the other images are %ux%u. Tiles need them all the same size\n", path.c_str(), source.width,
+                     source.height, width, height );
+            deleteNodes();
+            return false;
+        }
+        width = source.width;
+        height = source.height;
+    }
+    if ( sources.empty() )
+    {
+        width = generatedWidth != 0 ? generatedWidth : m_options.width;
+        height = generatedHeight != 0 ? generatedHeight : m_options.height;
+    }
+
+    // Host images can be as big as memory allows.
+    const bool cpuBackend = m_options.cpuBackend || Application::GetDevice() == VK_NULL_HANDLE;
+    uint32_t maxDimension = UINT32_MAX;
+    if ( !cpuBackend )
+    {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties( Application::GetPhysicalDevice(), &properties );
+        maxDimension = properties.limits.maxImageDimension2D;
+    }
+
+    StreamingPngWriter writer;
+    if ( !writer.Open( filepath, width, height ) )
+    {
+        fprintf( stderr, "Could not write %s\n", filepath.c_str() );
+        deleteNodes();
+        return false;
+    }
+
+    TransientImagePool imagePool;
+    GraphEvaluator::Options evaluatorOptions;
+    evaluatorOptions.batchCompute = m_options.batchCompute;
+    evaluatorOptions.fusePointwise = m_options.fusePointwise;
+    evaluatorOptions.blankImages = m_options.blankImages;
+    evaluatorOptions.cpuBackend = cpuBackend;
+    evaluatorOptions.floatFormat = m_options.floatFormat;
+    evaluatorOptions.imagePool = &imagePool;
+
+    const Rect bounds = { 0, 0, static_cast<int32_t>( width ), static_cast<int32_t>( height ) };
+    const uint32_t tileSize = std::max( m_options.tileSize, 1u );
+    // One row of tiles, the png is written a band at a time.
+    std::vector<uint8_t> band( static_cast<size_t>( width ) * std::min( tileSize, height ) * 4 );
+    std::vector<uint8_t> readback;
+    bool rendered = true;
+    for ( uint32_t bandY = 0; bandY < height && rendered; bandY += tileSize )
+    {
+        const uint32_t bandHeight = std::min( tileSize, height - bandY );
+        for ( uint32_t tileX = 0; tileX < width && rendered; tileX += tileSize )
+        {
+            const Rect tile = { static_cast<int32_t>( tileX ), static_cast<int32_t>( bandY ), static_cast<int32_t>( std::min( tileX + tileSize, width ) ),
+                                static_cast<int32_t>( bandY + bandHeight ) };
+
+            // Consumers come after their inputs in postorder, so walking it backwards each node's
+            // region is complete before it is passed on.
+            std::unordered_map<int, Rect> needed = { { rootNodeId, tile } };
+            Rect evaluated = tile;
+            for ( auto iter = postorder.rbegin(); iter != postorder.rend(); ++iter )
+            {
+                const Rect &output = needed[*iter];
+                const Rect input = Grow( output, GetHalo( tileGraph.node( *iter ), output ), bounds );
+                for ( const int neighbor : tileGraph.neighbors( *iter ) )
+                {
+                    needed[neighbor] = Union( needed[neighbor], input );
+                }
+                evaluated = Union( evaluated, input );
+            }
+            if ( evaluated.Width() > maxDimension || evaluated.Height() > maxDimension )
+            {
+                fprintf( stderr, "A tile needs a %ux%u region around it, more than the GPU can hold in one image. Try smaller tiles\n",
+                         evaluated.Width(), evaluated.Height() );
+                rendered = false;
+                break;
+            }
+
+            for ( auto &source : sources )
+            {
+                const ImageData region = Crop( source.second, evaluated );
+                Node *node = tileGraph.node( source.first );
+                node->value = std::make_shared<Image>( region.width, region.height, region.format, region.pixels.data(),
+                                                       cpuBackend ? ImageStorage::Host : ImageStorage::Device );
+                node->MarkDirty();
+            }
+
+            evaluatorOptions.region = { evaluated.x0, evaluated.y0, evaluated.Width(), evaluated.Height(), width, height };
+            GraphEvaluator evaluator( evaluatorOptions );
+            const std::shared_ptr<Image> output = evaluator.Evaluate( tileGraph, rootNodeId );
+            if ( !output )
+            {
+                fprintf( stderr, "Nothing to render, the output isn't connected to anything\n" );
+                rendered = false;
+                break;
+            }
+
+            const ImageFormat format = output->GetFormat();
+            readback.resize( static_cast<size_t>( output->GetWidth() ) * output->GetHeight() * Image::BytesPerPixel( format ) );
+            output->GetData( readback.data() );
+            for ( int32_t y = tile.y0; y < tile.y1; ++y )
+            {
+                uint8_t *to = band.data() + ( static_cast<size_t>( y - tile.y0 ) * width + tile.x0 ) * 4;
+                const size_t from = static_cast<size_t>( y - evaluated.y0 ) * output->GetWidth() + ( tile.x0 - evaluated.x0 );
+                Image::ConvertPixels( format, readback.data() + from * Image::BytesPerPixel( format ), ImageFormat::RGBA, to, tile.Width() );
+            }
+
+            for ( auto &source : sources )
+            {
+                tileGraph.node( source.first )->value.reset();
+            }
+        }
+
+        rendered = rendered && writer.WriteRows( band.data(), bandHeight );
+    }
+
+    rendered = writer.Close() && rendered;
+    if ( !rendered )
+    {
+        fprintf( stderr, "Could not render %s\n", filepath.c_str() );
+    }
+    deleteNodes();
+    return rendered;
+}
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+
+#include "BlankImageCache.h"
+#include "Graph.h"
+
+#include "GraphNodes/Node.h"
+
+namespace Surge
+{
+
+// Renders a graph's output one tile at a time and streams it to a png, for images too big to hold
+// on the GPU at once, or bigger than it can make an image. For every tile the region each node has
+// to produce is worked out from the output back, growing by the reach of nodes that read
+// neighbouring pixels, e.g. blurs. The source images are cropped to that region and the graph is
+// evaluated on just that part, so GPU memory goes with the tile size rather than the image size.
+//
+// Source images are decoded whole into host memory, and transform nodes can't be tiled since any
+// output pixel can come from anywhere in their input.
+class TiledEvaluator
+{
+public:
+    struct Options
+    {
+        // Width and height of a tile. The region evaluated for it is bigger by the reach of the
+        // graph's blurs, and has to fit in a single image.
+        uint32_t tileSize = 2048;
+        // The size of the output when the graph has neither image nodes nor generators, e.g. noise,
+        // to take it from.
+        uint32_t width = DefaultImageSize, height = DefaultImageSize;
+
+        // Passed on to the GraphEvaluator, see GraphEvaluator::Options.
+        bool batchCompute = true;
+        bool fusePointwise = false;
+        BlankImageCache *blankImages = nullptr;
+        bool cpuBackend = false;
+        ImageFormat floatFormat = ImageFormat::RGBA16F;
+    };
+
+    TiledEvaluator() = default;
+    explicit TiledEvaluator( const Options &options );
+
+    // Renders the output at rootNodeId to filepath, adding .png if it isn't there. IMAGE and
+    // DYNAMIC_IMAGE nodes are read from their files, whatever image they hold is not used, so the
+    // graph can be loaded with GraphFileOverrides::deferImages. Works on copies of the nodes,
+    // graph is left as it was.
+    bool Render( const Graph<Node *> &graph, int rootNodeId, const std::string &filepath );
+
+private:
+    Options m_options;
+};
+
+}
@@ -0,0 +1,69 @@
+#include "TransientImagePool.h"
+
+#include <algorithm>
+
+namespace Surge
+{
+
+static uint64_t ImageByteSize( const Image &image )
+{
+    return static_cast<uint64_t>( image.GetWidth() ) * image.GetHeight() * Image::BytesPerPixel( image.GetFormat() );
+}
+
+
+std::shared_ptr<Image> TransientImagePool::Acquire( const uint32_t width, const uint32_t height, const ImageFormat format, const ImageStorage storage )
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    for ( Entry &entry : m_entries )
+    {
+        // Only the pool can add references to its images, so once this reads 1 it stays that way.
+        const Image &image = *entry.image;
+        if ( entry.image.use_count() == 1 && image.GetWidth() == width && image.GetHeight() == height && image.GetFormat() == format &&
+             image.GetStorage() == storage )
+        {
+            entry.lastEpoch = m_epoch;
+            return entry.image;
+        }
+    }
+
+    m_entries.push_back( { std::make_shared<Image>( width, height, format, nullptr, storage ), m_epoch } );
+    return m_entries.back().image;
+}
+
+
+void TransientImagePool::NextEpoch()
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    ++m_epoch;
+}
+
+
+void TransientImagePool::Trim()
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    m_entries.erase( std::remove_if( m_entries.begin(), m_entries.end(), [this]( const Entry &entry ) -> bool
+    {
+        return entry.image.use_count() == 1 && entry.lastEpoch != m_epoch;
+    } ), m_entries.end() );
+}
+
+
+size_t TransientImagePool::GetImageCount() const
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    return m_entries.size();
+}
+
+
+uint64_t TransientImagePool::GetByteSize() const
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    uint64_t size = 0;
+    for ( const Entry &entry : m_entries )
+    {
+        size += ImageByteSize( *entry.image );
+    }
+    return size;
+}
+
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Image.h"
+
+namespace Surge
+{
+
+// Recycles the images intermediate node outputs are rendered into. An image is free again as soon
+// as the pool holds the only reference to it, so whatever the UI is still showing, or a node is
+// still waiting to read, is never handed out twice.
+class TransientImagePool
+{
+public:
+    // An image of the given size and format that nothing else is using, allocating one if needed.
+    std::shared_ptr<Image> Acquire( uint32_t width, uint32_t height, ImageFormat format, ImageStorage storage = ImageStorage::Device );
+
+    // Marks the start of an evaluation, Trim frees whatever went unused since.
+    void NextEpoch();
+    void Trim();
+
+    size_t   GetImageCount() const;
+    uint64_t GetByteSize() const;
+
+private:
+    struct Entry
+    {
+        std::shared_ptr<Image> image;
+        uint64_t               lastEpoch;
+    };
+
+    mutable std::mutex m_mutex;
+    std::vector<Entry> m_entries;
+    uint64_t           m_epoch = 0;
+};
+
+}
@@ -1,5 +1,7 @@
 #include "VulkanUtils.h"
 
+#include <algorithm>
+
 namespace vulkan {
 namespace utils {
 //Taken from sascha willems vulkan tools library https://github.com/SaschaWillems/Vulkan/blob/master/base/VulkanTools.cpp
@@ -160,7 +162,39 @@ void SetImageLayout(VkCommandBuffer cmdbuffer, VkImage image, VkImageAspectFlags
 
 }
 
-VkShaderModule ShaderLoader::LoadShader(VkDevice device, const char *path) {
+namespace {
+// The newest modification time of path and the files it includes, resolved
+// from the Shaders folder the same way FileIncluder does. Sets error if one of
+// them can't be read.
+std::filesystem::file_time_type
+NewestSourceTime(const std::string &path, std::unordered_set<std::string> &visited,
+                 std::error_code &error) {
+  std::filesystem::file_time_type newest = std::filesystem::last_write_time(path, error);
+  if (error || !visited.insert(path).second)
+    return newest;
+
+  std::ifstream file(path);
+  std::string line;
+  while (std::getline(file, line)) {
+    const size_t directive = line.find_first_not_of(" \t");
+    if (directive == std::string::npos || line.compare(directive, 8, "#include") != 0)
+      continue;
+    const size_t begin = line.find('"', directive);
+    const size_t end = begin == std::string::npos ? begin : line.find('"', begin + 1);
+    if (end == std::string::npos)
+      continue;
+    const std::string include = "Shaders/" + line.substr(begin + 1, end - begin - 1);
+    newest = std::max(newest, NewestSourceTime(include, visited, error));
+    if (error)
+      return newest;
+  }
+  return newest;
+}
+}
+
+VkShaderModule ShaderLoader::LoadShader(VkDevice device, const char *path,
+                                        const std::string &variant,
+                                        const std::string &define) {
   std::string tempPath     = path;
   std::string shaderName   = tempPath.rfind("/") != std::string::npos ? tempPath.substr(tempPath.rfind("/")) : tempPath;
   shaderc_shader_kind kind = shaderName.rfind(".frag") != std::string::npos
@@ -168,15 +202,50 @@ VkShaderModule ShaderLoader::LoadShader(VkDevice device, const char *path) {
                                : shaderName.rfind(".vert") != std::string::npos ? shaderc_vertex_shader
 	                           : shaderc_compute_shader;
 
+  const std::string spirvPath = tempPath.substr(0, tempPath.rfind('.')) +
+                                (variant.empty() ? "" : "." + variant) + ".spv";
+  // An edited include makes the SPIR-V as stale as an edited shader does.
+  std::error_code sourceError, spirvError;
+  std::unordered_set<std::string> visited;
+  const auto sourceTime = NewestSourceTime(tempPath, visited, sourceError);
+  const auto spirvTime = std::filesystem::last_write_time(spirvPath, spirvError);
+  if (!spirvError && (sourceError || spirvTime >= sourceTime)) {
+    std::vector<uint32_t> spirv = ReadSpirvFile(spirvPath);
+    if (!spirv.empty()) {
+      return CreateShaderModule(device, spirv);
+    }
+  }
+
+  // No build output to use, e.g. the shader was edited since the last build.
+  //TODO: Hot reload on window re-focus if the source changed.
   std::string source = ReadTextFile(path);
+  std::vector<uint32_t> spirv = CompileShader(shaderName, kind, source, true, define);
+  return CreateShaderModule(device, spirv);
+}
 
-  //TODO: Move runtime compile to actually save the byte code and only compile if the hash differs
-  //      Additionally hot reload on window re-focus if the hash differs.
-  std::vector<uint32_t> spirv = CompileShader(shaderName, kind, source, true);
+std::vector<uint32_t> ShaderLoader::ReadSpirvFile(const std::string &path) {
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file.is_open()) {
+    return {};
+  }
+  const std::streamsize size = file.tellg();
+  if (size <= 0 || size % sizeof(uint32_t) != 0) {
+    fprintf(stderr, "Ignoring %s, it is not a SPIR-V module\n", path.c_str());
+    return {};
+  }
+  std::vector<uint32_t> spirv(static_cast<size_t>(size) / sizeof(uint32_t));
+  file.seekg(0);
+  if (!file.read(reinterpret_cast<char *>(spirv.data()), size)) {
+    return {};
+  }
+  return spirv;
+}
 
+VkShaderModule ShaderLoader::CreateShaderModule(
+    VkDevice device, const std::vector<uint32_t> &spirv) {
   VkShaderModuleCreateInfo createInfo = {
       VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
-  createInfo.codeSize = spirv.size() * sizeof(unsigned int);
+  createInfo.codeSize = spirv.size() * sizeof(uint32_t);
   createInfo.pCode    = spirv.data();
 
   VkShaderModule shaderModule = nullptr;
@@ -185,13 +254,24 @@ VkShaderModule ShaderLoader::LoadShader(VkDevice device, const char *path) {
   return shaderModule;
 }
 
+VkShaderModule ShaderLoader::LoadShaderFromSource(VkDevice device,
+                                                  const char *name,
+                                                  shaderc_shader_kind kind,
+                                                  const std::string &source) {
+  std::vector<uint32_t> spirv = CompileShader(name, kind, source, true, std::string());
+  return CreateShaderModule(device, spirv);
+}
+
 std::vector<uint32_t> ShaderLoader::CompileShader(
     std::string_view shaderName, shaderc_shader_kind kind,
-    const std::string &source, bool optimize) {
+    const std::string &source, bool optimize, const std::string &define) {
   std::unique_ptr<FileIncluder> includer(new FileIncluder());
 
-  // Add any custom defines eg.
-  // options.AddMacroDefinition("MY_DEFINE", "1");
+  // Made for every shader, so the define of one variant doesn't stay set for
+  // the next.
+  shaderc::CompileOptions options;
+  if (!define.empty())
+    options.AddMacroDefinition(define);
   options.SetTargetEnvironment(shaderc_target_env_vulkan,
                                shaderc_env_version_vulkan_1_2);
   options.SetSourceLanguage(shaderc_source_language_glsl);
@@ -201,7 +281,7 @@ std::vector<uint32_t> ShaderLoader::CompileShader(
     options.SetOptimizationLevel(shaderc_optimization_level_size);
 
   std::string processedSource = this->
-      PreprocessShader(shaderName, kind, source);
+      PreprocessShader(shaderName, kind, source, options);
 
   printf("Compiling Shader %s of Type %s\n", shaderName.data(),
             kind == shaderc_fragment_shader ? "Fragment" : "Vertex");
@@ -218,7 +298,8 @@ std::vector<uint32_t> ShaderLoader::CompileShader(
 
 std::string ShaderLoader::PreprocessShader(std::string_view shaderName,
                                            shaderc_shader_kind kind,
-                                           const std::string &source) {
+                                           const std::string &source,
+                                           const shaderc::CompileOptions &options) {
   auto result = compiler.PreprocessGlsl(source, kind, shaderName.data(),
                                         options);
   if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
@@ -263,45 +344,39 @@ std::string ReadTextFile(const std::string_view &fileName) {
   return buffer;
 }
 
+namespace {
+// Owns the strings a shaderc_include_result points at, it comes back through
+// user_data when shaderc releases the include.
+struct IncludeData {
+  std::string source_name;
+  std::string content;
+  shaderc_include_result result;
+};
+}
+
 shaderc_include_result *FileIncluder::GetInclude(
     const char *requested_source, shaderc_include_type include_type,
     const char *requesting_source, size_t) {
 
-  std::string full_path = "";
-  if (include_type == shaderc_include_type_relative) {
-    full_path = "Shaders/" + std::string(requested_source);
-  } else {
-    full_path = "Shaders/" + std::string(requested_source);
-  }
+  std::string full_path = "Shaders/" + std::string(requested_source);
 
-  if (included_files.find(full_path) != included_files.end()) {
-    return included_files.at(full_path);
+  auto *data = new IncludeData();
+  if (std::ifstream(full_path).is_open()) {
+    data->source_name = full_path;
+    data->content = ReadTextFile(full_path);
+  } else {
+    // An empty source name tells shaderc the include failed, content is the error.
+    data->content = "Failed to find shader include " + full_path;
   }
+  data->result = {data->source_name.data(), data->source_name.length(),
+                  data->content.data(), data->content.size(), data};
 
-  std::string includeCode = ReadTextFile(full_path);
-  std::vector<char> contents(includeCode.cbegin(), includeCode.cend());
-
-  // In principle, several threads could be resolving includes at the same
-  // time.  Protect the included_files.
-
-  // Read the file and save its full path and contents into stable addresses.
-
-  auto result = new shaderc_include_result{
-      full_path.data(),
-      full_path.length(),
-      contents.data(),
-      contents.size()
-  };
-
-  included_files.emplace(full_path, result);
-
-  return result;
+  included_files.insert(full_path);
+  return &data->result;
 }
 
 void FileIncluder::ReleaseInclude(shaderc_include_result *include_result) {
-  std::string full_path(include_result->source_name);
-  if (included_files.find(full_path) != included_files.end()) {
-    delete included_files.at(full_path);
-  }
+  delete static_cast<IncludeData *>(include_result->user_data);
+}
 }
 }
\ No newline at end of file
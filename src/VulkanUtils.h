@@ -4,9 +4,11 @@
 #include <shaderc/shaderc.hpp>
 #include <string>
 #include <assert.h>
+#include <filesystem>
 #include <vector>
 #include <fstream>
 #include <unordered_map>
+#include <unordered_set>
 
 #define VK_NONE 0
 
@@ -48,30 +50,45 @@ public:
   void ReleaseInclude(shaderc_include_result *include_result) override;
 
   // Returns a reference to the member storing the set of included files.
-  const std::unordered_map<std::string, shaderc_include_result *> &
-  file_path_trace() const {
+  const std::unordered_set<std::string> &file_path_trace() const {
     return included_files;
   }
 
 
 private:
   // The set of full paths of included files.
-  std::unordered_map<std::string, shaderc_include_result *> included_files;
+  std::unordered_set<std::string> included_files;
 };
 
 struct ShaderLoader {
 public:
-  VkShaderModule LoadShader(VkDevice device, const char *path);
+  // Uses the SPIR-V the build compiled next to path (X.comp -> X.spv) when it
+  // is there and at least as new as the source and everything it includes,
+  // and compiles path otherwise.
+  // A variant of the shader is X.<variant>.spv, or compiled with define set,
+  // the same as the build makes it.
+  VkShaderModule LoadShader(VkDevice device, const char *path,
+                            const std::string &variant = std::string(),
+                            const std::string &define = std::string());
+  // Compiles GLSL generated at runtime, name only shows up in error messages.
+  // Includes are resolved from the Shaders folder the same as for files.
+  VkShaderModule LoadShaderFromSource(VkDevice device, const char *name,
+                                      shaderc_shader_kind kind,
+                                      const std::string &source);
   std::string ReadTextFile(const std::string_view &fileName);
 private:
+  static VkShaderModule CreateShaderModule(VkDevice device,
+                                           const std::vector<uint32_t> &spirv);
+  static std::vector<uint32_t> ReadSpirvFile(const std::string &path);
   shaderc::Compiler compiler;
-  shaderc::CompileOptions options;
   std::vector<uint32_t> CompileShader(std::string_view shaderName,
                                       shaderc_shader_kind kind,
-                                      const std::string &source, bool optimize);
+                                      const std::string &source, bool optimize,
+                                      const std::string &define);
   std::string PreprocessShader(std::string_view shaderName,
                                shaderc_shader_kind kind,
-                               const std::string &source);
+                               const std::string &source,
+                               const shaderc::CompileOptions &options);
 
 };
 